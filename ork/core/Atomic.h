@@ -55,7 +55,7 @@ namespace ork
  * This file defines some atomic operations.
  * Those are supported across MSVC and GCC.
  *
- * Implements needed atomic operations.
+ * Implements needed atomic operations, on long values.
  * - atomic_exchange_and_add(*pw, dv)
  *        adds dv to *pw and returns the old value of pw
  *
@@ -74,19 +74,19 @@ namespace ork
 
 #ifdef SINGLE_THREAD
 
-static FORCE_INLINE int atomic_exchange_and_add(int volatile * pw, int dv)
+static FORCE_INLINE long atomic_exchange_and_add(long volatile * pw, long dv)
 {
-    int r = *pw;
+    long r = *pw;
     *pw += dv;
     return r;
 }
 
-static FORCE_INLINE void atomic_increment(int volatile * pw)
+static FORCE_INLINE void atomic_increment(long volatile * pw)
 {
     (*pw)++;
 }
 
-static FORCE_INLINE int atomic_decrement(int volatile * pw)
+static FORCE_INLINE long atomic_decrement(long volatile * pw)
 {
     return (*pw)--;
 }
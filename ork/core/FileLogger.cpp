@@ -43,7 +43,6 @@
 
 #include <ctime>
 
-#include <pthread.h>
 #include <string.h>
 
 using namespace std;
@@ -120,54 +119,58 @@ FileLogger::~FileLogger()
 
 void FileLogger::log(const string &topic, const string &msg)
 {
-    if (hasTopic(topic)) {
-        time_t rawtime;
-        char timestring[256];
+    Logger::log(topic, msg);
+    if (next != NULL) {
+        next->log(topic, msg);
+    }
+}
 
-        time(&rawtime);
+void FileLogger::write(const string &topic, const string &msg)
+{
+    time_t rawtime;
+    char timestring[256];
+
+    time(&rawtime);
 #ifdef _MSC_VER
-        struct tm timeinfo;
-        localtime_s(&timeinfo, &rawtime);
-        strftime(timestring, 256, "%H:%M:%S", &timeinfo);
+    struct tm timeinfo;
+    localtime_s(&timeinfo, &rawtime);
+    strftime(timestring, 256, "%H:%M:%S", &timeinfo);
 #else
-        struct tm *timeinfo = localtime(&rawtime);
-        strftime(timestring, 256, "%H:%M:%S", timeinfo);
+    struct tm *timeinfo = localtime(&rawtime);
+    strftime(timestring, 256, "%H:%M:%S", timeinfo);
 #endif
 
-        pthread_mutex_lock((pthread_mutex_t*) mutex);
-        fstream &o = out->stream;
-        o << "<tr><td class=\"DATE\">" << timestring << "</td>\n";
-        o << "<td class=\"" << type << "\">[" << topic << "] ";
-        bool pre = false;
-        bool bold = false;
-        for (string::const_iterator it = msg.begin(); it < msg.end(); it++) {
-            char c = *it;
-            if (c == '\033') {
-                o << (pre ? "</pre>" : "<pre>");
-                pre = !pre;
-            } else if (c == '\'') {
-                o << (bold ? "</b>" : "<b>");
-                bold = !bold;
-            } else if (c == '<') {
-                o << "&lt;";
-            } else if (c == '>') {
-                o << "&gt;";
-            } else {
-                o << c;
-            }
+    fstream &o = out->stream;
+    o << "<tr><td class=\"DATE\">" << timestring << "</td>\n";
+    o << "<td class=\"" << type << "\">[" << topic << "] ";
+    bool pre = false;
+    bool bold = false;
+    for (string::const_iterator it = msg.begin(); it < msg.end(); it++) {
+        char c = *it;
+        if (c == '\033') {
+            o << (pre ? "</pre>" : "<pre>");
+            pre = !pre;
+        } else if (c == '\'') {
+            o << (bold ? "</b>" : "<b>");
+            bold = !bold;
+        } else if (c == '<') {
+            o << "&lt;";
+        } else if (c == '>') {
+            o << "&gt;";
+        } else {
+            o << c;
         }
-        o << "</td></tr>\n";
-        o.flush();
-        pthread_mutex_unlock((pthread_mutex_t*) mutex);
     }
-
-    if (next != NULL) {
-        next->log(topic, msg);
+    o << "</td></tr>\n";
+    if (!isAsynchronous()) {
+        o.flush();
     }
 }
 
 void FileLogger::flush()
 {
+    waitQueuedMessages();
+    out->stream.flush();
     out->flush();
 }
 
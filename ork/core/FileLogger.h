@@ -128,7 +128,8 @@ public:
     virtual ~FileLogger();
 
     /**
-     * Writes the given message to the file used by this logger.
+     * Logs the given message with Logger#log, and forwards it to the next
+     * logger.
      */
     virtual void log(const std::string &topic, const std::string &msg);
 
@@ -138,6 +139,11 @@ public:
     virtual void flush();
 
 protected:
+    /**
+     * Writes the given message to the file used by this logger, in html.
+     */
+    virtual void write(const std::string &topic, const std::string &msg);
+
     /**
      * The File to which this logger logs its messages.
      */
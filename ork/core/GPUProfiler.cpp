@@ -0,0 +1,299 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#include "ork/core/GPUProfiler.h"
+
+#include <deque>
+
+#include "GL/glew.h"
+
+using namespace std;
+
+namespace ork
+{
+
+/**
+ * Maximum number of frames whose queries can be pending. The queries of a
+ * frame that are still not completed after this number of frames are
+ * discarded.
+ */
+static const unsigned int GPU_PROFILER_FRAMES = 4;
+
+/**
+ * Number of frames whose results are kept after they have been read back.
+ */
+static const unsigned int GPU_PROFILER_RESULTS = 8;
+
+/**
+ * A zone whose queries are not yet read back.
+ */
+struct GPUProfilerZone
+{
+    const char *name; ///< the zone name.
+
+    const void *owner; ///< the zone owner.
+
+    GLuint begin; ///< the timestamp query issued at the beginning of the zone.
+
+    GLuint end; ///< the timestamp query issued at the end of the zone, or 0.
+};
+
+/**
+ * The zones of a frame whose queries are not yet read back.
+ */
+struct GPUProfilerFrame
+{
+    unsigned int frame; ///< the frame number.
+
+    vector<GPUProfilerZone> zones; ///< the zones of this frame.
+
+    GLuint last; ///< the last query issued in this frame, or 0.
+};
+
+/**
+ * The results of a frame that has been read back.
+ */
+struct GPUProfilerResult
+{
+    unsigned int frame; ///< the frame number.
+
+    vector<GPUProfiler::Sample> samples; ///< the zone results.
+};
+
+bool GPUProfiler::ENABLED = false;
+
+/**
+ * The current frame number.
+ */
+static unsigned int gpuProfilerFrame = 0;
+
+/**
+ * The frames whose queries are pending, from oldest to newest. The last one
+ * is the current frame.
+ */
+static deque<GPUProfilerFrame> gpuProfilerFrames;
+
+/**
+ * The indices, in the current frame, of the zones currently begun.
+ */
+static vector<unsigned int> gpuProfilerStack;
+
+/**
+ * The unused queries.
+ */
+static vector<GLuint> gpuProfilerQueries;
+
+/**
+ * The results of the last frames that have been read back.
+ */
+static deque<GPUProfilerResult> gpuProfilerResults;
+
+/**
+ * Returns an unused query from the pool, or a new one if the pool is empty.
+ */
+static GLuint newGPUProfilerQuery()
+{
+    GLuint q;
+    if (gpuProfilerQueries.empty()) {
+        glGenQueries(1, &q);
+    } else {
+        q = gpuProfilerQueries.back();
+        gpuProfilerQueries.pop_back();
+    }
+    return q;
+}
+
+/**
+ * Returns the queries of the given frame to the pool.
+ */
+static void releaseGPUProfilerQueries(GPUProfilerFrame &f)
+{
+    for (unsigned int i = 0; i < f.zones.size(); ++i) {
+        gpuProfilerQueries.push_back(f.zones[i].begin);
+        if (f.zones[i].end != 0) {
+            gpuProfilerQueries.push_back(f.zones[i].end);
+        }
+    }
+    f.zones.clear();
+}
+
+/**
+ * Returns the current frame.
+ */
+static GPUProfilerFrame &getGPUProfilerFrame()
+{
+    if (gpuProfilerFrames.empty() || gpuProfilerFrames.back().frame != gpuProfilerFrame) {
+        gpuProfilerFrames.push_back(GPUProfilerFrame());
+        gpuProfilerFrames.back().frame = gpuProfilerFrame;
+        gpuProfilerFrames.back().last = 0;
+    }
+    return gpuProfilerFrames.back();
+}
+
+void GPUProfiler::setEnabled(bool enabled)
+{
+    ENABLED = enabled;
+}
+
+void GPUProfiler::begin(const char *name)
+{
+    GPUProfilerFrame &f = getGPUProfilerFrame();
+    GPUProfilerZone z;
+    z.name = name;
+    z.owner = NULL;
+    z.begin = newGPUProfilerQuery();
+    z.end = 0;
+    glQueryCounter(z.begin, GL_TIMESTAMP);
+    f.last = z.begin;
+    gpuProfilerStack.push_back((unsigned int) f.zones.size());
+    f.zones.push_back(z);
+}
+
+void GPUProfiler::end()
+{
+    if (gpuProfilerStack.empty()) {
+        return;
+    }
+    GPUProfilerFrame &f = gpuProfilerFrames.back();
+    GPUProfilerZone &z = f.zones[gpuProfilerStack.back()];
+    gpuProfilerStack.pop_back();
+    z.end = newGPUProfilerQuery();
+    glQueryCounter(z.end, GL_TIMESTAMP);
+    f.last = z.end;
+}
+
+void GPUProfiler::setOwner(const void *owner)
+{
+    if (!gpuProfilerStack.empty()) {
+        gpuProfilerFrames.back().zones[gpuProfilerStack.back()].owner = owner;
+    }
+}
+
+void GPUProfiler::endFrame()
+{
+    // registers the current frame, even if it does not contain any zone, so
+    // that its (empty) results become available like for other frames
+    getGPUProfilerFrame();
+    // zones that are not ended at the end of a frame are ignored
+    gpuProfilerStack.clear();
+    ++gpuProfilerFrame;
+
+    // timestamp queries complete in the order they are issued, so we only
+    // need to test the last query of each frame, from oldest to newest
+    while (!gpuProfilerFrames.empty()) {
+        GPUProfilerFrame &f = gpuProfilerFrames.front();
+        if (f.last != 0) {
+            GLuint available = 0;
+            glGetQueryObjectuiv(f.last, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available == 0) {
+                if (gpuProfilerFrame - f.frame < GPU_PROFILER_FRAMES) {
+                    break;
+                }
+                // too many frames are pending, this one is discarded
+                releaseGPUProfilerQueries(f);
+                gpuProfilerFrames.pop_front();
+                continue;
+            }
+        }
+        vector<GLuint64> times(2 * f.zones.size());
+        GLuint64 origin = 0;
+        for (unsigned int i = 0; i < f.zones.size(); ++i) {
+            if (f.zones[i].end != 0) {
+                glGetQueryObjectui64v(f.zones[i].begin, GL_QUERY_RESULT, &times[2 * i]);
+                glGetQueryObjectui64v(f.zones[i].end, GL_QUERY_RESULT, &times[2 * i + 1]);
+                if (origin == 0 || times[2 * i] < origin) {
+                    origin = times[2 * i];
+                }
+            }
+        }
+        GPUProfilerResult r;
+        r.frame = f.frame;
+        for (unsigned int i = 0; i < f.zones.size(); ++i) {
+            if (f.zones[i].end != 0) {
+                Sample s;
+                s.name = f.zones[i].name;
+                s.owner = f.zones[i].owner;
+                s.start = (float) ((times[2 * i] - origin) * 1e-3);
+                s.duration = (float) ((times[2 * i + 1] - times[2 * i]) * 1e-3);
+                r.samples.push_back(s);
+            }
+        }
+        releaseGPUProfilerQueries(f);
+        gpuProfilerFrames.pop_front();
+        gpuProfilerResults.push_back(r);
+        if (gpuProfilerResults.size() > GPU_PROFILER_RESULTS) {
+            gpuProfilerResults.pop_front();
+        }
+    }
+}
+
+unsigned int GPUProfiler::getFrame()
+{
+    return gpuProfilerFrame;
+}
+
+bool GPUProfiler::getSamples(unsigned int frame, vector<Sample> &samples)
+{
+    for (unsigned int i = 0; i < gpuProfilerResults.size(); ++i) {
+        if (gpuProfilerResults[i].frame == frame) {
+            samples = gpuProfilerResults[i].samples;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool GPUProfiler::getStatistics(unsigned int frame, map< string, pair<int, float> > &statistics)
+{
+    vector<Sample> samples;
+    if (!getSamples(frame, samples)) {
+        return false;
+    }
+    statistics.clear();
+    for (unsigned int i = 0; i < samples.size(); ++i) {
+        pair<int, float> &s = statistics[samples[i].name];
+        s.first += 1;
+        s.second += samples[i].duration;
+    }
+    return true;
+}
+
+}
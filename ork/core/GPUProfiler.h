@@ -0,0 +1,196 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#ifndef _ORK_GPU_PROFILER_H_
+#define _ORK_GPU_PROFILER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ork
+{
+
+/**
+ * A GPU profiler. Like Profiler, it measures nested code regions, but it
+ * measures the time spent by the GPU to execute the OpenGL commands issued in
+ * these regions, with timestamp queries. Unlike GPUTimer, it never waits for
+ * the GPU: the queries of each frame are read back a few frames later, when
+ * their results are available. The queries are taken from a pool, so that no
+ * OpenGL objects are created in steady state. This class must only be used
+ * in the OpenGL thread.
+ *
+ * The MultithreadScheduler measures each GPU task with a zone named after the
+ * task type, and calls #endFrame at the end of each frame. Tasks related to a
+ * scene node can attribute their zone to this node with #setOwner.
+ * @ingroup core
+ */
+class ORK_API GPUProfiler
+{
+public:
+    /**
+     * A profiled code region. A zone begins when it is created and ends when
+     * it is destroyed.
+     */
+    class ORK_API Zone
+    {
+    public:
+        /**
+         * Begins a new zone, if the profiler is enabled.
+         *
+         * @param name the name of this zone, or NULL to not measure anything.
+         *      This string is not copied, it must remain valid while the
+         *      results of the current frame are available.
+         */
+        inline Zone(const char *name) : active(name != NULL && GPUProfiler::isEnabled())
+        {
+            if (active) {
+                GPUProfiler::begin(name);
+            }
+        }
+
+        /**
+         * Ends this zone.
+         */
+        inline ~Zone()
+        {
+            if (active) {
+                GPUProfiler::end();
+            }
+        }
+
+    private:
+        /**
+         * True if this zone was begun while the profiler was enabled.
+         */
+        bool active;
+    };
+
+    /**
+     * The GPU time measured for a zone.
+     */
+    struct Sample
+    {
+        const char *name; ///< the zone name.
+
+        const void *owner; ///< the zone owner (see #setOwner), or NULL.
+
+        float start; ///< the zone start time, in micro seconds since the first zone of its frame.
+
+        float duration; ///< the zone duration, in micro seconds.
+    };
+
+    /**
+     * Returns true if the profiler is enabled.
+     */
+    static inline bool isEnabled()
+    {
+        return ENABLED;
+    }
+
+    /**
+     * Enables or disables the profiler.
+     */
+    static void setEnabled(bool enabled);
+
+    /**
+     * Begins a zone. Each call must be matched by a call to #end() in the same
+     * frame. Zone should be used instead.
+     *
+     * @param name the name of the zone (see Zone#Zone).
+     */
+    static void begin(const char *name);
+
+    /**
+     * Ends the last begun zone.
+     */
+    static void end();
+
+    /**
+     * Sets the owner of the innermost zone currently begun, if any. This can
+     * be used to attribute the GPU time of a task to a scene node, for
+     * instance. The owner is only used as a key, it is never dereferenced.
+     */
+    static void setOwner(const void *owner);
+
+    /**
+     * Ends the current frame, and reads back the results of the previous
+     * frames whose queries are completed. This method never blocks. If the
+     * results of a frame are still not available after several frames, this
+     * frame is discarded.
+     */
+    static void endFrame();
+
+    /**
+     * Returns the number of the current frame (incremented by #endFrame).
+     */
+    static unsigned int getFrame();
+
+    /**
+     * Returns the GPU times measured for the zones of the given frame.
+     *
+     * @param frame a frame number (see #getFrame).
+     * @param[out] samples the GPU times of the zones of this frame, in the
+     *      order the zones began.
+     * @return false if the results of this frame are not yet available, or
+     *      are no longer available. Only the last few frames are kept.
+     */
+    static bool getSamples(unsigned int frame, std::vector<Sample> &samples);
+
+    /**
+     * Returns the number of zones and the total GPU time for each zone name,
+     * for the given frame. The times are in micro seconds.
+     *
+     * @return false if the results of this frame are not available (see
+     *      #getSamples).
+     */
+    static bool getStatistics(unsigned int frame, std::map< std::string, std::pair<int, float> > &statistics);
+
+private:
+    /**
+     * True if the profiler is enabled.
+     */
+    static bool ENABLED;
+};
+
+}
+
+#endif
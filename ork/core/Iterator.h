@@ -44,6 +44,7 @@
 
 #include <set>
 #include <map>
+#include <vector>
 
 namespace ork
 {
@@ -236,6 +237,62 @@ private:
     static std::multimap<key,type> emptyMap;
 };
 
+/**
+ * A vector iterator.
+ * @ingroup core
+ */
+template <typename type>
+class VectorIterator
+{
+public:
+    /**
+     * Creates a vector iterator for an empty vector.
+     */
+    VectorIterator();
+
+    /**
+     * Creates a vector iterator for the given vector.
+     */
+    VectorIterator(std::vector<type> &c);
+
+    /**
+     * Returns the size of the vector for which this iterator has been created.
+     */
+    unsigned int size();
+
+    /**
+     * Returns true if the iteration is not yet finished.
+     */
+    bool hasNext();
+
+    /**
+     * Returns the element at the current iterator position.
+     * The iterator position is then incremented.
+     */
+    type next();
+
+private:
+    /**
+     * The size of the vector for which this iterator has been created.
+     */
+    unsigned int n;
+
+    /**
+     * The current iterator position.
+     */
+    typename std::vector<type>::iterator i;
+
+    /**
+     * The iterator position corresponding to the end of the vector.
+     */
+    typename std::vector<type>::iterator end;
+
+    /**
+     * The empty vector used for creating empty iterators.
+     */
+    static std::vector<type> emptyVector;
+};
+
 template <typename type>
 SetIterator<type>::SetIterator() : n(0), i(emptySet.begin()), end(emptySet.end())
 {
@@ -353,6 +410,37 @@ type MultiMapIterator<key, type>::next(key &k)
 template <typename key, typename type>
 std::multimap<key,type> MultiMapIterator<key, type>::emptyMap;
 
+template <typename type>
+VectorIterator<type>::VectorIterator() : n(0), i(emptyVector.begin()), end(emptyVector.end())
+{
+}
+
+template <typename type>
+VectorIterator<type>::VectorIterator(std::vector<type> &c) : n((unsigned int)c.size()), i(c.begin()), end(c.end())
+{
+}
+
+template <typename type>
+unsigned int VectorIterator<type>::size()
+{
+    return n;
+}
+
+template <typename type>
+bool VectorIterator<type>::hasNext()
+{
+    return i != end;
+}
+
+template <typename type>
+type VectorIterator<type>::next()
+{
+    return *(i++);
+}
+
+template <typename type>
+std::vector<type> VectorIterator<type>::emptyVector;
+
 }
 
 #endif
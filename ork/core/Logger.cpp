@@ -42,16 +42,328 @@
 #include "ork/core/Logger.h"
 
 #include <iostream>
+#include <vector>
 
 #include <pthread.h>
 #include <cstdarg>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "ork/core/Atomic.h"
 
 using namespace std;
 
 namespace ork
 {
 
+/**
+ * Maximum number of distinct topics that can be selected with
+ * Logger#addTopic, i.e., the number of bits of Logger#topics.
+ */
+static const int MAX_TOPICS = 32;
+
+/**
+ * Number of slots of the hash table of selected topics. This must be a power
+ * of two, greater than #MAX_TOPICS so that the table is never full.
+ */
+static const int TOPIC_TABLE_SIZE = 2 * MAX_TOPICS;
+
+/**
+ * Maximum size of a topic, in asynchronous mode.
+ */
+static const int MAX_TOPIC_SIZE = 64;
+
+/**
+ * Number of messages in the queue of each thread, in asynchronous mode.
+ */
+static const int LOG_QUEUE_SIZE = 256;
+
+/**
+ * Maximum size of a message, in asynchronous mode and in Logger#logf.
+ */
+static const int MAX_LOG_SIZE = 512;
+
+/**
+ * A queued message.
+ */
+struct LogEntry
+{
+    ptr<Logger> logger; ///< the logger that must write this message.
+
+    char topic[MAX_TOPIC_SIZE]; ///< the topic of this message, possibly truncated.
+
+    long sequence; ///< the global order of this message.
+
+    char msg[MAX_LOG_SIZE]; ///< the message, possibly truncated.
+};
+
+/**
+ * The messages queued by a thread. Only the thread that owns the queue adds
+ * messages and increments #head, and only the writer thread removes messages
+ * and increments #tail, so that no lock is needed.
+ */
+struct LogQueue
+{
+    LogEntry entries[LOG_QUEUE_SIZE]; ///< ring buffer of queued messages.
+
+    volatile long head; ///< number of messages added to this queue.
+
+    volatile long tail; ///< number of messages removed from this queue.
+
+    LogQueue() : head(0), tail(0)
+    {
+    }
+};
+
+/**
+ * The topics selected with Logger#addTopic, and their hash code, indexed by
+ * topic id. They are never modified once added.
+ */
+static string topicNames[MAX_TOPICS];
+
+static unsigned int topicHashes[MAX_TOPICS];
+
+/**
+ * The number of selected topics. Only accessed with #logMutex locked.
+ */
+static int topicCount = 0;
+
+/**
+ * Hash table of the selected topics, with linear probing. Each slot contains 0
+ * if it is empty, or a topic id plus one. A slot is filled with an atomic
+ * operation after the name and hash code of its topic are set, so that the
+ * table can be read without locking.
+ */
+static volatile long topicTable[TOPIC_TABLE_SIZE];
+
+/**
+ * Mutex used to add topics and queues.
+ */
+static pthread_mutex_t logMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * The key used to get the LogQueue of the current thread.
+ */
+static pthread_key_t logQueueKey;
+
+static pthread_once_t logQueueKeyOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * The LogQueue of all the threads that have logged messages in asynchronous
+ * mode. They are never deleted, so that messages of terminated threads can
+ * still be written.
+ */
+static vector<LogQueue*> logQueues;
+
+/**
+ * Counter used to order the queued messages of all threads.
+ */
+static volatile long logSequence = 0;
+
+/**
+ * Number of messages dropped because their queue was full.
+ */
+static volatile long droppedMessages = 0;
+
+/**
+ * True if messages are logged asynchronously.
+ */
+static volatile bool asynchronous = false;
+
+/**
+ * True while the writer thread must run.
+ */
+static volatile bool writerRunning = false;
+
+/**
+ * The writer thread.
+ */
+static pthread_t writerThread;
+
+/**
+ * Returns the hash code of the given topic (FNV-1a).
+ */
+static unsigned int getTopicHash(const string &topic)
+{
+    unsigned int h = 2166136261u;
+    for (unsigned int i = 0; i < topic.size(); ++i) {
+        h = (h ^ (unsigned char) topic[i]) * 16777619u;
+    }
+    return h;
+}
+
+/**
+ * Returns the id of the given topic, or -1 if it has not been selected by
+ * any logger. In general, this compares the topic with at most one selected
+ * topic.
+ *
+ * @param topic a topic.
+ * @param hash the hash code of this topic.
+ * @param[out] slot the slot of topicTable where the topic was found, or the
+ *      empty slot where it can be inserted.
+ */
+static int findTopicId(const string &topic, unsigned int hash, int &slot)
+{
+    slot = int(hash & (TOPIC_TABLE_SIZE - 1));
+    while (true) {
+        long s = atomic_exchange_and_add(&topicTable[slot], 0);
+        if (s == 0) {
+            return -1;
+        }
+        int id = int(s - 1);
+        if (topicHashes[id] == hash && topicNames[id] == topic) {
+            return id;
+        }
+        slot = (slot + 1) & (TOPIC_TABLE_SIZE - 1);
+    }
+}
+
+/**
+ * Returns the id of the given topic, adding it if necessary, or -1 if there
+ * are already #MAX_TOPICS topics.
+ */
+static int addTopicId(const string &topic)
+{
+    unsigned int hash = getTopicHash(topic);
+    int slot;
+    pthread_mutex_lock(&logMutex);
+    int id = findTopicId(topic, hash, slot);
+    if (id == -1 && topicCount < MAX_TOPICS) {
+        id = topicCount++;
+        topicNames[id] = topic;
+        topicHashes[id] = hash;
+        // publishes the topic to the readers (this is a memory barrier)
+        atomic_exchange_and_add(&topicTable[slot], id + 1);
+    }
+    pthread_mutex_unlock(&logMutex);
+    return id;
+}
+
+static void sleepLogWriter()
+{
+#ifdef _WIN32
+    Sleep(1);
+#else
+    usleep(1000);
+#endif
+}
+
+/**
+ * The background writer thread, used in asynchronous mode.
+ */
+class LogWriter
+{
+public:
+    /**
+     * Writes the oldest message of all the queues, if any.
+     *
+     * @return false if all the queues are empty.
+     */
+    static bool writeNext()
+    {
+        pthread_mutex_lock(&logMutex);
+        LogQueue *next = NULL;
+        long sequence = 0;
+        for (unsigned int i = 0; i < logQueues.size(); ++i) {
+            LogQueue *q = logQueues[i];
+            long head = atomic_exchange_and_add(&q->head, 0);
+            if (head != q->tail) {
+                LogEntry &e = q->entries[q->tail % LOG_QUEUE_SIZE];
+                if (next == NULL || e.sequence - sequence < 0) {
+                    next = q;
+                    sequence = e.sequence;
+                }
+            }
+        }
+        pthread_mutex_unlock(&logMutex);
+        if (next == NULL) {
+            return false;
+        }
+        LogEntry &e = next->entries[next->tail % LOG_QUEUE_SIZE];
+        Logger *logger = e.logger.get();
+        pthread_mutex_lock((pthread_mutex_t*) logger->mutex);
+        logger->write(e.topic, e.msg);
+        pthread_mutex_unlock((pthread_mutex_t*) logger->mutex);
+        e.logger = NULL;
+        atomic_increment(&next->tail);
+        return true;
+    }
+
+    static void *run(void * /*arg*/)
+    {
+        while (writerRunning) {
+            if (!writeNext()) {
+                sleepLogWriter();
+            }
+        }
+        return NULL;
+    }
+
+    /**
+     * Stops the writer thread, and writes the remaining messages.
+     */
+    static void stop()
+    {
+        if (writerRunning) {
+            writerRunning = false;
+            pthread_join(writerThread, NULL);
+        }
+        while (writeNext()) {
+        }
+    }
+};
+
+/**
+ * Writes the queued messages at exit.
+ */
+static void stopLogWriter()
+{
+    asynchronous = false;
+    LogWriter::stop();
+}
+
+static void createLogQueueKey()
+{
+    pthread_key_create(&logQueueKey, NULL);
+}
+
+/**
+ * Adds a message to the queue of the current thread.
+ */
+static void queueMessage(Logger *logger, const string &topic, const string &msg)
+{
+    pthread_once(&logQueueKeyOnce, createLogQueueKey);
+    LogQueue *q = (LogQueue*) pthread_getspecific(logQueueKey);
+    if (q == NULL) {
+        q = new LogQueue();
+        pthread_mutex_lock(&logMutex);
+        logQueues.push_back(q);
+        pthread_mutex_unlock(&logMutex);
+        pthread_setspecific(logQueueKey, q);
+    }
+    long tail = atomic_exchange_and_add(&q->tail, 0);
+    if (q->head - tail >= LOG_QUEUE_SIZE) {
+        atomic_increment(&droppedMessages);
+        return;
+    }
+    LogEntry &e = q->entries[q->head % LOG_QUEUE_SIZE];
+    e.logger = logger;
+    strncpy(e.topic, topic.c_str(), MAX_TOPIC_SIZE - 1);
+    e.topic[MAX_TOPIC_SIZE - 1] = 0;
+    e.sequence = atomic_exchange_and_add(&logSequence, 1);
+    strncpy(e.msg, msg.c_str(), MAX_LOG_SIZE - 1);
+    e.msg[MAX_LOG_SIZE - 1] = 0;
+    // publishes the message to the writer thread (this is a memory barrier)
+    atomic_increment(&q->head);
+}
+
 static_ptr<Logger> Logger::DEBUG_LOGGER(NULL);
 
 static_ptr<Logger> Logger::INFO_LOGGER(new Logger("INFO"));
@@ -60,7 +372,7 @@ static_ptr<Logger> Logger::WARNING_LOGGER(new Logger("WARNING"));
 
 static_ptr<Logger> Logger::ERROR_LOGGER(new Logger("ERROR"));
 
-Logger::Logger(const string &type) : Object("Logger"), type(type)
+Logger::Logger(const string &type) : Object("Logger"), type(type), topics(0)
 {
     mutex = new pthread_mutex_t;
     pthread_mutex_init((pthread_mutex_t*) mutex, NULL);
@@ -74,40 +386,118 @@ Logger::~Logger()
 
 void Logger::addTopic(const string &topic)
 {
-    topics = topics + topic + ";";
+    int id = addTopicId(topic);
+    if (id == -1) {
+        if (ERROR_LOGGER != NULL) {
+            ERROR_LOGGER->log("ORK", "Too many logger topics, cannot add topic '" + topic + "'");
+        }
+        return;
+    }
+    long bit = long(1u << id);
+    // the mutex serializes the updates of topics, which is read without
+    // locking by #hasTopic
+    pthread_mutex_lock((pthread_mutex_t*) mutex);
+    if ((topics & bit) == 0) {
+        atomic_exchange_and_add(&topics, bit);
+    }
+    pthread_mutex_unlock((pthread_mutex_t*) mutex);
 }
 
 bool Logger::hasTopic(const string &topic)
 {
-    return topics.size() == 0 || topics.find(topic, 0) != string::npos;
+    long t = topics;
+    if (t == 0) {
+        return true;
+    }
+    int slot;
+    int id = findTopicId(topic, getTopicHash(topic), slot);
+    return id != -1 && (t & long(1u << id)) != 0;
 }
 
 void Logger::log(const string &topic, const string &msg)
 {
     if (hasTopic(topic)) {
-        pthread_mutex_lock((pthread_mutex_t*) mutex);
-        cerr << type << " [" << topic << "] " << msg << endl;
-        pthread_mutex_unlock((pthread_mutex_t*) mutex);
+        if (asynchronous) {
+            queueMessage(this, topic, msg);
+        } else {
+            pthread_mutex_lock((pthread_mutex_t*) mutex);
+            write(topic, msg);
+            pthread_mutex_unlock((pthread_mutex_t*) mutex);
+        }
     }
 }
 
 void Logger::logf(const char * topic, const char *fmt, ...)
 {
-    static const int MAX_LOG_SIZE = 512;
     char buf[MAX_LOG_SIZE];
 
     va_list vl;
     va_start(vl, fmt);
     vsnprintf(buf, MAX_LOG_SIZE, fmt, vl);
     va_end(vl);
-    std::string topicStr = topic;
-    std::string msgStr = buf;
-    log(topicStr, msgStr);
+    log(topic, buf);
 }
 
 void Logger::flush()
 {
+    waitQueuedMessages();
     cerr.flush();
 }
 
+void Logger::write(const string &topic, const string &msg)
+{
+    cerr << type << " [" << topic << "] " << msg << '\n';
+}
+
+void Logger::setAsynchronous(bool async)
+{
+    pthread_mutex_lock(&logMutex);
+    bool started = writerRunning;
+    pthread_mutex_unlock(&logMutex);
+    if (async && !started) {
+        static bool registered = false;
+        if (!registered) {
+            atexit(stopLogWriter);
+            registered = true;
+        }
+        writerRunning = true;
+        pthread_create(&writerThread, NULL, LogWriter::run, NULL);
+    }
+    asynchronous = async;
+    if (!async && started) {
+        LogWriter::stop();
+    }
+}
+
+bool Logger::isAsynchronous()
+{
+    return asynchronous;
+}
+
+unsigned int Logger::getDroppedMessages()
+{
+    return (unsigned int) droppedMessages;
+}
+
+void Logger::waitQueuedMessages()
+{
+    if (!writerRunning || pthread_equal(pthread_self(), writerThread)) {
+        return;
+    }
+    while (true) {
+        bool empty = true;
+        pthread_mutex_lock(&logMutex);
+        for (unsigned int i = 0; i < logQueues.size(); ++i) {
+            if (atomic_exchange_and_add(&logQueues[i]->head, 0) != logQueues[i]->tail) {
+                empty = false;
+            }
+        }
+        pthread_mutex_unlock(&logMutex);
+        if (empty || !writerRunning) {
+            return;
+        }
+        sleepLogWriter();
+    }
+}
+
 }
@@ -54,6 +54,12 @@ namespace ork
  * #ERROR_LOGGER. Each message has a topic. By default a logger logs all
  * messages, whatever their topic, but it is possible to restrict logging to
  * some topics only with #addTopic.
+ *
+ * By default messages are written synchronously by #log. In asynchronous mode
+ * (see #setAsynchronous), #log only copies the message in a fixed size queue
+ * owned by the calling thread, without any locking, and a background thread
+ * writes the queued messages with #write. If a queue is full, new messages
+ * from this thread are dropped (see #getDroppedMessages).
  * @ingroup core
  */
 class ORK_API Logger : public Object
@@ -93,7 +99,9 @@ public:
      * Adds the given topic to the list of topics managed by this logger.
      * By default a logger logs all messages, whatever their topic. But if at
      * least one topic is selected by this method, only messages whose topic
-     * has been selected by this method will be logged.
+     * has been selected by this method will be logged. At most 32 distinct
+     * topics can be selected, for all loggers; additional topics are rejected
+     * with an error message.
      */
     void addTopic(const std::string &topic);
 
@@ -104,8 +112,9 @@ public:
 
     /**
      * Logs a message given by its topic and its content. The default
-     * implementation of this method sends the message to the standard error
-     * output stream cerr.
+     * implementation of this method calls #write with the message if its topic
+     * is handled by this logger, either directly or, in asynchronous mode,
+     * from the background writer thread.
      */
     virtual void log(const std::string &topic, const std::string &msg);
 
@@ -121,10 +130,29 @@ public:
     void logf(const char * topic, const char *fmt, ...);
 
     /**
-     * Flushes the buffer of this logger, if any.
+     * Flushes the buffer of this logger, if any. In asynchronous mode, this
+     * first waits until all the queued messages have been written.
      */
     virtual void flush();
 
+    /**
+     * Sets the logging mode of all loggers. In asynchronous mode the messages
+     * are written by a background thread. Leaving this mode, or exiting the
+     * application, writes the messages that are still queued.
+     */
+    static void setAsynchronous(bool async);
+
+    /**
+     * Returns true if messages are logged asynchronously.
+     */
+    static bool isAsynchronous();
+
+    /**
+     * Returns the number of messages dropped because the queue of their thread
+     * was full, in asynchronous mode.
+     */
+    static unsigned int getDroppedMessages();
+
 protected:
     /**
      * The type of this logger (debug, info, warning, error, etc).
@@ -132,15 +160,32 @@ protected:
     const std::string type;
 
     /**
-     * The topics handled by this logger, separated by semi-columns.
-     * An empty string means that all topics are handled.
+     * The topics handled by this logger, as a bit mask of topic ids.
+     * 0 means that all topics are handled. This mask is updated atomically,
+     * and can be read from any thread without locking.
      */
-    std::string topics;
+    volatile long topics;
 
     /**
      * A mutex to access this logger from multiple threads.
      */
     void *mutex;
+
+    /**
+     * Writes a message given by its topic and its content. This method is
+     * called by #log, with #mutex locked, or by the background writer thread
+     * in asynchronous mode. The default implementation sends the message to
+     * the standard error output stream cerr.
+     */
+    virtual void write(const std::string &topic, const std::string &msg);
+
+    /**
+     * Waits until all the queued messages have been written, in asynchronous
+     * mode. Does nothing otherwise.
+     */
+    static void waitQueuedMessages();
+
+    friend class LogWriter;
 };
 
 }
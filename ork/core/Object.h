@@ -242,9 +242,10 @@ private:
 
 #ifndef USE_SHARED_PTR
     /**
-     * The number of references to this object.
+     * The number of references to this object. A long, as expected by the
+     * atomic operations of Atomic.h.
      */
-    int references;
+    long references;
 #endif
 
 #ifndef NDEBUG
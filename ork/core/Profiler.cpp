@@ -0,0 +1,283 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#include "ork/core/Profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include <pthread.h>
+
+#if defined( _WIN64 ) || defined( _WIN32 )
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+using namespace std;
+
+namespace ork
+{
+
+/**
+ * Maximum number of completed zones kept for each thread.
+ */
+static const unsigned int PROFILER_CAPACITY = 65536;
+
+/**
+ * Maximum nesting depth of the recorded zones. Deeper zones are ignored.
+ */
+static const int PROFILER_MAX_DEPTH = 64;
+
+/**
+ * A completed zone.
+ */
+struct ProfilerZone
+{
+    const char *name; ///< the zone name.
+
+    double start; ///< the zone start time, in micro seconds.
+
+    double duration; ///< the zone duration, in micro seconds.
+};
+
+/**
+ * The zones recorded by a thread. These buffers are only accessed by their
+ * thread, except in Profiler#clear and Profiler#writeChromeTrace.
+ */
+struct ProfilerThread
+{
+    int id; ///< the thread id in the exported traces.
+
+    string name; ///< the thread name in the exported traces.
+
+    vector<ProfilerZone> zones; ///< ring buffer of completed zones (allocated lazily).
+
+    unsigned int count; ///< number of zones recorded since last clear.
+
+    ProfilerZone stack[PROFILER_MAX_DEPTH]; ///< the zones currently begun.
+
+    int depth; ///< the number of zones currently begun.
+
+    ProfilerThread(int id) : id(id), count(0), depth(0)
+    {
+        char buf[32];
+        sprintf(buf, "thread %d", id);
+        name = buf;
+    }
+};
+
+volatile bool Profiler::ENABLED = false;
+
+/**
+ * The key used to get the ProfilerThread of the current thread.
+ */
+static pthread_key_t profilerKey;
+
+static pthread_once_t profilerKeyOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * The ProfilerThread of all the threads that have recorded zones. They are
+ * never deleted, so that the zones of terminated threads can be exported.
+ */
+static vector<ProfilerThread*> profilerThreads;
+
+/**
+ * Mutex used to protect profilerThreads.
+ */
+static pthread_mutex_t profilerMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void createProfilerKey()
+{
+    pthread_key_create(&profilerKey, NULL);
+}
+
+/**
+ * Returns the ProfilerThread of the current thread, creating it if needed.
+ */
+static ProfilerThread *getProfilerThread()
+{
+    pthread_once(&profilerKeyOnce, createProfilerKey);
+    ProfilerThread *t = (ProfilerThread*) pthread_getspecific(profilerKey);
+    if (t == NULL) {
+        pthread_mutex_lock(&profilerMutex);
+        t = new ProfilerThread(int(profilerThreads.size()));
+        profilerThreads.push_back(t);
+        pthread_mutex_unlock(&profilerMutex);
+        pthread_setspecific(profilerKey, t);
+    }
+    return t;
+}
+
+/**
+ * Returns the current time in micro seconds.
+ */
+static double getProfilerTime()
+{
+#if defined( _WIN64 ) || defined( _WIN32 )
+    static __int64 frequency = 0;
+    if (frequency == 0) {
+        QueryPerformanceFrequency((LARGE_INTEGER*) &frequency);
+    }
+    __int64 t;
+    QueryPerformanceCounter((LARGE_INTEGER*) &t);
+    return double(t) / double(frequency) * 1e6;
+#else
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e6 + t.tv_nsec * 1e-3;
+#endif
+}
+
+void Profiler::setEnabled(bool enabled)
+{
+    ENABLED = enabled;
+}
+
+void Profiler::setThreadName(const string &name)
+{
+    ProfilerThread *t = getProfilerThread();
+    pthread_mutex_lock(&profilerMutex);
+    t->name = name;
+    pthread_mutex_unlock(&profilerMutex);
+}
+
+void Profiler::begin(const char *name)
+{
+    ProfilerThread *t = getProfilerThread();
+    if (t->depth < PROFILER_MAX_DEPTH) {
+        ProfilerZone &z = t->stack[t->depth];
+        z.name = name;
+        z.start = getProfilerTime();
+    }
+    ++t->depth;
+}
+
+void Profiler::end()
+{
+    ProfilerThread *t = getProfilerThread();
+    if (t->depth == 0) {
+        return;
+    }
+    --t->depth;
+    if (t->depth < PROFILER_MAX_DEPTH) {
+        if (t->zones.empty()) {
+            t->zones.resize(PROFILER_CAPACITY);
+        }
+        ProfilerZone &z = t->zones[t->count % PROFILER_CAPACITY];
+        z = t->stack[t->depth];
+        z.duration = getProfilerTime() - z.start;
+        ++t->count;
+    }
+}
+
+void Profiler::clear()
+{
+    pthread_mutex_lock(&profilerMutex);
+    for (unsigned int i = 0; i < profilerThreads.size(); ++i) {
+        profilerThreads[i]->count = 0;
+    }
+    pthread_mutex_unlock(&profilerMutex);
+}
+
+/**
+ * Writes a string to a JSON file, with the necessary escape characters.
+ */
+static void writeJsonString(FILE *f, const char *s)
+{
+    fputc('"', f);
+    for (; *s != 0; ++s) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', f);
+            fputc(*s, f);
+        } else if ((unsigned char) *s >= 32) {
+            fputc(*s, f);
+        }
+    }
+    fputc('"', f);
+}
+
+bool Profiler::writeChromeTrace(const string &file)
+{
+    FILE *f = fopen(file.c_str(), "w");
+    if (f == NULL) {
+        return false;
+    }
+    pthread_mutex_lock(&profilerMutex);
+    // uses the oldest recorded zone as origin of time, so that the
+    // timestamps remain small and precise in the trace viewer
+    double origin = -1.0;
+    for (unsigned int i = 0; i < profilerThreads.size(); ++i) {
+        ProfilerThread *t = profilerThreads[i];
+        unsigned int n = min(t->count, PROFILER_CAPACITY);
+        for (unsigned int j = t->count - n; j < t->count; ++j) {
+            double start = t->zones[j % PROFILER_CAPACITY].start;
+            if (origin < 0.0 || start < origin) {
+                origin = start;
+            }
+        }
+    }
+    fprintf(f, "{\"traceEvents\":[");
+    bool first = true;
+    for (unsigned int i = 0; i < profilerThreads.size(); ++i) {
+        ProfilerThread *t = profilerThreads[i];
+        fprintf(f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",", t->id);
+        writeJsonString(f, t->name.c_str());
+        fprintf(f, "}}");
+        first = false;
+        // the ring buffer stores the zones in the order they end, so the
+        // oldest zone is at index count - n (modulo the capacity)
+        unsigned int n = min(t->count, PROFILER_CAPACITY);
+        for (unsigned int j = t->count - n; j < t->count; ++j) {
+            const ProfilerZone &z = t->zones[j % PROFILER_CAPACITY];
+            fprintf(f, ",\n{\"name\":");
+            writeJsonString(f, z.name);
+            fprintf(f, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%d}", z.start - origin, z.duration, t->id);
+        }
+    }
+    fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    pthread_mutex_unlock(&profilerMutex);
+    bool ok = ferror(f) == 0;
+    return fclose(f) == 0 && ok;
+}
+
+}
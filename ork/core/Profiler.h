@@ -0,0 +1,161 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#ifndef _ORK_PROFILER_H_
+#define _ORK_PROFILER_H_
+
+#include <string>
+
+namespace ork
+{
+
+/**
+ * A hierarchical CPU profiler. Code regions are measured with nestable
+ * #Zone objects. Each thread records its completed zones in its own fixed
+ * size ring buffer, without any locking, so that only the most recent zones
+ * are kept. When the profiler is disabled a Zone only tests a global flag,
+ * so profiling zones can be left permanently in the code. The recorded zones
+ * can be exported in the Chrome trace event format, to see the per thread
+ * timelines of the last frames in chrome://tracing or similar viewers.
+ * @ingroup core
+ */
+class ORK_API Profiler
+{
+public:
+    /**
+     * A profiled code region. A zone begins when it is created and ends when
+     * it is destroyed. It is normally declared as a local variable at the
+     * beginning of the scope to be measured.
+     */
+    class ORK_API Zone
+    {
+    public:
+        /**
+         * Begins a new zone, if the profiler is enabled.
+         *
+         * @param name the name of this zone. This string is not copied, it
+         *      must remain valid until the zones are cleared or exported
+         *      (string literals and Object#getClass() values can be used).
+         */
+        inline Zone(const char *name) : active(Profiler::isEnabled())
+        {
+            if (active) {
+                Profiler::begin(name);
+            }
+        }
+
+        /**
+         * Ends this zone.
+         */
+        inline ~Zone()
+        {
+            if (active) {
+                Profiler::end();
+            }
+        }
+
+    private:
+        /**
+         * True if this zone was begun while the profiler was enabled.
+         */
+        bool active;
+    };
+
+    /**
+     * Returns true if the profiler is enabled.
+     */
+    static inline bool isEnabled()
+    {
+        return ENABLED;
+    }
+
+    /**
+     * Enables or disables the profiler. Zones that are already begun when the
+     * profiler is disabled are still recorded when they end.
+     */
+    static void setEnabled(bool enabled);
+
+    /**
+     * Sets the name of the calling thread in the exported traces. By default
+     * threads are named "thread N" in the order they begin their first zone.
+     */
+    static void setThreadName(const std::string &name);
+
+    /**
+     * Begins a zone in the calling thread. Each call must be matched by a
+     * call to #end() in the same thread. Zone should be used instead.
+     *
+     * @param name the name of the zone (see Zone#Zone).
+     */
+    static void begin(const char *name);
+
+    /**
+     * Ends the last zone begun in the calling thread.
+     */
+    static void end();
+
+    /**
+     * Removes the zones recorded so far in all threads. This method should be
+     * called when the other threads are not recording zones, e.g. between
+     * two frames.
+     */
+    static void clear();
+
+    /**
+     * Writes the zones recorded so far in all threads to the given file, in
+     * the Chrome trace event JSON format. Like #clear(), this method should
+     * be called when the other threads are not recording zones.
+     *
+     * @param file the name of the file to be written.
+     * @return true if the file was successfully written.
+     */
+    static bool writeChromeTrace(const std::string &file);
+
+private:
+    /**
+     * True if the profiler is enabled.
+     */
+    static volatile bool ENABLED;
+};
+
+}
+
+#endif
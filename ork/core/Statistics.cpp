@@ -0,0 +1,210 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#include "ork/core/Statistics.h"
+
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+#include <pthread.h>
+
+using namespace std;
+
+namespace ork
+{
+
+/**
+ * The counters of a thread. Each thread only increments its own counters,
+ * which are only read by Statistics#endFrame. The counters are never reset,
+ * so that they can be read without synchronization: the number of events of
+ * a frame is the difference between two successive totals (modulo 2^32).
+ */
+struct StatisticsThread
+{
+    unsigned int counters[Statistics::MAX_COUNTERS]; ///< the total number of events.
+
+    StatisticsThread()
+    {
+        memset(counters, 0, sizeof(counters));
+    }
+};
+
+/**
+ * The key used to get the StatisticsThread of the current thread.
+ */
+static pthread_key_t statisticsKey;
+
+static pthread_once_t statisticsKeyOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * Mutex used to protect the static variables below.
+ */
+static pthread_mutex_t statisticsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * The StatisticsThread of all the threads that have counted events. They are
+ * never deleted, so that the events of terminated threads are not lost.
+ */
+static vector<StatisticsThread*> statisticsThreads;
+
+/**
+ * The counter names.
+ */
+static vector<string> statisticsNames;
+
+/**
+ * The total number of events, for all threads, at the last Statistics#endFrame.
+ */
+static unsigned int statisticsTotals[Statistics::MAX_COUNTERS];
+
+/**
+ * The number of events of the last frame.
+ */
+static unsigned int statisticsFrame[Statistics::MAX_COUNTERS];
+
+static void createStatisticsKey()
+{
+    pthread_key_create(&statisticsKey, NULL);
+}
+
+/**
+ * Initializes the names of the predefined counters, if needed. This must be
+ * called with statisticsMutex locked.
+ */
+static void initStatisticsNames()
+{
+    if (statisticsNames.empty()) {
+        statisticsNames.push_back("draws");
+        statisticsNames.push_back("programs");
+        statisticsNames.push_back("framebuffers");
+        statisticsNames.push_back("textures");
+        statisticsNames.push_back("uniforms");
+        statisticsNames.push_back("bytes");
+        statisticsNames.push_back("textureCalls");
+        statisticsNames.push_back("avoidedTextureCalls");
+        statisticsNames.push_back("stateCalls");
+    }
+}
+
+int Statistics::registerCounter(const string &name)
+{
+    int id = -1;
+    pthread_mutex_lock(&statisticsMutex);
+    initStatisticsNames();
+    if (statisticsNames.size() < MAX_COUNTERS) {
+        id = int(statisticsNames.size());
+        statisticsNames.push_back(name);
+    }
+    pthread_mutex_unlock(&statisticsMutex);
+    return id;
+}
+
+int Statistics::getCounterCount()
+{
+    pthread_mutex_lock(&statisticsMutex);
+    initStatisticsNames();
+    int n = int(statisticsNames.size());
+    pthread_mutex_unlock(&statisticsMutex);
+    return n;
+}
+
+string Statistics::getName(int counter)
+{
+    pthread_mutex_lock(&statisticsMutex);
+    initStatisticsNames();
+    string name = counter >= 0 && counter < int(statisticsNames.size()) ? statisticsNames[counter] : "";
+    pthread_mutex_unlock(&statisticsMutex);
+    return name;
+}
+
+void Statistics::add(int counter, unsigned int n)
+{
+    if (counter < 0 || counter >= MAX_COUNTERS) {
+        return;
+    }
+    pthread_once(&statisticsKeyOnce, createStatisticsKey);
+    StatisticsThread *t = (StatisticsThread*) pthread_getspecific(statisticsKey);
+    if (t == NULL) {
+        t = new StatisticsThread();
+        pthread_mutex_lock(&statisticsMutex);
+        statisticsThreads.push_back(t);
+        pthread_mutex_unlock(&statisticsMutex);
+        pthread_setspecific(statisticsKey, t);
+    }
+    t->counters[counter] += n;
+}
+
+void Statistics::endFrame()
+{
+    pthread_mutex_lock(&statisticsMutex);
+    for (int i = 0; i < MAX_COUNTERS; ++i) {
+        unsigned int total = 0;
+        for (unsigned int j = 0; j < statisticsThreads.size(); ++j) {
+            total += statisticsThreads[j]->counters[i];
+        }
+        statisticsFrame[i] = total - statisticsTotals[i];
+        statisticsTotals[i] = total;
+    }
+    pthread_mutex_unlock(&statisticsMutex);
+}
+
+unsigned int Statistics::get(int counter)
+{
+    return counter >= 0 && counter < MAX_COUNTERS ? statisticsFrame[counter] : 0;
+}
+
+string Statistics::toString()
+{
+    ostringstream os;
+    int n = getCounterCount();
+    for (int i = 0; i < n; ++i) {
+        if (get(i) != 0) {
+            if (os.tellp() > 0) {
+                os << ", ";
+            }
+            os << getName(i) << " " << get(i);
+        }
+    }
+    return os.str();
+}
+
+}
@@ -0,0 +1,132 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#ifndef _ORK_STATISTICS_H_
+#define _ORK_STATISTICS_H_
+
+#include <string>
+
+namespace ork
+{
+
+/**
+ * A registry of event counters, snapshotted at each frame. Each thread
+ * increments its own copy of the counters, without any locking. At the end of
+ * each frame, #endFrame computes the number of events of this frame, summed
+ * over all threads, which can then be queried with #get. Some counters are
+ * predefined for the main rendering events (see #Counter), and others can be
+ * added with #registerCounter.
+ * @ingroup core
+ */
+class ORK_API Statistics
+{
+public:
+    /**
+     * The predefined counters.
+     */
+    enum Counter {
+        DRAW_CALLS, ///< number of OpenGL draw calls (see MeshBuffers#draw).
+        PROGRAM_SWITCHES, ///< number of program changes (see Program#set).
+        FRAMEBUFFER_SWITCHES, ///< number of framebuffer changes (see FrameBuffer#set).
+        TEXTURE_BINDS, ///< number of textures bound to texture units.
+        UNIFORM_UPLOADS, ///< number of uniform values and uniform blocks sent to the GPU.
+        BUFFER_BYTES, ///< number of bytes sent to GPU buffers (see GPUBuffer#setData).
+        TEXTURE_CALLS, ///< number of OpenGL calls made to bind textures and samplers to texture units.
+        AVOIDED_TEXTURE_CALLS, ///< number of texture and sampler binding calls avoided for already bound textures, or with multi-bind calls.
+        STATE_CALLS ///< number of OpenGL calls made to change the framebuffer parameters (see FrameBuffer#setParameters).
+    };
+
+    /**
+     * The maximum number of counters, including the predefined ones.
+     */
+    static const int MAX_COUNTERS = 32;
+
+    /**
+     * Adds a new counter.
+     *
+     * @param name the name of the new counter.
+     * @return the id of the new counter, to be used in #add and #get, or -1
+     *      if the maximum number of counters is reached.
+     */
+    static int registerCounter(const std::string &name);
+
+    /**
+     * Returns the number of counters, including the predefined ones.
+     */
+    static int getCounterCount();
+
+    /**
+     * Returns the name of the given counter.
+     */
+    static std::string getName(int counter);
+
+    /**
+     * Adds the given number of events to a counter, in the calling thread.
+     * Does nothing if the counter id is invalid.
+     *
+     * @param counter a counter id (a #Counter or an id returned by #registerCounter).
+     * @param n the number of events to add.
+     */
+    static void add(int counter, unsigned int n = 1);
+
+    /**
+     * Ends the current frame. This computes the number of events since the
+     * last call to this method, for each counter. SceneManager#draw calls this
+     * method at the end of each frame.
+     */
+    static void endFrame();
+
+    /**
+     * Returns the number of events of the given counter during the last frame,
+     * i.e., between the last two calls to #endFrame.
+     */
+    static unsigned int get(int counter);
+
+    /**
+     * Returns a text description of the counters for the last frame, of the
+     * form "name value, name value, ...". Counters whose value is 0 are skipped.
+     */
+    static std::string toString();
+};
+
+}
+
+#endif
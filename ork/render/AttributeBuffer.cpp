@@ -68,6 +68,11 @@ AttributeBuffer::~AttributeBuffer()
 {
 }
 
+int AttributeBuffer::getIndex()
+{
+    return index;
+}
+
 int AttributeBuffer::getSize()
 {
     return size;
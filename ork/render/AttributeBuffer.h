@@ -131,6 +131,11 @@ public:
      */
     virtual ~AttributeBuffer();
 
+    /**
+     * Returns the vertex attribute index used for this attribute.
+     */
+    int getIndex();
+
     /**
      * Returns the number of components in attributes of this kind.
      */
@@ -234,6 +239,8 @@ private:
     friend class MeshBuffers;
 
     friend class FrameBuffer;
+
+    friend class BatchRenderer;
 };
 
 }
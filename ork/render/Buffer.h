@@ -270,6 +270,8 @@ private:
     friend class TextureRectangle;
 
     friend class TransformFeedback;
+
+    friend class BatchRenderer;
 };
 
 }
@@ -0,0 +1,163 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#include "ork/render/CommandList.h"
+
+using namespace std;
+
+namespace ork
+{
+
+CommandList::CommandList() : Object("CommandList")
+{
+}
+
+CommandList::~CommandList()
+{
+}
+
+void CommandList::clear()
+{
+    commands.clear();
+    objects.clear();
+    values.clear();
+    data.clear();
+    program = NULL;
+}
+
+int CommandList::getCommandCount() const
+{
+    return int(commands.size());
+}
+
+ptr<Program> CommandList::getProgram() const
+{
+    return program;
+}
+
+void CommandList::setProgram(ptr<Program> p)
+{
+    if (p != program) {
+        add(PROGRAM, p, 0);
+        program = p;
+    }
+}
+
+void CommandList::setValue(ptr<Uniform> u, ptr<Value> v)
+{
+    add(VALUE, u, int(values.size()));
+    values.push_back(v);
+}
+
+void CommandList::set(ptr<Uniform2f> u, const vec2f &v)
+{
+    add(VEC2F, u, addData(&v.x, 2));
+}
+
+void CommandList::set(ptr<Uniform3f> u, const vec3f &v)
+{
+    add(VEC3F, u, addData(&v.x, 3));
+}
+
+void CommandList::setMatrix(ptr<UniformMatrix4f> u, const mat4f &m)
+{
+    add(MAT4F, u, addData(m.coefficients(), 16));
+}
+
+void CommandList::draw(ptr<MeshBuffers> mesh, MeshMode m, GLint first, GLsizei count, GLsizei primCount, GLint base)
+{
+    Command &c = add(DRAW, mesh, int(m));
+    c.first = first;
+    c.count = count;
+    c.primCount = primCount;
+    c.base = base;
+}
+
+ptr<Program> CommandList::run(ptr<FrameBuffer> fb)
+{
+    Program *p = NULL;
+    for (unsigned int i = 0; i < commands.size(); ++i) {
+        const Command &c = commands[i];
+        switch (c.type) {
+        case PROGRAM:
+            p = static_cast<Program*>(c.object);
+            break;
+        case VALUE:
+            static_cast<Uniform*>(c.object)->setValueIfChanged(values[c.offset]);
+            break;
+        case VEC2F:
+            static_cast<Uniform2f*>(c.object)->set(vec2f(data[c.offset], data[c.offset + 1]));
+            break;
+        case VEC3F:
+            static_cast<Uniform3f*>(c.object)->set(vec3f(data[c.offset], data[c.offset + 1], data[c.offset + 2]));
+            break;
+        case MAT4F:
+            static_cast<UniformMatrix4f*>(c.object)->setMatrix(mat4f(&data[c.offset]));
+            break;
+        case DRAW:
+            if (p != NULL) {
+                fb->draw(p, *static_cast<MeshBuffers*>(c.object), MeshMode(c.offset), c.first, c.count, c.primCount, c.base);
+            }
+            break;
+        }
+    }
+    return p;
+}
+
+CommandList::Command &CommandList::add(CommandType type, ptr<Object> o, int offset)
+{
+    commands.push_back(Command());
+    Command &c = commands.back();
+    c.type = type;
+    c.object = o.get();
+    c.offset = offset;
+    objects.push_back(o);
+    return c;
+}
+
+int CommandList::addData(const float *v, int n)
+{
+    int offset = int(data.size());
+    data.insert(data.end(), v, v + n);
+    return offset;
+}
+
+}
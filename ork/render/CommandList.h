@@ -0,0 +1,263 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#ifndef _ORK_COMMAND_LIST_H_
+#define _ORK_COMMAND_LIST_H_
+
+#include <vector>
+
+#include "ork/render/FrameBuffer.h"
+
+namespace ork
+{
+
+/**
+ * A list of draw commands recorded without any OpenGL call, to be replayed
+ * later in the thread that owns the OpenGL context. The commands reference
+ * fully resolved objects (programs, uniforms, meshes), so that recording
+ * does not need any shared state and can be done in parallel, in several
+ * threads, each with its own CommandList. The replay (see #run) executes
+ * the commands in order with minimal validation. A CommandList can be
+ * reused from frame to frame with #clear, which keeps its allocated memory.
+ *
+ * @ingroup render
+ */
+class ORK_API CommandList : public Object
+{
+public:
+    /**
+     * Creates a new, empty CommandList.
+     */
+    CommandList();
+
+    /**
+     * Deletes this CommandList.
+     */
+    virtual ~CommandList();
+
+    /**
+     * Removes all the commands of this list. Also resets the recording
+     * program (see #getProgram).
+     */
+    void clear();
+
+    /**
+     * Returns the number of commands in this list.
+     */
+    int getCommandCount() const;
+
+    /**
+     * Returns the program used by the draw commands recorded from now on,
+     * i.e. the program of the last #setProgram command, or NULL if there
+     * is no such command.
+     */
+    ptr<Program> getProgram() const;
+
+    /**
+     * Records a command to use the given program for the next draws.
+     *
+     * @param p a program.
+     */
+    void setProgram(ptr<Program> p);
+
+    /**
+     * Records a command to set the value of a uniform. The value object is
+     * not copied, it must not be modified until this list is replayed. The
+     * uniform is not set again if this value did not change since it was
+     * last set (see Uniform#setValueIfChanged).
+     *
+     * @param u a uniform.
+     * @param v its new value.
+     */
+    void setValue(ptr<Uniform> u, ptr<Value> v);
+
+    /**
+     * Records a command to set the value of a vec2f uniform.
+     *
+     * @param u a uniform.
+     * @param v its new value.
+     */
+    void set(ptr<Uniform2f> u, const vec2f &v);
+
+    /**
+     * Records a command to set the value of a vec3f uniform.
+     *
+     * @param u a uniform.
+     * @param v its new value.
+     */
+    void set(ptr<Uniform3f> u, const vec3f &v);
+
+    /**
+     * Records a command to set the value of a mat4f uniform.
+     *
+     * @param u a uniform.
+     * @param m its new value.
+     */
+    void setMatrix(ptr<UniformMatrix4f> u, const mat4f &m);
+
+    /**
+     * Records a command to draw a part of a mesh with the current program
+     * (see #setProgram). See FrameBuffer#draw.
+     *
+     * @param mesh the mesh to draw.
+     * @param m how the mesh vertices must be interpreted.
+     * @param first the first vertex to draw, or the first indice to draw if
+     *      this mesh has indices.
+     * @param count the number of vertices to draw, or the number of indices
+     *      to draw if this mesh has indices.
+     * @param primCount the number of times this mesh must be drawn.
+     * @param base the base vertex to use. Only used for meshes with indices.
+     */
+    void draw(ptr<MeshBuffers> mesh, MeshMode m, GLint first, GLsizei count, GLsizei primCount = 1, GLint base = 0);
+
+    /**
+     * Replays the commands of this list. Must be called in the thread that
+     * owns the OpenGL context.
+     *
+     * @param fb the framebuffer into which the meshes must be drawn.
+     * @return the program of the last #setProgram command, or NULL if there
+     *      is no such command.
+     */
+    ptr<Program> run(ptr<FrameBuffer> fb);
+
+private:
+    /**
+     * The types of the recorded commands.
+     */
+    enum CommandType {
+        PROGRAM, ///< sets the program for the next draws
+        VALUE, ///< sets a uniform value from a Value object, if changed
+        VEC2F, ///< sets a vec2f uniform
+        VEC3F, ///< sets a vec3f uniform
+        MAT4F, ///< sets a mat4f uniform
+        DRAW ///< draws a mesh
+    };
+
+    /**
+     * A recorded command.
+     */
+    struct Command
+    {
+        /**
+         * The type of this command.
+         */
+        CommandType type;
+
+        /**
+         * The program, uniform or mesh of this command.
+         */
+        Object *object;
+
+        /**
+         * The offset of the arguments of this command in #data or, for
+         * VALUE commands, in #values. For DRAW commands, the mesh mode.
+         */
+        int offset;
+
+        /**
+         * The first vertex or indice to draw (DRAW commands only).
+         */
+        GLint first;
+
+        /**
+         * The number of vertices or indices to draw (DRAW commands only).
+         */
+        GLsizei count;
+
+        /**
+         * The number of instances to draw (DRAW commands only).
+         */
+        GLsizei primCount;
+
+        /**
+         * The base vertex (DRAW commands only).
+         */
+        GLint base;
+    };
+
+    /**
+     * The recorded commands.
+     */
+    std::vector<Command> commands;
+
+    /**
+     * References to the objects used in #commands, to keep them alive
+     * until this list is cleared.
+     */
+    std::vector< ptr<Object> > objects;
+
+    /**
+     * The Value objects of the VALUE commands.
+     */
+    std::vector< ptr<Value> > values;
+
+    /**
+     * The arguments of the VEC2F, VEC3F and MAT4F commands.
+     */
+    std::vector<float> data;
+
+    /**
+     * The program of the last PROGRAM command.
+     */
+    ptr<Program> program;
+
+    /**
+     * Adds a command to this list.
+     *
+     * @param type the command type.
+     * @param o the object of this command.
+     * @param offset the offset of the command arguments.
+     */
+    Command &add(CommandType type, ptr<Object> o, int offset);
+
+    /**
+     * Adds float arguments to #data.
+     *
+     * @param v the arguments.
+     * @param n the number of arguments.
+     * @return the offset of these arguments in #data.
+     */
+    int addData(const float *v, int n);
+};
+
+}
+
+#endif
@@ -51,6 +51,8 @@
 #endif
 
 #include "ork/core/Logger.h"
+#include "ork/core/Profiler.h"
+#include "ork/core/Statistics.h"
 #include "ork/render/Module.h"
 #include "ork/render/Texture.h"
 
@@ -183,7 +185,7 @@ FrameBuffer::Parameters::Parameters() :
     frontFaceCW(false), polygonFront(FILL), polygonBack(FILL),
     polygonSmooth(false), polygonOffset(0.0f, 0.0f), polygonOffsets(false, false, false), polygonId(0),
     multiSample(true), sampleAlphaToCoverage(false), sampleAlphaToOne(false),
-        sampleCoverage(1.0f), sampleMask(0xFFFFFFFF), multiSampleId(0),
+        sampleCoverage(1.0f), sampleMask(0xFFFFFFFF), sampleShading(false), samplesMin(0.0f), multiSampleId(0),
     occlusionQuery(NULL), occlusionMode(WAIT),
     multiScissor(false), scissorId(0),
     enableStencil(false), ffunc(ALWAYS), fref(0), fmask(0xFFFFFFFF), ffail(KEEP), fdpfail(KEEP), fdppass(KEEP),
@@ -208,202 +210,369 @@ FrameBuffer::Parameters::Parameters() :
     }
 }
 
+/**
+ * Returns the face culling mode corresponding to the given polygon modes,
+ * or 0 if face culling must be disabled.
+ */
+static GLenum getCullFace(PolygonMode front, PolygonMode back)
+{
+    if (front == CULL && back == CULL) {
+        return GL_FRONT_AND_BACK;
+    } else if (front == CULL) {
+        return GL_FRONT;
+    } else if (back == CULL) {
+        return GL_BACK;
+    }
+    return 0;
+}
+
+/**
+ * Returns the polygon rasterization mode corresponding to the given polygon
+ * modes, or 0 if all polygons are culled (the mode is then left unchanged).
+ */
+static GLenum getPolygonRasterMode(PolygonMode front, PolygonMode back)
+{
+    switch (front == CULL ? back : front) {
+    case POINT:
+        return GL_POINT;
+    case LINE:
+        return GL_LINE;
+    case FILL:
+        return GL_FILL;
+    default:
+        return 0;
+    }
+}
+
 void FrameBuffer::Parameters::set(const Parameters &p)
 {
     if (Logger::DEBUG_LOGGER != NULL) {
         Logger::DEBUG_LOGGER->log("RENDER", "Set FrameBuffer Parameters");
     }
-    GLint version = 0;
-    glGetIntegerv(GL_MAJOR_VERSION, &version);
+    // this object mirrors the current OpenGL state: inside each group of
+    // parameters that changed, only the parameters that differ are set
+    int n = 0;
 
     // TRANSFORM -------------
     if (transformId != p.transformId)
     {
+        bool all = multiViewports != p.multiViewports;
         if (p.multiViewports) {
             for (int i = 0; i < 16; ++i) {
-                glViewportIndexedf(i, p.viewports[i].x, p.viewports[i].y, p.viewports[i].z, p.viewports[i].w);
-                glDepthRangeIndexed(i, p.depthRanges[i].x, p.depthRanges[i].y);
+                if (all || viewports[i] != p.viewports[i]) {
+                    glViewportIndexedf(i, p.viewports[i].x, p.viewports[i].y, p.viewports[i].z, p.viewports[i].w);
+                    ++n;
+                }
+                if (all || depthRanges[i] != p.depthRanges[i]) {
+                    glDepthRangeIndexed(i, p.depthRanges[i].x, p.depthRanges[i].y);
+                    ++n;
+                }
             }
         } else {
-            glViewport(p.viewport.x, p.viewport.y, p.viewport.z, p.viewport.w);
-            glDepthRange(p.depthRange.x, p.depthRange.y);
+            if (all || viewport != p.viewport) {
+                glViewport(p.viewport.x, p.viewport.y, p.viewport.z, p.viewport.w);
+                ++n;
+            }
+            if (all || depthRange != p.depthRange) {
+                glDepthRange(p.depthRange.x, p.depthRange.y);
+                ++n;
+            }
         }
         for (int i = 0; i < 6; ++i) {
-            glEnable(GL_CLIP_DISTANCE0 + i, (p.clipDistances & (1 << i)) != 0);
+            if (((clipDistances ^ p.clipDistances) & (1 << i)) != 0) {
+                glEnable(GL_CLIP_DISTANCE0 + i, (p.clipDistances & (1 << i)) != 0);
+                ++n;
+            }
         }
     }
     // CLEAR -------------
     if (clearId != p.clearId)
     {
-        glClearColor(p.clearColor.x, p.clearColor.y, p.clearColor.z, p.clearColor.w);
-        glClearDepth(p.clearDepth);
-        glClearStencil(p.clearStencil);
+        if (clearColor != p.clearColor) {
+            glClearColor(p.clearColor.x, p.clearColor.y, p.clearColor.z, p.clearColor.w);
+            ++n;
+        }
+        if (clearDepth != p.clearDepth) {
+            glClearDepth(p.clearDepth);
+            ++n;
+        }
+        if (clearStencil != p.clearStencil) {
+            glClearStencil(p.clearStencil);
+            ++n;
+        }
     }
     // POINTS -------------
     if (pointId != p.pointId)
     {
-        glEnable(GL_PROGRAM_POINT_SIZE, p.pointSize <= 0.0f);
-        glPointSize(p.pointSize);
-        glPointParameterf(GL_POINT_FADE_THRESHOLD_SIZE, p.pointFadeThresholdSize);
-        glPointParameteri(GL_POINT_SPRITE_COORD_ORIGIN, p.pointLowerLeftOrigin ? GL_LOWER_LEFT : GL_UPPER_LEFT);
+        if ((pointSize <= 0.0f) != (p.pointSize <= 0.0f)) {
+            glEnable(GL_PROGRAM_POINT_SIZE, p.pointSize <= 0.0f);
+            ++n;
+        }
+        if (pointSize != p.pointSize) {
+            glPointSize(p.pointSize);
+            ++n;
+        }
+        if (pointFadeThresholdSize != p.pointFadeThresholdSize) {
+            glPointParameterf(GL_POINT_FADE_THRESHOLD_SIZE, p.pointFadeThresholdSize);
+            ++n;
+        }
+        if (pointLowerLeftOrigin != p.pointLowerLeftOrigin) {
+            glPointParameteri(GL_POINT_SPRITE_COORD_ORIGIN, p.pointLowerLeftOrigin ? GL_LOWER_LEFT : GL_UPPER_LEFT);
+            ++n;
+        }
     }
     // LINES -------------
-    if (lineWidth != p.lineWidth ||
-        lineSmooth != p.lineSmooth)
-    {
+    if (lineSmooth != p.lineSmooth) {
         glEnable(GL_LINE_SMOOTH, p.lineSmooth);
+        ++n;
+    }
+    if (lineWidth != p.lineWidth) {
         glLineWidth(p.lineWidth);
+        ++n;
     }
     // POLYGONS -------------
     if (polygonId != p.polygonId)
     {
-        glFrontFace(p.frontFaceCW ? GL_CW : GL_CCW);
-
-        if (p.polygonFront == CULL || p.polygonBack == CULL) {
-            glEnable(GL_CULL_FACE);
-            if (p.polygonFront == CULL && p.polygonBack == CULL) {
-                glCullFace(GL_FRONT_AND_BACK);
-            } else if (p.polygonFront == CULL) {
-                glCullFace(GL_FRONT);
-            } else {
-                glCullFace(GL_BACK);
-            }
-        } else {
-            glDisable(GL_CULL_FACE);
+        if (frontFaceCW != p.frontFaceCW) {
+            glFrontFace(p.frontFaceCW ? GL_CW : GL_CCW);
+            ++n;
         }
-        switch (p.polygonFront) {
-        case CULL:
-            switch (p.polygonBack) {
-            case CULL:
-                break;
-            case POINT:
-                glPolygonMode(GL_FRONT_AND_BACK, GL_POINT);
-                break;
-            case LINE:
-                glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-                break;
-            case FILL:
-                glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-                break;
-            }
-            break;
-        case POINT:
-            glPolygonMode(GL_FRONT_AND_BACK, GL_POINT);
-            break;
-        case LINE:
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-            break;
-        case FILL:
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-            break;
+        GLenum cull = getCullFace(polygonFront, polygonBack);
+        GLenum newCull = getCullFace(p.polygonFront, p.polygonBack);
+        if ((cull == 0) != (newCull == 0)) {
+            glEnable(GL_CULL_FACE, newCull != 0);
+            ++n;
+        }
+        if (newCull != 0 && cull != newCull) {
+            glCullFace(newCull);
+            ++n;
+        }
+        GLenum mode = getPolygonRasterMode(polygonFront, polygonBack);
+        GLenum newMode = getPolygonRasterMode(p.polygonFront, p.polygonBack);
+        // mode == 0 means that the current mode is unknown
+        if (newMode != 0 && (mode == 0 || mode != newMode)) {
+            glPolygonMode(GL_FRONT_AND_BACK, newMode);
+            ++n;
         }
         assert(getError() == 0);
-        glEnable(GL_POLYGON_SMOOTH, p.polygonSmooth);
-        glPolygonOffset(p.polygonOffset.x, p.polygonOffset.y);
-        glEnable(GL_POLYGON_OFFSET_POINT, p.polygonOffsets.x);
-        glEnable(GL_POLYGON_OFFSET_LINE, p.polygonOffsets.y);
-        glEnable(GL_POLYGON_OFFSET_FILL, p.polygonOffsets.z);
+        if (polygonSmooth != p.polygonSmooth) {
+            glEnable(GL_POLYGON_SMOOTH, p.polygonSmooth);
+            ++n;
+        }
+        if (polygonOffset != p.polygonOffset) {
+            glPolygonOffset(p.polygonOffset.x, p.polygonOffset.y);
+            ++n;
+        }
+        if (polygonOffsets.x != p.polygonOffsets.x) {
+            glEnable(GL_POLYGON_OFFSET_POINT, p.polygonOffsets.x);
+            ++n;
+        }
+        if (polygonOffsets.y != p.polygonOffsets.y) {
+            glEnable(GL_POLYGON_OFFSET_LINE, p.polygonOffsets.y);
+            ++n;
+        }
+        if (polygonOffsets.z != p.polygonOffsets.z) {
+            glEnable(GL_POLYGON_OFFSET_FILL, p.polygonOffsets.z);
+            ++n;
+        }
     }
     // MULTISAMPLING -------------
     if (multiSampleId != p.multiSampleId)
     {
-        glEnable(GL_MULTISAMPLE, p.multiSample);
-        glEnable(GL_SAMPLE_ALPHA_TO_COVERAGE, p.sampleAlphaToCoverage);
-        glEnable(GL_SAMPLE_ALPHA_TO_ONE, p.sampleAlphaToOne);
-        glEnable(GL_SAMPLE_COVERAGE, p.sampleCoverage < 1.0f);
-        glSampleCoverage(abs(p.sampleCoverage), p.sampleCoverage < 0.0f);
-        glEnable(GL_SAMPLE_MASK, p.sampleMask != (GLuint) 0xFFFFFFFF);
-        glSampleMaski(0, p.sampleMask);
-        if (version >= 4) {
-            glEnable(GL_SAMPLE_SHADING,p.sampleShading);
-            glMinSampleShading(p.samplesMin);
+        if (multiSample != p.multiSample) {
+            glEnable(GL_MULTISAMPLE, p.multiSample);
+            ++n;
+        }
+        if (sampleAlphaToCoverage != p.sampleAlphaToCoverage) {
+            glEnable(GL_SAMPLE_ALPHA_TO_COVERAGE, p.sampleAlphaToCoverage);
+            ++n;
+        }
+        if (sampleAlphaToOne != p.sampleAlphaToOne) {
+            glEnable(GL_SAMPLE_ALPHA_TO_ONE, p.sampleAlphaToOne);
+            ++n;
+        }
+        if ((sampleCoverage < 1.0f) != (p.sampleCoverage < 1.0f)) {
+            glEnable(GL_SAMPLE_COVERAGE, p.sampleCoverage < 1.0f);
+            ++n;
+        }
+        if (sampleCoverage != p.sampleCoverage) {
+            glSampleCoverage(abs(p.sampleCoverage), p.sampleCoverage < 0.0f);
+            ++n;
+        }
+        if ((sampleMask != (GLuint) 0xFFFFFFFF) != (p.sampleMask != (GLuint) 0xFFFFFFFF)) {
+            glEnable(GL_SAMPLE_MASK, p.sampleMask != (GLuint) 0xFFFFFFFF);
+            ++n;
+        }
+        if (sampleMask != p.sampleMask) {
+            glSampleMaski(0, p.sampleMask);
+            ++n;
+        }
+        if (getMajorVersion() >= 4) {
+            if (sampleShading != p.sampleShading) {
+                glEnable(GL_SAMPLE_SHADING, p.sampleShading);
+                ++n;
+            }
+            if (samplesMin != p.samplesMin) {
+                glMinSampleShading(p.samplesMin);
+                ++n;
+            }
         }
     }
     // SCISSOR TEST -------------
     if (scissorId != p.scissorId)
     {
+        bool all = multiScissor != p.multiScissor;
         if (p.multiScissor) {
             for (int i = 0; i < 16; ++i) {
-                if (p.enableScissor[i]) {
-                    glEnablei(i, GL_SCISSOR_TEST);
-                } else {
-                    glDisablei(i, GL_SCISSOR_TEST);
+                if (all || enableScissor[i] != p.enableScissor[i]) {
+                    if (p.enableScissor[i]) {
+                        glEnablei(i, GL_SCISSOR_TEST);
+                    } else {
+                        glDisablei(i, GL_SCISSOR_TEST);
+                    }
+                    ++n;
+                }
+                if (all || scissor[i] != p.scissor[i]) {
+                    glScissorIndexed(i, p.scissor[i].x, p.scissor[i].y, p.scissor[i].z, p.scissor[i].w);
+                    ++n;
                 }
-                glScissorIndexed(i, p.scissor[i].x, p.scissor[i].y, p.scissor[i].z, p.scissor[i].w);
             }
         } else {
-            glEnable(GL_SCISSOR_TEST, p.enableScissor[0]);
-            glScissor(p.scissor[0].x, p.scissor[0].y, p.scissor[0].z, p.scissor[0].w);
+            if (all || enableScissor[0] != p.enableScissor[0]) {
+                glEnable(GL_SCISSOR_TEST, p.enableScissor[0]);
+                ++n;
+            }
+            if (all || scissor[0] != p.scissor[0]) {
+                glScissor(p.scissor[0].x, p.scissor[0].y, p.scissor[0].z, p.scissor[0].w);
+                ++n;
+            }
         }
     }
     // STENCIL TEST -------------
     if (stencilId != p.stencilId)
     {
-        glEnable(GL_STENCIL_TEST, p.enableStencil);
-        glStencilFuncSeparate(GL_FRONT, getFunction(p.ffunc), p.fref, p.fmask);
-        glStencilFuncSeparate(GL_BACK, getFunction(p.bfunc), p.bref, p.bmask);
-        glStencilOpSeparate(GL_FRONT, getStencilOperation(p.ffail), getStencilOperation(p.fdpfail), getStencilOperation(p.fdppass));
-        glStencilOpSeparate(GL_BACK, getStencilOperation(p.bfail), getStencilOperation(p.bdpfail), getStencilOperation(p.bdppass));
+        if (enableStencil != p.enableStencil) {
+            glEnable(GL_STENCIL_TEST, p.enableStencil);
+            ++n;
+        }
+        if (ffunc != p.ffunc || fref != p.fref || fmask != p.fmask) {
+            glStencilFuncSeparate(GL_FRONT, getFunction(p.ffunc), p.fref, p.fmask);
+            ++n;
+        }
+        if (bfunc != p.bfunc || bref != p.bref || bmask != p.bmask) {
+            glStencilFuncSeparate(GL_BACK, getFunction(p.bfunc), p.bref, p.bmask);
+            ++n;
+        }
+        if (ffail != p.ffail || fdpfail != p.fdpfail || fdppass != p.fdppass) {
+            glStencilOpSeparate(GL_FRONT, getStencilOperation(p.ffail), getStencilOperation(p.fdpfail), getStencilOperation(p.fdppass));
+            ++n;
+        }
+        if (bfail != p.bfail || bdpfail != p.bdpfail || bdppass != p.bdppass) {
+            glStencilOpSeparate(GL_BACK, getStencilOperation(p.bfail), getStencilOperation(p.bdpfail), getStencilOperation(p.bdppass));
+            ++n;
+        }
     }
     // DEPTH TEST -------------
-    if (enableDepth != p.enableDepth ||
-        depth != p.depth)
-    {
+    if (enableDepth != p.enableDepth) {
         glEnable(GL_DEPTH_TEST, p.enableDepth);
+        ++n;
+    }
+    if (depth != p.depth) {
         glDepthFunc(getFunction(p.depth));
+        ++n;
     }
     // BLENDING --------------
     if (blendId != p.blendId)
     {
+        bool all = multiBlendEnable != p.multiBlendEnable;
         if (p.multiBlendEnable) {
             for (int i = 0; i < 4; ++i) {
-                if (p.enableBlend[i]) {
-                    glEnablei(GL_BLEND, i);
-                } else {
-                    glDisablei(GL_BLEND, i);
+                if (all || enableBlend[i] != p.enableBlend[i]) {
+                    if (p.enableBlend[i]) {
+                        glEnablei(GL_BLEND, i);
+                    } else {
+                        glDisablei(GL_BLEND, i);
+                    }
+                    ++n;
                 }
             }
-        } else {
+        } else if (all || enableBlend[0] != p.enableBlend[0]) {
             glEnable(GL_BLEND, p.enableBlend[0]);
+            ++n;
         }
-        if (p.multiBlendEq && version >= 4) {
-            for (int i = 0; i < 4; ++i) {
-                glBlendEquationSeparatei(i, getBlendEquation(p.rgb[i]), getBlendEquation(p.alpha[i]));
-                glBlendFuncSeparatei(i, getBlendArgument(p.srgb[i]), getBlendArgument(p.drgb[i]), getBlendArgument(p.salpha[i]), getBlendArgument(p.dalpha[i]));
+        bool multi = multiBlendEq && getMajorVersion() >= 4;
+        bool newMulti = p.multiBlendEq && getMajorVersion() >= 4;
+        all = multi != newMulti;
+        for (int i = 0; i < (newMulti ? 4 : 1); ++i) {
+            if (all || rgb[i] != p.rgb[i] || alpha[i] != p.alpha[i]) {
+                if (newMulti) {
+                    glBlendEquationSeparatei(i, getBlendEquation(p.rgb[i]), getBlendEquation(p.alpha[i]));
+                } else {
+                    glBlendEquationSeparate(getBlendEquation(p.rgb[0]), getBlendEquation(p.alpha[0]));
+                }
+                ++n;
             }
-        } else {
-            glBlendEquationSeparate(getBlendEquation(p.rgb[0]), getBlendEquation(p.alpha[0]));
-            glBlendFuncSeparate(getBlendArgument(p.srgb[0]), getBlendArgument(p.drgb[0]), getBlendArgument(p.salpha[0]), getBlendArgument(p.dalpha[0]));
+            if (all || srgb[i] != p.srgb[i] || drgb[i] != p.drgb[i] || salpha[i] != p.salpha[i] || dalpha[i] != p.dalpha[i]) {
+                if (newMulti) {
+                    glBlendFuncSeparatei(i, getBlendArgument(p.srgb[i]), getBlendArgument(p.drgb[i]), getBlendArgument(p.salpha[i]), getBlendArgument(p.dalpha[i]));
+                } else {
+                    glBlendFuncSeparate(getBlendArgument(p.srgb[0]), getBlendArgument(p.drgb[0]), getBlendArgument(p.salpha[0]), getBlendArgument(p.dalpha[0]));
+                }
+                ++n;
+            }
+        }
+        if (color != p.color) {
+            glBlendColor(p.color.x, p.color.y, p.color.z, p.color.w);
+            ++n;
         }
-        glBlendColor(p.color.x, p.color.y, p.color.z, p.color.w);
     }
     // DITHERING --------------
     if (enableDither != p.enableDither)
     {
         glEnable(GL_DITHER, p.enableDither);
+        ++n;
     }
     // LOGIC OP --------------
-    if (enableLogic != p.enableLogic ||
-        logicOp != p.logicOp)
-    {
-        glEnable(GL_COLOR_LOGIC_OP, p.enableDither);
+    if (enableLogic != p.enableLogic) {
+        glEnable(GL_COLOR_LOGIC_OP, p.enableLogic);
+        ++n;
+    }
+    if (logicOp != p.logicOp) {
         glLogicOp(getLogicOperation(p.logicOp));
+        ++n;
     }
     // WRITE MASKS --------------
     if (maskId != p.maskId)
     {
+        bool all = multiColorMask != p.multiColorMask;
         if (p.multiColorMask) {
             for (int i = 0; i < 4; ++i) {
-                glColorMaski(i, p.colorMask[i].x, p.colorMask[i].y, p.colorMask[i].z, p.colorMask[i].w);
+                if (all || colorMask[i] != p.colorMask[i]) {
+                    glColorMaski(i, p.colorMask[i].x, p.colorMask[i].y, p.colorMask[i].z, p.colorMask[i].w);
+                    ++n;
+                }
             }
-        } else {
+        } else if (all || colorMask[0] != p.colorMask[0]) {
             glColorMask(p.colorMask[0].x, p.colorMask[0].y, p.colorMask[0].z, p.colorMask[0].w);
+            ++n;
+        }
+        if (depthMask != p.depthMask) {
+            glDepthMask(p.depthMask);
+            ++n;
+        }
+        if (stencilMaskFront != p.stencilMaskFront) {
+            glStencilMaskSeparate(GL_FRONT, p.stencilMaskFront);
+            ++n;
+        }
+        if (stencilMaskBack != p.stencilMaskBack) {
+            glStencilMaskSeparate(GL_BACK, p.stencilMaskBack);
+            ++n;
         }
-        glDepthMask(p.depthMask);
-        glStencilMaskSeparate(GL_FRONT, p.stencilMaskFront);
-        glStencilMaskSeparate(GL_BACK, p.stencilMaskBack);
     }
     assert(getError() == 0);
+    if (n > 0) {
+        Statistics::add(Statistics::STATE_CALLS, n);
+    }
     *this = p;
 }
 
@@ -1366,7 +1535,11 @@ void FrameBuffer::clear(bool color, bool stencil, bool depth)
 
 void FrameBuffer::draw(ptr<Program> p, const MeshBuffers &mesh, MeshMode m, GLint first, GLsizei count, GLsizei primCount, GLint base)
 {
+    Profiler::Zone zone("FrameBuffer::draw");
     assert(TransformFeedback::TRANSFORM == NULL);
+    if (!p->isReady()) {
+        return;
+    }
     set();
     p->set();
     if (Logger::DEBUG_LOGGER != NULL) {
@@ -1379,7 +1552,11 @@ void FrameBuffer::draw(ptr<Program> p, const MeshBuffers &mesh, MeshMode m, GLin
 
 void FrameBuffer::multiDraw(ptr<Program> p, const MeshBuffers &mesh, MeshMode m, GLint *firsts, GLsizei *counts, GLsizei primCount, GLint* bases)
 {
+    Profiler::Zone zone("FrameBuffer::multiDraw");
     assert(TransformFeedback::TRANSFORM == NULL);
+    if (!p->isReady()) {
+        return;
+    }
     set();
     p->set();
     if (Logger::DEBUG_LOGGER != NULL) {
@@ -1392,7 +1569,11 @@ void FrameBuffer::multiDraw(ptr<Program> p, const MeshBuffers &mesh, MeshMode m,
 
 void FrameBuffer::drawIndirect(ptr<Program> p, const MeshBuffers &mesh, MeshMode m, const Buffer &buf)
 {
+    Profiler::Zone zone("FrameBuffer::drawIndirect");
     assert(TransformFeedback::TRANSFORM == NULL);
+    if (!p->isReady()) {
+        return;
+    }
     set();
     p->set();
     if (Logger::DEBUG_LOGGER != NULL) {
@@ -1403,9 +1584,30 @@ void FrameBuffer::drawIndirect(ptr<Program> p, const MeshBuffers &mesh, MeshMode
     endConditionalRender();
 }
 
+void FrameBuffer::multiDrawIndirect(ptr<Program> p, const MeshBuffers &mesh, MeshMode m, const Buffer &buf, GLsizei drawCount)
+{
+    Profiler::Zone zone("FrameBuffer::multiDrawIndirect");
+    assert(TransformFeedback::TRANSFORM == NULL);
+    if (!p->isReady()) {
+        return;
+    }
+    set();
+    p->set();
+    if (Logger::DEBUG_LOGGER != NULL) {
+        Logger::DEBUG_LOGGER->logf("RENDER", "MultiDrawIndirect (%d draws)", drawCount);
+    }
+    beginConditionalRender();
+    mesh.multiDrawIndirect(m, buf, drawCount);
+    endConditionalRender();
+}
+
 void FrameBuffer::drawFeedback(ptr<Program> p, const MeshBuffers &mesh, MeshMode m, const TransformFeedback &tfb, int stream)
 {
+    Profiler::Zone zone("FrameBuffer::drawFeedback");
     assert(TransformFeedback::TRANSFORM == NULL && tfb.id != 0);
+    if (!p->isReady()) {
+        return;
+    }
     set();
     p->set();
     if (Logger::DEBUG_LOGGER != NULL) {
@@ -1512,15 +1714,19 @@ void FrameBuffer::copyPixels(int xoff, int yoff, int x, int y, int w, int h, con
 
 GLint FrameBuffer::getMajorVersion()
 {
-    GLint v;
-    glGetIntegerv(GL_MAJOR_VERSION, &v);
+    static GLint v = -1;
+    if (v == -1) {
+        glGetIntegerv(GL_MAJOR_VERSION, &v);
+    }
     return v;
 }
 
 GLint FrameBuffer::getMinorVersion()
 {
-    GLint v;
-    glGetIntegerv(GL_MINOR_VERSION, &v);
+    static GLint v = -1;
+    if (v == -1) {
+        glGetIntegerv(GL_MINOR_VERSION, &v);
+    }
     return v;
 }
 
@@ -1566,6 +1772,7 @@ void FrameBuffer::set()
         glBindFramebuffer(GL_FRAMEBUFFER, framebufferId);
         CURRENT = this;
         framebufferChanged = true;
+        Statistics::add(Statistics::FRAMEBUFFER_SWITCHES);
     }
     if (framebufferChanged || parametersChanged != 0) {
         PARAMETERS.set(parameters);
@@ -45,6 +45,7 @@
 #include <vector>
 #include <map>
 
+#include "ork/core/Profiler.h"
 #include "ork/math/vec4.h"
 #include "ork/render/Mesh.h"
 #include "ork/render/Program.h"
@@ -1371,6 +1372,20 @@ public:
      */
     void drawIndirect(ptr<Program> p, const MeshBuffers &mesh, MeshMode m, const Buffer &buf);
 
+    /**
+     * Draws several parts of a mesh, each one or more times, with a single
+     * draw call. Only available with OpenGL 4.3 or more.
+     *
+     * @param p the program to use to draw the mesh.
+     * @param m how the mesh vertices must be interpreted.
+     * @param buf a CPU or GPU buffer containing, for each part, the 'count',
+     *      'primCount', 'first', 'base' and 'baseInstance' parameters, in
+     *      this order, as 32 bit integers ('base' must be omitted for meshes
+     *      without indices).
+     * @param drawCount the number of parts to draw.
+     */
+    void multiDrawIndirect(ptr<Program> p, const MeshBuffers &mesh, MeshMode m, const Buffer &buf, GLsizei drawCount);
+
     /**
      * Draws a mesh with a vertex count resulting from a transform feedback session.
      * Only available with OpenGL 4.0 or more.
@@ -1521,12 +1536,12 @@ public:
     void copyPixels(int xoff, int yoff, int x, int y, int w, int h, const TextureRectangle &dst, int level);
 
     /**
-     * Returns the OpenGL major version.
+     * Returns the OpenGL major version. The version is queried only once.
      */
     static GLint getMajorVersion();
 
     /**
-     * Returns the OpenGL minor version.
+     * Returns the OpenGL minor version. The version is queried only once.
      */
     static GLint getMinorVersion();
 
@@ -1674,11 +1689,16 @@ private:
 template<class vertex, class index>
 inline void FrameBuffer::draw(ptr<Program> p, const Mesh<vertex, index> &mesh, int primCount)
 {
+    Profiler::Zone zone("FrameBuffer::draw");
     assert(TransformFeedback::TRANSFORM == NULL);
+    if (!p->isReady()) {
+        return;
+    }
     set();
     p->set();
     beginConditionalRender();
-    mesh.getBuffers()->draw(mesh.getMode(), 0, mesh.getIndiceCount() == 0 ? mesh.getVertexCount() : mesh.getIndiceCount(), primCount, 0);
+    ptr<MeshBuffers> buffers = mesh.getBuffers();
+    buffers->draw(mesh.getMode(), mesh.streamFirst, mesh.getIndiceCount() == 0 ? mesh.getVertexCount() : mesh.getIndiceCount(), primCount, mesh.streamBase);
     endConditionalRender();
 }
 
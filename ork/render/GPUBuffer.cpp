@@ -46,6 +46,7 @@
 #include <GL/glew.h>
 
 #include "ork/core/Logger.h"
+#include "ork/core/Statistics.h"
 #include "ork/render/FrameBuffer.h"
 
 using namespace std;
@@ -219,7 +220,7 @@ GLuint UniformBufferManager::maxUnits = 0;
 
 static UniformBufferManager* UNIFORM_BUFFER_MANAGER = NULL;
 
-GPUBuffer::GPUBuffer() : size(0), mappedData(NULL), cpuData(NULL), isDirty(false), currentUniformUnit(-1)
+GPUBuffer::GPUBuffer() : size(0), mappedData(NULL), cpuData(NULL), isDirty(false), version(0), currentUniformUnit(-1)
 {
     if (UNIFORM_BUFFER_MANAGER == NULL) {
         UNIFORM_BUFFER_MANAGER = new UniformBufferManager();
@@ -255,6 +256,10 @@ void GPUBuffer::setData(int size, const void *data, BufferUsage u)
 {
     assert(mappedData == NULL);
     this->size = size;
+    ++version;
+    if (data != NULL) {
+        Statistics::add(Statistics::BUFFER_BYTES, size);
+    }
     glBindBuffer(GL_COPY_WRITE_BUFFER, bufferId);
     glBufferData(GL_COPY_WRITE_BUFFER, size, data, getBufferUsage(u));
     glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
@@ -278,6 +283,8 @@ void GPUBuffer::setData(int size, const void *data, BufferUsage u)
 void GPUBuffer::setSubData(int offset, int size, const void *data)
 {
     assert(mappedData == NULL);
+    ++version;
+    Statistics::add(Statistics::BUFFER_BYTES, size);
     glBindBuffer(GL_COPY_WRITE_BUFFER, bufferId);
     glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
     glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
@@ -297,6 +304,23 @@ void GPUBuffer::getSubData(int offset, int size, void *data)
     assert(FrameBuffer::getError() == GL_NO_ERROR);
 }
 
+void GPUBuffer::copySubData(ptr<GPUBuffer> src, int srcOffset, int offset, int size)
+{
+    assert(mappedData == NULL);
+    glBindBuffer(GL_COPY_READ_BUFFER, src->bufferId);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bufferId);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, srcOffset, offset, size);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    assert(FrameBuffer::getError() == GL_NO_ERROR);
+    dirty();
+}
+
+unsigned int GPUBuffer::getVersion() const
+{
+    return version;
+}
+
 volatile void *GPUBuffer::map(BufferAccess a)
 {
     assert(mappedData == NULL);
@@ -327,8 +351,10 @@ volatile void *GPUBuffer::getMappedData()
 void GPUBuffer::unmap()
 {
     assert(mappedData != NULL);
+    ++version;
 
     if (cpuData != NULL) {
+        Statistics::add(Statistics::BUFFER_BYTES, size);
         glBindBuffer(GL_COPY_WRITE_BUFFER, bufferId);
         glBufferSubData(GL_COPY_WRITE_BUFFER, 0, size, cpuData);
         glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
@@ -343,6 +369,27 @@ void GPUBuffer::unmap()
     mappedData = NULL;
 }
 
+volatile void *GPUBuffer::mapPersistent(int size)
+{
+    assert(mappedData == NULL);
+    this->size = size;
+    if (cpuData != NULL) {
+        delete[] cpuData;
+        cpuData = NULL;
+    }
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bufferId);
+    if (GLEW_ARB_buffer_storage) {
+        glBufferStorage(GL_COPY_WRITE_BUFFER, size, NULL, flags);
+        mappedData = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+    } else {
+        glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    assert(FrameBuffer::getError() == GL_NO_ERROR);
+    return mappedData;
+}
+
 void GPUBuffer::bind(int target) const
 {
     glBindBuffer(target, bufferId);
@@ -363,6 +410,7 @@ void GPUBuffer::unbind(int target) const
 void GPUBuffer::dirty() const
 {
     isDirty = true;
+    ++version;
 }
 
 void GPUBuffer::addUser(GLuint programId) const
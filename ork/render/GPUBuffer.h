@@ -105,6 +105,25 @@ public:
      */
     void getSubData(int offset, int size, void *data);
 
+    /**
+     * Replaces a part of the content of this buffer with a part of the
+     * content of another buffer. The copy is done on the GPU, without any
+     * synchronization with the CPU.
+     *
+     * @param src the buffer containing the data to be copied.
+     * @param srcOffset the offset of the data to be copied in src.
+     * @param offset index of the first byte to be replaced in this buffer.
+     * @param size number of bytes to be copied.
+     */
+    void copySubData(ptr<GPUBuffer> src, int srcOffset, int offset, int size);
+
+    /**
+     * Returns the number of times the content of this buffer has been
+     * changed, with #setData, #setSubData, #copySubData, #unmap, or by the
+     * GPU. Can be used to detect that a copy of this buffer is outdated.
+     */
+    unsigned int getVersion() const;
+
     /**
      * Maps this buffer into CPU memory and returns a pointer to it. If the
      * access mode is not READ_ONLY, changes made to the mapped buffer in CPU
@@ -124,6 +143,23 @@ public:
      */
     void unmap();
 
+    /**
+     * Allocates an immutable storage of the given size for this buffer, and
+     * maps it persistently and coherently into CPU memory for writing. The
+     * returned pointer remains valid until this buffer is deleted, and the
+     * content of this buffer can then only be changed through it. The GPU
+     * must not be reading a region while it is written (see RingBuffer).
+     * Persistent mappings require OpenGL 4.4 or ARB_buffer_storage. Without
+     * them, this method allocates a mutable storage of the given size and
+     * returns NULL, and the content of this buffer must then be changed with
+     * #setSubData.
+     *
+     * @param size the size of this buffer in bytes.
+     * @return the persistently mapped data of this buffer, or NULL if
+     *      persistent mappings are not supported.
+     */
+    volatile void *mapPersistent(int size);
+
 protected:
     virtual void bind(int target) const;
 
@@ -163,6 +199,11 @@ private:
      */
     mutable bool isDirty;
 
+    /**
+     * The number of times the content of this buffer has been changed.
+     */
+    mutable unsigned int version;
+
     /**
      * The uniform block binding unit to which this buffer is currently bound,
      * or -1 if it is not bound to any uniform block binding unit.
@@ -45,8 +45,10 @@
 #include <cstring> // for memcpy
 
 #include "ork/render/CPUBuffer.h"
+#include "ork/core/Logger.h"
 #include "ork/render/GPUBuffer.h"
 #include "ork/render/MeshBuffers.h"
+#include "ork/render/RingBuffer.h"
 
 namespace ork
 {
@@ -129,10 +131,31 @@ public:
     inline GLint getPatchVertices() const;
 
     /**
-     * Returns the MeshBuffers wrapped by this Mesh instance.
+     * Returns the MeshBuffers wrapped by this Mesh instance. If this mesh
+     * uses a RingBuffer, its data is stored at a varying position in this
+     * ring buffer, and this mesh must be drawn with
+     * FrameBuffer#draw(ptr<Program>, const Mesh<vertex, index>&, int).
      */
     inline ptr<MeshBuffers> getBuffers() const;
 
+    /**
+     * Returns the RingBuffer used to upload the data of this mesh, or NULL.
+     */
+    inline ptr<RingBuffer> getStreamBuffer() const;
+
+    /**
+     * Sets the RingBuffer used to upload the data of this mesh. Only for
+     * GPU_DYNAMIC and GPU_STREAM meshes. Instead of reallocating a buffer of
+     * its own each time its data changes, the mesh data is then copied into
+     * the region of the current frame of this ring buffer, and copied again
+     * at each new frame. If the ring buffer is full, the mesh reverts to its
+     * own buffers.
+     *
+     * @param stream a ring buffer, or NULL to use buffers owned by this
+     *      mesh.
+     */
+    inline void setStreamBuffer(ptr<RingBuffer> stream);
+
     /**
      * Declares an attribute of the vertices of this mesh.
      *
@@ -290,6 +313,33 @@ private:
      */
     mutable ptr<MeshBuffers> buffers;
 
+    /**
+     * The RingBuffer used to upload the data of this mesh, or NULL.
+     */
+    mutable ptr<RingBuffer> stream;
+
+    /**
+     * The indices attribute of this mesh when it uses #stream.
+     */
+    mutable ptr<AttributeBuffer> streamIndices;
+
+    /**
+     * The frame of #stream when the data of this mesh was last copied into
+     * it (see RingBuffer#getFrame).
+     */
+    mutable unsigned int streamFrame;
+
+    /**
+     * The position of the first indice (or vertex for meshes without
+     * indices) of this mesh in #stream, in indices (or vertices).
+     */
+    mutable GLint streamFirst;
+
+    /**
+     * The position of the first vertex of this mesh in #stream, in vertices.
+     */
+    mutable GLint streamBase;
+
     /**
      * Resizes the vertex array to expand its capacity.
      */
@@ -316,12 +366,19 @@ private:
      */
     void uploadIndexDataToGPU(BufferUsage u) const;
 
+    /**
+     * Copies the vertices and indices into #stream, if they changed or if
+     * they were copied in a previous frame. Returns false if #stream is full.
+     */
+    bool uploadToStreamBuffer() const;
+
     friend class FrameBuffer;
 };
 
 template<class vertex, class index>
 Mesh<vertex, index>::Mesh(MeshMode m, MeshUsage usage, int vertexCount, int indiceCount) :
-    Object("Mesh"), usage(usage), vertexBuffer(NULL), indexBuffer(NULL), created(false), m(m), buffers(new MeshBuffers())
+    Object("Mesh"), usage(usage), vertexBuffer(NULL), indexBuffer(NULL), created(false), m(m), buffers(new MeshBuffers()),
+    streamFrame(0), streamFirst(0), streamBase(0)
 {
     vertices = new vertex[vertexCount];
     verticesLength = vertexCount;
@@ -337,7 +394,8 @@ Mesh<vertex, index>::Mesh(MeshMode m, MeshUsage usage, int vertexCount, int indi
 
 template<class vertex, class index>
 Mesh<vertex, index>::Mesh(ptr<MeshBuffers> target, MeshMode m, MeshUsage usage, int vertexCount, int indiceCount) :
-    Object("Mesh"), usage(usage), created(false), m(m), buffers(target)
+    Object("Mesh"), usage(usage), created(false), m(m), buffers(target),
+    streamFrame(0), streamFirst(0), streamBase(0)
 {
     vertices = new vertex[vertexCount];
     verticesLength = vertexCount;
@@ -418,6 +476,41 @@ void Mesh<vertex, index>::uploadIndexDataToGPU(BufferUsage u) const
     indexDataHasChanged = false;
 }
 
+template<class vertex, class index>
+bool Mesh<vertex, index>::uploadToStreamBuffer() const
+{
+    bool newFrame = streamFrame != stream->getFrame();
+    if (vertexDataHasChanged || newFrame) {
+        int offset = stream->write(vertices, verticesCount * sizeof(vertex), sizeof(vertex));
+        if (offset < 0) {
+            return false;
+        }
+        streamBase = offset / sizeof(vertex);
+        vertexDataHasChanged = false;
+    }
+    if (indicesCount != 0 && (indexDataHasChanged || newFrame)) {
+        int offset = stream->write(indices, indicesCount * sizeof(index), sizeof(index));
+        if (offset < 0) {
+            return false;
+        }
+        streamFirst = offset / sizeof(index);
+        indexDataHasChanged = false;
+    }
+    streamFrame = stream->getFrame();
+
+    buffers->nvertices = verticesCount;
+    buffers->nindices = indicesCount;
+    if (indicesCount == 0) {
+        streamFirst = streamBase;
+        if (buffers->getIndiceBuffer() != NULL) {
+            buffers->setIndicesBuffer(NULL);
+        }
+    } else if (buffers->getIndiceBuffer() == NULL) {
+        buffers->setIndicesBuffer(streamIndices);
+    }
+    return true;
+}
+
 template<class vertex, class index>
 ptr<MeshBuffers> Mesh<vertex, index>::getBuffers() const
 {
@@ -425,7 +518,15 @@ ptr<MeshBuffers> Mesh<vertex, index>::getBuffers() const
         createBuffers();
     }
 
-    if ((usage == GPU_DYNAMIC) || (usage == GPU_STREAM)) { // upload data to GPU if needed
+    if (stream != NULL && !uploadToStreamBuffer()) {
+        if (Logger::WARNING_LOGGER != NULL) {
+            Logger::WARNING_LOGGER->log("RENDER", "Ring buffer full, mesh uses its own buffers");
+        }
+        const_cast<Mesh<vertex, index>*>(this)->setStreamBuffer(NULL);
+        createBuffers();
+    }
+
+    if (stream == NULL && ((usage == GPU_DYNAMIC) || (usage == GPU_STREAM))) { // upload data to GPU if needed
         BufferUsage u = usage == GPU_DYNAMIC ? DYNAMIC_DRAW : STREAM_DRAW;
         if (vertexDataHasChanged) {
             uploadVertexDataToGPU(u);
@@ -441,6 +542,29 @@ ptr<MeshBuffers> Mesh<vertex, index>::getBuffers() const
     return buffers;
 }
 
+template<class vertex, class index>
+ptr<RingBuffer> Mesh<vertex, index>::getStreamBuffer() const
+{
+    return stream;
+}
+
+template<class vertex, class index>
+void Mesh<vertex, index>::setStreamBuffer(ptr<RingBuffer> stream)
+{
+    assert(stream == NULL || usage == GPU_DYNAMIC || usage == GPU_STREAM);
+    if (created) {
+        buffers->reset();
+        buffers->setIndicesBuffer(NULL);
+        created = false;
+    }
+    this->stream = stream;
+    streamIndices = NULL;
+    streamFirst = 0;
+    streamBase = 0;
+    vertexDataHasChanged = true;
+    indexDataHasChanged = true;
+}
+
 template<class vertex, class index>
 void Mesh<vertex, index>::addAttributeType(int id, int size, AttributeType type, bool norm)
 {
@@ -526,7 +650,7 @@ void Mesh<vertex, index>::resizeVertices(int newSize)
     delete[] vertices;
     vertices = newVertices;
     verticesLength = newSize;
-    if (created) {
+    if (created && stream == NULL) {
         buffers->reset();
         created = false;
     }
@@ -540,7 +664,7 @@ void Mesh<vertex, index>::resizeIndices(int newSize)
     delete[] indices;
     indices = newIndices;
     indicesLength = newSize;
-    if (created) {
+    if (created && stream == NULL) {
         buffers->reset();
         created = false;
     }
@@ -553,7 +677,8 @@ void Mesh<vertex, index>::clear()
     indicesCount = 0;
     vertexDataHasChanged = true;
     indexDataHasChanged = true;
-    if (created) {
+    // a mesh using a ring buffer keeps the same buffers, see uploadToStreamBuffer
+    if (created && stream == NULL) {
         buffers->reset();
         buffers->setIndicesBuffer(NULL);
         created = false;
@@ -572,7 +697,9 @@ void Mesh<vertex, index>::clearBuffers()
 template<class vertex, class index>
 void Mesh<vertex, index>::createBuffers() const
 {
-    if (usage == GPU_STATIC || usage == GPU_DYNAMIC || usage ==  GPU_STREAM) {
+    if (stream != NULL) {
+        vertexBuffer = stream->getBuffer();
+    } else if (usage == GPU_STATIC || usage == GPU_DYNAMIC || usage ==  GPU_STREAM) {
         GPUBuffer *gpub = new GPUBuffer();
         vertexBuffer = ptr<Buffer>(gpub);
         if (usage == GPU_STATIC) {
@@ -588,7 +715,25 @@ void Mesh<vertex, index>::createBuffers() const
         buffers->getAttributeBuffer(i)->setBuffer(vertexBuffer);
     }
 
-    if (indicesCount != 0) {
+    AttributeType type;
+    switch (sizeof(index)) {
+    case 1:
+        type = A8UI;
+        break;
+    case 2:
+        type = A16UI;
+        break;
+    default:
+        type = A32UI;
+        break;
+    }
+    if (stream != NULL) {
+        indexBuffer = stream->getBuffer();
+        streamIndices = new AttributeBuffer(0, 1, type, false, indexBuffer);
+        if (indicesCount != 0) {
+            buffers->setIndicesBuffer(streamIndices);
+        }
+    } else if (indicesCount != 0) {
         if (usage == GPU_STATIC || usage == GPU_DYNAMIC || usage == GPU_STREAM) {
             GPUBuffer *gpub = new GPUBuffer();
             indexBuffer = ptr<Buffer>(gpub);
@@ -599,19 +744,6 @@ void Mesh<vertex, index>::createBuffers() const
             CPUBuffer *cpub = new CPUBuffer(indices);
             indexBuffer = ptr<Buffer>(cpub);
         }
-
-        AttributeType type;
-        switch (sizeof(index)) {
-        case 1:
-            type = A8UI;
-            break;
-        case 2:
-            type = A16UI;
-            break;
-        default:
-            type = A32UI;
-            break;
-        }
         buffers->setIndicesBuffer(new AttributeBuffer(0, 1, type, false, indexBuffer));
     }
     buffers->mode = m;
@@ -43,6 +43,8 @@
 
 #include <GL/glew.h>
 
+#include "ork/core/Atomic.h"
+#include "ork/core/Statistics.h"
 #include "ork/math/half.h"
 #include "ork/render/Program.h"
 #include "ork/render/FrameBuffer.h"
@@ -57,8 +59,17 @@ GLenum getAttributeType(AttributeType t);
 
 GLenum getMeshMode(MeshMode m);
 
+/**
+ * Returns a new version number for MeshBuffers#getVersion.
+ */
+static unsigned int nextVersion()
+{
+    static long VERSION = 0;
+    return (unsigned int) atomic_exchange_and_add(&VERSION, 1) + 1;
+}
+
 MeshBuffers::MeshBuffers() :
-    Object("MeshBuffers"), mode(POINTS), nvertices(0), nindices(0), primitiveRestart(-1), patchVertices(0)
+    Object("MeshBuffers"), mode(POINTS), nvertices(0), nindices(0), primitiveRestart(-1), patchVertices(0), version(nextVersion()), clientArrays(false)
 {
 }
 
@@ -68,6 +79,15 @@ MeshBuffers::~MeshBuffers()
         unbind();
         CURRENT = NULL;
     }
+    if (!vertexArrays.empty()) {
+        // the vertex array objects of other contexts cannot be deleted here
+        const void *context = FrameBuffer::getDefault().get();
+        for (unsigned int i = 0; i < vertexArrays.size(); ++i) {
+            if (vertexArrays[i].context == context) {
+                glDeleteVertexArrays(1, &vertexArrays[i].id);
+            }
+        }
+    }
 }
 
 int MeshBuffers::getAttributeCount() const
@@ -85,10 +105,16 @@ ptr<AttributeBuffer> MeshBuffers::getIndiceBuffer() const
     return indicesBuffer;
 }
 
+unsigned int MeshBuffers::getVersion() const
+{
+    return version;
+}
+
 void MeshBuffers::addAttributeBuffer(int index, int size, AttributeType type, bool norm)
 {
     ptr<AttributeBuffer> a = new AttributeBuffer(index, size, type, norm, NULL);
     attributeBuffers.push_back(a);
+    version = nextVersion();
 }
 
 void MeshBuffers::addAttributeBuffer(int index, int size, int vertexsize, AttributeType type, bool norm)
@@ -102,21 +128,88 @@ void MeshBuffers::addAttributeBuffer(int index, int size, int vertexsize, Attrib
     }
     ptr<AttributeBuffer> a = new AttributeBuffer(index, size, type, norm, NULL, vertexsize, offset);
     attributeBuffers.push_back(a);
+    version = nextVersion();
 }
 
 void MeshBuffers::addAttributeBuffer(ptr<AttributeBuffer> buffer)
 {
     attributeBuffers.push_back(buffer);
+    version = nextVersion();
 }
 
 void MeshBuffers::setIndicesBuffer(ptr<AttributeBuffer> indices)
 {
     indicesBuffer = indices;
+    version = nextVersion();
+}
+
+void MeshBuffers::getVertexArrayFormat(vector<size_t> &format) const
+{
+    format.clear();
+    for (unsigned int i = 0; i < attributeBuffers.size(); ++i) {
+        const AttributeBuffer *a = attributeBuffers[i].get();
+        format.push_back(size_t(a));
+        format.push_back(size_t(a->b.get()));
+        format.push_back(size_t(a->index));
+        format.push_back(size_t(a->size));
+        format.push_back(size_t(a->type));
+        format.push_back(size_t(a->norm) | (size_t(a->I) << 1) | (size_t(a->L) << 2));
+        format.push_back(size_t(a->stride));
+        format.push_back(size_t(a->offset));
+        format.push_back(size_t(a->divisor));
+    }
+    format.push_back(size_t(indicesBuffer.get()));
+    format.push_back(indicesBuffer == NULL ? 0 : size_t(indicesBuffer->b.get()));
 }
 
 void MeshBuffers::bind() const
 {
     assert(attributeBuffers.size() > 0);
+    // client side arrays cannot be recorded in a vertex array object
+    clientArrays = indicesBuffer != NULL && indicesBuffer->b.cast<GPUBuffer>() == NULL;
+    for (unsigned int i = 0; i < attributeBuffers.size() && !clientArrays; ++i) {
+        clientArrays = attributeBuffers[i]->b.cast<GPUBuffer>() == NULL;
+    }
+    if (clientArrays) {
+        glBindVertexArray(0);
+        bindAttributes();
+        return;
+    }
+    getVertexArrayFormat(vertexArrayFormat);
+    const void *context = FrameBuffer::getDefault().get();
+    VertexArray *v = NULL;
+    for (unsigned int i = 0; i < vertexArrays.size(); ++i) {
+        if (vertexArrays[i].context == context) {
+            v = &vertexArrays[i];
+            break;
+        }
+    }
+    if (v == NULL) {
+        vertexArrays.push_back(VertexArray());
+        v = &vertexArrays.back();
+        v->context = context;
+        glGenVertexArrays(1, &v->id);
+    } else if (v->format == vertexArrayFormat) {
+        glBindVertexArray(v->id);
+        if (indicesBuffer != NULL) {
+            type = indicesBuffer->type;
+            offset = indicesBuffer->b->data(indicesBuffer->offset);
+        }
+        assert(FrameBuffer::getError() == 0);
+        return;
+    } else {
+        // recreates the vertex array object, so that the attributes enabled
+        // for a previous format do not remain enabled
+        glDeleteVertexArrays(1, &v->id);
+        glGenVertexArrays(1, &v->id);
+    }
+    glBindVertexArray(v->id);
+    v->format = vertexArrayFormat;
+    bindAttributes();
+}
+
+void MeshBuffers::bindAttributes() const
+{
     // binds the attribute buffers for each attribute
     for (int i = (int) attributeBuffers.size() - 1; i >= 0; --i) {
         ptr<AttributeBuffer> a = attributeBuffers[i];
@@ -140,17 +233,22 @@ void MeshBuffers::bind() const
         b->bind(GL_ELEMENT_ARRAY_BUFFER);
         type = indicesBuffer->type;
         offset = b->data(indicesBuffer->offset);
+    } else if (!clientArrays) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     }
     assert(FrameBuffer::getError() == 0);
 }
 
 void MeshBuffers::unbind() const
 {
-    for (int i = (int) attributeBuffers.size() - 1; i >= 0; --i) {
-        ptr<AttributeBuffer> a = attributeBuffers[i];
-        int index = a->index;
-        glDisableVertexAttribArray(index);
+    if (clientArrays) {
+        for (int i = (int) attributeBuffers.size() - 1; i >= 0; --i) {
+            ptr<AttributeBuffer> a = attributeBuffers[i];
+            int index = a->index;
+            glDisableVertexAttribArray(index);
+        }
     }
+    glBindVertexArray(0);
     assert(glGetError() == 0);
 }
 
@@ -570,16 +668,22 @@ void MeshBuffers::setDefaultAttributeP(GLuint index, int count, GLuint *defaultV
 
 void MeshBuffers::swap(ptr<MeshBuffers> buffers)
 {
+    // the attribute format of the current vertex array changes
+    reset();
+    buffers->reset();
     std::swap(mode, buffers->mode);
     std::swap(nvertices, buffers->nvertices);
     std::swap(nindices, buffers->nindices);
     std::swap(bounds, buffers->bounds);
     std::swap(attributeBuffers, buffers->attributeBuffers);
     std::swap(indicesBuffer, buffers->indicesBuffer);
+    version = nextVersion();
+    buffers->version = nextVersion();
 }
 
 void MeshBuffers::draw(MeshMode m, GLint first, GLsizei count, GLsizei primCount, GLint base) const
 {
+    Statistics::add(Statistics::DRAW_CALLS);
     if (CURRENT != this) {
         set();
     }
@@ -641,6 +745,7 @@ void MeshBuffers::draw(MeshMode m, GLint first, GLsizei count, GLsizei primCount
 
 void MeshBuffers::multiDraw(MeshMode m, GLint *firsts, GLsizei *counts, GLsizei primCount, GLint *bases) const
 {
+    Statistics::add(Statistics::DRAW_CALLS);
     if (CURRENT != this) {
         set();
     }
@@ -692,6 +797,7 @@ void MeshBuffers::multiDraw(MeshMode m, GLint *firsts, GLsizei *counts, GLsizei
 
 void MeshBuffers::drawIndirect(MeshMode m, const Buffer &buf) const
 {
+    Statistics::add(Statistics::DRAW_CALLS);
     if (CURRENT != this) {
         set();
     }
@@ -733,8 +839,53 @@ void MeshBuffers::drawIndirect(MeshMode m, const Buffer &buf) const
 #endif
 }
 
+void MeshBuffers::multiDrawIndirect(MeshMode m, const Buffer &buf, GLsizei drawCount, GLsizei stride) const
+{
+    Statistics::add(Statistics::DRAW_CALLS);
+    if (CURRENT != this) {
+        set();
+    }
+
+    if (primitiveRestart != CURRENT_RESTART_INDEX) {
+        if (primitiveRestart >= 0) {
+            glEnable(GL_PRIMITIVE_RESTART);
+            glPrimitiveRestartIndex(GLuint(primitiveRestart));
+        } else {
+            glDisable(GL_PRIMITIVE_RESTART);
+        }
+        CURRENT_RESTART_INDEX = primitiveRestart;
+    }
+    if (patchVertices > 0 && patchVertices != CURRENT_PATCH_VERTICES) {
+        glPatchParameteri(GL_PATCH_VERTICES, patchVertices);
+    }
+
+    buf.bind(GL_DRAW_INDIRECT_BUFFER);
+    if (indicesBuffer == NULL) {
+        glMultiDrawArraysIndirect(getMeshMode(m), buf.data(0), drawCount, stride);
+    } else {
+        glMultiDrawElementsIndirect(getMeshMode(m), getAttributeType(type), buf.data(0), drawCount, stride);
+    }
+    buf.unbind(GL_DRAW_INDIRECT_BUFFER);
+
+#ifndef NDEBUG
+    GLenum err = glGetError();
+    if (err != 0) {
+        if (Program::CURRENT == NULL || Program::CURRENT->checkSamplers()) {
+            if (Logger::ERROR_LOGGER != NULL) {
+                ostringstream oss;
+                oss << "OpenGL error " << err << ", returned string '" << gluErrorString(err) << "'";
+                Logger::ERROR_LOGGER->log("RENDER", oss.str());
+                Logger::ERROR_LOGGER->flush();
+            }
+            assert(err == 0);
+        }
+    }
+#endif
+}
+
 void MeshBuffers::drawFeedback(MeshMode m, GLuint tfb, int stream) const
 {
+    Statistics::add(Statistics::DRAW_CALLS);
     if (CURRENT != this) {
         set();
     }
@@ -123,6 +123,15 @@ public:
      */
     ptr<AttributeBuffer> getIndiceBuffer() const;
 
+    /**
+     * Returns the version of the attribute and indices buffers of this mesh.
+     * This number changes each time a buffer is added or set, or when this
+     * mesh is updated with #swap. It is never shared by two meshes, so that a
+     * mesh address and this version can be used as a cache key, without
+     * keeping this mesh alive.
+     */
+    unsigned int getVersion() const;
+
     /**
      * Adds a vertex attribute buffer to this mesh. This method assumes that
      * this vertex attribute is stored in its own buffer.
@@ -357,6 +366,21 @@ protected:
      */
     void drawIndirect(MeshMode m, const Buffer &buf) const;
 
+    /**
+     * Draws several parts of this mesh, each one or more times, with a
+     * single draw call.
+     *
+     * @param m how the mesh vertices must be interpreted.
+     * @param buf a CPU or GPU buffer containing, for each part, the 'count',
+     *      'primCount', 'first', 'base' and 'baseInstance' parameters, in
+     *      this order, as 32 bit integers ('base' must be omitted for meshes
+     *      without indices).
+     * @param drawCount the number of parts to draw.
+     * @param stride the distance in bytes between the parameters of two
+     *      consecutive parts, or 0 if they are tightly packed.
+     */
+    void multiDrawIndirect(MeshMode m, const Buffer &buf, GLsizei drawCount, GLsizei stride = 0) const;
+
     /**
      * Draws this mesh with a vertex count resulting from a transform feedback session.
      * Only available with OpenGL 4.0 or more.
@@ -378,6 +402,54 @@ private:
      */
     ptr<AttributeBuffer> indicesBuffer;
 
+    /**
+     * The version of #attributeBuffers and #indicesBuffer (see #getVersion).
+     */
+    unsigned int version;
+
+    /**
+     * A vertex array object of this mesh. It records the attribute formats
+     * and buffers and the indices buffer of this mesh, so that binding this
+     * mesh requires a single OpenGL call.
+     */
+    struct VertexArray
+    {
+        /**
+         * The OpenGL context of this vertex array object, identified by its
+         * default framebuffer (vertex array objects are not shared between
+         * contexts).
+         */
+        const void *context;
+
+        /**
+         * The id of this vertex array object.
+         */
+        GLuint id;
+
+        /**
+         * The attribute formats and buffers recorded in this vertex array
+         * object (see #getVertexArrayFormat).
+         */
+        std::vector<size_t> format;
+    };
+
+    /**
+     * The vertex array objects of this mesh, one per OpenGL context.
+     */
+    mutable std::vector<VertexArray> vertexArrays;
+
+    /**
+     * The current attribute formats and buffers of this mesh. Only used in
+     * #bind, to compare them with those of the vertex array objects.
+     */
+    mutable std::vector<size_t> vertexArrayFormat;
+
+    /**
+     * True if this mesh is bound without vertex array object, because some
+     * of its buffers are CPUBuffer.
+     */
+    mutable bool clientArrays;
+
     /**
      * The currently bound mesh buffers. The buffers of a mesh must be bound
      * before it can be drawn.
@@ -405,10 +477,26 @@ private:
     static void *offset;
 
     /**
-     * Binds the buffers of this mesh, so that it is ready to be drawn.
+     * Binds the buffers of this mesh, so that it is ready to be drawn. This
+     * binds the vertex array object of this mesh for the current context,
+     * after specifying it if it does not exist yet or if the attribute
+     * formats or buffers of this mesh have changed. Meshes using CPUBuffer
+     * are bound without vertex array object.
      */
     void bind() const;
 
+    /**
+     * Specifies the attribute formats and buffers and the indices buffer
+     * of this mesh in the currently bound vertex array object.
+     */
+    void bindAttributes() const;
+
+    /**
+     * Returns the attribute formats and buffers and the indices buffer of
+     * this mesh, encoded in the given vector.
+     */
+    void getVertexArrayFormat(std::vector<size_t> &format) const;
+
     /**
      * Unbinds the buffers of this mesh, so that another mesh can be bound instead.
      */
@@ -53,6 +53,8 @@ using namespace std;
 namespace ork
 {
 
+bool Module::ASYNC_COMPILATION = false;
+
 Module::Module() : Object("Module")
 {
 }
@@ -117,8 +119,7 @@ void Module::init(int version,
         vertexShaderId = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertexShaderId, lineCount, lines, NULL);
         glCompileShader(vertexShaderId);
-        error = !check(vertexShaderId);
-        printLog(vertexShaderId, lineCount, lines, error);
+        error = !check(vertexShaderId, lineCount, lines);
         if (error) {
             // deletes already allocated objects
             glDeleteShader(vertexShaderId);
@@ -138,8 +139,7 @@ void Module::init(int version,
         tessControlShaderId = glCreateShader(GL_TESS_CONTROL_SHADER);
         glShaderSource(tessControlShaderId, lineCount, lines, NULL);
         glCompileShader(tessControlShaderId);
-        error = !check(tessControlShaderId);
-        printLog(tessControlShaderId, lineCount, lines, error);
+        error = !check(tessControlShaderId, lineCount, lines);
         if (error) {
             // deletes already allocated objects
             if (vertexShaderId != -1) {
@@ -163,8 +163,7 @@ void Module::init(int version,
         tessEvalShaderId = glCreateShader(GL_TESS_EVALUATION_SHADER);
         glShaderSource(tessEvalShaderId, lineCount, lines, NULL);
         glCompileShader(tessEvalShaderId);
-        error = !check(tessEvalShaderId);
-        printLog(tessEvalShaderId, lineCount, lines, error);
+        error = !check(tessEvalShaderId, lineCount, lines);
         if (error) {
             // deletes already allocated objects
             if (vertexShaderId != -1) {
@@ -192,8 +191,7 @@ void Module::init(int version,
         geometryShaderId = glCreateShader(GL_GEOMETRY_SHADER);
         glShaderSource(geometryShaderId, lineCount, lines, NULL);
         glCompileShader(geometryShaderId);
-        error = !check(geometryShaderId);
-        printLog(geometryShaderId, lineCount, lines, error);
+        error = !check(geometryShaderId, lineCount, lines);
         if (error) {
             // deletes already allocated objects
             if (vertexShaderId != -1) {
@@ -225,8 +223,7 @@ void Module::init(int version,
         fragmentShaderId = glCreateShader(GL_FRAGMENT_SHADER);
         glShaderSource(fragmentShaderId, lineCount, lines, NULL);
         glCompileShader(fragmentShaderId);
-        error = !check(fragmentShaderId);
-        printLog(fragmentShaderId, lineCount, lines, error);
+        error = !check(fragmentShaderId, lineCount, lines);
         if (error) {
             // deletes already allocated objects
             if (vertexShaderId != -1) {
@@ -316,6 +313,39 @@ const set<Program*> &Module::getUsers() const
     return users;
 }
 
+bool Module::isReady(bool wait)
+{
+    map<int, string>::iterator i = pendingShaders.begin();
+    while (i != pendingShaders.end()) {
+        if (!wait && GLEW_KHR_parallel_shader_compile) {
+            GLint done;
+            glGetShaderiv(i->first, GL_COMPLETION_STATUS_KHR, &done);
+            if (done == GL_FALSE) {
+                return false;
+            }
+        }
+        const char *lines = i->second.c_str();
+        GLint compiled;
+        glGetShaderiv(i->first, GL_COMPILE_STATUS, &compiled);
+        printLog(i->first, 1, &lines, compiled == 0);
+        pendingShaders.erase(i++);
+    }
+    return true;
+}
+
+bool Module::isAsynchronousCompilation()
+{
+    return ASYNC_COMPILATION;
+}
+
+void Module::setAsynchronousCompilation(bool async)
+{
+    if (async && !ASYNC_COMPILATION && GLEW_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    }
+    ASYNC_COMPILATION = async;
+}
+
 void Module::setFeedbackMode(bool interleaved)
 {
     feedbackMode = interleaved ? 1 : 2;
@@ -360,12 +390,21 @@ void Module::swap(ptr<Module> s)
     std::swap(geometryShaderId, s->geometryShaderId);
     std::swap(fragmentShaderId, s->fragmentShaderId);
     std::swap(initialValues, s->initialValues);
+    std::swap(pendingShaders, s->pendingShaders);
 }
 
-bool Module::check(int shaderId)
+bool Module::check(int shaderId, int nlines, const char** lines)
 {
+    if (ASYNC_COMPILATION) {
+        string &source = pendingShaders[shaderId];
+        for (int i = 0; i < nlines; ++i) {
+            source += lines[i];
+        }
+        return true;
+    }
     GLint compiled;
     glGetShaderiv(shaderId, GL_COMPILE_STATUS, &compiled);
+    printLog(shaderId, nlines, lines, compiled == 0);
     return compiled != 0;
 }
 
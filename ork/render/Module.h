@@ -167,6 +167,41 @@ public:
      */
     const std::set<Program*> &getUsers() const;
 
+    /**
+     * Returns true if the shaders of this module are compiled. This is
+     * always the case for modules created in synchronous mode (see
+     * #setAsynchronousCompilation). Otherwise the compiler output is logged
+     * when this method first finds that the compilation is finished. This
+     * method must be called in the OpenGL thread.
+     *
+     * @param wait true to wait until the compilation is finished. Otherwise
+     *      this method returns immediately, if the KHR_parallel_shader_compile
+     *      extension is available (without it this method always waits).
+     * @return true if the compilation is finished (successfully or not).
+     */
+    bool isReady(bool wait = false);
+
+    /**
+     * Returns true if the modules and programs are compiled and linked
+     * asynchronously (see #setAsynchronousCompilation).
+     */
+    static bool isAsynchronousCompilation();
+
+    /**
+     * Sets the compilation mode of the modules and programs created from now
+     * on. In synchronous mode (the default) their constructor waits for the
+     * compilation and link results, and throws an exception if there are
+     * errors. In asynchronous mode their constructor only starts the
+     * compilation and link, whose results are checked later, when needed
+     * (see #isReady and Program#isReady). The compilation then runs in
+     * parallel in the driver threads if the KHR_parallel_shader_compile
+     * extension is available, and the errors are only logged.
+     *
+     * @param async true to compile the modules and link the programs
+     *      asynchronously.
+     */
+    static void setAsynchronousCompilation(bool async);
+
     /**
      * Sets the format to use when a Program using this module is
      * used in transform feedback.
@@ -289,11 +324,27 @@ private:
     std::map<std::string, ptr<Value> > initialValues;
 
     /**
-     * Checks if a shader part has been correctly compiled.
+     * The shaders of this module whose compilation results have not been
+     * checked yet, with their source code (see #isReady).
+     */
+    std::map<int, std::string> pendingShaders;
+
+    /**
+     * True if the modules and programs are compiled and linked
+     * asynchronously (see #setAsynchronousCompilation).
+     */
+    static bool ASYNC_COMPILATION;
+
+    /**
+     * Checks if a shader part has been correctly compiled, and logs the
+     * compiler output. In asynchronous mode the check is delayed until
+     * #isReady is called, and this method returns true.
      *
      * @param shaderId the id the shader part to check.
+     * @param nlines number of lines in the shader source code.
+     * @param lines the shader source code.
      */
-    bool check(int shaderId);
+    bool check(int shaderId, int nlines, const char** lines);
 
     /**
      * Logs the shader compiler output.
@@ -26,6 +26,7 @@
 #include <GL/glew.h>
 #include <set>
 
+#include "ork/core/Statistics.h"
 #include "ork/resource/ResourceTemplate.h"
 #include "ork/render/FrameBuffer.h"
 
@@ -45,29 +46,29 @@ GLenum getStage(Stage s);
 
 Program *Program::CURRENT = NULL;
 
-Program::Program() : Object("Program")
+Program::Program() : Object("Program"), uniformsVersion(nextUniformsVersion()), bindless(false), pending(0)
 {
 }
 
-Program::Program(const vector< ptr<Module> > &modules, bool separable) : Object("Program")
+Program::Program(const vector< ptr<Module> > &modules, bool separable) : Object("Program"), uniformsVersion(nextUniformsVersion()), bindless(false), pending(0)
 {
     init(modules, separable);
 }
 
-Program::Program(ptr<Module> module, bool separable) : Object("Program")
+Program::Program(ptr<Module> module, bool separable) : Object("Program"), uniformsVersion(nextUniformsVersion()), bindless(false), pending(0)
 {
     vector< ptr<Module> > modules;
     modules.push_back(module);
     init(modules, separable);
 }
 
-Program::Program(GLenum format, GLsizei length, unsigned char *binary, bool separable) : Object("Program")
+Program::Program(GLenum format, GLsizei length, unsigned char *binary, bool separable) : Object("Program"), uniformsVersion(nextUniformsVersion()), bindless(false), pending(0)
 {
     init(format, length, binary, separable);
 }
 
 Program::Program(ptr<Program> vertex, ptr<Program> tessControl, ptr<Program> tessEval, ptr<Program> geometry, ptr<Program> fragment) :
-    Object("Program")
+    Object("Program"), uniformsVersion(nextUniformsVersion()), bindless(false), pending(0)
 {
     programId = 0;
     glGenProgramPipelines(1, &pipelineId);
@@ -165,7 +166,12 @@ void Program::init(const vector< ptr<Module> > &modules, bool separable)
     }
     glLinkProgram(programId);
 
-    initUniforms();
+    if (Module::isAsynchronousCompilation()) {
+        // the link status and the uniforms are read in isReady
+        pending = 1;
+    } else {
+        initUniforms();
+    }
 }
 
 void Program::init(GLenum format, GLsizei length, unsigned char *binary, bool separable)
@@ -186,6 +192,7 @@ void Program::init(GLenum format, GLsizei length, unsigned char *binary, bool se
 
 void Program::init(Stage s, ptr<Program> p)
 {
+    p->isReady(true);
     assert(p->programId > 0);
     for (unsigned int i = 0; i < pipelinePrograms.size(); ++i) {
         if (pipelinePrograms[i] == p) {
@@ -718,8 +725,22 @@ vector< ptr<Uniform> > Program::getUniforms() const
     return result;
 }
 
+unsigned int Program::getUniformsVersion() const
+{
+    return uniformsVersion;
+}
+
+unsigned int Program::nextUniformsVersion()
+{
+    static long VERSION = 0;
+    return (unsigned int) atomic_exchange_and_add(&VERSION, 1) + 1;
+}
+
 ptr<Uniform> Program::getUniform(const string &name)
 {
+    if (pending) {
+        isReady(true);
+    }
     map<string, ptr<Uniform> >::iterator i = uniforms.find(name);
     if (i == uniforms.end()) {
 //        Logger::WARNING_LOGGER->logf("RENDER", "Missing Uniform %s", name.c_str());
@@ -730,6 +751,9 @@ ptr<Uniform> Program::getUniform(const string &name)
 
 ptr<UniformBlock> Program::getUniformBlock(const string &name)
 {
+    if (pending) {
+        isReady(true);
+    }
     map<string, ptr<UniformBlock> >::iterator i = uniformBlocks.find(name);
     if (i == uniformBlocks.end()) {
         return NULL;
@@ -737,8 +761,64 @@ ptr<UniformBlock> Program::getUniformBlock(const string &name)
     return i->second;
 }
 
+bool Program::isBindless() const
+{
+    return bindless;
+}
+
+void Program::setBindless(bool bindless)
+{
+    bindless = bindless && Texture::isBindlessSupported();
+    if (this->bindless == bindless) {
+        return;
+    }
+    this->bindless = bindless;
+    if (bindless) {
+        for (unsigned int i = 0; i < uniformSamplers.size(); ++i) {
+            if (uniformSamplers[i]->block != NULL) {
+                uniformSamplers[i]->setValue();
+            }
+        }
+    }
+}
+
+bool Program::isReady(bool wait)
+{
+    if (pending) {
+        if (!wait && GLEW_KHR_parallel_shader_compile) {
+            GLint done;
+            glGetProgramiv(programId, GL_COMPLETION_STATUS_KHR, &done);
+            if (done == GL_FALSE) {
+                return false;
+            }
+        }
+        for (unsigned int i = 0; i < modules.size(); ++i) {
+            modules[i]->isReady(true);
+        }
+        try {
+            initUniforms();
+        } catch (...) {
+            // the link errors have been logged, and programId set to 0
+        }
+        uniformsVersion = nextUniformsVersion();
+        // the program is no longer pending only once its uniforms are fully
+        // initialized, so that the threads that test isPending never see
+        // partially filled uniform maps (this is a memory barrier)
+        atomic_decrement(&pending);
+    }
+    return programId > 0 || pipelineId > 0;
+}
+
+bool Program::isPending() const
+{
+    return atomic_exchange_and_add(const_cast<volatile long*>(&pending), 0) != 0;
+}
+
 unsigned char *Program::getBinary(GLsizei &length, GLenum &format)
 {
+    if (pending) {
+        isReady(true);
+    }
     if (programId == 0) {
         length = 0;
         return NULL;
@@ -756,6 +836,9 @@ void Program::swap(ptr<Program> p)
         CURRENT = NULL;
     }
 
+    isReady(true);
+    p->isReady(true);
+
     updateTextureUsers(false);
     p->updateTextureUsers(false);
 
@@ -771,6 +854,9 @@ void Program::swap(ptr<Program> p)
     std::swap(uniforms, p->uniforms);
     std::swap(uniformBlocks, p->uniformBlocks);
     std::swap(uniformSubroutines, p->uniformSubroutines);
+    std::swap(bindless, p->bindless);
+    uniformsVersion = nextUniformsVersion();
+    p->uniformsVersion = nextUniformsVersion();
 
     map<string, ptr<Uniform> >::iterator i = p->uniforms.begin();
     while (i != p->uniforms.end()) {
@@ -882,8 +968,12 @@ bool Program::checkSamplers()
 
 void Program::set()
 {
+    if (pending) {
+        isReady(true);
+    }
     if (CURRENT != this) {
         CURRENT = this;
+        Statistics::add(Statistics::PROGRAM_SWITCHES);
         if (pipelineId == 0) {
             glUseProgram(programId);
         } else {
@@ -914,9 +1004,13 @@ void Program::set()
 
 void Program::bindTexturesAndUniformBlocks()
 {
+    // samplers in uniform blocks only update the handles of the textures
+    // that have been swapped, the others are bound to texture units
+    Texture::beginBindings();
     for (unsigned int i = 0; i < uniformSamplers.size(); ++i) {
         uniformSamplers[i]->setValue();
     }
+    Texture::endBindings();
 
     map<string, ptr<UniformBlock> >::iterator j = uniformBlocks.begin();
     while (j != uniformBlocks.end()) {
@@ -924,6 +1018,15 @@ void Program::bindTexturesAndUniformBlocks()
         GLint unit = u->buffer->bindToUniformBufferUnit(Program::CURRENT->programIds);
         assert(unit >= 0);
         glUniformBlockBinding(programId, u->index, GLuint(unit));
+        if (u->getStreamBuffer() != NULL) {
+            // the above binding replaced the stream buffer range of this unit
+            if (u->isMapped()) {
+                // copies the modified values into a new range and binds it
+                u->unmapBuffer();
+            } else {
+                u->bindStreamBuffer();
+            }
+        }
         j++;
     }
 
@@ -949,6 +1052,7 @@ void Program::updateDirtyUniforms(int stages)
             if (CURRENT->pipelineId > 0) {
                 glActiveShaderProgram(CURRENT->pipelineId, programId);
             }
+            Statistics::add(Statistics::UNIFORM_UPLOADS);
             u->setValue();
             u->dirty = false;
         }
@@ -1071,7 +1175,8 @@ public:
     {
         e = e == NULL ? desc->descriptor : e;
         vector< ptr<Module> > modules;
-        checkParameters(desc, e, "name,");
+        checkParameters(desc, e, "name,bindless,");
+        const char *bindless = e->Attribute("bindless");
 
         if (desc->getData() != NULL) {
             try {
@@ -1080,6 +1185,9 @@ public:
             } catch (...) {
                 desc->clearData();
             }
+            if (bindless != NULL && strcmp(bindless, "true") == 0) {
+                setBindless(true);
+            }
             return;
         }
 
@@ -1117,6 +1225,10 @@ public:
             n = n->NextSibling();
         }
         init(modules, false);
+
+        if (bindless != NULL && strcmp(bindless, "true") == 0) {
+            setBindless(true);
+        }
     }
 
     virtual bool prepareUpdate()
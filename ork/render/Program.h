@@ -121,13 +121,26 @@ public:
     ptr<Module> getModule(int index) const;
 
     /**
-     * Returns the uniforms of this program.
+     * Returns the uniforms of this program. Returns an empty vector if this
+     * program is still pending (see #isPending).
      */
     std::vector< ptr<Uniform> > getUniforms() const;
 
+    /**
+     * Returns the version of the uniforms of this program. This number
+     * changes each time the uniforms of this program are initialized or
+     * updated with #swap, which can add or remove uniforms. It is never
+     * shared by two programs, so that a program address and this version
+     * can be used as a cache key, without keeping this program alive.
+     */
+    unsigned int getUniformsVersion() const;
+
     /**
      * Returns the uniform of this program whose name is given.
      *
+     * If this program is still pending (see #isPending), this method waits
+     * until it is linked.
+     *
      * @param name a GLSL uniform name.
      * @return the uniform of this program whose name is given,
      *       or NULL if there is no such uniform.
@@ -504,6 +517,57 @@ public:
      */
     ptr<UniformBlock> getUniformBlock(const std::string &name);
 
+    /**
+     * Returns true if this program uses bindless textures.
+     */
+    bool isBindless() const;
+
+    /**
+     * Sets the way the textures of the uniform samplers of this program are
+     * accessed. By default each texture is bound to a texture unit when the
+     * program is used, which may evict textures bound for other programs.
+     * With bindless textures (ARB_bindless_texture), the samplers declared
+     * in a uniform block store the resident handle of their texture (see
+     * Texture#getHandle) in the block buffer, and these textures never need
+     * to be bound. Such a block typically contains an array of samplers,
+     * indexed in the shader by a per draw index (an uniform, an instance
+     * attribute or gl_DrawID), so that draws using different textures do
+     * not need to change any texture binding. The samplers declared outside
+     * uniform blocks still use texture units. The GL_ARB_bindless_texture
+     * macro can be used to declare the same sampler array outside any block
+     * when the extension is not available, in which case all its textures
+     * are bound to texture units.
+     *
+     * @param bindless true to use bindless textures if they are supported
+     *      (see Texture#isBindlessSupported). Otherwise this program keeps
+     *      using texture units.
+     */
+    void setBindless(bool bindless);
+
+    /**
+     * Returns true if this program is compiled and linked, without errors.
+     * A program created in asynchronous mode (see
+     * Module#setAsynchronousCompilation) is pending until this method finds
+     * that its link is finished. Its link status and its uniforms are then
+     * read, and its uniforms version is incremented. The draw methods of
+     * FrameBuffer skip the draws that use a program that is not ready. This
+     * method must be called in the OpenGL thread.
+     *
+     * @param wait true to wait until the link is finished. Otherwise this
+     *      method returns immediately, if the KHR_parallel_shader_compile
+     *      extension is available (without it this method always waits).
+     */
+    bool isReady(bool wait = false);
+
+    /**
+     * Returns true if this program has been created in asynchronous mode,
+     * and if #isReady has not yet found that its link is finished. Unlike
+     * #isReady, this method does not make any OpenGL call, and can be called
+     * from any thread. When it returns false, the uniforms of this program
+     * are fully initialized.
+     */
+    bool isPending() const;
+
     /**
      * Returns a compiled version of this program.
      *
@@ -601,6 +665,16 @@ private:
      */
     std::map<std::string, ptr<Uniform> > oldUniforms;
 
+    /**
+     * The version of #uniforms (see #getUniformsVersion).
+     */
+    unsigned int uniformsVersion;
+
+    /**
+     * Returns a new version number for #uniformsVersion.
+     */
+    static unsigned int nextUniformsVersion();
+
     /**
      * The uniform samplers of this program.
      */
@@ -622,6 +696,19 @@ private:
      */
     std::map<std::string, ptr<UniformBlock> > uniformBlocks;
 
+    /**
+     * True if this program uses bindless textures (see #setBindless).
+     */
+    bool bindless;
+
+    /**
+     * 1 if this program is linked asynchronously, and if its link status
+     * and uniforms have not been read yet (see #isReady), 0 otherwise. This
+     * flag is reset with an atomic operation after the uniforms have been
+     * read, so that other threads can test it with #isPending.
+     */
+    volatile long pending;
+
     /**
      * The program currently in use.
      */
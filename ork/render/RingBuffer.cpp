@@ -0,0 +1,156 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#include "ork/render/RingBuffer.h"
+
+#include <cstring>
+
+#include <GL/glew.h>
+
+#include "ork/render/FrameBuffer.h"
+
+using namespace std;
+
+namespace ork
+{
+
+RingBuffer::RingBuffer(int frameSize, int frames) :
+    Object("RingBuffer"), frameSize(frameSize), current(0), head(0), frame(0), stalls(0), fences(frames, (void*) NULL)
+{
+    assert(frames > 0);
+    buffer = new GPUBuffer();
+    data = (volatile unsigned char*) buffer->mapPersistent(frameSize * frames);
+    persistent = data != NULL;
+    if (!persistent) {
+        data = new unsigned char[frameSize * frames];
+    }
+}
+
+RingBuffer::~RingBuffer()
+{
+    if (!persistent) {
+        delete[] data;
+    }
+    for (unsigned int i = 0; i < fences.size(); ++i) {
+        if (fences[i] != NULL) {
+            glDeleteSync((GLsync) fences[i]);
+        }
+    }
+}
+
+ptr<GPUBuffer> RingBuffer::getBuffer() const
+{
+    return buffer;
+}
+
+int RingBuffer::getFrameSize() const
+{
+    return frameSize;
+}
+
+unsigned int RingBuffer::getFrame() const
+{
+    return frame;
+}
+
+int RingBuffer::getStallCount() const
+{
+    return stalls;
+}
+
+int RingBuffer::allocate(int size, int alignment)
+{
+    int start = current * frameSize;
+    int offset = ((start + head + alignment - 1) / alignment) * alignment;
+    if (offset + size > start + frameSize) {
+        return -1;
+    }
+    head = offset + size - start;
+    return offset;
+}
+
+volatile void *RingBuffer::getData(int offset) const
+{
+    return data + offset;
+}
+
+int RingBuffer::write(const void *data, int size, int alignment)
+{
+    int offset = allocate(size, alignment);
+    if (offset >= 0) {
+        memcpy((void*) (this->data + offset), data, size);
+        flush(offset, size);
+    }
+    return offset;
+}
+
+void RingBuffer::flush(int offset, int size)
+{
+    if (!persistent) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer->getId());
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, (void*) (data + offset));
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        assert(FrameBuffer::getError() == GL_NO_ERROR);
+    }
+}
+
+void RingBuffer::nextFrame()
+{
+    fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    current = (current + 1) % fences.size();
+    head = 0;
+    frame += 1;
+    GLsync fence = (GLsync) fences[current];
+    if (fence != NULL) {
+        GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            stalls += 1;
+            while (status == GL_TIMEOUT_EXPIRED) {
+                status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            }
+        }
+        glDeleteSync(fence);
+        fences[current] = NULL;
+    }
+    assert(FrameBuffer::getError() == GL_NO_ERROR);
+}
+
+}
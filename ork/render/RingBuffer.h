@@ -0,0 +1,207 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#ifndef _ORK_RING_BUFFER_H_
+#define _ORK_RING_BUFFER_H_
+
+#include <vector>
+
+#include "ork/render/GPUBuffer.h"
+
+namespace ork
+{
+
+/**
+ * A GPUBuffer used as a ring of per frame regions, to stream data to the
+ * GPU without driver side allocations nor implicit synchronizations. The
+ * buffer storage is allocated once and persistently mapped (see
+ * GPUBuffer#mapPersistent). It is divided in several regions of the same
+ * size, by default three (triple buffering). The data of a frame is
+ * suballocated in one region, and a fence is inserted in the OpenGL command
+ * stream when the frame ends (see #nextFrame). The next frames use the next
+ * regions, and a region is reused only when the fence of its previous frame
+ * is signaled, i.e. when the GPU no longer reads its previous content.
+ *
+ * The data written in a region is therefore valid only during the frame
+ * in which it has been written. If persistent mappings are not supported
+ * (they require OpenGL 4.4 or ARB_buffer_storage), the data is written in a
+ * CPU copy of the buffer, and then copied into the buffer with
+ * glBufferSubData (see #flush).
+ *
+ * @ingroup render
+ */
+class ORK_API RingBuffer : public Object
+{
+public:
+    /**
+     * Creates a new RingBuffer.
+     *
+     * @param frameSize the size in bytes of the region used for each frame.
+     * @param frames the number of regions.
+     */
+    RingBuffer(int frameSize, int frames = 3);
+
+    /**
+     * Deletes this RingBuffer.
+     */
+    virtual ~RingBuffer();
+
+    /**
+     * Returns the GPUBuffer containing the regions of this ring buffer.
+     */
+    ptr<GPUBuffer> getBuffer() const;
+
+    /**
+     * Returns the size in bytes of the region used for each frame.
+     */
+    int getFrameSize() const;
+
+    /**
+     * Returns the number of calls to #nextFrame since this buffer was
+     * created.
+     */
+    unsigned int getFrame() const;
+
+    /**
+     * Returns the number of times #nextFrame had to wait for the GPU before
+     * reusing a region.
+     */
+    int getStallCount() const;
+
+    /**
+     * Allocates a part of the region of the current frame. Returns the
+     * offset of this part in #getBuffer, or -1 if there is not enough space
+     * left in this region.
+     *
+     * @param size the size of the part to allocate, in bytes.
+     * @param alignment the alignment of the part to allocate, in bytes. The
+     *      offset of this part is a multiple of this alignment.
+     */
+    int allocate(int size, int alignment);
+
+    /**
+     * Returns a pointer to the given offset in the mapped buffer. The data
+     * written at this pointer must then be flushed with #flush.
+     *
+     * @param offset an offset returned by #allocate.
+     */
+    volatile void *getData(int offset) const;
+
+    /**
+     * Makes the data written at the given offset with #getData visible to
+     * the GPU. Does nothing if the buffer is persistently mapped.
+     *
+     * @param offset an offset returned by #allocate.
+     * @param size the size of the written data, in bytes.
+     */
+    void flush(int offset, int size);
+
+    /**
+     * Allocates a part of the region of the current frame, and copies the
+     * given data into it. Returns the offset of this part in #getBuffer, or
+     * -1 if there is not enough space left in this region.
+     *
+     * @param data the data to be copied.
+     * @param size the size of the data to be copied, in bytes.
+     * @param alignment the alignment of the part to allocate, in bytes.
+     */
+    int write(const void *data, int size, int alignment);
+
+    /**
+     * Ends the current frame and starts a new one. This inserts a fence
+     * after the commands of the current frame, and waits until the fence of
+     * the region of the new frame is signaled, if necessary.
+     */
+    void nextFrame();
+
+private:
+    /**
+     * The GPUBuffer containing the regions of this ring buffer.
+     */
+    ptr<GPUBuffer> buffer;
+
+    /**
+     * The persistently mapped data of #buffer, or a CPU copy of its data if
+     * #persistent is false.
+     */
+    volatile unsigned char *data;
+
+    /**
+     * True if #buffer is persistently mapped (see GPUBuffer#mapPersistent).
+     */
+    bool persistent;
+
+    /**
+     * The size in bytes of each region.
+     */
+    int frameSize;
+
+    /**
+     * The region of the current frame.
+     */
+    int current;
+
+    /**
+     * The offset of the first free byte in the region of the current frame,
+     * relatively to the start of this region.
+     */
+    int head;
+
+    /**
+     * The number of calls to #nextFrame.
+     */
+    unsigned int frame;
+
+    /**
+     * The number of times #nextFrame had to wait for the GPU.
+     */
+    int stalls;
+
+    /**
+     * The fence inserted at the end of the last frame of each region, or
+     * NULL. The actual type of these objects is GLsync.
+     */
+    std::vector<void*> fences;
+};
+
+}
+
+#endif
@@ -43,9 +43,11 @@
 
 #include <algorithm>
 #include <exception>
+#include <set>
 
 #include <GL/glew.h>
 
+#include "ork/core/Statistics.h"
 #include "ork/resource/ResourceManager.h"
 #include "ork/render/FrameBuffer.h"
 
@@ -549,7 +551,8 @@ public:
      * @param unit the index of this texture unit.
      */
     TextureUnit(GLuint unit) :
-        unit(unit), lastBindingTime(0), currentSamplerBinding(NULL), currentTextureBinding(NULL)
+        unit(unit), lastBindingTime(0), currentSamplerBinding(NULL), currentTextureBinding(NULL),
+        pendingSampler(false), pendingTexture(false)
     {
     }
 
@@ -560,19 +563,35 @@ public:
      * @param sampler the Sampler to bind to this unit.
      * @param tex the Texture to bind to this unit.
      * @param time the current time.
+     * @param deferred true to only update the bindings of this unit, and to
+     *      leave the OpenGL calls to TextureUnitManager#endBindings.
+     * @return the number of OpenGL calls needed to bind the sampler and
+     *      texture to this unit, or 0 if they were already bound to it.
      */
-    void bind(const Sampler* sampler, const Texture* tex, unsigned int time)
+    int bind(const Sampler* sampler, const Texture* tex, unsigned int time, bool deferred)
     {
         lastBindingTime = time; // always update time, or LRU won't work
 
+        if (sampler == currentSamplerBinding && tex == currentTextureBinding) {
+            return 0;
+        }
+
         GLuint currentSamplerId = currentSamplerBinding == NULL ? 0 : currentSamplerBinding->getId();
         GLuint samplerId = sampler == NULL ? 0 : sampler->getId();
+        int calls = 1;
 
-        glActiveTexture(GL_TEXTURE0 + unit);
+        if (!deferred) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+        }
 
         if (sampler != currentSamplerBinding) {
-            glBindSampler(unit, samplerId);
+            if (deferred) {
+                pendingSampler = true;
+            } else {
+                glBindSampler(unit, samplerId);
+            }
             currentSamplerBinding = sampler;
+            calls += 1;
         }
 
         if (tex != currentTextureBinding) {
@@ -581,17 +600,27 @@ public:
                 assert(i != currentTextureBinding->currentTextureUnits.end());
                 currentTextureBinding->currentTextureUnits.erase(i);
                 if (tex == NULL || currentTextureBinding->textureTarget != tex->textureTarget) {
-                    glBindTexture(currentTextureBinding->textureTarget, 0);
+                    if (!deferred) {
+                        glBindTexture(currentTextureBinding->textureTarget, 0);
+                    }
+                    calls += 1;
                 }
             }
             if (tex != NULL) {
                 tex->currentTextureUnits.insert(make_pair(samplerId, unit));
-                glBindTexture(tex->textureTarget, tex->textureId);
+                if (!deferred) {
+                    glBindTexture(tex->textureTarget, tex->textureId);
+                }
+                calls += 1;
+            }
+            if (deferred) {
+                pendingTexture = true;
             }
             currentTextureBinding = tex;
         }
 
         assert(FrameBuffer::getError() == 0);
+        return calls;
     }
 
     unsigned int getLastBindingTime() const
@@ -636,10 +665,26 @@ private:
      * The texture currently bound to this texture unit.
      */
     const Texture* currentTextureBinding;
+
+    /**
+     * True if #currentSamplerBinding has not been bound yet with OpenGL.
+     */
+    bool pendingSampler;
+
+    /**
+     * True if #currentTextureBinding has not been bound yet with OpenGL.
+     */
+    bool pendingTexture;
+
+    friend class TextureUnitManager;
 };
 
 /**
- * Manages texture units.
+ * Manages texture units. The free units are kept in a stack, and the units
+ * in use in a list sorted by binding time, so that finding a unit to bind a
+ * new texture does not need to examine all the units. If the multi-bind
+ * OpenGL functions are available, the bindings done between #beginBindings
+ * and #endBindings are grouped in glBindTextures and glBindSamplers calls.
  */
 class TextureUnitManager
 {
@@ -653,8 +698,19 @@ public:
         for (GLuint i = 0; i < maxUnits; ++i) {
             units[i] = new TextureUnit(i);
         }
+        // the free units, with unit 0 at the top of the stack
+        freeCount = 0;
+        for (GLuint i = maxUnits; i > 0; --i) {
+            pushFree(i - 1);
+        }
+        // the units in use, from the least to the most recently bound
+        first = -1;
+        last = -1;
 
         time = 0;
+        multiBind = GLEW_ARB_multi_bind != 0;
+        deferred = false;
+        deferredCalls = 0;
     }
 
     /**
@@ -668,34 +724,24 @@ public:
     int findFreeTextureUnit(const vector<GLuint> &programIds)
     {
         // we first try to find an unused texture unit
-        for (GLuint i = 0; i < maxUnits; ++i) {
-            if (units[i]->isFree()) {
-                return i;
-            }
+        if (freeCount > 0) {
+            return freeUnits[freeCount - 1];
         }
 
         // if all the texture units are used we must unbind a texture to free
         // a texture unit; we choose the least recently used unit that is not
-        // used by the current program
-
-        int bestUnit = -1;
-        unsigned int oldestBindingTime = time;
-
-        for (GLuint i = 0; i < maxUnits; ++i) {
+        // used by the current program (only the units used by this program,
+        // which were bound recently, may be skipped)
+        for (int i = first; i != -1; i = next[i]) {
             const Texture *t = units[i]->getCurrentTextureBinding();
             if (!t->isUsedBy(programIds)) {
-                unsigned int bindingTime = units[i]->getLastBindingTime();
-                if (bestUnit == -1 || bindingTime < oldestBindingTime) {
-                    bestUnit = i;
-                    oldestBindingTime = bindingTime;
-                }
+                return i;
             }
         }
 
         // if you fail here, there is no more texture unit available
-        assert(bestUnit != -1);
-
-        return bestUnit;
+        assert(false);
+        return -1;
     }
 
     /**
@@ -703,14 +749,38 @@ public:
      */
     void bind(unsigned int i, const Sampler* sampler, const Texture* tex)
     {
-        units[i]->bind(sampler, tex, time++);
+        if (units[i]->isFree()) {
+            if (tex != NULL) {
+                removeFree(i);
+                append(i);
+            }
+        } else if (tex == NULL) {
+            remove(i);
+            pushFree(i);
+        } else {
+            remove(i);
+            append(i);
+        }
+
+        int calls = units[i]->bind(sampler, tex, time++, deferred);
+        if (calls != 0 && tex != NULL) {
+            Statistics::add(Statistics::TEXTURE_BINDS);
+        }
+        if (calls == 0) {
+            // a glActiveTexture call was needed before
+            Statistics::add(Statistics::AVOIDED_TEXTURE_CALLS);
+        } else if (deferred) {
+            deferredCalls += calls;
+        } else {
+            Statistics::add(Statistics::TEXTURE_CALLS, calls);
+        }
     }
 
     void unbind(const Texture *tex)
     {
         for (GLuint i = 0; i < maxUnits; ++i) {
             if (units[i]->getCurrentTextureBinding() == tex) {
-                units[i]->bind(NULL, NULL, time++);
+                bind(i, NULL, NULL);
             }
         }
     }
@@ -719,7 +789,7 @@ public:
     {
         for (GLuint i = 0; i < maxUnits; ++i) {
             if (units[i]->getCurrentSamplerBinding() == sampler) {
-                units[i]->bind(NULL, NULL, time++);
+                bind(i, NULL, NULL);
             }
         }
     }
@@ -727,11 +797,70 @@ public:
     void unbindAll()
     {
         for (GLuint i = 0; i < maxUnits; ++i) {
-            units[i]->bind(NULL, NULL, 0);
+            bind(i, NULL, NULL);
         }
         time = 0;
     }
 
+    /**
+     * Starts a group of bindings whose OpenGL calls can be deferred until
+     * #endBindings. Does nothing if multi-bind is not supported.
+     */
+    void beginBindings()
+    {
+        deferred = multiBind;
+    }
+
+    /**
+     * Ends a group of bindings started with #beginBindings, and binds the
+     * textures and samplers of each range of consecutive units that changed
+     * with a single glBindTextures and glBindSamplers call.
+     */
+    void endBindings()
+    {
+        if (!deferred) {
+            return;
+        }
+        deferred = false;
+        if (deferredCalls == 0) {
+            return;
+        }
+
+        GLuint ids[MAX_TEXTURE_UNITS];
+        int calls = 0;
+        for (GLuint i = 0; i < maxUnits; ++i) {
+            if (units[i]->pendingTexture) {
+                GLuint j = i;
+                while (j < maxUnits && units[j]->pendingTexture) {
+                    const Texture *t = units[j]->getCurrentTextureBinding();
+                    ids[j - i] = t == NULL ? 0 : t->textureId;
+                    units[j++]->pendingTexture = false;
+                }
+                glBindTextures(i, j - i, ids);
+                calls += 1;
+                i = j;
+            }
+        }
+        for (GLuint i = 0; i < maxUnits; ++i) {
+            if (units[i]->pendingSampler) {
+                GLuint j = i;
+                while (j < maxUnits && units[j]->pendingSampler) {
+                    const Sampler *s = units[j]->getCurrentSamplerBinding();
+                    ids[j - i] = s == NULL ? 0 : s->getId();
+                    units[j++]->pendingSampler = false;
+                }
+                glBindSamplers(i, j - i, ids);
+                calls += 1;
+                i = j;
+            }
+        }
+        assert(FrameBuffer::getError() == 0);
+
+        Statistics::add(Statistics::TEXTURE_CALLS, calls);
+        Statistics::add(Statistics::AVOIDED_TEXTURE_CALLS, deferredCalls - calls);
+        deferredCalls = 0;
+    }
+
     static unsigned int getMaxTextureUnits()
     {
         if (maxUnits == 0) {
@@ -763,17 +892,109 @@ private:
      */
     TextureUnit *units[MAX_TEXTURE_UNITS];
 
+    /**
+     * The stack of free texture units. freeCount elements.
+     */
+    int freeUnits[MAX_TEXTURE_UNITS];
+
+    /**
+     * The position of each free texture unit in #freeUnits.
+     */
+    int freeIndex[MAX_TEXTURE_UNITS];
+
+    /**
+     * The number of free texture units.
+     */
+    int freeCount;
+
+    /**
+     * The previous unit of each unit in use, in the list of units in use
+     * sorted by binding time, or -1.
+     */
+    int prev[MAX_TEXTURE_UNITS];
+
+    /**
+     * The next unit of each unit in use, in the list of units in use
+     * sorted by binding time, or -1.
+     */
+    int next[MAX_TEXTURE_UNITS];
+
+    /**
+     * The least recently bound unit in use, or -1.
+     */
+    int first;
+
+    /**
+     * The most recently bound unit in use, or -1.
+     */
+    int last;
+
     /**
      * The 'time' used to measure the texture binding times. This abstract time
      * is an integer that is incremented each time a texture is bound.
      */
     unsigned int time;
 
+    /**
+     * True if the glBindTextures and glBindSamplers functions are available.
+     */
+    bool multiBind;
+
+    /**
+     * True between #beginBindings and #endBindings if #multiBind is true.
+     */
+    bool deferred;
+
+    /**
+     * The number of OpenGL calls that the bindings deferred since
+     * #beginBindings would have needed without multi-bind.
+     */
+    int deferredCalls;
+
     /**
      * Maximum number of texture units on the current graphics card.
      */
     static GLuint maxUnits;
 
+    void pushFree(int i)
+    {
+        freeIndex[i] = freeCount;
+        freeUnits[freeCount++] = i;
+    }
+
+    void removeFree(int i)
+    {
+        int j = freeUnits[--freeCount];
+        freeUnits[freeIndex[i]] = j;
+        freeIndex[j] = freeIndex[i];
+    }
+
+    void append(int i)
+    {
+        prev[i] = last;
+        next[i] = -1;
+        if (last == -1) {
+            first = i;
+        } else {
+            next[last] = i;
+        }
+        last = i;
+    }
+
+    void remove(int i)
+    {
+        if (prev[i] == -1) {
+            first = next[i];
+        } else {
+            next[prev[i]] = next[i];
+        }
+        if (next[i] == -1) {
+            last = prev[i];
+        } else {
+            prev[next[i]] = prev[i];
+        }
+    }
+
     friend class Texture;
 };
 
@@ -781,6 +1002,11 @@ GLuint TextureUnitManager::maxUnits = 0;
 
 static TextureUnitManager *TEXTURE_UNIT_MANAGER = NULL;
 
+/**
+ * The textures that have bindless handles (see Texture#getHandle).
+ */
+static set<const Texture*> BINDLESS_TEXTURES;
+
 Texture::Parameters::Parameters() : Sampler::Parameters(),
         _minLevel(0), _maxLevel(1000)
 {
@@ -1058,6 +1284,7 @@ void Texture::init(TextureInternalFormat tf, const Texture::Parameters &params)
 Texture::~Texture()
 {
     TEXTURE_UNIT_MANAGER->unbind(this);
+    releaseHandles(-1);
 
     glDeleteTextures(1, &textureId);
     assert(FrameBuffer::getError() == 0);
@@ -1366,6 +1593,17 @@ void Texture::swap(ptr<Texture> t)
     }
     assert(textureTarget == t->textureTarget);
     std::swap(textureId, t->textureId);
+    std::swap(handles, t->handles);
+    if (handles.empty()) {
+        BINDLESS_TEXTURES.erase(this);
+    } else {
+        BINDLESS_TEXTURES.insert(this);
+    }
+    if (t->handles.empty()) {
+        BINDLESS_TEXTURES.erase(t.get());
+    } else {
+        BINDLESS_TEXTURES.insert(t.get());
+    }
     std::swap(internalFormat, t->internalFormat);
     std::swap(params, t->params);
 }
@@ -1396,6 +1634,52 @@ unsigned int Texture::getMaxTextureUnits()
 void Texture::unbindSampler(Sampler *sampler)
 {
     TEXTURE_UNIT_MANAGER->unbind(sampler);
+    // handles of textures with this sampler become invalid
+    vector<const Texture*> textures(BINDLESS_TEXTURES.begin(), BINDLESS_TEXTURES.end());
+    for (unsigned int i = 0; i < textures.size(); ++i) {
+        textures[i]->releaseHandles(sampler->getId());
+    }
+}
+
+GLuint64 Texture::getHandle(ptr<Sampler> s) const
+{
+    GLuint samplerId = s == NULL ? 0 : s->getId();
+    map<GLuint, GLuint64>::iterator i = handles.find(samplerId);
+    if (i != handles.end()) {
+        return i->second;
+    }
+    GLuint64 handle;
+    if (s == NULL) {
+        handle = glGetTextureHandleARB(textureId);
+    } else {
+        handle = glGetTextureSamplerHandleARB(textureId, samplerId);
+    }
+    glMakeTextureHandleResidentARB(handle);
+    assert(FrameBuffer::getError() == 0);
+    handles.insert(make_pair(samplerId, handle));
+    BINDLESS_TEXTURES.insert(this);
+    return handle;
+}
+
+void Texture::releaseHandles(GLint samplerId) const
+{
+    map<GLuint, GLuint64>::iterator i = handles.begin();
+    while (i != handles.end()) {
+        if (samplerId == -1 || i->first == GLuint(samplerId)) {
+            glMakeTextureHandleNonResidentARB(i->second);
+            handles.erase(i++);
+        } else {
+            ++i;
+        }
+    }
+    if (handles.empty()) {
+        BINDLESS_TEXTURES.erase(this);
+    }
+}
+
+bool Texture::isBindlessSupported()
+{
+    return GLEW_ARB_bindless_texture != 0;
 }
 
 void Texture::unbindAll()
@@ -1403,4 +1687,19 @@ void Texture::unbindAll()
     TEXTURE_UNIT_MANAGER->unbindAll();
 }
 
+void Texture::beginBindings()
+{
+    // the manager is created with the first texture
+    if (TEXTURE_UNIT_MANAGER != NULL) {
+        TEXTURE_UNIT_MANAGER->beginBindings();
+    }
+}
+
+void Texture::endBindings()
+{
+    if (TEXTURE_UNIT_MANAGER != NULL) {
+        TEXTURE_UNIT_MANAGER->endBindings();
+    }
+}
+
 }
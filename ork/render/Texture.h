@@ -252,6 +252,25 @@ public:
      */
     void generateMipMap();
 
+    /**
+     * Returns a resident bindless handle for this texture and the given
+     * sampler. The handle is created and made resident the first time this
+     * method is called with this sampler, and remains resident until this
+     * texture or the sampler is deleted. Must be used only if
+     * #isBindlessSupported. Note that the parameters and the images of a
+     * texture can no longer be changed once a handle has been created for it
+     * (except with the setSubImage methods).
+     *
+     * @param s a sampler object to sample this texture. May be NULL.
+     */
+    GLuint64 getHandle(ptr<Sampler> s) const;
+
+    /**
+     * Returns true if bindless textures (ARB_bindless_texture) are
+     * supported (see #getHandle).
+     */
+    static bool isBindlessSupported();
+
 protected:
     /**
      * Creates a new unitialized texture.
@@ -326,6 +345,20 @@ private:
      */
     mutable std::map<GLuint, GLuint> currentTextureUnits;
 
+    /**
+     * The resident bindless handles of this texture. There is one handle
+     * per sampler object (see #getHandle).
+     */
+    mutable std::map<GLuint, GLuint64> handles;
+
+    /**
+     * Makes non resident the handles of this texture, or only its handle
+     * for the given sampler.
+     *
+     * @param samplerId a sampler object id, or -1 to release all handles.
+     */
+    void releaseHandles(GLint samplerId) const;
+
     /**
      * Identifiers of the programs that use this texture.
      */
@@ -361,6 +394,17 @@ private:
      */
     static void unbindAll();
 
+    /**
+     * Starts a group of texture bindings whose OpenGL calls can be grouped
+     * until #endBindings is called.
+     */
+    static void beginBindings();
+
+    /**
+     * Ends a group of texture bindings started with #beginBindings.
+     */
+    static void endBindings();
+
     friend class Sampler;
 
     friend class Texture1D;
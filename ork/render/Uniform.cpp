@@ -41,8 +41,12 @@
 
 #include "ork/render/Uniform.h"
 
+#include <algorithm>
+
 #include <GL/glew.h>
 
+#include "ork/core/Logger.h"
+#include "ork/core/Statistics.h"
 #include "ork/render/FrameBuffer.h"
 
 using namespace std;
@@ -52,12 +56,12 @@ namespace ork
 
 #ifdef ORK_NO_GLPROGRAMUNIFORM
 Uniform::Uniform(const char *type, Program *program, UniformBlock *block, const string &name, GLint location) :
-    Object(type), program(program), block(block), name(name), location(location), dirty(false)
+    Object(type), program(program), block(block), name(name), location(location), valueVersion(0), dirty(false)
 {
 }
 #else
 Uniform::Uniform(const char *type, Program *program, UniformBlock *block, const string &name, GLint location) :
-    Object(type), program(program), block(block), name(name), location(location)
+    Object(type), program(program), block(block), name(name), location(location), valueVersion(0)
 {
 }
 #endif
@@ -71,6 +75,15 @@ string Uniform::getName() const
     return name;
 }
 
+void Uniform::setValueIfChanged(ptr<Value> v)
+{
+    unsigned int version = v->getVersion();
+    if (block != NULL || version != valueVersion) {
+        setValue(v);
+        valueVersion = version;
+    }
+}
+
 #ifdef ORK_NO_GLPROGRAMUNIFORM
 void Uniform::setValueIfCurrent()
 {
@@ -81,12 +94,19 @@ void Uniform::setValueIfCurrent()
         if (Program::CURRENT->pipelineId > 0) {
             glActiveShaderProgram(Program::CURRENT->pipelineId, program->programId);
         }
+        Statistics::add(Statistics::UNIFORM_UPLOADS);
         setValue();
         dirty = false;
     } else {
         dirty = true;
     }
 }
+#else
+void Uniform::uploadValue()
+{
+    Statistics::add(Statistics::UNIFORM_UPLOADS);
+    setValue();
+}
 #endif
 
 volatile void *Uniform::mapBuffer(GLint offset) const
@@ -94,6 +114,11 @@ volatile void *Uniform::mapBuffer(GLint offset) const
     return block->mapBuffer(offset);
 }
 
+void Uniform::updateBuffer(GLint offset, GLint size) const
+{
+    block->updateBuffer(offset, size);
+}
+
 // ----------------------------------------------------------------------------
 
 const char uniform1f[] = "Uniform1f";
@@ -546,7 +571,7 @@ ptr<Sampler> UniformSampler::getSampler() const
 void UniformSampler::setSampler(const ptr<Sampler> sampler)
 {
     this->sampler = sampler;
-    if (program != NULL && program->isCurrent()) {
+    if (program != NULL && (program->isCurrent() || block != NULL)) {
         setValue();
     }
 }
@@ -558,6 +583,7 @@ ptr<Texture> UniformSampler::get() const
 
 void UniformSampler::set(ptr<Texture> value)
 {
+    valueVersion = 0;
     if (program != NULL) {
         if (this->value != NULL) {
             this->value->removeUser(program->getId());
@@ -567,7 +593,7 @@ void UniformSampler::set(ptr<Texture> value)
         }
     }
     this->value = value;
-    if (program != NULL && program->isCurrent()) {
+    if (program != NULL && (program->isCurrent() || block != NULL)) {
         setValue();
     }
 }
@@ -581,6 +607,21 @@ void UniformSampler::setValue(ptr<Value> v)
 
 void UniformSampler::setValue()
 {
+    if (block != NULL) {
+        // samplers in uniform blocks require bindless textures: the texture
+        // handle is stored in the block buffer, like any other block data,
+        // and does not need to be set again when the program changes
+        if (program != NULL && program->isBindless()) {
+            GLuint64 h = value == NULL ? 0 : value->getHandle(sampler);
+            GLuint64 *buf = (GLuint64*) mapBuffer(location);
+            if (*buf != h) {
+                *buf = h;
+                updateBuffer(location, sizeof(GLuint64));
+            }
+        }
+        unit = -1;
+        return;
+    }
     if (value != NULL && location != -1 && Program::CURRENT != NULL) {
         GLint newUnit = value->bindToTextureUnit(sampler, Program::CURRENT->programIds);
         assert(newUnit >= 0);
@@ -641,6 +682,7 @@ string UniformSubroutine::getSubroutine()
 
 void UniformSubroutine::set(int subroutine)
 {
+    valueVersion = 0;
     value = subroutine;
     if (program != NULL) {
         program->uniformSubroutines[stage][location + 1] = compatibleSubroutineIndices[subroutine];
@@ -679,11 +721,68 @@ class UniformBlockBuffer : public GPUBuffer
 public:
     string name;
 
-    UniformBlockBuffer(const string name) : GPUBuffer(), name(name)
+    /**
+     * A CPU copy of the block values. Empty until first needed.
+     */
+    vector<unsigned char> data;
+
+    /**
+     * The start of the range of data modified since it was last copied to
+     * the GPU.
+     */
+    int dirtyStart;
+
+    /**
+     * The end of the range of data modified since it was last copied to
+     * the GPU (exclusive). The range is empty if dirtyEnd <= dirtyStart.
+     */
+    int dirtyEnd;
+
+    /**
+     * The ring buffer used to stream the block values, or NULL.
+     */
+    ptr<RingBuffer> stream;
+
+    /**
+     * The frame of stream when the block values were last copied into it.
+     */
+    unsigned int streamFrame;
+
+    /**
+     * The offset in stream where the block values were last copied.
+     */
+    int streamOffset;
+
+    UniformBlockBuffer(const string name) : GPUBuffer(), name(name), dirtyStart(0), dirtyEnd(0), streamFrame(0), streamOffset(0)
+    {
+    }
+
+    /**
+     * Returns the CPU copy of the block values, reading them from the GPU
+     * if needed.
+     */
+    unsigned char *getData()
     {
+        if (int(data.size()) != getSize()) {
+            data.resize(getSize());
+            getSubData(0, getSize(), &data[0]);
+            dirtyStart = 0;
+            dirtyEnd = 0;
+        }
+        return &data[0];
     }
 };
 
+static GLint getUniformBufferOffsetAlignment()
+{
+    static GLint alignment = 0;
+    if (alignment == 0) {
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        alignment = max(alignment, 1);
+    }
+    return alignment;
+}
+
 UniformBlock::UniformBlock(Program *program, const string &name, GLuint index, GLuint size) :
     Object("UniformBlock"), program(program), name(name), index(index), size(size), buffer(NULL)
 {
@@ -708,6 +807,38 @@ ptr<GPUBuffer> UniformBlock::getBuffer() const
     return buffer;
 }
 
+ptr<RingBuffer> UniformBlock::getStreamBuffer() const
+{
+    ptr<UniformBlockBuffer> b = buffer.cast<UniformBlockBuffer>();
+    return b == NULL ? NULL : b->stream;
+}
+
+void UniformBlock::setStreamBuffer(ptr<RingBuffer> stream)
+{
+    ptr<UniformBlockBuffer> b = buffer.cast<UniformBlockBuffer>();
+    if (b == NULL) {
+        // buffers set with #setBuffer cannot be streamed
+        return;
+    }
+    if (b->stream == stream) {
+        return;
+    }
+    if (b->stream == NULL) {
+        if (isMapped()) {
+            unmapBuffer();
+        }
+        b->getData();
+    } else if (stream == NULL) {
+        b->setSubData(0, b->getSize(), b->getData());
+        if (b->currentUniformUnit != -1) {
+            glBindBufferBase(GL_UNIFORM_BUFFER, b->currentUniformUnit, b->getId());
+        }
+    }
+    b->stream = stream;
+    b->dirtyStart = 0;
+    b->dirtyEnd = stream == NULL ? 0 : b->getSize();
+}
+
 ptr<Uniform> UniformBlock::getUniform(const string &name) const
 {
     map<string, ptr<Uniform> >::const_iterator i = uniforms.find(name);
@@ -743,23 +874,96 @@ void UniformBlock::setBuffer(ptr<GPUBuffer> buffer)
 bool UniformBlock::isMapped() const
 {
     assert(buffer != NULL);
-    return buffer->getMappedData() != NULL;
+    UniformBlockBuffer *b = dynamic_cast<UniformBlockBuffer*>(buffer.get());
+    if (b == NULL) {
+        // a buffer set with #setBuffer: it is really mapped
+        return buffer->getMappedData() != NULL;
+    }
+    if (b->stream != NULL && b->streamFrame != b->stream->getFrame()) {
+        return true;
+    }
+    return b->dirtyEnd > b->dirtyStart;
 }
 
 volatile void *UniformBlock::mapBuffer(GLint offset)
 {
     assert(buffer != NULL);
-    volatile void *result = buffer->getMappedData();
-    if (result == NULL) {
-        result = buffer->map(READ_WRITE);
+    UniformBlockBuffer *b = dynamic_cast<UniformBlockBuffer*>(buffer.get());
+    if (b == NULL) {
+        volatile void *result = buffer->getMappedData();
+        if (result == NULL) {
+            result = buffer->map(READ_WRITE);
+        }
+        return (void*) (((unsigned char*) result) + offset);
+    }
+    return b->getData() + offset;
+}
+
+void UniformBlock::updateBuffer(GLint offset, GLint size)
+{
+    assert(buffer != NULL);
+    UniformBlockBuffer *b = dynamic_cast<UniformBlockBuffer*>(buffer.get());
+    if (b == NULL) {
+        // the values are written directly in the mapped buffer
+        return;
+    }
+    int end = min(int(offset + size), b->getSize());
+    if (b->dirtyEnd <= b->dirtyStart) {
+        b->dirtyStart = offset;
+        b->dirtyEnd = end;
+    } else {
+        b->dirtyStart = min(b->dirtyStart, int(offset));
+        b->dirtyEnd = max(b->dirtyEnd, end);
     }
-    return (void*) (((unsigned char*) result) + offset);
 }
 
 void UniformBlock::unmapBuffer()
 {
-    assert(buffer != NULL && buffer->getMappedData() != NULL);
-    buffer->unmap();
+    assert(buffer != NULL);
+    UniformBlockBuffer *b = dynamic_cast<UniformBlockBuffer*>(buffer.get());
+    if (b == NULL) {
+        assert(buffer->getMappedData() != NULL);
+        buffer->unmap();
+        return;
+    }
+    if (b->stream != NULL) {
+        // the range can only be bound once the buffer has a uniform unit,
+        // i.e. after Program#bindTexturesAndUniformBlocks
+        GLint unit = b->currentUniformUnit;
+        if (unit == -1) {
+            return;
+        }
+        int offset = b->stream->write(b->getData(), b->getSize(), getUniformBufferOffsetAlignment());
+        if (offset < 0) {
+            if (Logger::WARNING_LOGGER != NULL) {
+                Logger::WARNING_LOGGER->log("RENDER", "Ring buffer full, uniform block " + name + " uses its own buffer");
+            }
+            setStreamBuffer(NULL);
+            return;
+        }
+        Statistics::add(Statistics::UNIFORM_UPLOADS);
+        Statistics::add(Statistics::BUFFER_BYTES, b->getSize());
+        b->streamFrame = b->stream->getFrame();
+        b->streamOffset = offset;
+        b->dirtyStart = 0;
+        b->dirtyEnd = 0;
+        bindStreamBuffer();
+        return;
+    }
+    if (b->dirtyEnd > b->dirtyStart) {
+        Statistics::add(Statistics::UNIFORM_UPLOADS);
+        b->setSubData(b->dirtyStart, b->dirtyEnd - b->dirtyStart, b->getData() + b->dirtyStart);
+        b->dirtyStart = 0;
+        b->dirtyEnd = 0;
+    }
+}
+
+void UniformBlock::bindStreamBuffer()
+{
+    UniformBlockBuffer *b = dynamic_cast<UniformBlockBuffer*>(buffer.get());
+    assert(b != NULL && b->stream != NULL && b->currentUniformUnit != -1);
+    glBindBufferRange(GL_UNIFORM_BUFFER, b->currentUniformUnit, b->stream->getBuffer()->getId(), b->streamOffset, b->getSize());
+    assert(FrameBuffer::getError() == GL_NO_ERROR);
 }
 
 }
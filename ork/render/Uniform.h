@@ -52,6 +52,7 @@
 #include "ork/math/mat3.h"
 #include "ork/math/mat4.h"
 #include "ork/render/GPUBuffer.h"
+#include "ork/render/RingBuffer.h"
 #include "ork/render/Texture.h"
 #include "ork/render/Value.h"
 
@@ -65,7 +66,7 @@ class UniformBlock;
 #ifdef ORK_NO_GLPROGRAMUNIFORM
 #define SETVALUE setValueIfCurrent
 #else
-#define SETVALUE setValue
+#define SETVALUE uploadValue
 #endif
 
 /**
@@ -103,6 +104,17 @@ public:
      */
     virtual void setValue(ptr<Value> v) = 0;
 
+    /**
+     * Sets the value of this uniform, unless it was already set with this
+     * method from the given value, and if this value did not change since
+     * then (see Value#getVersion). Uniforms inside a UniformBlock are always
+     * set, since their buffer can be shared between programs.
+     *
+     * @param v the new value for this uniform. Must be of the same
+     *      type as this Uniform.
+     */
+    void setValueIfChanged(ptr<Value> v);
+
 protected:
     /**
      * The Program to which this uniform belongs.
@@ -125,6 +137,12 @@ protected:
      */
     GLint location;
 
+    /**
+     * The version of the Value from which this uniform was last set with
+     * #setValueIfChanged, or 0 if it has been set by other means since.
+     */
+    unsigned int valueVersion;
+
 #ifdef ORK_NO_GLPROGRAMUNIFORM
     /**
      * True if the value of this uniform in its program is not up to date.
@@ -149,6 +167,12 @@ protected:
      * Sets this uniform in its program if this it is the current one.
      */
     void setValueIfCurrent();
+#else
+    /**
+     * Sets this uniform in its program, and counts this upload in the
+     * Statistics#UNIFORM_UPLOADS counter.
+     */
+    void uploadValue();
 #endif
 
     /**
@@ -157,10 +181,18 @@ protected:
     virtual void setValue() = 0;
 
     /**
-     * Maps the GPUBuffer of the uniform block of this uniform into memory.
+     * Returns the address, in the CPU copy of the values of the uniform block
+     * of this uniform, of the value at the given offset (see
+     * UniformBlock#mapBuffer).
      */
     volatile void *mapBuffer(GLint offset) const;
 
+    /**
+     * Marks the given range of the values of the uniform block of this
+     * uniform as modified (see UniformBlock#updateBuffer).
+     */
+    void updateBuffer(GLint offset, GLint size) const;
+
     friend class Module;
 
     friend class ModuleResource;
@@ -210,6 +242,7 @@ public:
      */
     void set(T value)
     {
+        valueVersion = 0;
         if (block == NULL || program  == NULL) {
             this->value = value;
             if (program != NULL) {
@@ -217,7 +250,10 @@ public:
             }
         } else {
             R* buf = (R*) mapBuffer(location);
-            *buf = value;
+            if (*buf != R(value)) {
+                *buf = value;
+                updateBuffer(location, sizeof(R));
+            }
         }
     }
 
@@ -338,6 +374,7 @@ public:
      */
     void set(const vec2<T> &value)
     {
+        valueVersion = 0;
         if (block == NULL || program  == NULL) {
             this->value = value;
             if (program != NULL) {
@@ -345,8 +382,11 @@ public:
             }
         } else {
             R* buf = (R*) mapBuffer(location);
-            buf[0] = value.x;
-            buf[1] = value.y;
+            if (buf[0] != R(value.x) || buf[1] != R(value.y)) {
+                buf[0] = value.x;
+                buf[1] = value.y;
+                updateBuffer(location, 2 * sizeof(R));
+            }
         }
     }
 
@@ -467,6 +507,7 @@ public:
      */
     void set(const vec3<T> &value)
     {
+        valueVersion = 0;
         if (block == NULL || program  == NULL) {
             this->value = value;
             if (program != NULL) {
@@ -474,9 +515,12 @@ public:
             }
         } else {
             R* buf = (R*) mapBuffer(location);
-            buf[0] = value.x;
-            buf[1] = value.y;
-            buf[2] = value.z;
+            if (buf[0] != R(value.x) || buf[1] != R(value.y) || buf[2] != R(value.z)) {
+                buf[0] = value.x;
+                buf[1] = value.y;
+                buf[2] = value.z;
+                updateBuffer(location, 3 * sizeof(R));
+            }
         }
     }
 
@@ -597,6 +641,7 @@ public:
      */
     void set(const vec4<T> &value)
     {
+        valueVersion = 0;
         if (block == NULL || program  == NULL) {
             this->value = value;
             if (program != NULL) {
@@ -604,10 +649,13 @@ public:
             }
         } else {
             R* buf = (R*) mapBuffer(location);
-            buf[0] = value.x;
-            buf[1] = value.y;
-            buf[2] = value.z;
-            buf[3] = value.w;
+            if (buf[0] != R(value.x) || buf[1] != R(value.y) || buf[2] != R(value.z) || buf[3] != R(value.w)) {
+                buf[0] = value.x;
+                buf[1] = value.y;
+                buf[2] = value.z;
+                buf[3] = value.w;
+                updateBuffer(location, 4 * sizeof(R));
+            }
         }
     }
 
@@ -743,6 +791,7 @@ public:
      */
     void set(const T *value)
     {
+        valueVersion = 0;
         if (block == NULL || program  == NULL) {
             for (int i = 0; i < R * C; ++i) {
                 this->value[i] = value[i];
@@ -752,19 +801,27 @@ public:
             }
         } else {
             unsigned char *buf = (unsigned char*) mapBuffer(location);
+            bool changed = false;
             if (isRowMajor) {
                 for (int r = 0; r < R; ++r) {
                     for (int c = 0; c < C; ++c) {
-                        ((T*) (buf + r * stride))[c] = value[r * C + c];
+                        T &dst = ((T*) (buf + r * stride))[c];
+                        changed |= dst != value[r * C + c];
+                        dst = value[r * C + c];
                     }
                 }
             } else {
                 for (int r = 0; r < R; ++r) {
                     for (int c = 0; c < C; ++c) {
-                        ((T*) (buf + c * stride))[r] = value[r * C + c];
+                        T &dst = ((T*) (buf + c * stride))[r];
+                        changed |= dst != value[r * C + c];
+                        dst = value[r * C + c];
                     }
                 }
             }
+            if (changed) {
+                updateBuffer(location, (isRowMajor ? R : C) * stride);
+            }
         }
     }
 
@@ -1293,6 +1350,28 @@ public:
      */
     ptr<GPUBuffer> getBuffer() const;
 
+    /**
+     * Returns the RingBuffer used to stream the values of the uniforms of
+     * this block, or NULL.
+     */
+    ptr<RingBuffer> getStreamBuffer() const;
+
+    /**
+     * Sets the RingBuffer used to stream the values of the uniforms of this
+     * block. The values are then stored in client memory and, when they have
+     * changed since the last draw, they are copied into a new region of this
+     * ring buffer, which is bound to the uniform buffer unit of this block
+     * with glBindBufferRange. Hence consecutive draws with different values
+     * need a single GL call per draw, instead of a buffer update that must
+     * wait for the previous draws. This applies to all the uniform blocks
+     * that share the GPUBuffer of this block (see #getBuffer). This has no
+     * effect if this buffer was set with #setBuffer.
+     *
+     * @param stream a ring buffer, or NULL to store the uniform values in the
+     *      GPUBuffer of this block.
+     */
+    void setStreamBuffer(ptr<RingBuffer> stream);
+
     /**
      * Returns the uniform of this block whose name is given.
      *
@@ -1716,26 +1795,48 @@ protected:
     UniformBlock(Program *program, const std::string &name, GLuint index, GLuint size);
 
     /**
-     * Returns true if the GPUBuffer associated with this block is currently
-     * mapped in client memory.
+     * Returns true if the values of this block have been modified since
+     * they were last copied to the GPU, i.e. if #unmapBuffer must be called.
      */
     bool isMapped() const;
 
     /**
-     * Maps the GPUBuffer associated with this block in client memory. This
-     * method also returns the address in client memory of the value at the
-     * given offset in the buffer.
+     * Returns the address of the value at the given offset in the CPU copy
+     * of the GPUBuffer associated with this block. This copy is shared by
+     * all the blocks using this buffer. It is read from the GPU only once,
+     * and no OpenGL buffer is actually mapped. The modified values must be
+     * signaled with #updateBuffer. A buffer set with #setBuffer is mapped
+     * instead, and directly modified.
      *
      * @param offset an offset in bytes from the start of the buffer.
-     * @return a pointer to the value at 'offset' in the mapped buffer.
+     * @return a pointer to the value at 'offset' in the CPU copy.
      */
     volatile void *mapBuffer(GLint offset);
 
     /**
-     * Unmaps the GPUBuffer associated with this block in client memory.
+     * Marks the given range of the CPU copy of the buffer of this block as
+     * modified. The modified ranges are merged into a single range, copied
+     * to the GPU by the next call to #unmapBuffer.
+     *
+     * @param offset an offset in bytes from the start of the buffer.
+     * @param size the size in bytes of the modified range.
+     */
+    void updateBuffer(GLint offset, GLint size);
+
+    /**
+     * Copies the modified values of this block to the GPU, with a single
+     * glBufferSubData call for the modified range, or into a new region of
+     * the stream buffer of this block if it has one.
      */
     void unmapBuffer();
 
+    /**
+     * Binds the region of the stream buffer of this block that contains its
+     * current values, written by the last call to #unmapBuffer, to the
+     * uniform buffer unit of this block. Does not copy any value.
+     */
+    void bindStreamBuffer();
+
     friend class Uniform;
 
     friend class Module;
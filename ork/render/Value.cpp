@@ -47,7 +47,7 @@ namespace ork
 {
 
 Value::Value(const char *type, const string &name) :
-    Object(type), name(name)
+    Object(type), name(name), version(nextVersion())
 {
 }
 
@@ -60,6 +60,17 @@ string Value::getName() const
     return name;
 }
 
+unsigned int Value::getVersion() const
+{
+    return version;
+}
+
+unsigned int Value::nextVersion()
+{
+    static long VERSION = 0;
+    return (unsigned int) atomic_exchange_and_add(&VERSION, 1) + 1;
+}
+
 const char value1f[] = "Value1f";
 
 const char value1d[] = "Value1d";
@@ -163,6 +174,7 @@ ptr<Texture> ValueSampler::get() const
 void ValueSampler::set(const ptr<Texture> value)
 {
     this->value = value;
+    version = nextVersion();
 }
 
 ValueSubroutine::ValueSubroutine(Stage stage, const string &name) :
@@ -197,6 +209,7 @@ string ValueSubroutine::get() const
 void ValueSubroutine::set(const string &value)
 {
     this->value = value;
+    version = nextVersion();
 }
 
 }
@@ -77,16 +77,34 @@ public:
      */
     std::string getName() const;
 
+    /**
+     * Returns the version of this value. This number changes each time this
+     * value is modified, and is never shared by two different values. It is
+     * never 0.
+     */
+    unsigned int getVersion() const;
+
 protected:
     /**
      * The name of this value.
      */
     std::string name;
 
+    /**
+     * The version of this value (see #getVersion).
+     */
+    unsigned int version;
+
     /**
      * Creates an uninitialized value.
      */
     Value(const char *type, const std::string &name);
+
+    /**
+     * Returns a new version number, to be used after a modification of a
+     * value.
+     */
+    static unsigned int nextVersion();
 };
 
 // ----------------------------------------------------------------------------
@@ -141,6 +159,7 @@ public:
     void set(T value)
     {
         this->value = value;
+        this->version = Value::nextVersion();
     }
 
 private:
@@ -242,6 +261,7 @@ public:
     void set(const vec2<T> &value)
     {
         this->value = value;
+        this->version = Value::nextVersion();
     }
 
 private:
@@ -343,6 +363,7 @@ public:
     void set(const vec3<T> &value)
     {
         this->value = value;
+        this->version = Value::nextVersion();
     }
 
 private:
@@ -444,6 +465,7 @@ public:
     void set(const vec4<T> &value)
     {
         this->value = value;
+        this->version = Value::nextVersion();
     }
 
 private:
@@ -552,6 +574,7 @@ public:
         for (int i = 0; i < R * C; ++i) {
             this->value[i] = value[i];
         }
+        this->version = Value::nextVersion();
     }
 
 protected:
@@ -41,6 +41,8 @@
 
 #include "ork/resource/ResourceManager.h"
 
+#include "ork/core/Profiler.h"
+
 using namespace std;
 
 namespace ork
@@ -93,6 +95,7 @@ ptr<Object> ResourceManager::loadResource(const string &name)
         Logger::INFO_LOGGER->log("RESOURCE", "Loading resource '" + name + "'");
     }
     // otherwise the resource is not already loaded; we first load its descriptor
+    Profiler::Zone zone("ResourceManager::loadResource");
     ptr<Object> r = NULL;
     ptr<ResourceDescriptor> d = loader->loadResource(name);
 
@@ -0,0 +1,448 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#include "ork/scenegraph/BatchRenderer.h"
+
+#include <algorithm>
+
+#include "ork/core/Logger.h"
+#include "ork/render/FrameBuffer.h"
+#include "ork/scenegraph/SceneManager.h"
+
+using namespace std;
+
+namespace ork
+{
+
+BatchRenderer::Batch::Batch() : Object("BatchRenderer::Batch"), dirty(false)
+{
+}
+
+BatchRenderer::Batch::~Batch()
+{
+}
+
+BatchRenderer::BatchRenderer() : Object("BatchRenderer")
+{
+}
+
+BatchRenderer::~BatchRenderer()
+{
+}
+
+bool BatchRenderer::addMesh(ptr<MeshBuffers> m)
+{
+    return getRange(m).batch >= 0;
+}
+
+int BatchRenderer::getMeshCount()
+{
+    return (int) ranges.size();
+}
+
+int BatchRenderer::getBatchCount()
+{
+    return (int) batches.size();
+}
+
+void BatchRenderer::clear()
+{
+    batches.clear();
+    ranges.clear();
+}
+
+ptr<RingBuffer> BatchRenderer::getStreamBuffer() const
+{
+    return stream;
+}
+
+void BatchRenderer::setStreamBuffer(ptr<RingBuffer> stream)
+{
+    this->stream = stream;
+}
+
+void BatchRenderer::draw(ptr<Program> p, const vector< ptr<MeshBuffers> > &meshes, const vector< ptr<SceneNode> > &nodes)
+{
+    assert(meshes.size() == nodes.size());
+    // groups the meshes by batch
+    vector<Range*> r(meshes.size());
+    for (unsigned int i = 0; i < meshes.size(); ++i) {
+        r[i] = &getRange(meshes[i]);
+    }
+    vector< vector<unsigned int> > groups(batches.size());
+    for (unsigned int i = 0; i < meshes.size(); ++i) {
+        if (r[i]->batch >= 0) {
+            groups[r[i]->batch].push_back(i);
+        } else if (Logger::ERROR_LOGGER != NULL) {
+            Logger::ERROR_LOGGER->log("SCENEGRAPH", "BatchRenderer : cannot draw a mesh that is not batched");
+        }
+    }
+
+    ptr<FrameBuffer> fb = SceneManager::getCurrentFrameBuffer();
+    for (unsigned int k = 0; k < groups.size(); ++k) {
+        const vector<unsigned int> &group = groups[k];
+        if (group.empty()) {
+            continue;
+        }
+        ptr<Batch> b = batches[k];
+        ptr<AttributeBuffer> indices = b->mesh->getIndiceBuffer();
+        if (b->dirty) {
+            update(b);
+        }
+
+        // computes the draw commands and the per draw data; consecutive
+        // draws of the same mesh are merged in a single command
+        Drawing &d = getDrawing(b, p);
+        int stride = d.layout->getStride();
+        int commandSize = indices == NULL ? 4 : 5;
+        vector<float> data(group.size() * stride + 1);
+        vector<GLuint> commands;
+        Range *prev = NULL;
+        for (unsigned int j = 0; j < group.size(); ++j) {
+            unsigned int i = group[j];
+            d.layout->getData(nodes[i], &data[j * stride]);
+            if (r[i] == prev) {
+                commands[commands.size() - commandSize + 1] += 1;
+            } else {
+                commands.push_back(r[i]->count);
+                commands.push_back(1);
+                commands.push_back(r[i]->first);
+                if (indices != NULL) {
+                    commands.push_back(r[i]->base);
+                }
+                commands.push_back(j);
+                prev = r[i];
+            }
+        }
+        // the per draw data is valid only during this frame, and is thus
+        // written in the ring buffer, if any, unless it is full; its offset
+        // must be a multiple of the stride, to be selected with the base
+        // instance of the draw commands
+        int size = int(group.size() * stride * sizeof(float));
+        int alignment = int(max(stride, 1) * sizeof(float));
+        int offset = stream == NULL ? -1 : stream->write(&data[0], size, alignment);
+        if (offset >= 0) {
+            setInstances(b, d, stream->getBuffer());
+        } else {
+            offset = 0;
+            d.buffer->setData(size, &data[0], STREAM_DRAW);
+            setInstances(b, d, d.buffer);
+        }
+        if (stride > 0 && offset > 0) {
+            for (unsigned int c = commandSize - 1; c < commands.size(); c += commandSize) {
+                commands[c] += offset / alignment;
+            }
+        }
+        d.commands->setData(int(commands.size() * sizeof(GLuint)), &commands[0], STREAM_DRAW);
+        fb->multiDrawIndirect(p, *(d.mesh), b->mesh->mode, *(d.commands), GLsizei(commands.size() / commandSize));
+    }
+}
+
+BatchRenderer::Range &BatchRenderer::getRange(ptr<MeshBuffers> m)
+{
+    map<MeshBuffers*, Range>::iterator i = ranges.find(m.get());
+    if (i != ranges.end()) {
+        if (isValid(i->second)) {
+            return i->second;
+        }
+        // the mesh has changed: removes it from its batch and adds it again
+        if (i->second.batch >= 0) {
+            ptr<Batch> b = batches[i->second.batch];
+            b->meshes.erase(find(b->meshes.begin(), b->meshes.end(), m.get()));
+            b->dirty = true;
+        }
+    }
+    Range &r = ranges[m.get()];
+    r.mesh = m;
+    r.batch = -1;
+    r.first = 0;
+    r.count = 0;
+    r.base = 0;
+    r.nvertices = m->nvertices;
+    r.nindices = m->nindices;
+    r.attributes.clear();
+    r.buffers.clear();
+    r.sources.clear();
+    r.versions.clear();
+    r.offsets.clear();
+    r.sizes.clear();
+
+    int n = m->getAttributeCount();
+    ptr<AttributeBuffer> indices = m->getIndiceBuffer();
+    for (int j = 0; j < n; ++j) {
+        r.attributes.push_back(m->getAttributeBuffer(j));
+        r.buffers.push_back(m->getAttributeBuffer(j)->b);
+    }
+    if (indices != NULL) {
+        r.attributes.push_back(indices);
+        r.buffers.push_back(indices->b);
+    }
+    if (n == 0 || m->nvertices == 0 || (indices == NULL) != (m->nindices == 0)) {
+        return r;
+    }
+
+    // finds the source buffer of each attribute, and the vertex size, start
+    // offset and used size of each buffer
+    vector< ptr<Buffer> > buffers;
+    vector<int> strides;
+    vector<int> starts;
+    vector<int> sizes;
+    vector<int> slots(n);
+    for (int j = 0; j < n; ++j) {
+        ptr<AttributeBuffer> a = m->getAttributeBuffer(j);
+        if (a->b == NULL || a->divisor != 0) {
+            return r;
+        }
+        int stride = a->stride == 0 ? a->getAttributeSize() : a->stride;
+        unsigned int s = 0;
+        while (s < buffers.size() && buffers[s] != a->b) {
+            ++s;
+        }
+        if (s == buffers.size()) {
+            buffers.push_back(a->b);
+            strides.push_back(stride);
+            starts.push_back(a->offset);
+            sizes.push_back(0);
+        } else if (strides[s] != stride) {
+            return r;
+        }
+        starts[s] = min(starts[s], a->offset);
+        slots[j] = s;
+    }
+    for (int j = 0; j < n; ++j) {
+        ptr<AttributeBuffer> a = m->getAttributeBuffer(j);
+        int s = slots[j];
+        int end = a->offset - starts[s] + a->getAttributeSize();
+        if (end > strides[s]) {
+            return r;
+        }
+        sizes[s] = max(sizes[s], end);
+    }
+
+    // finds a batch with the same format
+    int batch = -1;
+    for (unsigned int k = 0; k < batches.size() && batch == -1; ++k) {
+        ptr<Batch> b = batches[k];
+        ptr<MeshBuffers> bm = b->mesh;
+        ptr<AttributeBuffer> bi = bm->getIndiceBuffer();
+        bool same = bm->mode == m->mode && bm->primitiveRestart == m->primitiveRestart && bm->patchVertices == m->patchVertices;
+        same = same && b->strides == strides && b->slots == slots;
+        same = same && (bi == NULL) == (indices == NULL) && (bi == NULL || bi->type == indices->type);
+        for (int j = 0; same && j < n; ++j) {
+            ptr<AttributeBuffer> a = m->getAttributeBuffer(j);
+            ptr<AttributeBuffer> c = bm->getAttributeBuffer(j);
+            same = c->index == a->index && c->size == a->size && c->type == a->type;
+            same = same && c->I == a->I && c->L == a->L && c->norm == a->norm;
+            same = same && c->stride == a->stride && c->offset == a->offset - starts[slots[j]];
+        }
+        if (same) {
+            batch = k;
+        }
+    }
+    if (batch == -1) {
+        ptr<Batch> b = new Batch();
+        b->mesh = new MeshBuffers();
+        b->mesh->mode = m->mode;
+        b->mesh->primitiveRestart = m->primitiveRestart;
+        b->mesh->patchVertices = m->patchVertices;
+        b->strides = strides;
+        b->slots = slots;
+        vector< ptr<GPUBuffer> > gpuBuffers;
+        for (unsigned int s = 0; s < strides.size(); ++s) {
+            gpuBuffers.push_back(new GPUBuffer());
+        }
+        for (int j = 0; j < n; ++j) {
+            ptr<AttributeBuffer> a = m->getAttributeBuffer(j);
+            ptr<AttributeBuffer> c = new AttributeBuffer(a->index, a->size, a->type, a->norm,
+                gpuBuffers[slots[j]], a->stride, a->offset - starts[slots[j]]);
+            c->I = a->I;
+            c->L = a->L;
+            b->mesh->addAttributeBuffer(c);
+        }
+        if (indices != NULL) {
+            b->mesh->setIndicesBuffer(new AttributeBuffer(0, 1, indices->type, false, new GPUBuffer()));
+        }
+        batch = (int) batches.size();
+        batches.push_back(b);
+    }
+
+    // appends the mesh to the batch; its data is copied in the batch
+    // buffers when the batch is drawn (see #update)
+    for (unsigned int s = 0; s < strides.size(); ++s) {
+        r.sources.push_back(buffers[s]);
+        r.offsets.push_back(starts[s]);
+        r.sizes.push_back((m->nvertices - 1) * strides[s] + sizes[s]);
+    }
+    if (indices != NULL) {
+        r.sources.push_back(indices->b);
+        r.offsets.push_back(indices->offset);
+        r.sizes.push_back(m->nindices * indices->getAttributeSize());
+    }
+    for (unsigned int s = 0; s < r.sources.size(); ++s) {
+        ptr<GPUBuffer> g = r.sources[s].cast<GPUBuffer>();
+        r.versions.push_back(g == NULL ? 0 : g->getVersion());
+    }
+    ptr<Batch> b = batches[batch];
+    r.batch = batch;
+    r.count = indices == NULL ? m->nvertices : m->nindices;
+    b->meshes.push_back(m.get());
+    b->dirty = true;
+    return r;
+}
+
+bool BatchRenderer::isValid(const Range &r)
+{
+    ptr<MeshBuffers> m = r.mesh;
+    int n = m->getAttributeCount();
+    ptr<AttributeBuffer> indices = m->getIndiceBuffer();
+    if (m->nvertices != r.nvertices || m->nindices != r.nindices) {
+        return false;
+    }
+    if (r.attributes.size() != (unsigned int) (indices == NULL ? n : n + 1)) {
+        return false;
+    }
+    for (int j = 0; j < n; ++j) {
+        ptr<AttributeBuffer> a = m->getAttributeBuffer(j);
+        if (a != r.attributes[j] || a->b != r.buffers[j]) {
+            return false;
+        }
+    }
+    if (indices != NULL && (indices != r.attributes[n] || indices->b != r.buffers[n])) {
+        return false;
+    }
+    for (unsigned int s = 0; s < r.sources.size(); ++s) {
+        ptr<GPUBuffer> g = r.sources[s].cast<GPUBuffer>();
+        if (g != NULL && g->getVersion() != r.versions[s]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BatchRenderer::update(ptr<Batch> b)
+{
+    // computes the location of each mesh in the shared buffers
+    ptr<AttributeBuffer> indices = b->mesh->getIndiceBuffer();
+    int nvertices = 0;
+    int nindices = 0;
+    for (unsigned int i = 0; i < b->meshes.size(); ++i) {
+        Range &r = ranges[b->meshes[i]];
+        r.base = nvertices;
+        r.first = indices == NULL ? nvertices : nindices;
+        nvertices += r.nvertices;
+        nindices += r.nindices;
+    }
+    b->mesh->nvertices = nvertices;
+    b->mesh->nindices = nindices;
+
+    // reallocates the shared buffers, in the same order as Range#sources,
+    // and copies the mesh data into them, on the GPU for GPU buffers
+    unsigned int slots = (unsigned int) b->strides.size();
+    vector< ptr<GPUBuffer> > targets(indices == NULL ? slots : slots + 1);
+    vector<int> sizes(targets.size());
+    for (int j = 0; j < b->mesh->getAttributeCount(); ++j) {
+        targets[b->slots[j]] = b->mesh->getAttributeBuffer(j)->getBuffer().cast<GPUBuffer>();
+    }
+    for (unsigned int s = 0; s < slots; ++s) {
+        sizes[s] = b->strides[s];
+    }
+    if (indices != NULL) {
+        targets[slots] = indices->getBuffer().cast<GPUBuffer>();
+        sizes[slots] = indices->getAttributeSize();
+    }
+    for (unsigned int s = 0; s < targets.size(); ++s) {
+        targets[s]->setData((s < slots ? nvertices : nindices) * sizes[s], NULL, STATIC_DRAW);
+    }
+    for (unsigned int i = 0; i < b->meshes.size(); ++i) {
+        const Range &r = ranges[b->meshes[i]];
+        for (unsigned int s = 0; s < targets.size(); ++s) {
+            int offset = (s < slots ? r.base : r.first) * sizes[s];
+            ptr<GPUBuffer> g = r.sources[s].cast<GPUBuffer>();
+            if (r.sizes[s] <= 0) {
+                continue;
+            } else if (g != NULL) {
+                targets[s]->copySubData(g, r.offsets[s], offset, r.sizes[s]);
+            } else {
+                targets[s]->setSubData(offset, r.sizes[s], r.sources[s]->data(r.offsets[s]));
+            }
+        }
+    }
+    b->dirty = false;
+}
+
+BatchRenderer::Drawing &BatchRenderer::getDrawing(ptr<Batch> b, ptr<Program> p)
+{
+    map<Program*, Drawing>::iterator i = b->drawings.find(p.get());
+    if (i != b->drawings.end() && i->second.layout->isValid(p)) {
+        return i->second;
+    }
+    if (i == b->drawings.end()) {
+        if (b->drawings.size() >= MAX_DRAWINGS) {
+            b->drawings.clear();
+        }
+        i = b->drawings.insert(make_pair(p.get(), Drawing())).first;
+        i->second.buffer = new GPUBuffer();
+        i->second.commands = new GPUBuffer();
+    }
+    Drawing &d = i->second;
+    d.layout = new InstanceLayout(p, b->mesh);
+    d.mesh = NULL;
+    return d;
+}
+
+void BatchRenderer::setInstances(ptr<Batch> b, Drawing &d, ptr<GPUBuffer> instances)
+{
+    if (d.mesh != NULL && d.instances == instances) {
+        return;
+    }
+    d.mesh = new MeshBuffers();
+    d.mesh->mode = b->mesh->mode;
+    d.mesh->primitiveRestart = b->mesh->primitiveRestart;
+    d.mesh->patchVertices = b->mesh->patchVertices;
+    for (int j = 0; j < b->mesh->getAttributeCount(); ++j) {
+        d.mesh->addAttributeBuffer(b->mesh->getAttributeBuffer(j));
+    }
+    d.layout->addAttributeBuffers(d.mesh, instances);
+    d.mesh->setIndicesBuffer(b->mesh->getIndiceBuffer());
+    d.instances = instances;
+}
+
+}
@@ -0,0 +1,377 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#ifndef _ORK_BATCH_RENDERER_H_
+#define _ORK_BATCH_RENDERER_H_
+
+#include <map>
+#include <vector>
+
+#include "ork/render/GPUBuffer.h"
+#include "ork/render/RingBuffer.h"
+#include "ork/scenegraph/InstanceLayout.h"
+
+namespace ork
+{
+
+/**
+ * A renderer to draw many static meshes with few draw calls. A BatchRenderer
+ * copies the vertices and indices of the meshes that are added to it into a
+ * few shared vertex and index buffers, one set of buffers per batch. A batch
+ * contains meshes with the same vertex format, the same index type and the
+ * same mode. Then all the meshes of a batch drawn with the same program and
+ * the same states are drawn with a single glMultiDraw*Indirect call. The
+ * draw commands of this call are built at each frame from the meshes to be
+ * drawn, and the per draw data (such as transformations and material
+ * indices) is read by the program from per instance attributes (see
+ * InstanceLayout), streamed in a per frame instance buffer (see #setStreamBuffer). Consecutive
+ * draws of the same mesh share the same draw command.
+ *
+ * A LoopTask in batch mode uses the BatchRenderer of its SceneManager to
+ * merge the draws of several scene nodes (see RenderQueue).
+ *
+ * The mesh data is copied on the GPU when the meshes are drawn, without
+ * reading the mesh buffers back. A mesh whose buffers, vertex or index
+ * count, or GPUBuffer content change is copied again (the content of a
+ * CPUBuffer is assumed not to change). The vertices of a mesh must start at
+ * the beginning of its buffers, with attributes either interleaved or
+ * stored in separate buffers. Meshes that do not satisfy these conditions
+ * are not batched. Only available with OpenGL 4.3 or more.
+ *
+ * @ingroup scenegraph
+ */
+class ORK_API BatchRenderer : public Object
+{
+public:
+    /**
+     * Creates a new BatchRenderer.
+     */
+    BatchRenderer();
+
+    /**
+     * Deletes this BatchRenderer.
+     */
+    virtual ~BatchRenderer();
+
+    /**
+     * Adds a mesh to this renderer, if it is not already done. Returns true
+     * if this mesh can be drawn with this renderer.
+     *
+     * @param m a static mesh.
+     */
+    bool addMesh(ptr<MeshBuffers> m);
+
+    /**
+     * Returns the number of meshes that have been added to this renderer.
+     */
+    int getMeshCount();
+
+    /**
+     * Returns the number of batches of this renderer.
+     */
+    int getBatchCount();
+
+    /**
+     * Removes all the meshes of this renderer.
+     */
+    void clear();
+
+    /**
+     * Draws the given meshes with the given program in the current
+     * framebuffer. The meshes are drawn with one draw call per batch.
+     *
+     * @param p the program to use to draw the meshes.
+     * @param meshes the meshes to be drawn. Each mesh must have been added
+     *      to this renderer with #addMesh.
+     * @param nodes the scene nodes whose data must be stored in the per
+     *      draw attributes, one per mesh.
+     */
+    void draw(ptr<Program> p, const std::vector< ptr<MeshBuffers> > &meshes, const std::vector< ptr<SceneNode> > &nodes);
+
+    /**
+     * Returns the RingBuffer used to upload the per draw data, or NULL.
+     */
+    ptr<RingBuffer> getStreamBuffer() const;
+
+    /**
+     * Sets the RingBuffer used to upload the per draw data. Instead of
+     * reallocating a buffer of its own at each draw, this renderer then
+     * copies the per draw data into the region of the current frame of this
+     * ring buffer. If the ring buffer is full, the renderer reverts to its
+     * own buffers for this draw.
+     *
+     * @param stream a ring buffer, or NULL to use buffers owned by this
+     *      renderer.
+     */
+    void setStreamBuffer(ptr<RingBuffer> stream);
+
+private:
+    /**
+     * The data needed to draw the meshes of a batch with a program.
+     */
+    struct Drawing
+    {
+        /**
+         * The per draw attributes read by the program used to draw the
+         * meshes. This program is not kept alive by this drawing.
+         */
+        ptr<InstanceLayout> layout;
+
+        /**
+         * The shared buffers of the batch, followed by the per draw
+         * attributes.
+         */
+        ptr<MeshBuffers> mesh;
+
+        /**
+         * The buffer containing the per draw attributes when there is no
+         * ring buffer or when it is full (see #setStreamBuffer).
+         */
+        ptr<GPUBuffer> buffer;
+
+        /**
+         * The buffer from which #mesh reads the per draw attributes, i.e.
+         * the ring buffer of the renderer, or #buffer. The draw
+         * commands select the data of each draw with their base instance.
+         */
+        ptr<GPUBuffer> instances;
+
+        /**
+         * The buffer containing the draw commands.
+         */
+        ptr<GPUBuffer> commands;
+    };
+
+    /**
+     * A set of meshes with the same format, stored in shared buffers.
+     */
+    class Batch : public Object
+    {
+    public:
+        /**
+         * The shared vertex and index buffers of this batch.
+         */
+        ptr<MeshBuffers> mesh;
+
+        /**
+         * The vertex size in bytes of each shared vertex buffer.
+         */
+        std::vector<int> strides;
+
+        /**
+         * The buffer of each attribute of #mesh, as an index in #strides.
+         */
+        std::vector<int> slots;
+
+        /**
+         * The meshes of this batch, in the order of their data in the
+         * shared buffers.
+         */
+        std::vector<MeshBuffers*> meshes;
+
+        /**
+         * True if the shared buffers must be updated from #meshes.
+         */
+        bool dirty;
+
+        /**
+         * The data to draw the meshes of this batch, for each program. A
+         * program may have been deleted, and its address reused, which is
+         * detected with InstanceLayout#isValid.
+         */
+        std::map<Program*, Drawing> drawings;
+
+        /**
+         * Creates a new empty Batch.
+         */
+        Batch();
+
+        /**
+         * Deletes this Batch.
+         */
+        virtual ~Batch();
+    };
+
+    /**
+     * The location of a mesh in a batch.
+     */
+    struct Range
+    {
+        /**
+         * The mesh.
+         */
+        ptr<MeshBuffers> mesh;
+
+        /**
+         * The index of the batch containing the mesh, or -1 if the mesh
+         * cannot be batched.
+         */
+        int batch;
+
+        /**
+         * The first index (or vertex for meshes without indices) of the mesh
+         * in the batch.
+         */
+        int first;
+
+        /**
+         * The number of indices (or vertices) of the mesh.
+         */
+        int count;
+
+        /**
+         * The index of the first vertex of the mesh in the batch.
+         */
+        int base;
+
+        /**
+         * The number of vertices of the mesh.
+         */
+        int nvertices;
+
+        /**
+         * The number of indices of the mesh.
+         */
+        int nindices;
+
+        /**
+         * The attribute buffers of the mesh, followed by its indices buffer,
+         * if any.
+         */
+        std::vector< ptr<AttributeBuffer> > attributes;
+
+        /**
+         * The buffer of each AttributeBuffer in #attributes.
+         */
+        std::vector< ptr<Buffer> > buffers;
+
+        /**
+         * The buffer containing each shared vertex buffer data of the mesh,
+         * followed by the buffer containing its indices, if any.
+         */
+        std::vector< ptr<Buffer> > sources;
+
+        /**
+         * The version of each buffer in #sources, when the mesh was added
+         * (see GPUBuffer#getVersion).
+         */
+        std::vector<unsigned int> versions;
+
+        /**
+         * The offset of the mesh data in each buffer of #sources.
+         */
+        std::vector<int> offsets;
+
+        /**
+         * The size of the mesh data in each buffer of #sources.
+         */
+        std::vector<int> sizes;
+    };
+
+    /**
+     * The maximum number of programs for which the drawing data of a batch is
+     * kept.
+     */
+    static const unsigned int MAX_DRAWINGS = 8;
+
+    /**
+     * The batches of this renderer.
+     */
+    std::vector< ptr<Batch> > batches;
+
+    /**
+     * The location of each mesh added to this renderer.
+     */
+    std::map<MeshBuffers*, Range> ranges;
+
+    /**
+     * The RingBuffer used to upload the per draw data, or NULL.
+     */
+    ptr<RingBuffer> stream;
+
+    /**
+     * Returns the location of the given mesh in this renderer, adding it to
+     * a batch if necessary, or adding it again if it has changed.
+     *
+     * @param m a mesh.
+     */
+    Range &getRange(ptr<MeshBuffers> m);
+
+    /**
+     * Returns true if the given mesh location is still valid, i.e., if the
+     * mesh buffers and their content did not change since the mesh was
+     * added.
+     *
+     * @param r a mesh location.
+     */
+    static bool isValid(const Range &r);
+
+    /**
+     * Copies the data of the meshes of the given batch in its shared
+     * buffers, and updates the location of these meshes.
+     *
+     * @param b a batch.
+     */
+    void update(ptr<Batch> b);
+
+    /**
+     * Returns the data to draw the meshes of the given batch with the given
+     * program.
+     *
+     * @param b a batch.
+     * @param p a program.
+     */
+    Drawing &getDrawing(ptr<Batch> b, ptr<Program> p);
+
+    /**
+     * Updates the mesh of the given drawing data, if necessary, so that it
+     * reads the per draw attributes from the given buffer.
+     *
+     * @param b a batch.
+     * @param d the data to draw the meshes of this batch.
+     * @param instances the buffer containing the per draw attributes.
+     */
+    static void setInstances(ptr<Batch> b, Drawing &d, ptr<GPUBuffer> instances);
+};
+
+}
+
+#endif
@@ -41,8 +41,10 @@
 
 #include "ork/scenegraph/DrawMeshTask.h"
 
+#include "ork/core/GPUProfiler.h"
 #include "ork/render/FrameBuffer.h"
 #include "ork/resource/ResourceTemplate.h"
+#include "ork/scenegraph/RenderQueue.h"
 #include "ork/scenegraph/SceneManager.h"
 
 using namespace std;
@@ -86,17 +88,104 @@ ptr<Task> DrawMeshTask::getTask(ptr<Object> context)
         }
         throw exception();
     }
-    return new Impl(m, count);
+    ptr<Impl> result = new Impl(this, n, m, count);
+    if (RenderQueue::getCurrent() != NULL) {
+        RenderQueue::getCurrent()->setMesh(m, result);
+    }
+    return result;
 }
 
 void DrawMeshTask::swap(ptr<DrawMeshTask> t)
 {
     std::swap(mesh, t->mesh);
     std::swap(count, t->count);
+    instancings.clear();
+    t->instancings.clear();
+}
+
+DrawMeshTask::Instancing &DrawMeshTask::getInstancing(ptr<Program> p, ptr<MeshBuffers> m, unsigned int frame)
+{
+    pair<MeshBuffers*, Program*> key = make_pair(m.get(), p.get());
+    map<pair<MeshBuffers*, Program*>, Instancing>::iterator i = instancings.begin();
+    while (i != instancings.end()) {
+        // an entry unused during the last frame may belong to a deleted mesh,
+        // whose buffers are still referenced by its instanced mesh
+        if (i->second.frame + 1 < frame && i->first != key) {
+            instancings.erase(i++);
+        } else {
+            ++i;
+        }
+    }
+    i = instancings.find(key);
+    if (i == instancings.end()) {
+        if (instancings.size() >= MAX_INSTANCINGS) {
+            instancings.clear();
+        }
+        Instancing &result = instancings[key];
+        result.meshVersion = 0;
+        result.buffer = new GPUBuffer();
+        result.offset = 0;
+        i = instancings.find(key);
+    }
+    Instancing &r = i->second;
+    r.frame = frame;
+    // the per instance attributes depend on the attributes of the mesh
+    if (r.layout == NULL || !r.layout->isValid(p) || r.meshVersion != m->getVersion()) {
+        r.layout = new InstanceLayout(p, m);
+        r.mesh = NULL;
+    }
+    return r;
+}
+
+void DrawMeshTask::setInstances(Instancing &r, ptr<MeshBuffers> m, ptr<GPUBuffer> b, int offset)
+{
+    // the mesh version also detects a new mesh at the address of a deleted one
+    bool valid = r.mesh != NULL && r.meshVersion == m->getVersion() && r.instances == b && r.offset == offset;
+    if (!valid) {
+        r.mesh = new MeshBuffers();
+        for (int j = 0; j < m->getAttributeCount(); ++j) {
+            r.mesh->addAttributeBuffer(m->getAttributeBuffer(j));
+        }
+        r.layout->addAttributeBuffers(r.mesh, b, offset);
+        r.mesh->setIndicesBuffer(m->getIndiceBuffer());
+        r.meshVersion = m->getVersion();
+        r.instances = b;
+        r.offset = offset;
+    }
 }
 
-DrawMeshTask::Impl::Impl(ptr<MeshBuffers> m, int count) :
-    Task("DrawMesh", true, 0), m(m), count(count)
+void DrawMeshTask::drawInstances(ptr<Program> p, ptr<MeshBuffers> m, const vector< ptr<SceneNode> > &nodes)
+{
+    ptr<SceneManager> manager = nodes[0]->getOwner();
+    Instancing &r = getInstancing(p, m, manager->getFrameNumber());
+    int stride = r.layout->getStride();
+    int size = int(nodes.size() * stride * sizeof(float));
+    vector<float> data(nodes.size() * stride + 1);
+    for (unsigned int i = 0; i < nodes.size(); ++i) {
+        r.layout->getData(nodes[i], &data[i * stride]);
+    }
+    // the per instance data is valid only during this frame, and is thus
+    // written in the ring buffer of the scene manager, unless it is full
+    ptr<RingBuffer> stream = manager->getStreamBuffer();
+    int offset = stream->write(&data[0], size, sizeof(float));
+    if (offset >= 0) {
+        setInstances(r, m, stream->getBuffer(), offset);
+    } else {
+        r.buffer->setData(size, &data[0], STREAM_DRAW);
+        setInstances(r, m, r.buffer, 0);
+    }
+
+    r.mesh->mode = m->mode;
+    r.mesh->nvertices = m->nvertices;
+    r.mesh->nindices = m->nindices;
+    r.mesh->primitiveRestart = m->primitiveRestart;
+    r.mesh->patchVertices = m->patchVertices;
+    int n = m->nindices == 0 ? m->nvertices : m->nindices;
+    SceneManager::getCurrentFrameBuffer()->draw(p, *(r.mesh), m->mode, 0, n, (GLsizei) nodes.size());
+}
+
+DrawMeshTask::Impl::Impl(ptr<DrawMeshTask> owner, ptr<SceneNode> n, ptr<MeshBuffers> m, int count) :
+    Task("DrawMesh", true, 0), owner(owner), n(n), m(m), count(count)
 {
 }
 
@@ -111,8 +200,17 @@ bool DrawMeshTask::Impl::run()
             Resource *r = dynamic_cast<Resource*>(m.get());
             Logger::DEBUG_LOGGER->log("SCENEGRAPH", r == NULL ? "DrawMesk" : "DrawMesh '" + r->getName() + "'");
         }
+        GPUProfiler::setOwner(n.get());
         ptr<Program> prog = SceneManager::getCurrentProgram();
-        if (m->nindices == 0) {
+        if (!prog->isReady()) {
+            // the program is still being compiled (see Module#setAsynchronousCompilation)
+            return true;
+        }
+        if (batches != NULL) {
+            batches->draw(prog, meshes, instances);
+        } else if (instances.size() > 0) {
+            owner->drawInstances(prog, m, instances);
+        } else if (m->nindices == 0) {
             SceneManager::getCurrentFrameBuffer()->draw(prog, *m, m->mode, 0, m->nvertices);
         } else {
             SceneManager::getCurrentFrameBuffer()->draw(prog, *m, m->mode, 0, m->nindices);
@@ -121,6 +219,17 @@ bool DrawMeshTask::Impl::run()
     return true;
 }
 
+bool DrawMeshTask::Impl::record(CommandList &commands)
+{
+    if (batches != NULL || instances.size() > 0 || commands.getProgram() == NULL) {
+        return false;
+    }
+    if (m != NULL) {
+        commands.draw(m, m->mode, 0, m->nindices == 0 ? m->nvertices : m->nindices);
+    }
+    return true;
+}
+
 /// @cond RESOURCES
 
 class DrawMeshTaskResource : public ResourceTemplate<40, DrawMeshTask>
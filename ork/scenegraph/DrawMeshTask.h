@@ -42,14 +42,27 @@
 #ifndef _ORK_DRAW_MESH_TASK_H_
 #define _ORK_DRAW_MESH_TASK_H_
 
+#include "ork/render/GPUBuffer.h"
 #include "ork/scenegraph/AbstractTask.h"
+#include "ork/scenegraph/BatchRenderer.h"
+#include "ork/scenegraph/InstanceLayout.h"
+#include "ork/scenegraph/RecordTask.h"
 
 namespace ork
 {
 
 /**
  * An AbstractTask to draw a mesh. The mesh is drawn using the current
- * framebuffer and the current program.
+ * framebuffer and the current program. If the mesh name designates a LodMesh
+ * of a scene node, the level selected for this node by the last call to
+ * SceneManager#update is drawn (see SceneNode#getMesh).
+ *
+ * When the draws of several scene nodes are merged by a LoopTask in
+ * instancing mode (see RenderQueue), the mesh is drawn once for all these
+ * nodes with an instanced draw call. The per node data is then read by the
+ * program from per instance vertex attributes (see InstanceLayout). When the
+ * draws of several scene nodes are merged by a LoopTask in batch mode, the
+ * meshes of these nodes are drawn with a BatchRenderer.
  *
  * @ingroup scenegraph
  */
@@ -109,14 +122,121 @@ private:
      */
     int count;
 
+    /**
+     * The data needed to draw a mesh with a program with instancing. The mesh
+     * and the program are not kept alive by this data. They may have been
+     * deleted, and their address reused, which is detected with their
+     * version.
+     */
+    struct Instancing
+    {
+        /**
+         * The per instance attributes read by the program (see
+         * InstanceLayout#isValid).
+         */
+        ptr<InstanceLayout> layout;
+
+        /**
+         * The attributes and indices of the mesh followed by the per instance
+         * attributes.
+         */
+        ptr<MeshBuffers> mesh;
+
+        /**
+         * The version of the mesh when #mesh was created (see
+         * MeshBuffers#getVersion).
+         */
+        unsigned int meshVersion;
+
+        /**
+         * The last frame in which this data was used (see
+         * SceneManager#getFrameNumber).
+         */
+        unsigned int frame;
+
+        /**
+         * The buffer containing the per instance attributes when the ring
+         * buffer of the scene manager is full (see SceneManager#getStreamBuffer).
+         */
+        ptr<GPUBuffer> buffer;
+
+        /**
+         * The buffer from which #mesh reads the per instance attributes,
+         * i.e. the ring buffer of the scene manager, or #buffer.
+         */
+        ptr<GPUBuffer> instances;
+
+        /**
+         * The offset of the per instance attributes in #instances, in bytes.
+         */
+        int offset;
+    };
+
+    /**
+     * The data used to draw the meshes of this task with instancing, for
+     * each mesh and program. The entries unused during the last frame are
+     * removed, so that they do not keep the buffers of deleted meshes alive.
+     */
+    std::map<std::pair<MeshBuffers*, Program*>, Instancing> instancings;
+
+    /**
+     * The maximum number of entries in #instancings.
+     */
+    static const unsigned int MAX_INSTANCINGS = 8;
+
+    /**
+     * Returns the data to draw the given mesh with the given program with
+     * instancing, creating it or updating its layout if necessary.
+     *
+     * @param p a program.
+     * @param m a mesh.
+     * @param frame the current frame number.
+     */
+    Instancing &getInstancing(ptr<Program> p, ptr<MeshBuffers> m, unsigned int frame);
+
+    /**
+     * Updates the mesh of the given instancing data, if necessary, so that
+     * it reads the attributes and indices of the given mesh, and the per
+     * instance attributes at the given offset of the given buffer.
+     *
+     * @param r the data to draw a mesh with instancing.
+     * @param m the mesh drawn with r.
+     * @param b the buffer containing the per instance attributes.
+     * @param offset the offset of these attributes in b, in bytes.
+     */
+    static void setInstances(Instancing &r, ptr<MeshBuffers> m, ptr<GPUBuffer> b, int offset);
+
+    /**
+     * Draws the given mesh once for each of the given scene nodes, with an
+     * instanced draw call. The per instance data is streamed to the GPU with
+     * the ring buffer of the scene manager.
+     *
+     * @param p the program to be used.
+     * @param m the mesh to be drawn.
+     * @param nodes the scene nodes whose data must be stored in the per
+     *      instance attributes.
+     */
+    void drawInstances(ptr<Program> p, ptr<MeshBuffers> m, const std::vector< ptr<SceneNode> > &nodes);
+
     /**
      * A ork::Task to draw a mesh.
      */
-    class Impl : public Task
+    class Impl : public Task, public Recordable
     {
     public:
         /**
-         * The mesh that must be drawn.
+         * The DrawMeshTask that created this task.
+         */
+        ptr<DrawMeshTask> owner;
+
+        /**
+         * The scene node for which #m must be drawn.
+         */
+        ptr<SceneNode> n;
+
+        /**
+         * The mesh that must be drawn, or NULL if the draw of this task has
+         * been merged into the draw of another task by a RenderQueue.
          */
         ptr<MeshBuffers> m;
 
@@ -125,13 +245,35 @@ private:
          */
         int count;
 
+        /**
+         * The scene nodes for which #m must be drawn with instancing, or an
+         * empty vector to draw #m normally. Set by the RenderQueue that
+         * merged the draws of these nodes into this task.
+         */
+        std::vector< ptr<SceneNode> > instances;
+
+        /**
+         * The renderer to be used to draw #meshes, or NULL to draw #m.
+         * Set by the RenderQueue that merged the draws of #instances into
+         * this task.
+         */
+        ptr<BatchRenderer> batches;
+
+        /**
+         * The meshes to be drawn with #batches, one per scene node in
+         * #instances.
+         */
+        std::vector< ptr<MeshBuffers> > meshes;
+
         /**
          * Creates a new DrawMeshTask::Impl task.
          *
+         * @param owner the DrawMeshTask that created this task.
+         * @param n the scene node for which the mesh must be drawn.
          * @param m the mesh to be drawn.
          * @param count the number of time the mesh must be drawn.
          */
-        Impl(ptr<MeshBuffers> m, int count);
+        Impl(ptr<DrawMeshTask> owner, ptr<SceneNode> n, ptr<MeshBuffers> m, int count);
 
         /**
          * Deletes this DrawMeshTask::Impl task.
@@ -139,7 +281,15 @@ private:
         virtual ~Impl();
 
         virtual bool run();
+
+        /**
+         * Records the draw of #m with the current program of the given list.
+         * Instanced and batched draws cannot be recorded.
+         */
+        virtual bool record(CommandList &commands);
     };
+
+    friend class RenderQueue;
 };
 
 }
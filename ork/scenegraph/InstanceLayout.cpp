@@ -0,0 +1,206 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#include "ork/scenegraph/InstanceLayout.h"
+
+#include <set>
+
+#include <GL/glew.h>
+
+#include "ork/core/Logger.h"
+#include "ork/render/FrameBuffer.h"
+#include "ork/scenegraph/SceneNode.h"
+
+using namespace std;
+
+namespace ork
+{
+
+/**
+ * Copies a row major matrix into a column major attribute, padding it with
+ * zeros if it is smaller than the attribute.
+ *
+ * @param m the matrix coefficients, in row major order.
+ * @param mrows the number of rows of m.
+ * @param mcols the number of columns of m.
+ * @param rows the number of rows of the attribute.
+ * @param cols the number of columns of the attribute.
+ * @param[out] data the attribute data.
+ */
+template<typename T>
+static void copyInstanceData(const T *m, int mrows, int mcols, int rows, int cols, float *data)
+{
+    for (int c = 0; c < cols; ++c) {
+        for (int r = 0; r < rows; ++r) {
+            *(data++) = r < mrows && c < mcols ? float(m[r * mcols + c]) : 0.0f;
+        }
+    }
+}
+
+InstanceLayout::InstanceLayout(ptr<Program> p, ptr<MeshBuffers> m) :
+    Object("InstanceLayout"), programVersion(p->getUniformsVersion()), stride(0)
+{
+    set<int> used;
+    for (int i = 0; i < m->getAttributeCount(); ++i) {
+        used.insert(m->getAttributeBuffer(i)->getIndex());
+    }
+    GLint count = 0;
+    glGetProgramiv(p->getId(), GL_ACTIVE_ATTRIBUTES, &count);
+    for (GLint i = 0; i < count; ++i) {
+        char name[256];
+        GLint size;
+        GLenum type;
+        glGetActiveAttrib(p->getId(), i, 256, NULL, &size, &type, name);
+        Attribute a;
+        a.name = name;
+        a.location = glGetAttribLocation(p->getId(), name);
+        if (a.location < 0 || used.find(a.location) != used.end()) {
+            continue;
+        }
+        switch (type) {
+        case GL_FLOAT:
+            a.columns = 1;
+            a.rows = 1;
+            break;
+        case GL_FLOAT_VEC2:
+            a.columns = 1;
+            a.rows = 2;
+            break;
+        case GL_FLOAT_VEC3:
+            a.columns = 1;
+            a.rows = 3;
+            break;
+        case GL_FLOAT_VEC4:
+            a.columns = 1;
+            a.rows = 4;
+            break;
+        case GL_FLOAT_MAT3:
+            a.columns = 3;
+            a.rows = 3;
+            break;
+        case GL_FLOAT_MAT4:
+            a.columns = 4;
+            a.rows = 4;
+            break;
+        default:
+            if (Logger::ERROR_LOGGER != NULL) {
+                Logger::ERROR_LOGGER->log("SCENEGRAPH", "Unsupported instance attribute type for '" + a.name + "'");
+            }
+            continue;
+        }
+        attributes.push_back(a);
+        stride += a.columns * a.rows;
+    }
+    assert(FrameBuffer::getError() == 0);
+}
+
+InstanceLayout::~InstanceLayout()
+{
+}
+
+bool InstanceLayout::isValid(ptr<Program> p) const
+{
+    return p->getUniformsVersion() == programVersion;
+}
+
+int InstanceLayout::getStride() const
+{
+    return stride;
+}
+
+int InstanceLayout::getLocationCount() const
+{
+    int n = 0;
+    for (unsigned int i = 0; i < attributes.size(); ++i) {
+        n += attributes[i].columns;
+    }
+    return n;
+}
+
+void InstanceLayout::addAttributeBuffers(ptr<MeshBuffers> m, ptr<Buffer> b, int offset) const
+{
+    for (unsigned int i = 0; i < attributes.size(); ++i) {
+        const Attribute &a = attributes[i];
+        for (int c = 0; c < a.columns; ++c) {
+            m->addAttributeBuffer(new AttributeBuffer(a.location + c, a.rows, A32F, false,
+                b, stride * sizeof(float), offset, 1));
+            offset += a.rows * sizeof(float);
+        }
+    }
+}
+
+void InstanceLayout::getData(ptr<SceneNode> n, float *data) const
+{
+    float zero = 0.0f;
+    for (unsigned int i = 0; i < attributes.size(); ++i) {
+        const Attribute &a = attributes[i];
+        if (a.name == "localToWorld" || a.name == "localToScreen") {
+            mat4d t = a.name == "localToWorld" ? n->getLocalToWorld() : n->getLocalToScreen();
+            copyInstanceData(t.coefficients(), 4, 4, a.rows, a.columns, data);
+        } else {
+            ptr<Value> v = n->getValue(a.name);
+            if (v == NULL) {
+                copyInstanceData(&zero, 0, 0, a.rows, a.columns, data);
+            } else if (v->getType() == VEC1F) {
+                float f = v.cast<Value1f>()->get();
+                copyInstanceData(&f, 1, 1, a.rows, a.columns, data);
+            } else if (v->getType() == VEC2F) {
+                vec2f f = v.cast<Value2f>()->get();
+                copyInstanceData(&f.x, 2, 1, a.rows, a.columns, data);
+            } else if (v->getType() == VEC3F) {
+                vec3f f = v.cast<Value3f>()->get();
+                copyInstanceData(&f.x, 3, 1, a.rows, a.columns, data);
+            } else if (v->getType() == VEC4F) {
+                vec4f f = v.cast<Value4f>()->get();
+                copyInstanceData(&f.x, 4, 1, a.rows, a.columns, data);
+            } else if (v->getType() == MAT3F) {
+                copyInstanceData(v.cast<ValueMatrix3f>()->get(), 3, 3, a.rows, a.columns, data);
+            } else if (v->getType() == MAT4F) {
+                copyInstanceData(v.cast<ValueMatrix4f>()->get(), 4, 4, a.rows, a.columns, data);
+            } else {
+                copyInstanceData(&zero, 0, 0, a.rows, a.columns, data);
+            }
+        }
+        data += a.rows * a.columns;
+    }
+}
+
+}
@@ -0,0 +1,171 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#ifndef _ORK_INSTANCE_LAYOUT_H_
+#define _ORK_INSTANCE_LAYOUT_H_
+
+#include <vector>
+
+#include "ork/render/MeshBuffers.h"
+#include "ork/render/Program.h"
+
+namespace ork
+{
+
+class SceneNode;
+
+/**
+ * The per instance vertex attributes read by a program to draw a mesh with
+ * instancing. These are the active attributes of the program that are not
+ * provided by the mesh itself. An attribute named "localToWorld" or
+ * "localToScreen" receives the corresponding transformation of each scene
+ * node (see SceneNode), and any other attribute receives the value of the
+ * same name of each scene node (see SceneNode#getValue), or 0 if there is no
+ * such value. Only float, vec2, vec3, vec4, mat3 and mat4 attributes are
+ * supported. The per instance data of all the instances is stored in a
+ * single buffer, with one float per component.
+ *
+ * @ingroup scenegraph
+ */
+class ORK_API InstanceLayout : public Object
+{
+public:
+    /**
+     * Creates a new InstanceLayout.
+     *
+     * @param p a program.
+     * @param m a mesh drawn with this program.
+     */
+    InstanceLayout(ptr<Program> p, ptr<MeshBuffers> m);
+
+    /**
+     * Deletes this InstanceLayout.
+     */
+    virtual ~InstanceLayout();
+
+    /**
+     * Returns true if this layout is valid for the given program, i.e., if
+     * it was created for this program, and if this program has not been
+     * updated since then.
+     *
+     * @param p a program.
+     */
+    bool isValid(ptr<Program> p) const;
+
+    /**
+     * Returns the number of floats per instance.
+     */
+    int getStride() const;
+
+    /**
+     * Returns the number of attribute locations used by the per instance
+     * attributes.
+     */
+    int getLocationCount() const;
+
+    /**
+     * Adds the per instance attributes to the given mesh.
+     *
+     * @param m a mesh.
+     * @param b the buffer that contains the per instance data.
+     * @param offset the offset of the per instance data in b, in bytes.
+     */
+    void addAttributeBuffers(ptr<MeshBuffers> m, ptr<Buffer> b, int offset = 0) const;
+
+    /**
+     * Writes the per instance data of the given scene node.
+     *
+     * @param n a scene node.
+     * @param[out] data where the #getStride floats of this scene node must
+     *      be written.
+     */
+    void getData(ptr<SceneNode> n, float *data) const;
+
+private:
+    /**
+     * A per instance vertex attribute.
+     */
+    struct Attribute
+    {
+        /**
+         * The name of this attribute in the program.
+         */
+        std::string name;
+
+        /**
+         * The location of this attribute in the program.
+         */
+        int location;
+
+        /**
+         * The number of columns of this attribute (1 for vectors). Each
+         * column uses one attribute location.
+         */
+        int columns;
+
+        /**
+         * The number of rows of this attribute (i.e. of components per
+         * column).
+         */
+        int rows;
+    };
+
+    /**
+     * The version of the program of this layout when it was created (see
+     * Program#getUniformsVersion). The program itself is not kept, so that
+     * a cached layout does not keep it alive.
+     */
+    unsigned int programVersion;
+
+    /**
+     * The per instance attributes.
+     */
+    std::vector<Attribute> attributes;
+
+    /**
+     * The number of floats per instance.
+     */
+    int stride;
+};
+
+}
+
+#endif
@@ -0,0 +1,189 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#include "ork/scenegraph/LodMesh.h"
+
+#include "ork/resource/ResourceTemplate.h"
+
+using namespace std;
+
+namespace ork
+{
+
+LodMesh::LodMesh(float hysteresis) :
+    Object("LodMesh"), hysteresis(hysteresis)
+{
+}
+
+LodMesh::~LodMesh()
+{
+}
+
+float LodMesh::getHysteresis()
+{
+    return hysteresis;
+}
+
+void LodMesh::setHysteresis(float hysteresis)
+{
+    this->hysteresis = hysteresis;
+}
+
+int LodMesh::getLevelCount()
+{
+    return (int) levels.size();
+}
+
+ptr<MeshBuffers> LodMesh::getMesh(int level)
+{
+    return levels[level].mesh;
+}
+
+float LodMesh::getScreenSize(int level)
+{
+    return levels[level].screenSize;
+}
+
+int LodMesh::getTriangleCount(int level)
+{
+    ptr<MeshBuffers> m = levels[level].mesh;
+    int n = m->nindices == 0 ? m->nvertices : m->nindices;
+    switch (m->mode) {
+    case TRIANGLES:
+        return n / 3;
+    case TRIANGLE_STRIP:
+    case TRIANGLE_FAN:
+        return max(n - 2, 0);
+    case TRIANGLES_ADJACENCY:
+        return n / 6;
+    case TRIANGLE_STRIP_ADJACENCY:
+        return max(n - 4, 0) / 2;
+    case PATCHES:
+        return m->patchVertices > 0 ? n / m->patchVertices : 0;
+    default:
+        return 0;
+    }
+}
+
+void LodMesh::addLevel(ptr<MeshBuffers> mesh, float screenSize)
+{
+    assert(levels.empty() || screenSize <= levels.back().screenSize);
+    Level l;
+    l.mesh = mesh;
+    l.screenSize = screenSize;
+    levels.push_back(l);
+}
+
+int LodMesh::selectLevel(float screenSize, int current)
+{
+    int last = (int) levels.size() - 1;
+    int level = min(max(current, 0), last);
+    // switches to a finer level only if the screen size is clearly above its
+    // threshold, and to a coarser level only if the screen size is clearly
+    // below the threshold of the current level
+    while (level > 0 && screenSize >= levels[level - 1].screenSize * (1.0f + hysteresis)) {
+        --level;
+    }
+    while (level < last && screenSize < levels[level].screenSize * (1.0f - hysteresis)) {
+        ++level;
+    }
+    return level;
+}
+
+void LodMesh::swap(ptr<LodMesh> l)
+{
+    std::swap(levels, l->levels);
+    std::swap(hysteresis, l->hysteresis);
+}
+
+/// @cond RESOURCES
+
+class LodMeshResource : public ResourceTemplate<10, LodMesh>
+{
+public:
+    LodMeshResource(ptr<ResourceManager> manager, const string &name, ptr<ResourceDescriptor> desc, const TiXmlElement *e = NULL) :
+        ResourceTemplate<10, LodMesh>(manager, name, desc)
+    {
+        e = e == NULL ? desc->descriptor : e;
+        checkParameters(desc, e, "name,hysteresis,");
+        float h = 0.1f;
+        getFloatParameter(desc, e, "hysteresis", &h);
+        setHysteresis(h);
+        const TiXmlNode *n = e->FirstChild();
+        while (n != NULL) {
+            const TiXmlElement *f = n->ToElement();
+            if (f != NULL) {
+                if (strcmp(f->Value(), "level") != 0) {
+                    if (Logger::ERROR_LOGGER != NULL) {
+                        log(Logger::ERROR_LOGGER, desc, f, "Invalid subelement '" + f->ValueStr() + "'");
+                    }
+                    throw exception();
+                }
+                checkParameters(desc, f, "mesh,size,");
+                float size = 0.0f;
+                getFloatParameter(desc, f, "size", &size);
+                ptr<MeshBuffers> mesh = manager->loadResource(getParameter(desc, f, "mesh")).cast<MeshBuffers>();
+                if (getLevelCount() > 0 && size > getScreenSize(getLevelCount() - 1)) {
+                    if (Logger::ERROR_LOGGER != NULL) {
+                        log(Logger::ERROR_LOGGER, desc, f, "Levels must be sorted by decreasing screen size");
+                    }
+                    throw exception();
+                }
+                addLevel(mesh, size);
+            }
+            n = n->NextSibling();
+        }
+        if (getLevelCount() == 0) {
+            if (Logger::ERROR_LOGGER != NULL) {
+                log(Logger::ERROR_LOGGER, desc, e, "Missing level subelement");
+            }
+            throw exception();
+        }
+    }
+};
+
+extern const char lodMesh[] = "lodMesh";
+
+static ResourceFactory::Type<lodMesh, LodMeshResource> LodMeshType;
+
+/// @endcond
+
+}
@@ -0,0 +1,178 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#ifndef _ORK_LOD_MESH_H_
+#define _ORK_LOD_MESH_H_
+
+#include <vector>
+
+#include "ork/render/MeshBuffers.h"
+
+namespace ork
+{
+
+/**
+ * A set of meshes representing the same object at several levels of detail.
+ * Each level is associated with a minimum screen size, and levels are sorted
+ * from the finest to the coarsest one. The screen size of an object is the
+ * ratio between the projected diameter of its bounding sphere and the height
+ * of the viewport. Level i is used when this size is larger than the screen
+ * size of level i, and smaller than the screen size of level i-1.
+ *
+ * A LodMesh does not store the level currently used: several SceneNode can
+ * share the same LodMesh, and the SceneManager keeps the current level of
+ * each node (see SceneNode#addLod). In order to avoid level popping when an
+ * object stays near a threshold, a relative hysteresis margin is used: a
+ * finer level is selected when the screen size exceeds its threshold by this
+ * margin, and a coarser level is selected when the screen size falls below
+ * the threshold of the current level by this margin.
+ *
+ * @ingroup scenegraph
+ */
+class ORK_API LodMesh : public Object
+{
+public:
+    /**
+     * Creates a new LodMesh without any level.
+     *
+     * @param hysteresis the relative hysteresis margin used to switch
+     *      between levels.
+     */
+    LodMesh(float hysteresis = 0.1f);
+
+    /**
+     * Deletes this LodMesh.
+     */
+    virtual ~LodMesh();
+
+    /**
+     * Returns the relative hysteresis margin used to switch between levels.
+     */
+    float getHysteresis();
+
+    /**
+     * Sets the relative hysteresis margin used to switch between levels.
+     *
+     * @param hysteresis a relative margin, e.g. 0.1 for 10%.
+     */
+    void setHysteresis(float hysteresis);
+
+    /**
+     * Returns the number of levels of this LodMesh.
+     */
+    int getLevelCount();
+
+    /**
+     * Returns the mesh of the given level.
+     *
+     * @param level a level index, 0 being the finest level.
+     */
+    ptr<MeshBuffers> getMesh(int level);
+
+    /**
+     * Returns the minimum screen size of the given level.
+     *
+     * @param level a level index, 0 being the finest level.
+     */
+    float getScreenSize(int level);
+
+    /**
+     * Returns the number of triangles of the given level.
+     *
+     * @param level a level index, 0 being the finest level.
+     */
+    int getTriangleCount(int level);
+
+    /**
+     * Adds a coarser level to this LodMesh.
+     *
+     * @param mesh the mesh of this level.
+     * @param screenSize the minimum screen size of this level. It must be
+     *      smaller than the screen size of the previous levels.
+     */
+    void addLevel(ptr<MeshBuffers> mesh, float screenSize);
+
+    /**
+     * Returns the level that must be used for the given screen size.
+     *
+     * @param screenSize the screen size of an object using this LodMesh.
+     * @param current the level used for this object at the previous frame,
+     *      used to apply the hysteresis margin.
+     */
+    int selectLevel(float screenSize, int current);
+
+protected:
+    /**
+     * Swaps this LodMesh with the given one.
+     */
+    void swap(ptr<LodMesh> l);
+
+private:
+    /**
+     * A level of a LodMesh.
+     */
+    struct Level
+    {
+        /**
+         * The mesh of this level.
+         */
+        ptr<MeshBuffers> mesh;
+
+        /**
+         * The minimum screen size of this level.
+         */
+        float screenSize;
+    };
+
+    /**
+     * The levels of this LodMesh, from the finest to the coarsest.
+     */
+    std::vector<Level> levels;
+
+    /**
+     * The relative hysteresis margin used to switch between levels.
+     */
+    float hysteresis;
+};
+
+}
+
+#endif
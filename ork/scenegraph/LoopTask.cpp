@@ -43,6 +43,8 @@
 
 #include "ork/resource/ResourceTemplate.h"
 #include "ork/taskgraph/TaskGraph.h"
+#include "ork/scenegraph/RecordTask.h"
+#include "ork/scenegraph/RenderQueue.h"
 #include "ork/scenegraph/SceneManager.h"
 #include "ork/scenegraph/SequenceTask.h"
 
@@ -55,19 +57,26 @@ LoopTask::LoopTask() : AbstractTask("LoopTask")
 {
 }
 
-LoopTask::LoopTask(const string &var, const string &flag, bool cull, bool parallel, ptr<TaskFactory> subtask) :
+LoopTask::LoopTask(const string &var, const string &flag, bool cull, bool parallel, ptr<TaskFactory> subtask, bool queue, bool instancing, bool batch, bool record) :
     AbstractTask("LoopTask")
 {
-    init(var, flag, cull, parallel, subtask);
+    init(var, flag, cull, parallel, subtask, queue, instancing, batch, record);
 }
 
-void LoopTask::init(const string &var, const string &flag, bool cull, bool parallel, ptr<TaskFactory> subtask)
+void LoopTask::init(const string &var, const string &flag, bool cull, bool parallel, ptr<TaskFactory> subtask, bool queue, bool instancing, bool batch, bool record)
 {
     this->var = var;
     this->flag = flag;
+    this->flagId = SceneNode::getFlagId(flag);
     this->cull = cull;
     this->parallel = parallel;
     this->subtask = subtask;
+    this->queue = queue;
+    this->instancing = instancing;
+    this->batch = batch;
+    this->record = record;
+    this->usedCommandLists = 0;
+    this->commandListsFrame = 0;
 }
 
 LoopTask::~LoopTask()
@@ -79,12 +88,74 @@ ptr<Task> LoopTask::getTask(ptr<Object> context)
     ptr<SceneManager> manager = context.cast<Method>()->getOwner()->getOwner();
 
     vector< ptr<SceneNode> > nodes;
-    SceneManager::NodeIterator i = manager->getNodes(flag);
-    while (i.hasNext()) {
-        ptr<SceneNode> n = i.next();
-        if (!cull || n->isVisible) {
-            nodes.push_back(n);
+    if (cull) {
+        manager->getVisibleNodes(flagId, nodes);
+    } else {
+        SceneManager::NodeIterator i = manager->getNodes(flagId);
+        while (i.hasNext()) {
+            nodes.push_back(i.next());
+        }
+    }
+
+    // nested loops do not use the render queue, their tasks are recorded
+    // as part of the task of the enclosing loop
+    if ((queue || instancing || batch) && RenderQueue::getCurrent() == NULL) {
+        ptr<RenderQueue> q = manager->getRenderQueue();
+        for (unsigned int i = 0; i < nodes.size(); ++i) {
+            manager->setNodeVar(var, nodes[i]);
+            q->begin(nodes[i]);
+            try {
+                ptr<Task> next = subtask->getTask(context);
+                if (next.cast<TaskGraph>() == NULL || !next.cast<TaskGraph>()->isEmpty()) {
+                    q->end(next);
+                } else {
+                    q->end(NULL);
+                }
+            } catch (...) {
+                q->end(NULL);
+            }
         }
+        return q->submit(instancing, batch ? manager->getBatchRenderer() : NULL, parallel);
+    }
+
+    // the tasks of the scene nodes are recorded in chunks of at most
+    // RECORD_CHUNK_SIZE nodes, by independent CPU tasks, and replayed in
+    // sequence by a single GPU task
+    if (record && nodes.size() > 1) {
+        ptr<TaskGraph> result = new TaskGraph();
+        ptr<ReplayTask> replay = new ReplayTask();
+        ptr<RecordTask> r = NULL;
+        unsigned int recorded = 0;
+        // the lists used by the previous frames can be reused, but not
+        // those used by a previous expansion of this task in this frame,
+        // whose RecordTask may be executed at the same time as ours
+        if (commandListsFrame != manager->getFrameNumber()) {
+            commandListsFrame = manager->getFrameNumber();
+            usedCommandLists = 0;
+        }
+        result->addTask(replay);
+        for (unsigned int i = 0; i < nodes.size(); ++i) {
+            manager->setNodeVar(var, nodes[i]);
+            try {
+                ptr<Task> next = subtask->getTask(context);
+                if (next.cast<TaskGraph>() == NULL || !next.cast<TaskGraph>()->isEmpty()) {
+                    if (r == NULL || recorded == RECORD_CHUNK_SIZE) {
+                        if (usedCommandLists == commandLists.size()) {
+                            commandLists.push_back(new CommandList());
+                        }
+                        r = new RecordTask(commandLists[usedCommandLists++]);
+                        result->addTask(r);
+                        result->addDependency(replay, r);
+                        replay->addTask(r);
+                        recorded = 0;
+                    }
+                    r->addTask(next);
+                    ++recorded;
+                }
+            } catch (...) {
+            }
+        }
+        return result;
     }
 
     if (nodes.size() == 1) {
@@ -115,7 +186,13 @@ void LoopTask::swap(ptr<LoopTask> t)
 {
     std::swap(var, t->var);
     std::swap(flag, t->flag);
+    std::swap(flagId, t->flagId);
     std::swap(cull, t->cull);
+    std::swap(parallel, t->parallel);
+    std::swap(queue, t->queue);
+    std::swap(instancing, t->instancing);
+    std::swap(batch, t->batch);
+    std::swap(record, t->record);
     std::swap(subtask, t->subtask);
 }
 
@@ -128,17 +205,33 @@ public:
         ResourceTemplate<40, LoopTask>(manager, name, desc)
     {
         e = e == NULL ? desc->descriptor : e;
-        checkParameters(desc, e, "var,flag,culling,parallel,");
+        checkParameters(desc, e, "var,flag,culling,parallel,queue,instancing,batch,record,");
         string var = getParameter(desc, e, "var");
         string flag = getParameter(desc, e, "flag");
         bool cull = false;
         bool parallel = false;
+        bool queue = false;
+        bool instancing = false;
+        bool batch = false;
+        bool record = false;
         if (e->Attribute("culling") != NULL && strcmp(e->Attribute("culling"), "true") == 0) {
             cull = true;
         }
         if (e->Attribute("parallel") != NULL && strcmp(e->Attribute("parallel"), "true") == 0) {
             parallel = true;
         }
+        if (e->Attribute("queue") != NULL && strcmp(e->Attribute("queue"), "true") == 0) {
+            queue = true;
+        }
+        if (e->Attribute("instancing") != NULL && strcmp(e->Attribute("instancing"), "true") == 0) {
+            instancing = true;
+        }
+        if (e->Attribute("batch") != NULL && strcmp(e->Attribute("batch"), "true") == 0) {
+            batch = true;
+        }
+        if (e->Attribute("record") != NULL && strcmp(e->Attribute("record"), "true") == 0) {
+            record = true;
+        }
         vector< ptr<TaskFactory> > subtasks;
         const TiXmlNode *n = e->FirstChild();
         while (n != NULL) {
@@ -151,9 +244,9 @@ public:
             n = n->NextSibling();
         }
         if (subtasks.size() == 1) {
-            init(var, flag, cull, parallel, subtasks[0]);
+            init(var, flag, cull, parallel, subtasks[0], queue, instancing, batch, record);
         } else {
-            init(var, flag, cull, parallel, new SequenceTask(subtasks));
+            init(var, flag, cull, parallel, new SequenceTask(subtasks), queue, instancing, batch, record);
         }
     }
 };
@@ -42,6 +42,7 @@
 #ifndef _ORK_LOOP_TASK_H_
 #define _ORK_LOOP_TASK_H_
 
+#include "ork/render/CommandList.h"
 #include "ork/scenegraph/AbstractTask.h"
 
 namespace ork
@@ -63,8 +64,21 @@ public:
      * @param cull true to apply the loop only on the visible scene nodes.
      * @param parallel true the apply the loop to all scene nodes in parallel.
      * @param subtask the task that must be executed on each SceneNode.
+     * @param queue true to execute the tasks of the scene nodes in the order
+     *      that minimizes state changes (see RenderQueue). If parallel is
+     *      true, the tasks are sorted but have no dependencies between them.
+     * @param instancing true to also merge the tasks of the scene nodes that
+     *      draw the same mesh with the same states into instanced draws
+     *      (see RenderQueue). Implies queue.
+     * @param batch true to also merge the tasks of the scene nodes that draw
+     *      different meshes with the same states into multi draws, using
+     *      the BatchRenderer of the SceneManager (see RenderQueue). Implies
+     *      queue.
+     * @param record true to record the tasks of the scene nodes in command
+     *      lists, in parallel, and to replay them in sequence (see
+     *      RecordTask). Ignored if queue is true.
      */
-    LoopTask(const std::string &var, const std::string &flag, bool cull, bool parallel, ptr<TaskFactory> subtask);
+    LoopTask(const std::string &var, const std::string &flag, bool cull, bool parallel, ptr<TaskFactory> subtask, bool queue = false, bool instancing = false, bool batch = false, bool record = false);
 
     /**
      * Deletes this LoopTask.
@@ -88,8 +102,21 @@ protected:
      * @param cull true to apply the loop only on the visible scene nodes.
      * @param parallel true the apply the loop to all scene nodes in parallel.
      * @param subtask the task that must be executed on each SceneNode.
+     * @param queue true to execute the tasks of the scene nodes in the order
+     *      that minimizes state changes (see RenderQueue). If parallel is
+     *      true, the tasks are sorted but have no dependencies between them.
+     * @param instancing true to also merge the tasks of the scene nodes that
+     *      draw the same mesh with the same states into instanced draws
+     *      (see RenderQueue). Implies queue.
+     * @param batch true to also merge the tasks of the scene nodes that draw
+     *      different meshes with the same states into multi draws, using
+     *      the BatchRenderer of the SceneManager (see RenderQueue). Implies
+     *      queue.
+     * @param record true to record the tasks of the scene nodes in command
+     *      lists, in parallel, and to replay them in sequence (see
+     *      RecordTask). Ignored if queue is true.
      */
-    void init(const std::string &var, const std::string &flag, bool cull, bool parallel, ptr<TaskFactory> subtask);
+    void init(const std::string &var, const std::string &flag, bool cull, bool parallel, ptr<TaskFactory> subtask, bool queue = false, bool instancing = false, bool batch = false, bool record = false);
 
     /**
      * Swaps this LoopTask with the given one.
@@ -109,6 +136,11 @@ private:
      */
     std::string flag;
 
+    /**
+     * The identifier of #flag (see SceneNode#getFlagId).
+     */
+    unsigned int flagId;
+
     /**
      * True to apply the loop to all scene nodes in parallel.
      */
@@ -119,10 +151,60 @@ private:
      */
     bool cull;
 
+    /**
+     * True to execute the tasks of the scene nodes in the order that
+     * minimizes state changes, using the RenderQueue of the SceneManager.
+     * The tasks are then executed sequentially, unless #parallel is true.
+     */
+    bool queue;
+
+    /**
+     * True to merge the tasks of the scene nodes that draw the same mesh with
+     * the same states into instanced draws, using the RenderQueue of the
+     * SceneManager.
+     */
+    bool instancing;
+
+    /**
+     * True to merge the tasks of the scene nodes that draw different meshes
+     * with the same states into multi draws, using the BatchRenderer of the
+     * SceneManager.
+     */
+    bool batch;
+
+    /**
+     * True to record the tasks of the scene nodes in command lists, with
+     * RecordTask executed in parallel, and to replay these lists in sequence
+     * with a ReplayTask.
+     */
+    bool record;
+
     /**
      * The task that must be executed on each scene node.
      */
     ptr<TaskFactory> subtask;
+
+    /**
+     * The command lists used in #record mode, reused from frame to frame.
+     * A list is used by at most one RecordTask per frame, even if this task
+     * is expanded several times in the same frame.
+     */
+    std::vector< ptr<CommandList> > commandLists;
+
+    /**
+     * The number of #commandLists used during the frame #commandListsFrame.
+     */
+    unsigned int usedCommandLists;
+
+    /**
+     * The frame number during which #usedCommandLists lists were used.
+     */
+    unsigned int commandListsFrame;
+
+    /**
+     * The maximum number of scene nodes recorded by each RecordTask.
+     */
+    static const unsigned int RECORD_CHUNK_SIZE = 16;
 };
 
 }
@@ -0,0 +1,428 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#include "ork/scenegraph/OcclusionCuller.h"
+
+#include "pmath.h"
+#include <algorithm>
+
+#include "ork/scenegraph/SceneNode.h"
+#include "ork/taskgraph/ParallelForTask.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ORK_OCCLUSION_SSE
+#endif
+
+using namespace std;
+
+namespace ork
+{
+
+/**
+ * The indices of the 6 faces of a box, whose corners are numbered with bit 0
+ * for x, bit 1 for y and bit 2 for z. The vertices of each face are given in
+ * cyclic order.
+ */
+static const int BOX_FACES[24] = {
+    0, 1, 3, 2, // zmin
+    4, 6, 7, 5, // zmax
+    0, 4, 5, 1, // ymin
+    2, 3, 7, 6, // ymax
+    0, 2, 6, 4, // xmin
+    1, 5, 7, 3  // xmax
+};
+
+/**
+ * Minimum w clip coordinate of a vertex in front of the camera.
+ */
+static const double MIN_W = 1e-5;
+
+/**
+ * Number of rows of the depth buffer rasterized by each iteration of a
+ * RasterizeTask.
+ */
+static const int BAND_HEIGHT = 8;
+
+class OcclusionCuller::RasterizeTask : public ParallelForTask
+{
+public:
+    OcclusionCuller *culler;
+
+    RasterizeTask(OcclusionCuller *culler) :
+        ParallelForTask("OcclusionRasterizeTask", (culler->height + BAND_HEIGHT - 1) / BAND_HEIGHT), culler(culler)
+    {
+    }
+
+protected:
+    virtual bool run(int begin, int end)
+    {
+        culler->rasterize(begin * BAND_HEIGHT, min(end * BAND_HEIGHT, culler->height));
+        return true;
+    }
+};
+
+class OcclusionCuller::TestTask : public ParallelForTask
+{
+public:
+    OcclusionCuller *culler;
+
+    TestTask(OcclusionCuller *culler) :
+        ParallelForTask("OcclusionTestTask", int(culler->nodes->size())), culler(culler)
+    {
+    }
+
+protected:
+    virtual bool run(int begin, int end)
+    {
+        for (int i = begin; i < end; ++i) {
+            culler->results[i] = culler->isOccluded((*culler->nodes)[i]->getWorldBounds()) ? 1 : 0;
+        }
+        return true;
+    }
+};
+
+OcclusionCuller::OcclusionCuller() : Object("OcclusionCuller")
+{
+}
+
+OcclusionCuller::OcclusionCuller(const string &occluderFlag, int width, int height) :
+    Object("OcclusionCuller")
+{
+    init(occluderFlag, width, height);
+}
+
+void OcclusionCuller::init(const string &occluderFlag, int width, int height)
+{
+    this->occluderFlag = occluderFlag;
+    this->occluderFlagId = SceneNode::getFlagId(occluderFlag);
+    this->width = (max(width, 4) + 3) & ~3;
+    this->height = max(height, 1);
+    this->nodes = NULL;
+    this->occluderCount = 0;
+    this->testedCount = 0;
+    this->occludedCount = 0;
+
+    int size = 0;
+    int w = this->width;
+    int h = this->height;
+    while (true) {
+        levelOffsets.push_back(size);
+        levelWidths.push_back(w);
+        levelHeights.push_back(h);
+        size += w * h;
+        if (w == 1 && h == 1) {
+            break;
+        }
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+    }
+    depths.resize(size);
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+}
+
+string OcclusionCuller::getOccluderFlag()
+{
+    return occluderFlag;
+}
+
+unsigned int OcclusionCuller::getOccluderFlagId()
+{
+    return occluderFlagId;
+}
+
+int OcclusionCuller::getOccluderCount()
+{
+    return occluderCount;
+}
+
+int OcclusionCuller::getTestedCount()
+{
+    return testedCount;
+}
+
+int OcclusionCuller::getOccludedCount()
+{
+    return occludedCount;
+}
+
+void OcclusionCuller::cull(const mat4d &worldToScreen, const vector<SceneNode*> &occluders,
+    const vector<SceneNode*> &nodes, vector<SceneNode*> &occluded, ptr<Scheduler> scheduler)
+{
+    this->worldToScreen = worldToScreen;
+    this->nodes = &nodes;
+    quads.clear();
+    occluderCount = 0;
+    testedCount = (int) nodes.size();
+    occludedCount = 0;
+    for (unsigned int i = 0; i < occluders.size(); ++i) {
+        if (addOccluder(occluders[i])) {
+            ++occluderCount;
+        }
+    }
+    if (quads.empty() || nodes.empty()) {
+        this->nodes = NULL;
+        return;
+    }
+
+    fill(depths.begin(), depths.begin() + width * height, 1.0f);
+    execute(new RasterizeTask(this), scheduler);
+    buildPyramid();
+
+    results.assign(nodes.size(), 0);
+    execute(new TestTask(this), scheduler);
+    for (unsigned int i = 0; i < nodes.size(); ++i) {
+        if (results[i] != 0) {
+            occluded.push_back(nodes[i]);
+            ++occludedCount;
+        }
+    }
+    this->nodes = NULL;
+}
+
+bool OcclusionCuller::addOccluder(SceneNode *occluder)
+{
+    box3d b = occluder->getLocalBounds();
+    if (b.xmin > b.xmax || b.ymin > b.ymax || b.zmin > b.zmax) {
+        return false;
+    }
+    mat4d localToScreen = occluder->getLocalToScreen();
+    float x[8], y[8], z[8];
+    for (int i = 0; i < 8; ++i) {
+        vec4d p = localToScreen * vec4d(i & 1 ? b.xmax : b.xmin, i & 2 ? b.ymax : b.ymin, i & 4 ? b.zmax : b.zmin, 1.0);
+        if (p.w < MIN_W) {
+            return false;
+        }
+        x[i] = float((p.x / p.w * 0.5 + 0.5) * width);
+        y[i] = float((p.y / p.w * 0.5 + 0.5) * height);
+        z[i] = float(p.z / p.w * 0.5 + 0.5);
+    }
+    for (int i = 0; i < 24; i += 4) {
+        Quad q;
+        for (int j = 0; j < 4; ++j) {
+            int k = BOX_FACES[i + j];
+            q.x[j] = x[k];
+            q.y[j] = y[k];
+            q.z[j] = z[k];
+        }
+        quads.push_back(q);
+    }
+    return true;
+}
+
+void OcclusionCuller::execute(ptr<Task> task, ptr<Scheduler> scheduler)
+{
+    if (scheduler != NULL) {
+        scheduler->execute(task);
+    } else {
+        task->run();
+    }
+}
+
+void OcclusionCuller::rasterize(int ymin, int ymax)
+{
+    for (unsigned int i = 0; i < quads.size(); ++i) {
+        const Quad &q = quads[i];
+        float area = 0.0f;
+        for (int j = 0; j < 4; ++j) {
+            area += q.x[j] * q.y[(j + 1) & 3] - q.x[(j + 1) & 3] * q.y[j];
+        }
+        if (fabs(area) < 2.0f) {
+            // a quad smaller than one pixel cannot cover a pixel completely
+            continue;
+        }
+        // makes the quad counter clockwise
+        float x[4], y[4], z[4];
+        for (int j = 0; j < 4; ++j) {
+            int k = area > 0.0f ? j : 3 - j;
+            x[j] = q.x[k];
+            y[j] = q.y[k];
+            z[j] = q.z[k];
+        }
+
+        // depth plane z = az * x + bz * y + cz, computed from the largest of
+        // the two triangles 012 and 023 of the (planar) quad
+        float area012 = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        float area023 = (x[2] - x[0]) * (y[3] - y[0]) - (x[3] - x[0]) * (y[2] - y[0]);
+        int i1 = area012 >= area023 ? 1 : 2;
+        int i2 = i1 + 1;
+        float ta = max(area012, area023);
+        float az = ((z[i1] - z[0]) * (y[i2] - y[0]) - (z[i2] - z[0]) * (y[i1] - y[0])) / ta;
+        float bz = ((z[i2] - z[0]) * (x[i1] - x[0]) - (z[i1] - z[0]) * (x[i2] - x[0])) / ta;
+        float cz = z[0] - az * x[0] - bz * y[0];
+        // the maximum depth over a pixel, relatively to its center, and the
+        // maximum depth of the quad
+        cz += 0.5f * (fabs(az) + fabs(bz));
+        float zmax = max(max(z[0], z[1]), max(z[2], z[3]));
+
+        // edge functions e = a * x + b * y + c, positive inside the quad; c
+        // is offset so that e is positive at a pixel center only if the
+        // whole pixel is inside the quad
+        float a[4], b[4], c[4];
+        for (int j = 0; j < 4; ++j) {
+            int k = (j + 1) & 3;
+            a[j] = y[j] - y[k];
+            b[j] = x[k] - x[j];
+            c[j] = x[j] * y[k] - y[j] * x[k] - 0.5f * (fabs(a[j]) + fabs(b[j]));
+        }
+
+        int xa = max(int(floor(min(min(x[0], x[1]), min(x[2], x[3])))), 0);
+        int xb = min(int(ceil(max(max(x[0], x[1]), max(x[2], x[3])))), width - 1);
+        int ya = max(int(floor(min(min(y[0], y[1]), min(y[2], y[3])))), ymin);
+        int yb = min(int(ceil(max(max(y[0], y[1]), max(y[2], y[3])))), ymax - 1);
+        if (xa > xb || ya > yb) {
+            continue;
+        }
+
+        xa = xa & ~3;
+        for (int py = ya; py <= yb; ++py) {
+            float cy = py + 0.5f;
+            float r[4];
+            for (int j = 0; j < 4; ++j) {
+                r[j] = b[j] * cy + c[j];
+            }
+            float rz = bz * cy + cz;
+            float *row = &depths[py * width];
+#ifdef ORK_OCCLUSION_SSE
+            __m128 zero = _mm_setzero_ps();
+            __m128 va0 = _mm_set1_ps(a[0]), vr0 = _mm_set1_ps(r[0]);
+            __m128 va1 = _mm_set1_ps(a[1]), vr1 = _mm_set1_ps(r[1]);
+            __m128 va2 = _mm_set1_ps(a[2]), vr2 = _mm_set1_ps(r[2]);
+            __m128 va3 = _mm_set1_ps(a[3]), vr3 = _mm_set1_ps(r[3]);
+            __m128 vaz = _mm_set1_ps(az), vrz = _mm_set1_ps(rz), vzmax = _mm_set1_ps(zmax);
+            for (int px = xa; px <= xb; px += 4) {
+                __m128 cx = _mm_setr_ps(px + 0.5f, px + 1.5f, px + 2.5f, px + 3.5f);
+                __m128 e0 = _mm_add_ps(_mm_mul_ps(va0, cx), vr0);
+                __m128 e1 = _mm_add_ps(_mm_mul_ps(va1, cx), vr1);
+                __m128 e2 = _mm_add_ps(_mm_mul_ps(va2, cx), vr2);
+                __m128 e3 = _mm_add_ps(_mm_mul_ps(va3, cx), vr3);
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)),
+                    _mm_and_ps(_mm_cmpge_ps(e2, zero), _mm_cmpge_ps(e3, zero)));
+                if (_mm_movemask_ps(inside) == 0) {
+                    continue;
+                }
+                __m128 z = _mm_min_ps(_mm_add_ps(_mm_mul_ps(vaz, cx), vrz), vzmax);
+                __m128 d = _mm_loadu_ps(row + px);
+                __m128 m = _mm_min_ps(d, z);
+                _mm_storeu_ps(row + px, _mm_or_ps(_mm_and_ps(inside, m), _mm_andnot_ps(inside, d)));
+            }
+#else
+            for (int px = xa; px <= xb; ++px) {
+                float cx = px + 0.5f;
+                if (a[0] * cx + r[0] >= 0.0f && a[1] * cx + r[1] >= 0.0f && a[2] * cx + r[2] >= 0.0f && a[3] * cx + r[3] >= 0.0f) {
+                    row[px] = min(row[px], min(az * cx + rz, zmax));
+                }
+            }
+#endif
+        }
+    }
+}
+
+void OcclusionCuller::buildPyramid()
+{
+    for (unsigned int l = 1; l < levelOffsets.size(); ++l) {
+        const float *src = &depths[levelOffsets[l - 1]];
+        float *dst = &depths[levelOffsets[l]];
+        int sw = levelWidths[l - 1];
+        int sh = levelHeights[l - 1];
+        int dw = levelWidths[l];
+        int dh = levelHeights[l];
+        for (int y = 0; y < dh; ++y) {
+            int y0 = 2 * y;
+            int y1 = min(y0 + 1, sh - 1);
+            for (int x = 0; x < dw; ++x) {
+                int x0 = 2 * x;
+                int x1 = min(x0 + 1, sw - 1);
+                float d0 = max(src[y0 * sw + x0], src[y0 * sw + x1]);
+                float d1 = max(src[y1 * sw + x0], src[y1 * sw + x1]);
+                dst[y * dw + x] = max(d0, d1);
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::isOccluded(const box3d &b)
+{
+    float xmin = float(width), xmax = 0.0f;
+    float ymin = float(height), ymax = 0.0f;
+    float zmin = 1.0f;
+    for (int i = 0; i < 8; ++i) {
+        vec4d p = worldToScreen * vec4d(i & 1 ? b.xmax : b.xmin, i & 2 ? b.ymax : b.ymin, i & 4 ? b.zmax : b.zmin, 1.0);
+        if (p.w < MIN_W) {
+            // the box crosses the near plane
+            return false;
+        }
+        float x = float((p.x / p.w * 0.5 + 0.5) * width);
+        float y = float((p.y / p.w * 0.5 + 0.5) * height);
+        xmin = min(xmin, x);
+        xmax = max(xmax, x);
+        ymin = min(ymin, y);
+        ymax = max(ymax, y);
+        zmin = min(zmin, float(p.z / p.w * 0.5 + 0.5));
+    }
+    int x0 = max(int(floor(xmin)), 0);
+    int x1 = min(int(floor(xmax)), width - 1);
+    int y0 = max(int(floor(ymin)), 0);
+    int y1 = min(int(floor(ymax)), height - 1);
+    if (x0 > x1 || y0 > y1) {
+        return false;
+    }
+    // selects the pyramid level where the box covers at most 2x2 texels
+    unsigned int l = 0;
+    while (l + 1 < levelOffsets.size() && ((x1 >> l) - (x0 >> l) > 1 || (y1 >> l) - (y0 >> l) > 1)) {
+        ++l;
+    }
+    const float *level = &depths[levelOffsets[l]];
+    int w = levelWidths[l];
+    for (int y = y0 >> l; y <= (y1 >> l); ++y) {
+        for (int x = x0 >> l; x <= (x1 >> l); ++x) {
+            if (zmin <= level[y * w + x]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+}
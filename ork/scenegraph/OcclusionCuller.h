@@ -0,0 +1,285 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#ifndef _ORK_OCCLUSION_CULLER_H_
+#define _ORK_OCCLUSION_CULLER_H_
+
+#include <vector>
+#include <string>
+
+#include "ork/core/Object.h"
+#include "ork/math/mat4.h"
+#include "ork/taskgraph/Scheduler.h"
+
+namespace ork
+{
+
+class SceneNode;
+
+/**
+ * A software occlusion culler based on a hierarchical depth buffer. At each
+ * frame, after frustum culling, the visible occluder nodes are rasterized on
+ * CPU into a low resolution depth buffer, from which a max depth pyramid is
+ * built. Then the world bounds of the other visible nodes are tested against
+ * this pyramid, and the nodes that are hidden behind the occluders are marked
+ * as invisible. No GPU work is involved.
+ *
+ * Occluders are the scene nodes having a given flag. Their local bounding box
+ * is used as occluder geometry, which is conservative only if this box is
+ * completely filled by the node's meshes (e.g. for buildings or walls).
+ * Occluders crossing the near plane are ignored. The rasterization is itself
+ * conservative: a depth buffer pixel is covered only if it is completely
+ * inside a face of an occluder, and it receives the maximum depth of this
+ * face over the pixel. Hence a node is never culled if some part of it might
+ * be visible.
+ *
+ * The rasterization is done with SSE2 when available. The rasterization and
+ * the tests are ParallelForTask, which can be executed by several threads of
+ * the Scheduler given to #cull.
+ *
+ * @ingroup scenegraph
+ */
+class ORK_API OcclusionCuller : public Object
+{
+public:
+    /**
+     * Creates a new OcclusionCuller.
+     *
+     * @param occluderFlag the flag of the occluder nodes.
+     * @param width the width of the depth buffer. It is rounded up to a
+     *      multiple of 4.
+     * @param height the height of the depth buffer.
+     */
+    OcclusionCuller(const std::string &occluderFlag, int width = 256, int height = 128);
+
+    /**
+     * Deletes this OcclusionCuller.
+     */
+    virtual ~OcclusionCuller();
+
+    /**
+     * Returns the flag of the occluder nodes.
+     */
+    std::string getOccluderFlag();
+
+    /**
+     * Returns the identifier of the flag of the occluder nodes (see
+     * SceneNode#getFlagId).
+     */
+    unsigned int getOccluderFlagId();
+
+    /**
+     * Returns the number of occluders rasterized during the last call to
+     * #cull.
+     */
+    int getOccluderCount();
+
+    /**
+     * Returns the number of nodes tested during the last call to #cull.
+     */
+    int getTestedCount();
+
+    /**
+     * Returns the number of nodes found occluded during the last call to
+     * #cull.
+     */
+    int getOccludedCount();
+
+    /**
+     * Rasterizes the given occluders and tests the given nodes against them.
+     * This method is called by SceneManager#update.
+     *
+     * @param worldToScreen the world to screen transformation.
+     * @param occluders the visible occluder nodes.
+     * @param nodes the visible nodes to be tested.
+     * @param[out] occluded the nodes found occluded.
+     * @param scheduler the scheduler used to execute the rasterization and
+     *      the tests (see Scheduler#execute), or NULL to execute them in the
+     *      current thread.
+     */
+    void cull(const mat4d &worldToScreen, const std::vector<SceneNode*> &occluders,
+        const std::vector<SceneNode*> &nodes, std::vector<SceneNode*> &occluded,
+        ptr<Scheduler> scheduler = NULL);
+
+protected:
+    /**
+     * Creates an uninitialized OcclusionCuller.
+     */
+    OcclusionCuller();
+
+    /**
+     * Initializes this OcclusionCuller.
+     *
+     * See #OcclusionCuller.
+     */
+    void init(const std::string &occluderFlag, int width, int height);
+
+private:
+    /**
+     * A convex quad in depth buffer coordinates.
+     */
+    struct Quad
+    {
+        float x[4]; ///< x coordinates of the vertices, in pixels.
+
+        float y[4]; ///< y coordinates of the vertices, in pixels.
+
+        float z[4]; ///< depth of the vertices, between 0 and 1.
+    };
+
+    /**
+     * A ParallelForTask to rasterize the occluders in bands of rows.
+     */
+    class RasterizeTask;
+
+    /**
+     * A ParallelForTask to test the nodes against the depth pyramid.
+     */
+    class TestTask;
+
+    /**
+     * The flag of the occluder nodes.
+     */
+    std::string occluderFlag;
+
+    /**
+     * The identifier of #occluderFlag.
+     */
+    unsigned int occluderFlagId;
+
+    /**
+     * The width of the depth buffer, a multiple of 4.
+     */
+    int width;
+
+    /**
+     * The height of the depth buffer.
+     */
+    int height;
+
+    /**
+     * The depth pyramid. Level 0 is the depth buffer itself, and each texel
+     * of level k+1 contains the max depth of the corresponding 2x2 texels of
+     * level k.
+     */
+    std::vector<float> depths;
+
+    /**
+     * The offset of each level of the pyramid in #depths.
+     */
+    std::vector<int> levelOffsets;
+
+    /**
+     * The width of each level of the pyramid.
+     */
+    std::vector<int> levelWidths;
+
+    /**
+     * The height of each level of the pyramid.
+     */
+    std::vector<int> levelHeights;
+
+    /**
+     * The faces of the occluders, for the current frame.
+     */
+    std::vector<Quad> quads;
+
+    /**
+     * The world to screen transformation, for the current frame.
+     */
+    mat4d worldToScreen;
+
+    /**
+     * The nodes to be tested, for the current frame.
+     */
+    const std::vector<SceneNode*> *nodes;
+
+    /**
+     * The result of the tests, for each node in #nodes.
+     */
+    std::vector<char> results;
+
+    /**
+     * Number of occluders rasterized during the last call to #cull.
+     */
+    int occluderCount;
+
+    /**
+     * Number of nodes tested during the last call to #cull.
+     */
+    int testedCount;
+
+    /**
+     * Number of nodes found occluded during the last call to #cull.
+     */
+    int occludedCount;
+
+    /**
+     * Adds the faces of the bounding box of the given occluder to #quads.
+     * Returns false if this box crosses the near plane.
+     */
+    bool addOccluder(SceneNode *occluder);
+
+    /**
+     * Executes the given task with the given scheduler, or in the current
+     * thread if the scheduler is NULL.
+     */
+    static void execute(ptr<Task> task, ptr<Scheduler> scheduler);
+
+    /**
+     * Rasterizes #quads in the given band of rows of the depth buffer.
+     */
+    void rasterize(int ymin, int ymax);
+
+    /**
+     * Builds the levels 1 and more of the depth pyramid.
+     */
+    void buildPyramid();
+
+    /**
+     * Returns true if the given bounding box is hidden by the occluders.
+     */
+    bool isOccluded(const box3d &worldBounds);
+};
+
+}
+
+#endif
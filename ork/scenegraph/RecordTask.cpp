@@ -0,0 +1,187 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#include "ork/scenegraph/RecordTask.h"
+
+#include <map>
+
+#include "ork/core/Profiler.h"
+#include "ork/taskgraph/TaskGraph.h"
+#include "ork/scenegraph/SceneManager.h"
+
+using namespace std;
+
+namespace ork
+{
+
+Recordable::~Recordable()
+{
+}
+
+RecordTask::RecordTask(ptr<CommandList> commands) :
+    Task("Record", false, 0), commands(commands), recorded(false)
+{
+}
+
+RecordTask::~RecordTask()
+{
+}
+
+void RecordTask::addTask(ptr<Task> t)
+{
+    tasks.push_back(t);
+}
+
+void RecordTask::init(set<Task*> &initialized)
+{
+    if (initialized.find(this) == initialized.end()) {
+        Task::init(initialized);
+        for (unsigned int i = 0; i < tasks.size(); ++i) {
+            tasks[i]->init(initialized);
+        }
+    }
+}
+
+bool RecordTask::run()
+{
+    commands->clear();
+    recorded = true;
+    for (unsigned int i = 0; recorded && i < tasks.size(); ++i) {
+        recorded = record(tasks[i]);
+    }
+    if (!recorded) {
+        commands->clear();
+    }
+    return true;
+}
+
+bool RecordTask::record(ptr<Task> t)
+{
+    if (t.cast<TaskGraph>() != NULL) {
+        vector< ptr<Task> > sorted;
+        getSortedTasks(t, sorted);
+        for (unsigned int i = 0; i < sorted.size(); ++i) {
+            if (!record(sorted[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+    Recordable *r = dynamic_cast<Recordable*>(t.get());
+    return r != NULL && r->record(*commands);
+}
+
+void RecordTask::execute(ptr<Task> t)
+{
+    if (t.cast<TaskGraph>() != NULL) {
+        vector< ptr<Task> > sorted;
+        getSortedTasks(t, sorted);
+        for (unsigned int i = 0; i < sorted.size(); ++i) {
+            execute(sorted[i]);
+        }
+    } else {
+        Profiler::Zone zone(t->getClass());
+        t->begin();
+        t->run();
+        t->end();
+    }
+}
+
+void RecordTask::getSortedTasks(ptr<Task> t, vector< ptr<Task> > &result)
+{
+    ptr<TaskGraph> g = t.cast<TaskGraph>();
+    map<Task*, int> predecessors;
+    TaskGraph::TaskIterator i = g->getAllTasks();
+    while (i.hasNext()) {
+        ptr<Task> u = i.next();
+        predecessors[u.get()] = g->getDependencies(u).size();
+    }
+    i = g->getFirstTasks();
+    while (i.hasNext()) {
+        result.push_back(i.next());
+    }
+    for (unsigned int k = 0; k < result.size(); ++k) {
+        TaskGraph::TaskIterator j = g->getInverseDependencies(result[k]);
+        while (j.hasNext()) {
+            ptr<Task> u = j.next();
+            if (--predecessors[u.get()] == 0) {
+                result.push_back(u);
+            }
+        }
+    }
+}
+
+ReplayTask::ReplayTask() : Task("Replay", true, 0)
+{
+}
+
+ReplayTask::~ReplayTask()
+{
+}
+
+void ReplayTask::addTask(ptr<RecordTask> t)
+{
+    tasks.push_back(t);
+}
+
+bool ReplayTask::run()
+{
+    if (Logger::DEBUG_LOGGER != NULL) {
+        Logger::DEBUG_LOGGER->log("SCENEGRAPH", "Replay");
+    }
+    ptr<FrameBuffer> fb = SceneManager::getCurrentFrameBuffer();
+    for (unsigned int i = 0; i < tasks.size(); ++i) {
+        RecordTask *t = tasks[i].get();
+        if (t->recorded) {
+            ptr<Program> p = t->commands->run(fb);
+            if (p != NULL) {
+                SceneManager::setCurrentProgram(p);
+            }
+        } else {
+            for (unsigned int j = 0; j < t->tasks.size(); ++j) {
+                RecordTask::execute(t->tasks[j]);
+            }
+        }
+    }
+    return true;
+}
+
+}
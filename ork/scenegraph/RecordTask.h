@@ -0,0 +1,197 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#ifndef _ORK_RECORD_TASK_H_
+#define _ORK_RECORD_TASK_H_
+
+#include <vector>
+
+#include "ork/render/CommandList.h"
+#include "ork/taskgraph/Task.h"
+
+namespace ork
+{
+
+/**
+ * A task that can record its OpenGL work in a CommandList, instead of
+ * executing it directly. Tasks implementing this interface can be recorded
+ * by a RecordTask in any thread.
+ * @ingroup scenegraph
+ */
+class ORK_API Recordable
+{
+public:
+    /**
+     * Deletes this Recordable.
+     */
+    virtual ~Recordable();
+
+    /**
+     * Records the work of this task in the given command list. This method
+     * must not make any OpenGL call, nor modify any state shared with other
+     * tasks, because it can be called in any thread.
+     *
+     * @param commands the list where the commands must be recorded.
+     * @return false if this task cannot be recorded, and must be executed
+     *      normally.
+     */
+    virtual bool record(CommandList &commands) = 0;
+};
+
+/**
+ * A CPU task that records the commands of some GPU tasks in a CommandList.
+ * Several RecordTask can be executed in parallel by a MultithreadScheduler,
+ * and their commands are then replayed in order in the OpenGL thread by a
+ * ReplayTask. If a recorded task is not a Recordable, or cannot be recorded,
+ * the tasks of this RecordTask are executed normally by the ReplayTask.
+ * @ingroup scenegraph
+ */
+class ORK_API RecordTask : public Task
+{
+public:
+    /**
+     * Creates a new RecordTask.
+     *
+     * @param commands the command list where the tasks must be recorded.
+     */
+    RecordTask(ptr<CommandList> commands);
+
+    /**
+     * Deletes this RecordTask.
+     */
+    virtual ~RecordTask();
+
+    /**
+     * Adds a task to be recorded by this RecordTask. The tasks are recorded
+     * in the order in which they are added.
+     *
+     * @param t a task, or a task graph.
+     */
+    void addTask(ptr<Task> t);
+
+    /**
+     * Initializes the tasks to be recorded.
+     */
+    virtual void init(std::set<Task*> &initialized);
+
+    virtual bool run();
+
+private:
+    /**
+     * The tasks to be recorded.
+     */
+    std::vector< ptr<Task> > tasks;
+
+    /**
+     * The command list where #tasks are recorded.
+     */
+    ptr<CommandList> commands;
+
+    /**
+     * True if all the #tasks have been recorded in #commands.
+     */
+    bool recorded;
+
+    /**
+     * Records the given task in #commands.
+     *
+     * @param t a task or task graph.
+     * @return false if a task cannot be recorded.
+     */
+    bool record(ptr<Task> t);
+
+    /**
+     * Executes the given task in the current thread.
+     *
+     * @param t a task or task graph.
+     */
+    static void execute(ptr<Task> t);
+
+    /**
+     * Returns the tasks of a task graph in an order that respects their
+     * dependencies.
+     *
+     * @param t a task graph.
+     * @param[out] result the tasks of t.
+     */
+    static void getSortedTasks(ptr<Task> t, std::vector< ptr<Task> > &result);
+
+    friend class ReplayTask;
+};
+
+/**
+ * A GPU task that replays, in order, the command lists of some RecordTask.
+ * This task must depend on these RecordTask.
+ * @ingroup scenegraph
+ */
+class ORK_API ReplayTask : public Task
+{
+public:
+    /**
+     * Creates a new ReplayTask.
+     */
+    ReplayTask();
+
+    /**
+     * Deletes this ReplayTask.
+     */
+    virtual ~ReplayTask();
+
+    /**
+     * Adds a RecordTask to be replayed by this task. The RecordTask are
+     * replayed in the order in which they are added.
+     *
+     * @param t a RecordTask.
+     */
+    void addTask(ptr<RecordTask> t);
+
+    virtual bool run();
+
+private:
+    /**
+     * The RecordTask to be replayed.
+     */
+    std::vector< ptr<RecordTask> > tasks;
+};
+
+}
+
+#endif
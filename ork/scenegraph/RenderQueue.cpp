@@ -0,0 +1,327 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#include "ork/scenegraph/RenderQueue.h"
+
+#include <cstring>
+
+#include "ork/render/FrameBuffer.h"
+#include "ork/taskgraph/TaskGraph.h"
+#include "ork/scenegraph/DrawMeshTask.h"
+#include "ork/scenegraph/SceneManager.h"
+
+using namespace std;
+
+namespace ork
+{
+
+/**
+ * The position of the least significant bit of each key field, for each
+ * RenderQueue#state. The depth is stored in the 20 least significant bits.
+ */
+static const int FIELD_SHIFT[RenderQueue::STATE_COUNT] = { 60, 48, 36, 20 };
+
+/**
+ * The maximum value of each key field, for each RenderQueue#state.
+ */
+static const unsigned int FIELD_MASK[RenderQueue::STATE_COUNT] = { 0xF, 0xFFF, 0xFFF, 0xFFFF };
+
+RenderQueue *RenderQueue::CURRENT = NULL;
+
+RenderQueue::RenderQueue() : Object("RenderQueue")
+{
+    resetStatistics();
+}
+
+RenderQueue::~RenderQueue()
+{
+    if (CURRENT == this) {
+        CURRENT = NULL;
+    }
+}
+
+RenderQueue *RenderQueue::getCurrent()
+{
+    return CURRENT;
+}
+
+void RenderQueue::begin(ptr<SceneNode> n)
+{
+    assert(CURRENT == NULL);
+    CURRENT = this;
+    entry.task = NULL;
+    entry.key = 0;
+    entry.node = n;
+    entry.draw = NULL;
+    entry.draws = 0;
+    // the framebuffer is not known yet, since the SetTargetTask executed
+    // before the loop has not been run; the tasks without SetTargetTask use
+    // this framebuffer, whose key 0 is the first one seen after #submit, so
+    // that they are sorted before those that change the target
+    setField(FRAMEBUFFER, getId(FRAMEBUFFER, 0));
+    // the depth is the distance to the camera, whose positive float bits
+    // have the same order as the corresponding integers
+    float depth = float(max(-n->getLocalToCamera()[2][3], 0.0));
+    unsigned int bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    entry.key |= bits >> 11;
+}
+
+void RenderQueue::setTarget(ptr<Object> source, const vector< ptr<Texture> > &textures)
+{
+    assert(CURRENT == this);
+    size_t target = size_t(source.get());
+    for (unsigned int i = 0; i < textures.size(); ++i) {
+        target = target * 31 + size_t(textures[i].get());
+    }
+    setField(FRAMEBUFFER, getId(FRAMEBUFFER, target));
+}
+
+void RenderQueue::setProgram(ptr<Program> p, ptr<SceneNode> n)
+{
+    assert(CURRENT == this);
+    setField(PROGRAM, getId(PROGRAM, size_t(p.get())));
+    size_t textures = 0;
+    if (n != NULL) {
+        SceneNode::ValueIterator i = n->getValues();
+        while (i.hasNext()) {
+            ValueSampler *v = dynamic_cast<ValueSampler*>(i.next().get());
+            if (v != NULL) {
+                textures = textures * 31 + size_t(v->get().get());
+            }
+        }
+    }
+    setField(TEXTURES, getId(TEXTURES, textures));
+}
+
+void RenderQueue::setMesh(ptr<MeshBuffers> m, ptr<Task> draw)
+{
+    assert(CURRENT == this);
+    setField(MESH, getId(MESH, size_t(m.get())));
+    entry.draw = draw;
+    entry.draws += 1;
+}
+
+void RenderQueue::end(ptr<Task> t)
+{
+    assert(CURRENT == this);
+    CURRENT = NULL;
+    if (t != NULL) {
+        entry.task = t;
+        entries.push_back(entry);
+    }
+    entry.task = NULL;
+    entry.node = NULL;
+    entry.draw = NULL;
+}
+
+int RenderQueue::getSize()
+{
+    return (int) entries.size();
+}
+
+ptr<Task> RenderQueue::submit(bool instancing, ptr<BatchRenderer> batches, bool parallel)
+{
+    unsigned int n = (unsigned int) entries.size();
+    vector<unsigned long long> keys(n);
+    vector<unsigned int> order(n);
+    vector<unsigned int> tmp(n);
+    for (unsigned int i = 0; i < n; ++i) {
+        keys[i] = entries[i].key;
+        order[i] = i;
+    }
+    countChanges(keys, unsortedChanges);
+
+    // least significant digit radix sort, with 8 bits digits; the passes in
+    // which all keys have the same digit are skipped
+    for (int shift = 0; shift < 64; shift += 8) {
+        unsigned int count[256];
+        memset(count, 0, sizeof(count));
+        for (unsigned int i = 0; i < n; ++i) {
+            count[(keys[i] >> shift) & 0xFF]++;
+        }
+        if (n == 0 || count[(keys[0] >> shift) & 0xFF] == n) {
+            continue;
+        }
+        unsigned int offset = 0;
+        for (int d = 0; d < 256; ++d) {
+            unsigned int c = count[d];
+            count[d] = offset;
+            offset += c;
+        }
+        for (unsigned int i = 0; i < n; ++i) {
+            unsigned int j = order[i];
+            tmp[count[(keys[j] >> shift) & 0xFF]++] = j;
+        }
+        order.swap(tmp);
+    }
+
+    ptr<TaskGraph> result = new TaskGraph();
+    ptr<Task> prev = NULL;
+    unsigned int i = 0;
+    while (i < n) {
+        const Entry &e = entries[order[i]];
+        // finds the consecutive entries that can be merged with e
+        unsigned int j = i + 1;
+        if (instancing || batches != NULL) {
+            while (j < n && canMerge(e, entries[order[j]], batches)) {
+                ++j;
+            }
+        }
+        if (j > i + 1) {
+            ptr<DrawMeshTask::Impl> d = e.draw.cast<DrawMeshTask::Impl>();
+            d->instances.clear();
+            d->meshes.clear();
+            d->batches = batches;
+            for (unsigned int k = i; k < j; ++k) {
+                ptr<DrawMeshTask::Impl> dk = entries[order[k]].draw.cast<DrawMeshTask::Impl>();
+                d->instances.push_back(entries[order[k]].node);
+                if (batches != NULL) {
+                    d->meshes.push_back(dk->m);
+                }
+                if (k > i) {
+                    // the other subtasks of the merged tasks must still be
+                    // executed, but their mesh is drawn by d
+                    dk->m = NULL;
+                }
+            }
+        }
+        instancedDraws += e.draws;
+        for (unsigned int k = i; k < j; ++k) {
+            draws += entries[order[k]].draws;
+            ptr<Task> next = entries[order[k]].task;
+            result->addTask(next);
+            if (!parallel && prev != NULL) {
+                result->addDependency(next, prev);
+            }
+            prev = next;
+        }
+        i = j;
+    }
+    vector<unsigned long long> sortedKeys(n);
+    for (i = 0; i < n; ++i) {
+        sortedKeys[i] = keys[order[i]];
+    }
+    countChanges(sortedKeys, sortedChanges);
+
+    entries.clear();
+    for (int s = 0; s < STATE_COUNT; ++s) {
+        ids[s].clear();
+    }
+    return result;
+}
+
+int RenderQueue::getStateChanges(state s, bool sorted)
+{
+    return sorted ? sortedChanges[s] : unsortedChanges[s];
+}
+
+int RenderQueue::getDraws(bool instanced)
+{
+    return instanced ? instancedDraws : draws;
+}
+
+void RenderQueue::resetStatistics()
+{
+    for (int s = 0; s < STATE_COUNT; ++s) {
+        unsortedChanges[s] = 0;
+        sortedChanges[s] = 0;
+    }
+    draws = 0;
+    instancedDraws = 0;
+}
+
+unsigned int RenderQueue::getId(state s, size_t key)
+{
+    map<size_t, unsigned int>::iterator i = ids[s].find(key);
+    if (i != ids[s].end()) {
+        return i->second;
+    }
+    unsigned int id = min((unsigned int) ids[s].size(), FIELD_MASK[s]);
+    ids[s].insert(make_pair(key, id));
+    return id;
+}
+
+void RenderQueue::setField(state s, unsigned int id)
+{
+    unsigned long long mask = (unsigned long long) FIELD_MASK[s] << FIELD_SHIFT[s];
+    entry.key = (entry.key & ~mask) | ((unsigned long long) id << FIELD_SHIFT[s]);
+}
+
+bool RenderQueue::canMerge(const Entry &e, const Entry &f, ptr<BatchRenderer> batches)
+{
+    if (e.draws != 1 || f.draws != 1 || e.draw == NULL || f.draw == NULL) {
+        return false;
+    }
+    // the fields must be equal and must not be saturated, otherwise they
+    // may designate different objects; the meshes can be different if they
+    // are batched
+    state last = batches == NULL ? MESH : TEXTURES;
+    for (int s = 0; s <= last; ++s) {
+        unsigned int id = (unsigned int) (e.key >> FIELD_SHIFT[s]) & FIELD_MASK[s];
+        if (id == FIELD_MASK[s]) {
+            return false;
+        }
+    }
+    if ((e.key >> FIELD_SHIFT[last]) != (f.key >> FIELD_SHIFT[last])) {
+        return false;
+    }
+    if (batches != NULL) {
+        ptr<MeshBuffers> em = e.draw.cast<DrawMeshTask::Impl>()->m;
+        ptr<MeshBuffers> fm = f.draw.cast<DrawMeshTask::Impl>()->m;
+        return batches->addMesh(em) && batches->addMesh(fm);
+    }
+    return true;
+}
+
+void RenderQueue::countChanges(const vector<unsigned long long> &keys, int *changes)
+{
+    for (unsigned int i = 0; i < keys.size(); ++i) {
+        for (int s = 0; s < STATE_COUNT; ++s) {
+            unsigned long long mask = (unsigned long long) FIELD_MASK[s] << FIELD_SHIFT[s];
+            if (i == 0 || ((keys[i] ^ keys[i - 1]) & mask) != 0) {
+                changes[s] += 1;
+            }
+        }
+    }
+}
+
+}
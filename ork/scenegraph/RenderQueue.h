@@ -0,0 +1,312 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#ifndef _ORK_RENDER_QUEUE_H_
+#define _ORK_RENDER_QUEUE_H_
+
+#include <map>
+#include <vector>
+
+#include "ork/taskgraph/Task.h"
+#include "ork/scenegraph/BatchRenderer.h"
+#include "ork/scenegraph/SceneNode.h"
+
+namespace ork
+{
+
+class FrameBuffer;
+
+/**
+ * A queue to reorder the draw tasks of a loop in order to minimize state
+ * changes. A LoopTask in render queue mode records, for each scene node, the
+ * task produced by its subtask with a sort key. This key is made of the
+ * framebuffer, the program, the textures, and the mesh used by this task,
+ * and of the node depth. The framebuffer is reported by the SetTargetTask of
+ * the task, if any (the tasks without SetTargetTask use the framebuffer that
+ * is current before the loop, and are sorted first), the program and the
+ * textures are reported by the SetProgramTask (textures are given by the
+ * sampler values of the scene node), and the mesh is reported by the
+ * DrawMeshTask. The recorded tasks are then sorted with
+ * a radix sort on their key, and are executed in this order. Since the
+ * framebuffer, programs and meshes skip the redundant OpenGL calls when they
+ * are already bound, this reduces the number of state changes.
+ *
+ * The framebuffers, programs, textures and meshes are identified with small
+ * integers, in the order in which they are first seen since the last call to
+ * #submit. The key has room for 16 framebuffers, 4096 programs and texture
+ * sets, and 65536 meshes. Above these limits, the extra objects share the
+ * same identifier, and are not sorted relatively to each other.
+ *
+ * A RenderQueue can also merge the recorded tasks into instanced draws. This
+ * is possible when consecutive tasks, after sorting, use the same
+ * framebuffer, program, textures and mesh, and draw this mesh only once.
+ * The draw of the first of these tasks is then replaced with an
+ * instanced draw for all the merged scene nodes (see DrawMeshTask), and the
+ * draws of the other tasks are skipped (their other subtasks are still
+ * executed).
+ * This assumes that these tasks only differ in per node data, which the
+ * program reads from per instance attributes. Likewise, consecutive tasks
+ * that draw different meshes with the same states can be merged into a
+ * single multi draw with a BatchRenderer, if these meshes can be batched.
+ *
+ * @ingroup scenegraph
+ */
+class ORK_API RenderQueue : public Object
+{
+public:
+    /**
+     * The states whose changes are counted by a RenderQueue.
+     */
+    enum state {
+        FRAMEBUFFER, ///< framebuffer changes
+        PROGRAM, ///< program changes
+        TEXTURES, ///< texture set changes
+        MESH, ///< mesh changes
+        STATE_COUNT ///< number of states
+    };
+
+    /**
+     * Creates a new RenderQueue.
+     */
+    RenderQueue();
+
+    /**
+     * Deletes this RenderQueue.
+     */
+    virtual ~RenderQueue();
+
+    /**
+     * Returns the RenderQueue that is currently recording a task, or NULL.
+     */
+    static RenderQueue *getCurrent();
+
+    /**
+     * Starts the recording of the task of the given scene node.
+     *
+     * @param n the scene node whose task will be recorded. Its depth in
+     *      camera space is used as the last sort criterion.
+     */
+    void begin(ptr<SceneNode> n);
+
+    /**
+     * Sets the framebuffer attachments used by the task being recorded.
+     *
+     * @param source the SetTargetTask that sets these attachments.
+     * @param textures the textures attached by this task.
+     */
+    void setTarget(ptr<Object> source, const std::vector< ptr<Texture> > &textures);
+
+    /**
+     * Sets the program used by the task being recorded.
+     *
+     * @param p a program.
+     * @param n the scene node whose sampler values are set in this program,
+     *      or NULL.
+     */
+    void setProgram(ptr<Program> p, ptr<SceneNode> n);
+
+    /**
+     * Sets the mesh drawn by the task being recorded.
+     *
+     * @param m a mesh.
+     * @param draw the task that draws this mesh. Must be a DrawMeshTask
+     *      task, or NULL if the draws of this scene node cannot be merged
+     *      with others.
+     */
+    void setMesh(ptr<MeshBuffers> m, ptr<Task> draw = NULL);
+
+    /**
+     * Ends the recording of a task started with #begin.
+     *
+     * @param t the recorded task, or NULL to cancel this recording.
+     */
+    void end(ptr<Task> t);
+
+    /**
+     * Returns the number of tasks recorded since the last call to #submit.
+     */
+    int getSize();
+
+    /**
+     * Sorts the tasks recorded since the last call to #submit, and returns a
+     * task graph that executes them in this order. The queue is then empty.
+     *
+     * @param instancing true to merge consecutive tasks drawing the same
+     *      mesh with the same states into instanced draws.
+     * @param batches the renderer to be used to merge consecutive tasks
+     *      drawing meshes with the same states into multi draws, or NULL.
+     * @param parallel true to return the sorted tasks without dependencies
+     *      between them, so that they can be executed in parallel, and thus
+     *      not necessarily in sorted order.
+     */
+    ptr<Task> submit(bool instancing = false, ptr<BatchRenderer> batches = NULL, bool parallel = false);
+
+    /**
+     * Returns the number of changes of the given state in the tasks submitted
+     * since the last call to #resetStatistics.
+     *
+     * @param s a state.
+     * @param sorted true to count the changes in the submission order, false
+     *      to count them in the recording order (i.e. without render queue).
+     */
+    int getStateChanges(state s, bool sorted);
+
+    /**
+     * Returns the number of draws in the tasks submitted since the last call
+     * to #resetStatistics.
+     *
+     * @param instanced true to count the draws after merging them into
+     *      instanced draws or multi draws, false to count them before.
+     */
+    int getDraws(bool instanced);
+
+    /**
+     * Resets the state change counters.
+     */
+    void resetStatistics();
+
+private:
+    /**
+     * A recorded task.
+     */
+    struct Entry
+    {
+        /**
+         * The recorded task.
+         */
+        ptr<Task> task;
+
+        /**
+         * The sort key of this task.
+         */
+        unsigned long long key;
+
+        /**
+         * The scene node whose task is recorded.
+         */
+        ptr<SceneNode> node;
+
+        /**
+         * The DrawMeshTask task of this task, or NULL.
+         */
+        ptr<Task> draw;
+
+        /**
+         * The number of meshes drawn by this task.
+         */
+        int draws;
+    };
+
+    /**
+     * The RenderQueue that is currently recording a task, or NULL.
+     */
+    static RenderQueue *CURRENT;
+
+    /**
+     * The recorded tasks.
+     */
+    std::vector<Entry> entries;
+
+    /**
+     * The entry being recorded, if #CURRENT is this queue.
+     */
+    Entry entry;
+
+    /**
+     * The identifiers of the framebuffers, programs, texture sets and meshes
+     * seen since the last call to #submit.
+     */
+    std::map<size_t, unsigned int> ids[STATE_COUNT];
+
+    /**
+     * The number of state changes without sorting, for each state.
+     */
+    int unsortedChanges[STATE_COUNT];
+
+    /**
+     * The number of state changes after sorting, for each state.
+     */
+    int sortedChanges[STATE_COUNT];
+
+    /**
+     * The number of draws before merging them into instanced draws.
+     */
+    int draws;
+
+    /**
+     * The number of draws after merging them into instanced draws.
+     */
+    int instancedDraws;
+
+    /**
+     * Returns the identifier of the given object, for the given state.
+     *
+     * @param s a state.
+     * @param key a framebuffer, program or mesh pointer, or a hash code of a
+     *      set of textures.
+     */
+    unsigned int getId(state s, size_t key);
+
+    /**
+     * Sets a field of the key of the entry being recorded.
+     *
+     * @param s a state.
+     * @param id the value of this field.
+     */
+    void setField(state s, unsigned int id);
+
+    /**
+     * Returns true if the tasks of the given entries can be merged into a
+     * single instanced draw or, if batches is not NULL, into a single multi
+     * draw with this renderer.
+     */
+    static bool canMerge(const Entry &e, const Entry &f, ptr<BatchRenderer> batches);
+
+    /**
+     * Adds the state changes in the given sequence of keys to the given
+     * counters.
+     */
+    static void countChanges(const std::vector<unsigned long long> &keys, int *changes);
+};
+
+}
+
+#endif
@@ -41,13 +41,74 @@
 
 #include "ork/scenegraph/SceneManager.h"
 
+#include <algorithm>
+#include <cfloat>
+
+#include "ork/core/Profiler.h"
+#include "ork/core/Statistics.h"
 #include "ork/render/FrameBuffer.h"
+#include "ork/scenegraph/BatchRenderer.h"
+#include "ork/render/RingBuffer.h"
+#include "ork/scenegraph/OcclusionCuller.h"
+#include "ork/scenegraph/RenderQueue.h"
 
 using namespace std;
 
 namespace ork
 {
 
+/**
+ * Sets or clears the given bit of the given bitset, enlarging it if needed.
+ */
+static void setBit(vector<unsigned int> &bits, unsigned int i, bool value)
+{
+    unsigned int w = i >> 5;
+    if (w >= bits.size()) {
+        if (!value) {
+            return;
+        }
+        bits.resize(w + 1, 0);
+    }
+    if (value) {
+        bits[w] |= 1u << (i & 31);
+    } else {
+        bits[w] &= ~(1u << (i & 31));
+    }
+}
+
+/**
+ * Returns the index of the lowest bit set in x, which must not be 0.
+ */
+static unsigned int lowestBit(unsigned int x)
+{
+    // de Bruijn sequence, see http://graphics.stanford.edu/~seander/bithacks.html
+    static const unsigned int DEBRUIJN[32] = {
+        0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+        31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+    };
+    return DEBRUIJN[((x & (0u - x)) * 0x077CB531u) >> 27];
+}
+
+/**
+ * A LodMesh of a visible node, with the screen size of this node.
+ */
+struct LodCandidate
+{
+    LodMesh *mesh;
+
+    int *drawLevel;
+
+    float screenSize;
+};
+
+/**
+ * Sorts LodCandidate by increasing screen size.
+ */
+static bool lodCandidateLess(const LodCandidate &a, const LodCandidate &b)
+{
+    return a.screenSize < b.screenSize;
+}
+
 FrameBuffer* SceneManager::CURRENTFB = NULL;
 Program* SceneManager::CURRENTPROG = NULL;
 
@@ -77,8 +138,10 @@ void SceneManager::setCurrentProgram(ptr<Program> prog)
 SceneManager::SceneManager()
   : Object("SceneManager"),
     worldToScreen(mat4d::ZERO), // should call update before using
-    frameNumber(0)
+    nodeCount(0), triangleBudget(0), triangleCount(0), frameNumber(0)
 {
+    renderQueue = new RenderQueue();
+    batchRenderer = new BatchRenderer();
 
 }
 
@@ -87,6 +150,7 @@ SceneManager::~SceneManager()
     if (root != NULL) {
         root->setOwner(NULL);
     }
+    clearNodes();
     resourceManager->close();
 }
 
@@ -100,8 +164,10 @@ void SceneManager::setRoot(ptr<SceneNode> root)
     if (this->root != NULL) {
         this->root->setOwner(NULL);
     }
+    clearNodes();
     this->root = root;
     this->root->setOwner(this);
+    addNodes(root);
     this->camera = NULL;
 }
 
@@ -139,10 +205,31 @@ void SceneManager::setCameraMethod(const string &method)
 
 SceneManager::NodeIterator SceneManager::getNodes(const string &flag)
 {
-    if (nodeMap.size() == 0 && root != NULL) {
-        buildNodeMap(root);
+    return getNodes(SceneNode::getFlagId(flag));
+}
+
+SceneManager::NodeIterator SceneManager::getNodes(unsigned int flagId)
+{
+    if (flagId < flagNodes.size()) {
+        return SceneManager::NodeIterator(flagNodes[flagId]);
+    }
+    return SceneManager::NodeIterator();
+}
+
+void SceneManager::getVisibleNodes(unsigned int flagId, vector< ptr<SceneNode> > &nodes)
+{
+    if (flagId >= flagMasks.size()) {
+        return;
+    }
+    const vector<unsigned int> &mask = flagMasks[flagId];
+    unsigned int n = (unsigned int) min(mask.size(), visibleMask.size());
+    for (unsigned int w = 0; w < n; ++w) {
+        unsigned int bits = mask[w] & visibleMask[w];
+        while (bits != 0) {
+            nodes.push_back(this->nodes[(w << 5) + lowestBit(bits)]);
+            bits &= bits - 1;
+        }
     }
-    return SceneManager::NodeIterator(flag, nodeMap);
 }
 
 ptr<SceneNode> SceneManager::getNodeVar(const string &name)
@@ -179,6 +266,52 @@ void SceneManager::setScheduler(ptr<Scheduler> scheduler)
     this->scheduler = scheduler;
 }
 
+ptr<OcclusionCuller> SceneManager::getOcclusionCuller()
+{
+    return occlusionCuller;
+}
+
+void SceneManager::setOcclusionCuller(ptr<OcclusionCuller> culler)
+{
+    occlusionCuller = culler;
+}
+
+ptr<RenderQueue> SceneManager::getRenderQueue()
+{
+    return renderQueue;
+}
+
+ptr<BatchRenderer> SceneManager::getBatchRenderer()
+{
+    if (batchRenderer->getStreamBuffer() == NULL) {
+        batchRenderer->setStreamBuffer(getStreamBuffer());
+    }
+    return batchRenderer;
+}
+
+ptr<RingBuffer> SceneManager::getStreamBuffer()
+{
+    if (streamBuffer == NULL) {
+        streamBuffer = new RingBuffer(4 * 1024 * 1024);
+    }
+    return streamBuffer;
+}
+
+int SceneManager::getTriangleBudget()
+{
+    return triangleBudget;
+}
+
+void SceneManager::setTriangleBudget(int budget)
+{
+    triangleBudget = budget;
+}
+
+int SceneManager::getTriangleCount()
+{
+    return triangleCount;
+}
+
 mat4d SceneManager::getCameraToScreen()
 {
     return cameraToScreen;
@@ -277,6 +410,7 @@ void SceneManager::getFrustumPlanes(const mat4d &toScreen, vec4d *frustumPlanes)
 
 void SceneManager::update(double t, double dt)
 {
+    Profiler::Zone zone("SceneManager::update");
     this->t = t;
     this->dt = dt;
 
@@ -287,11 +421,17 @@ void SceneManager::update(double t, double dt)
         root->updateLocalToCamera(getCameraNode()->getWorldToLocal(), cameraToScreen);
         getFrustumPlanes(worldToScreen, worldFrustumPlanes);
         computeVisibility(root, PARTIALLY_VISIBLE);
+        if (occlusionCuller != NULL) {
+            computeOcclusion();
+        }
+        selectLods();
     }
 }
 
 void SceneManager::draw()
 {
+    Profiler::Zone zone("SceneManager::draw");
+    renderQueue->resetStatistics();
     if (camera != NULL) {
         ptr<Method> m = camera->getMethod(cameraMethod);
         if (m != NULL) {
@@ -308,6 +448,10 @@ void SceneManager::draw()
             }
         }
     }
+    if (streamBuffer != NULL) {
+        streamBuffer->nextFrame();
+    }
+    Statistics::endFrame();
     ++frameNumber;
 }
 
@@ -375,26 +519,244 @@ void SceneManager::computeVisibility(ptr<SceneNode> n, visibility v)
         v = getVisibility(n->getWorldBounds());
     }
     n->isVisible = v != INVISIBLE;
+    setBit(visibleMask, n->nodeId, n->isVisible);
 
     for (unsigned int i = 0; i < n->getChildrenCount(); ++i) {
         computeVisibility(n->getChild(i), v);
     }
 }
 
-void SceneManager::clearNodeMap()
+void SceneManager::computeOcclusion()
+{
+    unsigned int occluderFlag = occlusionCuller->getOccluderFlagId();
+    vector<SceneNode*> occluders;
+    vector<SceneNode*> candidates;
+    for (unsigned int w = 0; w < visibleMask.size(); ++w) {
+        unsigned int bits = visibleMask[w];
+        while (bits != 0) {
+            SceneNode *n = nodes[(w << 5) + lowestBit(bits)];
+            if (n->hasFlag(occluderFlag)) {
+                occluders.push_back(n);
+            } else {
+                candidates.push_back(n);
+            }
+            bits &= bits - 1;
+        }
+    }
+    vector<SceneNode*> occluded;
+    occlusionCuller->cull(worldToScreen, occluders, candidates, occluded, scheduler);
+    for (unsigned int i = 0; i < occluded.size(); ++i) {
+        occluded[i]->isVisible = false;
+        setBit(visibleMask, occluded[i]->nodeId, false);
+    }
+}
+
+void SceneManager::selectLods()
+{
+    // the projected diameter of a sphere of radius r at depth w, divided by
+    // the viewport height, is r * cameraToScreen[1][1] / w
+    double scale = getCameraToScreen()[1][1];
+    vector<LodCandidate> candidates;
+    triangleCount = 0;
+    for (unsigned int w = 0; w < visibleMask.size(); ++w) {
+        unsigned int bits = visibleMask[w];
+        while (bits != 0) {
+            SceneNode *n = nodes[(w << 5) + lowestBit(bits)];
+            bits &= bits - 1;
+            if (n->lods.empty()) {
+                continue;
+            }
+            // uses the local bounds, and not the world bounds which also
+            // contain the children of this node
+            mat4d l = n->getLocalToWorld();
+            box3d b = n->getLocalBounds();
+            vec3d c = l * b.center();
+            double s = max(max((l * vec4d(1.0, 0.0, 0.0, 0.0)).xyz().length(),
+                (l * vec4d(0.0, 1.0, 0.0, 0.0)).xyz().length()), (l * vec4d(0.0, 0.0, 1.0, 0.0)).xyz().length());
+            double r = 0.5 * s * (vec3d(b.xmax, b.ymax, b.zmax) - vec3d(b.xmin, b.ymin, b.zmin)).length();
+            double depth = (worldToScreen * vec4d(c.x, c.y, c.z, 1.0)).w;
+            float size = depth > 0.0 ? float(r * scale / depth) : FLT_MAX;
+            map<string, SceneNode::Lod>::iterator i = n->lods.begin();
+            while (i != n->lods.end()) {
+                SceneNode::Lod &l = i->second;
+                l.level = l.mesh->selectLevel(size, l.level);
+                l.drawLevel = l.level;
+                triangleCount += l.mesh->getTriangleCount(l.level);
+                LodCandidate lc;
+                lc.mesh = l.mesh.get();
+                lc.drawLevel = &l.drawLevel;
+                lc.screenSize = size;
+                candidates.push_back(lc);
+                ++i;
+            }
+        }
+    }
+    if (triangleBudget <= 0 || triangleCount <= triangleBudget) {
+        return;
+    }
+    // coarsens the smallest nodes first, one level at a time, until the
+    // budget is met or all nodes use their coarsest level
+    sort(candidates.begin(), candidates.end(), lodCandidateLess);
+    bool changed = true;
+    while (changed && triangleCount > triangleBudget) {
+        changed = false;
+        for (unsigned int i = 0; i < candidates.size() && triangleCount > triangleBudget; ++i) {
+            LodMesh *m = candidates[i].mesh;
+            int &level = *candidates[i].drawLevel;
+            if (level + 1 < m->getLevelCount()) {
+                triangleCount += m->getTriangleCount(level + 1) - m->getTriangleCount(level);
+                level += 1;
+                changed = true;
+            }
+        }
+    }
+}
+
+void SceneManager::addNodes(ptr<SceneNode> node)
+{
+    // the identifiers are not reused, so that the nodes are always
+    // enumerated in the order in which they were added (see #compactNodes)
+    unsigned int id = (unsigned int) nodes.size();
+    nodes.push_back(node.get());
+    nodeCount += 1;
+    node->nodeId = id;
+    setBit(visibleMask, id, node->isVisible);
+    const vector<unsigned int> &bits = node->flagBits;
+    for (unsigned int w = 0; w < bits.size(); ++w) {
+        unsigned int b = bits[w];
+        while (b != 0) {
+            unsigned int flagId = (w << 5) + lowestBit(b);
+            if (flagId >= flagNodes.size()) {
+                flagNodes.resize(flagId + 1);
+                flagMasks.resize(flagId + 1);
+            }
+            flagNodes[flagId].push_back(node);
+            setBit(flagMasks[flagId], id, true);
+            b &= b - 1;
+        }
+    }
+    unsigned int n = node->getChildrenCount();
+    for (unsigned int i = 0; i < n; ++i) {
+        addNodes(node->getChild(i));
+    }
+}
+
+void SceneManager::removeNodes(ptr<SceneNode> node)
+{
+    vector<unsigned int> flags;
+    releaseNodes(node.get(), flags);
+    // removes the released nodes from the dense node arrays, with a single
+    // pass per flag, while preserving the order of the remaining nodes
+    for (unsigned int w = 0; w < flags.size(); ++w) {
+        unsigned int b = flags[w];
+        while (b != 0) {
+            vector< ptr<SceneNode> > &v = flagNodes[(w << 5) + lowestBit(b)];
+            unsigned int j = 0;
+            for (unsigned int i = 0; i < v.size(); ++i) {
+                if (v[i]->owner == this) {
+                    v[j++] = v[i];
+                }
+            }
+            v.resize(j);
+            b &= b - 1;
+        }
+    }
+    // the unused identifiers are reclaimed when they outnumber the used
+    // ones, so that the cost of this compaction is amortized over the removals
+    if (nodes.size() >= 64 && nodes.size() > 2 * nodeCount) {
+        compactNodes();
+    }
+}
+
+void SceneManager::addNodeFlag(ptr<SceneNode> node, unsigned int flagId)
 {
-    nodeMap.clear();
+    if (flagId >= flagNodes.size()) {
+        flagNodes.resize(flagId + 1);
+        flagMasks.resize(flagId + 1);
+    }
+    // inserts the node at its position in identifier order, usually at
+    // the end since recently added nodes have the largest identifiers
+    vector< ptr<SceneNode> > &v = flagNodes[flagId];
+    unsigned int i = (unsigned int) v.size();
+    while (i > 0 && v[i - 1]->nodeId > node->nodeId) {
+        --i;
+    }
+    v.insert(v.begin() + i, node);
+    setBit(flagMasks[flagId], node->nodeId, true);
 }
 
-void SceneManager::buildNodeMap(ptr<SceneNode> node)
+void SceneManager::removeNodeFlag(ptr<SceneNode> node, unsigned int flagId)
 {
-    SceneNode::FlagIterator i = node->getFlags();
-    while (i.hasNext()) {
-        nodeMap.insert(make_pair(i.next(), node));
+    vector< ptr<SceneNode> > &v = flagNodes[flagId];
+    vector< ptr<SceneNode> >::iterator i = find(v.begin(), v.end(), node);
+    if (i != v.end()) {
+        v.erase(i);
+    }
+    setBit(flagMasks[flagId], node->nodeId, false);
+}
+
+void SceneManager::clearNodes()
+{
+    nodes.clear();
+    nodeCount = 0;
+    flagNodes.clear();
+    flagMasks.clear();
+    visibleMask.clear();
+}
+
+void SceneManager::compactNodes()
+{
+    // renumbers the used nodes without changing their order, so that the
+    // #flagNodes vectors remain sorted, and rebuilds the bitsets
+    unsigned int n = 0;
+    for (unsigned int i = 0; i < nodes.size(); ++i) {
+        if (nodes[i] != NULL) {
+            nodes[i]->nodeId = n;
+            nodes[n++] = nodes[i];
+        }
+    }
+    nodes.resize(n);
+    visibleMask.clear();
+    for (unsigned int f = 0; f < flagMasks.size(); ++f) {
+        flagMasks[f].clear();
+    }
+    for (unsigned int i = 0; i < n; ++i) {
+        SceneNode *node = nodes[i];
+        setBit(visibleMask, i, node->isVisible);
+        const vector<unsigned int> &bits = node->flagBits;
+        for (unsigned int w = 0; w < bits.size(); ++w) {
+            unsigned int b = bits[w];
+            while (b != 0) {
+                setBit(flagMasks[(w << 5) + lowestBit(b)], i, true);
+                b &= b - 1;
+            }
+        }
+    }
+}
+
+void SceneManager::releaseNodes(SceneNode *node, vector<unsigned int> &flags)
+{
+    unsigned int id = node->nodeId;
+    const vector<unsigned int> &bits = node->flagBits;
+    for (unsigned int w = 0; w < bits.size(); ++w) {
+        unsigned int b = bits[w];
+        while (b != 0) {
+            unsigned int flagId = (w << 5) + lowestBit(b);
+            setBit(flagMasks[flagId], id, false);
+            setBit(flags, flagId, true);
+            b &= b - 1;
+        }
     }
+    setBit(visibleMask, id, false);
+    node->isVisible = false;
+    nodes[id] = NULL;
+    nodeCount -= 1;
+    // the owner is reset here so that the caller can recognize the released
+    // nodes; it is set again by the caller if needed (see SceneNode#swap)
+    node->owner = NULL;
     unsigned int n = node->getChildrenCount();
     for (unsigned int i = 0; i < n; ++i) {
-        buildNodeMap(node->getChild(i));
+        releaseNodes(node->getChild(i).get(), flags);
     }
 }
 
@@ -49,6 +49,14 @@
 namespace ork
 {
 
+class OcclusionCuller;
+
+class RenderQueue;
+
+class BatchRenderer;
+
+class RingBuffer;
+
 /**
  * A manager to manage a scene graph.
  * @ingroup scenegraph
@@ -66,9 +74,9 @@ public:
     };
 
     /**
-     * An iterator over a map of SceneNode.
+     * An iterator over a vector of SceneNode.
      */
-    typedef MultiMapIterator<std::string, ptr<SceneNode> > NodeIterator;
+    typedef VectorIterator< ptr<SceneNode> > NodeIterator;
 
     /**
      * Creates an empty SceneManager.
@@ -123,6 +131,30 @@ public:
      */
     NodeIterator getNodes(const std::string &flag);
 
+    /**
+     * Returns the nodes of the scene graph that have the given flag. The
+     * nodes are returned in the order in which they were added to the scene
+     * graph (i.e. in scene graph order for the nodes added with #setRoot),
+     * independently of the order in which the flags were added to them.
+     *
+     * @param flagId a SceneNode flag identifier (see SceneNode#getFlagId).
+     */
+    NodeIterator getNodes(unsigned int flagId);
+
+    /**
+     * Returns the nodes of the scene graph that have the given flag and whose
+     * SceneNode#isVisible flag was set by the last call to #update, in the
+     * order in which they were added to the scene graph (see #getNodes). This
+     * query is an intersection of two bitsets, and does not need to test the
+     * nodes one by one. The nodes attached to the scene graph since the last
+     * call to #update (including nodes moved from one parent to another) are
+     * considered invisible until the next call to #update.
+     *
+     * @param flagId a SceneNode flag identifier (see SceneNode#getFlagId).
+     * @param[out] nodes the vector to which the visible nodes must be added.
+     */
+    void getVisibleNodes(unsigned int flagId, std::vector< ptr<SceneNode> > &nodes);
+
     /**
      * Returns the SceneNode currently bound to the given loop variable.
      *
@@ -161,6 +193,61 @@ public:
      */
     void setScheduler(ptr<Scheduler> scheduler);
 
+    /**
+     * Returns the OcclusionCuller used to cull occluded nodes in #update.
+     */
+    ptr<OcclusionCuller> getOcclusionCuller();
+
+    /**
+     * Sets the OcclusionCuller used to cull occluded nodes in #update.
+     *
+     * @param culler an occlusion culler, or NULL to use frustum culling only.
+     */
+    void setOcclusionCuller(ptr<OcclusionCuller> culler);
+
+    /**
+     * Returns the RenderQueue used by the LoopTask in render queue mode. Its
+     * state change counters are reset at the beginning of each #draw.
+     */
+    ptr<RenderQueue> getRenderQueue();
+
+    /**
+     * Returns the BatchRenderer used by the LoopTask in batch mode. Its per
+     * draw data is streamed with the ring buffer of this manager (see
+     * #getStreamBuffer).
+     */
+    ptr<BatchRenderer> getBatchRenderer();
+
+    /**
+     * Returns the RingBuffer that tasks can use to stream per frame data to
+     * the GPU (see Mesh#setStreamBuffer). This ring buffer is created the
+     * first time this method is called, and advanced to its next frame at
+     * the end of each #draw.
+     */
+    ptr<RingBuffer> getStreamBuffer();
+
+    /**
+     * Returns the maximum number of LodMesh triangles to draw per frame, or
+     * 0 if there is no limit.
+     */
+    int getTriangleBudget();
+
+    /**
+     * Sets the maximum number of LodMesh triangles to draw per frame. When
+     * the levels selected from the screen size of the visible nodes exceed
+     * this budget, the levels of the smallest nodes on screen are coarsened
+     * first, until the budget is met or all nodes use their coarsest level.
+     *
+     * @param budget a number of triangles, or 0 to disable this limit.
+     */
+    void setTriangleBudget(int budget);
+
+    /**
+     * Returns the number of LodMesh triangles of the visible nodes, for the
+     * levels selected by the last call to #update.
+     */
+    int getTriangleCount();
+
     /**
      * Returns the transformation from camera space to screen space.
      */
@@ -217,6 +304,7 @@ public:
 
     /**
      * Executes the #getCameraMethod of the #getCameraNode node.
+     * Statistics#endFrame is called at the end of this method.
      */
     void draw();
 
@@ -322,9 +410,32 @@ private:
     ptr<Task> currentTask;
 
     /**
-     * A multimap that associates to each flag all the nodes having this flag.
+     * The nodes of the scene graph, indexed by SceneNode#nodeId, in the
+     * order in which they were added. Unused indices contain NULL.
+     */
+    std::vector<SceneNode*> nodes;
+
+    /**
+     * The number of non NULL entries in #nodes.
+     */
+    unsigned int nodeCount;
+
+    /**
+     * The nodes having each flag, sorted by SceneNode#nodeId, indexed by flag
+     * identifier.
+     */
+    std::vector< std::vector< ptr<SceneNode> > > flagNodes;
+
+    /**
+     * The nodes having each flag, as bitsets indexed by SceneNode#nodeId.
+     * This vector is indexed by flag identifier.
      */
-    std::multimap<std::string, ptr<SceneNode> > nodeMap;
+    std::vector< std::vector<unsigned int> > flagMasks;
+
+    /**
+     * The visible nodes, as a bitset indexed by SceneNode#nodeId.
+     */
+    std::vector<unsigned int> visibleMask;
 
     /**
      * A map that associates to each loop variable its current value.
@@ -341,6 +452,38 @@ private:
      */
     ptr<Scheduler> scheduler;
 
+    /**
+     * The OcclusionCuller used to cull occluded nodes, or NULL.
+     */
+    ptr<OcclusionCuller> occlusionCuller;
+
+    /**
+     * The RenderQueue used by the LoopTask in render queue mode.
+     */
+    ptr<RenderQueue> renderQueue;
+
+    /**
+     * The BatchRenderer used by the LoopTask in batch mode.
+     */
+    ptr<BatchRenderer> batchRenderer;
+
+    /**
+     * The RingBuffer returned by #getStreamBuffer, or NULL if it has not
+     * been created yet.
+     */
+    ptr<RingBuffer> streamBuffer;
+
+    /**
+     * The maximum number of LodMesh triangles to draw per frame, or 0.
+     */
+    int triangleBudget;
+
+    /**
+     * The number of LodMesh triangles of the visible nodes, for the levels
+     * selected by the last call to #update.
+     */
+    int triangleCount;
+
     /**
      * The current frame number.
      */
@@ -374,16 +517,66 @@ private:
     void computeVisibility(ptr<SceneNode> n, visibility v);
 
     /**
-     * Clears the #nodeMap map.
+     * Clears the SceneNode#isVisible flag of the nodes hidden by the
+     * occluders of the #occlusionCuller.
+     */
+    void computeOcclusion();
+
+    /**
+     * Selects the level of each LodMesh of the visible nodes, from their
+     * screen size and from the #triangleBudget.
+     */
+    void selectLods();
+
+    /**
+     * Adds the given node and its descendants to the node index.
+     *
+     * @param node a node of the scene graph managed by this manager.
+     */
+    void addNodes(ptr<SceneNode> node);
+
+    /**
+     * Removes the given node and its descendants from the node index.
+     *
+     * @param node a node of the scene graph managed by this manager.
+     */
+    void removeNodes(ptr<SceneNode> node);
+
+    /**
+     * Adds the given node to the nodes having the given flag.
+     *
+     * @param node a node of the scene graph managed by this manager.
+     * @param flagId the flag that has been added to this node.
+     */
+    void addNodeFlag(ptr<SceneNode> node, unsigned int flagId);
+
+    /**
+     * Removes the given node from the nodes having the given flag.
+     *
+     * @param node a node of the scene graph managed by this manager.
+     * @param flagId the flag that has been removed from this node.
+     */
+    void removeNodeFlag(ptr<SceneNode> node, unsigned int flagId);
+
+    /**
+     * Clears the node index.
+     */
+    void clearNodes();
+
+    /**
+     * Removes the unused indices of #nodes, by renumbering the nodes without
+     * changing their order, and rebuilds the node bitsets accordingly.
      */
-    void clearNodeMap();
+    void compactNodes();
 
     /**
-     * Builds the #nodeMap map for the given scene graph.
+     * Removes the given node and its descendants from #nodes, and from the
+     * flag bitsets. Their entries in #flagNodes are not removed.
      *
-     * @param node the root node of a scene graph.
+     * @param node a node of the scene graph managed by this manager.
+     * @param[in,out] flags the flags of the removed nodes, as a bitset.
      */
-    void buildNodeMap(ptr<SceneNode> node);
+    void releaseNodes(SceneNode *node, std::vector<unsigned int> &flags);
 
     friend class SceneNode;
 };
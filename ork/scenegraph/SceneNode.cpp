@@ -42,7 +42,9 @@
 #include "ork/scenegraph/SceneNode.h"
 
 #include <algorithm>
+#include <pthread.h>
 
+#include "ork/render/CommandList.h"
 #include "ork/render/FrameBuffer.h"
 #include "ork/resource/ResourceTemplate.h"
 #include "ork/scenegraph/SceneManager.h"
@@ -52,12 +54,30 @@ using namespace std;
 namespace ork
 {
 
-SceneNode::SceneNode() : Object("SceneNode"), owner(NULL)
+/**
+ * The maximum number of programs for which uniform bindings are cached in
+ * each scene node.
+ */
+static const unsigned int MAX_UNIFORM_BINDINGS = 8;
+
+/**
+ * Mutex used to synchronize accesses to SceneNode#flagIds and
+ * SceneNode#flagNames. Statically initialized, since flag identifiers can
+ * be requested before any scene node is created (e.g. by a LoopTask).
+ */
+static pthread_mutex_t flagMutex = PTHREAD_MUTEX_INITIALIZER;
+
+map<string, unsigned int> SceneNode::flagIds;
+
+vector<string> SceneNode::flagNames;
+
+SceneNode::SceneNode() : Object("SceneNode"), isVisible(false), owner(NULL), nodeId(0)
 {
     localToParent = mat4d::IDENTITY;
     localToWorld = mat4d::IDENTITY;
     worldToLocalUpToDate = false;
     localBounds = box3d(0.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+    localToCamera = mat4d::IDENTITY;
     localToScreen = mat4d::IDENTITY;
 }
 
@@ -135,23 +155,82 @@ SceneNode::FlagIterator SceneNode::getFlags()
 
 bool SceneNode::hasFlag(const string &flag)
 {
-    return flags.find(flag) != flags.end();
+    unsigned int id;
+    return findFlagId(flag, id) && hasFlag(id);
+}
+
+bool SceneNode::hasFlag(unsigned int flagId)
+{
+    unsigned int w = flagId >> 5;
+    return w < flagBits.size() && (flagBits[w] & (1u << (flagId & 31))) != 0;
 }
 
 void SceneNode::addFlag(const string &flag)
 {
+    unsigned int id = getFlagId(flag);
+    if (hasFlag(id)) {
+        return;
+    }
+    unsigned int w = id >> 5;
+    if (w >= flagBits.size()) {
+        flagBits.resize(w + 1, 0);
+    }
+    flagBits[w] |= 1u << (id & 31);
     flags.insert(flag);
     if (owner != NULL) {
-        owner->clearNodeMap();
+        owner->addNodeFlag(this, id);
     }
 }
 
 void SceneNode::removeFlag(const string &flag)
 {
+    unsigned int id;
+    if (!findFlagId(flag, id) || !hasFlag(id)) {
+        return;
+    }
+    flagBits[id >> 5] &= ~(1u << (id & 31));
     flags.erase(flag);
     if (owner != NULL) {
-        owner->clearNodeMap();
+        owner->removeNodeFlag(this, id);
+    }
+}
+
+unsigned int SceneNode::getFlagId(const string &flag)
+{
+    // the flag table is shared by all scene graphs, and can be accessed
+    // from several threads (e.g. from tasks executed by worker threads)
+    pthread_mutex_lock(&flagMutex);
+    unsigned int id;
+    map<string, unsigned int>::iterator i = flagIds.find(flag);
+    if (i != flagIds.end()) {
+        id = i->second;
+    } else {
+        id = (unsigned int) flagNames.size();
+        flagIds.insert(make_pair(flag, id));
+        flagNames.push_back(flag);
     }
+    pthread_mutex_unlock(&flagMutex);
+    return id;
+}
+
+string SceneNode::getFlagName(unsigned int flagId)
+{
+    pthread_mutex_lock(&flagMutex);
+    string name = flagId < flagNames.size() ? flagNames[flagId] : string();
+    pthread_mutex_unlock(&flagMutex);
+    return name;
+}
+
+bool SceneNode::findFlagId(const string &flag, unsigned int &flagId)
+{
+    pthread_mutex_lock(&flagMutex);
+    map<string, unsigned int>::iterator i = flagIds.find(flag);
+    bool found = i != flagIds.end();
+    if (found) {
+        flagId = i->second;
+    }
+    pthread_mutex_unlock(&flagMutex);
+    return found;
 }
 
 SceneNode::ValueIterator SceneNode::getValues()
@@ -168,11 +247,60 @@ ptr<Value> SceneNode::getValue(const string &name)
 void SceneNode::addValue(ptr<Value> value)
 {
     values.insert(make_pair(value->getName(), value));
+    uniformBindings.clear();
 }
 
 void SceneNode::removeValue(const string &name)
 {
     values.erase(name);
+    uniformBindings.clear();
+}
+
+void SceneNode::setUniforms(ptr<Program> p)
+{
+    UniformBindings *b = NULL;
+    for (unsigned int i = 0; i < uniformBindings.size(); ++i) {
+        if (uniformBindings[i].program == p.get()) {
+            b = &uniformBindings[i];
+            break;
+        }
+    }
+    if (b == NULL) {
+        if (uniformBindings.size() >= MAX_UNIFORM_BINDINGS) {
+            uniformBindings.erase(uniformBindings.begin());
+        }
+        uniformBindings.push_back(UniformBindings());
+        b = &uniformBindings.back();
+        b->program = p.get();
+        b->version = p->getUniformsVersion() + 1;
+    }
+    if (b->version != p->getUniformsVersion()) {
+        b->version = p->getUniformsVersion();
+        b->bindings.clear();
+        map<string, ptr<Value> >::iterator i = values.begin();
+        while (i != values.end()) {
+            ptr<Uniform> u = p->getUniform(i->first);
+            if (u != NULL) {
+                b->bindings.push_back(make_pair(i->second.get(), u.get()));
+            }
+            ++i;
+        }
+    }
+    for (unsigned int i = 0; i < b->bindings.size(); ++i) {
+        b->bindings[i].second->setValueIfChanged(b->bindings[i].first);
+    }
+}
+
+void SceneNode::recordUniforms(ptr<Program> p, CommandList &commands)
+{
+    map<string, ptr<Value> >::iterator i = values.begin();
+    while (i != values.end()) {
+        ptr<Uniform> u = p->getUniform(i->first);
+        if (u != NULL) {
+            commands.setValue(u, i->second);
+        }
+        ++i;
+    }
 }
 
 SceneNode::ModuleIterator SceneNode::getModules()
@@ -204,7 +332,11 @@ SceneNode::MeshIterator SceneNode::getMeshes()
 ptr<MeshBuffers> SceneNode::getMesh(const string &name)
 {
     map<string, ptr<MeshBuffers> >::iterator i = meshes.find(name);
-    return i == meshes.end() ? NULL : (*i).second;
+    if (i != meshes.end()) {
+        return i->second;
+    }
+    map<string, Lod>::iterator j = lods.find(name);
+    return j == lods.end() ? NULL : j->second.mesh->getMesh(j->second.drawLevel);
 }
 
 void SceneNode::addMesh(const string &name, ptr<MeshBuffers> m)
@@ -218,6 +350,33 @@ void SceneNode::removeMesh(const string &name)
     meshes.erase(name);
 }
 
+ptr<LodMesh> SceneNode::getLod(const string &name)
+{
+    map<string, Lod>::iterator i = lods.find(name);
+    return i == lods.end() ? NULL : i->second.mesh;
+}
+
+int SceneNode::getLodLevel(const string &name)
+{
+    map<string, Lod>::iterator i = lods.find(name);
+    return i == lods.end() ? -1 : i->second.drawLevel;
+}
+
+void SceneNode::addLod(const string &name, ptr<LodMesh> lod)
+{
+    assert(lod->getLevelCount() > 0);
+    Lod &l = lods[name];
+    l.mesh = lod;
+    l.level = 0;
+    l.drawLevel = 0;
+    localBounds = localBounds.enlarge(lod->getMesh(0)->bounds.cast<double>());
+}
+
+void SceneNode::removeLod(const string &name)
+{
+    lods.erase(name);
+}
+
 SceneNode::FieldIterator SceneNode::getFields()
 {
     return SceneNode::FieldIterator(fields);
@@ -286,23 +445,36 @@ void SceneNode::addChild(ptr<SceneNode> child)
         children.push_back(child);
         child->setOwner(owner);
         if (owner != NULL) {
-            owner->clearNodeMap();
+            owner->addNodes(child);
         }
     }
 }
 
 void SceneNode::removeChild(unsigned int index)
 {
+    ptr<SceneNode> child = children[index];
     children.erase(children.begin() + index);
+    if (owner != NULL) {
+        owner->removeNodes(child);
+        child->setOwner(NULL);
+    }
 }
 
 void SceneNode::swap(ptr<SceneNode> n)
 {
+    SceneManager *owner = this->owner;
+    if (owner != NULL) {
+        owner->removeNodes(this);
+    }
     std::swap(localToParent, n->localToParent);
     std::swap(flags, n->flags);
+    std::swap(flagBits, n->flagBits);
     std::swap(values, n->values);
+    uniformBindings.clear();
+    n->uniformBindings.clear();
     std::swap(modules, n->modules);
     std::swap(meshes, n->meshes);
+    std::swap(lods, n->lods);
     std::swap(methods, n->methods);
     std::swap(children, n->children);
     map<string, ptr<Method> >::iterator i;
@@ -314,11 +486,11 @@ void SceneNode::swap(ptr<SceneNode> n)
     while (i != n->methods.end()) {
         i->second->owner = n.get();
     }
-    if (owner != NULL) {
-        owner->clearNodeMap();
-    }
     setOwner(owner);
     n->setOwner(NULL);
+    if (owner != NULL) {
+        owner->addNodes(this);
+    }
 }
 
 void SceneNode::setOwner(SceneManager *owner)
@@ -860,6 +1032,13 @@ public:
                 ptr<MeshBuffers> mesh = manager->loadResource(string(value)).cast<MeshBuffers>();
                 addMesh(id, mesh);
 
+            } else if (strcmp(f->Value(), "lod") == 0) {
+                checkParameters(desc, f, "id,value,");
+                string id = getParameter(desc, f, "id");
+                string value = getParameter(desc, f, "value");
+                ptr<LodMesh> lod = manager->loadResource(string(value)).cast<LodMesh>();
+                addLod(id, lod);
+
             } else if (strcmp(f->Value(), "field") == 0) {
                 checkParameters(desc, f, "id,value,");
                 string id = getParameter(desc, f, "id");
@@ -49,7 +49,9 @@
 #include "ork/math/box3.h"
 #include "ork/core/Iterator.h"
 #include "ork/render/MeshBuffers.h"
+#include "ork/scenegraph/LodMesh.h"
 #include "ork/render/Module.h"
+#include "ork/render/Program.h"
 #include "ork/scenegraph/Method.h"
 
 namespace ork
@@ -66,6 +68,8 @@ namespace ork
 
 class SceneManager;
 
+class CommandList;
+
 /**
  * A scene graph node. A scene graph is a tree of generic scene nodes, where
  * each node can be seen as an object with a state (fields) and a behavior
@@ -198,6 +202,13 @@ public:
      */
     bool hasFlag(const std::string &flag);
 
+    /**
+     * Returns true is this node has the given flag.
+     *
+     * @param flagId a flag identifier (see #getFlagId).
+     */
+    bool hasFlag(unsigned int flagId);
+
     /**
      * Adds the given flag to the flags of this node.
      *
@@ -212,6 +223,23 @@ public:
      */
     void removeFlag(const std::string &flag);
 
+    /**
+     * Returns the identifier of the given flag. Flags are interned into small
+     * consecutive integers, shared by all scene nodes, so that they can be
+     * stored and compared as bits instead of strings. A new identifier is
+     * created if the flag was never used before.
+     *
+     * @param flag a flag.
+     */
+    static unsigned int getFlagId(const std::string &flag);
+
+    /**
+     * Returns the flag corresponding to the given identifier.
+     *
+     * @param flagId a flag identifier returned by #getFlagId.
+     */
+    static std::string getFlagName(unsigned int flagId);
+
     /**
      * Returns the values of this node.
      */
@@ -238,6 +266,29 @@ public:
      */
     void removeValue(const std::string &name);
 
+    /**
+     * Sets the uniforms of the given program from the values of this node.
+     * The uniforms corresponding to these values are looked up once, and
+     * are then cached until a value is added to or removed from this node,
+     * or until the uniforms of the program change. The uniforms whose value
+     * did not change since they were last set from this node are not set
+     * again (see Uniform#setValueIfChanged).
+     *
+     * @param p a program.
+     */
+    void setUniforms(ptr<Program> p);
+
+    /**
+     * Records commands to set the uniforms of the given program from the
+     * values of this node. Unlike #setUniforms this method does not use nor
+     * update the cached uniform bindings, and can therefore be called in any
+     * thread (see RecordTask).
+     *
+     * @param p a program.
+     * @param commands the list where the commands must be recorded.
+     */
+    void recordUniforms(ptr<Program> p, CommandList &commands);
+
     /**
      * Returns the modules of this node.
      */
@@ -271,7 +322,9 @@ public:
     MeshIterator getMeshes();
 
     /**
-     * Returns the mesh of this node whose local name is given.
+     * Returns the mesh of this node whose local name is given. If this name
+     * corresponds to a LodMesh (see #addLod), returns the mesh of the level
+     * selected for this node by the last call to SceneManager#update.
      *
      * @param name the local name of a mesh.
      */
@@ -292,6 +345,38 @@ public:
      */
     void removeMesh(const std::string &name);
 
+    /**
+     * Returns the LodMesh of this node whose local name is given.
+     *
+     * @param name the local name of a LodMesh.
+     */
+    ptr<LodMesh> getLod(const std::string &name);
+
+    /**
+     * Returns the level of the given LodMesh selected for this node by the
+     * last call to SceneManager#update, or -1 if there is no such LodMesh.
+     *
+     * @param name the local name of a LodMesh.
+     */
+    int getLodLevel(const std::string &name);
+
+    /**
+     * Adds a LodMesh to this node under the given local name. The mesh of
+     * the level selected by the SceneManager can then be retrieved with
+     * #getMesh, with this local name.
+     *
+     * @param name a local name.
+     * @param lod a LodMesh with at least one level.
+     */
+    void addLod(const std::string &name, ptr<LodMesh> lod);
+
+    /**
+     * Removes the LodMesh whose local name is given from this node.
+     *
+     * @param name the local name of the LodMesh.
+     */
+    void removeLod(const std::string &name);
+
     /**
      * Returns the fields of this node.
      */
@@ -434,11 +519,62 @@ private:
      */
     std::set<std::string> flags;
 
+    /**
+     * The flags of this node, as a bitset indexed by flag identifiers.
+     */
+    std::vector<unsigned int> flagBits;
+
+    /**
+     * The index of this node in the node index of its #owner. Only valid if
+     * #owner is not NULL.
+     */
+    unsigned int nodeId;
+
+    /**
+     * The identifiers of the flags used so far, indexed by flag name.
+     */
+    static std::map<std::string, unsigned int> flagIds;
+
+    /**
+     * The names of the flags used so far, indexed by flag identifier.
+     */
+    static std::vector<std::string> flagNames;
+
     /**
      * The values of this node.
      */
     std::map<std::string, ptr<Value> > values;
 
+    /**
+     * The uniforms of a program that correspond to the values of this node.
+     */
+    struct UniformBindings
+    {
+        /**
+         * The program whose uniforms are bound. This program may have been
+         * deleted, which is detected with #version.
+         */
+        Program *program;
+
+        /**
+         * The version of the program uniforms when #bindings was computed
+         * (see Program#getUniformsVersion).
+         */
+        unsigned int version;
+
+        /**
+         * The values of this node, with the corresponding uniforms of
+         * #program.
+         */
+        std::vector< std::pair<Value*, Uniform*> > bindings;
+    };
+
+    /**
+     * The uniform bindings of this node, for the programs used in
+     * #setUniforms. Cleared when the values of this node change.
+     */
+    std::vector<UniformBindings> uniformBindings;
+
     /**
      * The modules of this node.
      */
@@ -449,6 +585,35 @@ private:
      */
     std::map<std::string, ptr<MeshBuffers> > meshes;
 
+    /**
+     * A LodMesh used by this node, with the levels selected for this node.
+     */
+    struct Lod
+    {
+        /**
+         * The LodMesh.
+         */
+        ptr<LodMesh> mesh;
+
+        /**
+         * The level selected from the screen size of this node, before the
+         * triangle budget of the SceneManager is applied. Used to apply the
+         * hysteresis margin of the LodMesh.
+         */
+        int level;
+
+        /**
+         * The level actually drawn, after the triangle budget of the
+         * SceneManager is applied.
+         */
+        int drawLevel;
+    };
+
+    /**
+     * The LodMesh of this node.
+     */
+    std::map<std::string, Lod> lods;
+
     /**
      * The fields of this node.
      */
@@ -472,6 +637,15 @@ private:
      */
     void setOwner(SceneManager *owner);
 
+    /**
+     * Returns the identifier of the given flag, if it has already been used.
+     *
+     * @param flag a flag.
+     * @param[out] flagId the identifier of this flag, if it exists.
+     * @return true if this flag has an identifier.
+     */
+    static bool findFlagId(const std::string &flag, unsigned int &flagId);
+
     /**
      * Updates the #localToWorld transform. This method also updates #worldBounds
      * and #worldPos.
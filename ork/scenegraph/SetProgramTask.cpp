@@ -41,7 +41,9 @@
 
 #include "ork/scenegraph/SetProgramTask.h"
 
+#include "ork/core/GPUProfiler.h"
 #include "ork/resource/ResourceTemplate.h"
+#include "ork/scenegraph/RenderQueue.h"
 #include "ork/scenegraph/SceneManager.h"
 
 using namespace std;
@@ -93,6 +95,9 @@ ptr<Task> SetProgramTask::getTask(ptr<Object> context)
         }
         throw exception();
     }
+    if (RenderQueue::getCurrent() != NULL) {
+        RenderQueue::getCurrent()->setProgram(p, setUniforms ? n : NULL);
+    }
     return new Impl(p, setUniforms ? n : NULL);
 }
 
@@ -117,21 +122,29 @@ bool SetProgramTask::Impl::run()
             Resource *r = dynamic_cast<Resource*>(p.get());
             Logger::DEBUG_LOGGER->log("SCENEGRAPH", r == NULL ? "SetProgram" : "SetProgram '" + r->getName() + "'");
         }
-        if (n != NULL) {
-            SceneNode::ValueIterator i = n->getValues();
-            while (i.hasNext()) {
-                ptr<Value> v = i.next();
-                ptr<Uniform> u = p->getUniform(v->getName());
-                if (u != NULL) {
-                    u->setValue(v);
-                }
-            }
+        GPUProfiler::setOwner(n.get());
+        if (n != NULL && p->isReady()) {
+            n->setUniforms(p);
         }
         SceneManager::setCurrentProgram(p);
     }
     return true;
 }
 
+bool SetProgramTask::Impl::record(CommandList &commands)
+{
+    if (p != NULL && p->isPending()) {
+        return false;
+    }
+    if (p != NULL) {
+        if (n != NULL) {
+            n->recordUniforms(p, commands);
+        }
+        commands.setProgram(p);
+    }
+    return true;
+}
+
 /// @cond RESOURCES
 
 class SetProgramTaskResource : public ResourceTemplate<40, SetProgramTask>
@@ -25,6 +25,7 @@
 
 #include "ork/render/Program.h"
 #include "ork/scenegraph/AbstractTask.h"
+#include "ork/scenegraph/RecordTask.h"
 
 namespace ork
 {
@@ -98,7 +99,7 @@ private:
     /**
      * A ork::Task to set a program.
      */
-    class Impl : public Task
+    class Impl : public Task, public Recordable
     {
     public:
         /**
@@ -125,6 +126,8 @@ private:
         virtual ~Impl();
 
         virtual bool run();
+
+        virtual bool record(CommandList &commands);
     };
 };
 
@@ -43,6 +43,7 @@
 
 #include "ork/render/FrameBuffer.h"
 #include "ork/resource/ResourceTemplate.h"
+#include "ork/scenegraph/RenderQueue.h"
 #include "ork/scenegraph/SceneManager.h"
 
 using namespace std;
@@ -117,6 +118,9 @@ ptr<Task> SetTargetTask::getTask(ptr<Object> context)
         throw exception();
     }
 
+    if (RenderQueue::getCurrent() != NULL) {
+        RenderQueue::getCurrent()->setTarget(this, textures);
+    }
     return new Impl(this, textures);
 }
 
@@ -57,16 +57,16 @@ SetTransformsTask::SetTransformsTask() : AbstractTask("SetTransformsTask")
 SetTransformsTask::SetTransformsTask(const string &screen, QualifiedName m,
         const char *t, const char *ltow, const char *ltos,
         const char *ctow, const char *ctos, const char *stoc,
-        const char *wtos, const char *wp, const char *wd) :
+        const char *wtos, const char *wp, const char *wd, const char *b) :
     AbstractTask("SetTransformsTask")
 {
-    init(screen, m, t, ltow, ltos, ctow, ctos, stoc, wtos, wp, wd);
+    init(screen, m, t, ltow, ltos, ctow, ctos, stoc, wtos, wp, wd, b);
 }
 
 void SetTransformsTask::init(const string &screen, QualifiedName m,
         const char *t, const char *ltow, const char *ltos,
         const char *ctow, const char *ctos, const char *stoc,
-        const char *wtos, const char *wp, const char *wd)
+        const char *wtos, const char *wp, const char *wd, const char *b)
 {
     this->screen = QualifiedName(screen + ".");
     this->m = m;
@@ -79,6 +79,7 @@ void SetTransformsTask::init(const string &screen, QualifiedName m,
     this->wtos = wtos;
     this->wp = wp;
     this->wd = wd;
+    this->b = b;
     this->time = NULL;
     this->localToWorld = NULL;
     this->localToScreen = NULL;
@@ -144,6 +145,7 @@ void SetTransformsTask::swap(ptr<SetTransformsTask> t)
     std::swap(stoc, t->stoc);
     std::swap(wp, t->wp);
     std::swap(wd, t->wd);
+    std::swap(b, t->b);
 
     if (lastProg != NULL) {
         time = this->t == NULL ? NULL : lastProg->getUniform2f(this->t);
@@ -180,7 +182,7 @@ bool SetTransformsTask::Impl::run()
         prog = SceneManager::getCurrentProgram();
     }
 
-    if (prog == NULL) {
+    if (prog == NULL || !prog->isReady()) {
         return true;
     }
     if (Logger::DEBUG_LOGGER != NULL) {
@@ -198,6 +200,12 @@ bool SetTransformsTask::Impl::run()
         source->worldPos = source->wp == NULL ? NULL : prog->getUniform3f(source->wp);
         source->worldDir = source->wd == NULL ? NULL : prog->getUniform3f(source->wd);
         source->lastProg = prog;
+        if (source->b != NULL) {
+            ptr<UniformBlock> block = prog->getUniformBlock(source->b);
+            if (block != NULL) {
+                block->setStreamBuffer(context->getOwner()->getStreamBuffer());
+            }
+        }
     }
 
     if (source->time != NULL) {
@@ -255,6 +263,83 @@ bool SetTransformsTask::Impl::run()
     return true;
 }
 
+bool SetTransformsTask::Impl::record(CommandList &commands)
+{
+    ptr<Program> prog = NULL;
+    if (source->module != NULL && !source->module->getUsers().empty()) {
+        prog = *(source->module->getUsers().begin());
+    } else {
+        prog = commands.getProgram();
+    }
+
+    if (prog == NULL || prog->isPending() || source->b != NULL) {
+        return false;
+    }
+
+    ptr<SceneManager> manager = context->getOwner();
+    ptr<Uniform2f> u2;
+    ptr<Uniform3f> u3;
+    ptr<UniformMatrix4f> m4;
+
+    u2 = source->t == NULL ? NULL : prog->getUniform2f(source->t);
+    if (u2 != NULL) {
+        commands.set(u2, vec2f(manager->getTime(), manager->getElapsedTime()));
+    }
+
+    m4 = source->ltow == NULL ? NULL : prog->getUniformMatrix4f(source->ltow);
+    if (m4 != NULL) {
+        commands.setMatrix(m4, context->getLocalToWorld().cast<float>());
+    }
+
+    m4 = source->ltos == NULL ? NULL : prog->getUniformMatrix4f(source->ltos);
+    if (m4 != NULL) {
+        if (source->screen.target.size() == 0) {
+            commands.setMatrix(m4, context->getLocalToScreen().cast<float>());
+        } else {
+            mat4d ltow = context->getLocalToWorld();
+            mat4d wtos = screenNode->getWorldToLocal();
+            commands.setMatrix(m4, (wtos * ltow).cast<float>());
+        }
+    }
+
+    m4 = source->ctow == NULL ? NULL : prog->getUniformMatrix4f(source->ctow);
+    if (m4 != NULL) {
+        commands.setMatrix(m4, manager->getCameraNode()->getLocalToWorld().cast<float>());
+    }
+
+    m4 = source->ctos == NULL ? NULL : prog->getUniformMatrix4f(source->ctos);
+    if (m4 != NULL) {
+        commands.setMatrix(m4, manager->getCameraToScreen().cast<float>());
+    }
+
+    m4 = source->stoc == NULL ? NULL : prog->getUniformMatrix4f(source->stoc);
+    if (m4 != NULL) {
+        commands.setMatrix(m4, manager->getCameraToScreen().inverse().cast<float>());
+    }
+
+    m4 = source->wtos == NULL ? NULL : prog->getUniformMatrix4f(source->wtos);
+    if (m4 != NULL) {
+        if (source->screen.target.size() == 0) {
+            commands.setMatrix(m4, manager->getWorldToScreen().cast<float>());
+        } else {
+            commands.setMatrix(m4, screenNode->getWorldToLocal().cast<float>());
+        }
+    }
+
+    u3 = source->wp == NULL ? NULL : prog->getUniform3f(source->wp);
+    if (u3 != NULL) {
+        commands.set(u3, context->getWorldPos().cast<float>());
+    }
+
+    u3 = source->wd == NULL ? NULL : prog->getUniform3f(source->wd);
+    if (u3 != NULL) {
+        vec4d d = context->getLocalToWorld() * vec4d::UNIT_Z;
+        commands.set(u3, vec3f((float) -d.x, (float) -d.y, (float) -d.z));
+    }
+
+    return true;
+}
+
 /// @cond RESOURCES
 
 class SetTransformsTaskResource : public ResourceTemplate<40, SetTransformsTask>
@@ -264,7 +349,7 @@ public:
         ResourceTemplate<40, SetTransformsTask>(manager, name, desc)
     {
         e = e == NULL ? desc->descriptor : e;
-        checkParameters(desc, e, "screen,time,localToWorld,localToScreen,cameraToWorld,cameraToScreen,screenToCamera,module,worldToScreen,worldPos,worldDir,");
+        checkParameters(desc, e, "screen,time,localToWorld,localToScreen,cameraToWorld,cameraToScreen,screenToCamera,module,worldToScreen,worldPos,worldDir,block,");
 
         const char* s = e->Attribute("screen");
         string screen = s == NULL ? "" : string(e->Attribute("screen"));
@@ -281,7 +366,8 @@ public:
         const char *worldToScreen = e->Attribute("worldToScreen");
         const char *worldPos = e->Attribute("worldPos");
         const char *worldDir = e->Attribute("worldDir");
-        init(screen, module, time, localToWorld, localToScreen, cameraToWorld, cameraToScreen, screenToCamera, worldToScreen, worldPos, worldDir);
+        const char *block = e->Attribute("block");
+        init(screen, module, time, localToWorld, localToScreen, cameraToWorld, cameraToScreen, screenToCamera, worldToScreen, worldPos, worldDir, block);
     }
 };
 
@@ -44,6 +44,7 @@
 
 #include "ork/scenegraph/AbstractTask.h"
 #include "ork/render/Program.h"
+#include "ork/scenegraph/RecordTask.h"
 
 namespace ork
 {
@@ -83,11 +84,14 @@ public:
      *      of the origin of the local frame.
      * @param wd the vec3 uniform to be set to the world coordinates
      *      of the unit z vector of the local frame.
+     * @param b the uniform block containing the above uniforms, if they
+     *      must be streamed to the GPU via the stream buffer of the scene
+     *      manager (see UniformBlock#setStreamBuffer), or NULL.
      */
     SetTransformsTask(const std::string &screen, QualifiedName m,
         const char *t, const char *ltow, const char *ltos,
         const char *ctow, const char *ctos, const char *stoc,
-        const char *wtos, const char *wp, const char *wd);
+        const char *wtos, const char *wp, const char *wd, const char *b = NULL);
 
     /**
      * Deletes this SetTransformsTask.
@@ -110,7 +114,7 @@ protected:
     void init(const std::string &screen, QualifiedName m,
         const char *t, const char *ltow, const char *ltos,
         const char *ctow, const char *ctos, const char *stoc,
-        const char *wtos, const char *wp, const char *wd);
+        const char *wtos, const char *wp, const char *wd, const char *b = NULL);
 
     /**
      * Swaps this SetTransformsTask with the given one.
@@ -168,10 +172,12 @@ private:
 
     const char *wd;
 
+    const char *b;
+
     /**
      * An ork::Task to set transformation matrices in programs.
      */
-    class Impl : public Task
+    class Impl : public Task, public Recordable
     {
     public:
         /**
@@ -196,6 +202,13 @@ private:
 
         virtual bool run();
 
+        /**
+         * Records the uniform values set by #run. The uniforms are looked up
+         * in the program without using the cache of #source. Programs with a
+         * streamed uniform block cannot be recorded.
+         */
+        virtual bool record(CommandList &commands);
+
     private:
         /**
          * The SceneNode that contains the Method to which #source belongs.
@@ -41,6 +41,7 @@
 
 #include "ork/scenegraph/ShowInfoTask.h"
 
+#include "ork/core/Statistics.h"
 #include "ork/render/FrameBuffer.h"
 #include "ork/resource/ResourceTemplate.h"
 #include "ork/scenegraph/SceneManager.h"
@@ -54,7 +55,7 @@ void initInfoTask(ptr<ResourceManager> manager, const string &name, ptr<Resource
     ptr<Font> &f, ptr<Program> &p, int &c, float &size, vec3i &pos)
 {
     e = e == NULL ? desc->descriptor : e;
-    Resource::checkParameters(desc, e, "name,x,y,maxLines,font,fontSize,fontColor,fontProgram,");
+    Resource::checkParameters(desc, e, "name,x,y,maxLines,font,fontSize,fontColor,fontProgram,statistics,");
     int x = 4;
     int y = -4;
     int maxLines = 8;
@@ -104,6 +105,8 @@ void initInfoTask(ptr<ResourceManager> manager, const string &name, ptr<Resource
 
 static_ptr< Mesh<Font::Vertex, unsigned int> > ShowInfoTask::fontMesh;
 
+static_ptr<RingBuffer> ShowInfoTask::fontMeshStream;
+
 map<string, string> ShowInfoTask::infos;
 
 ShowInfoTask::ShowInfoTask() : AbstractTask("ShowInfoTask")
@@ -127,8 +130,9 @@ void ShowInfoTask::init(ptr<Font> f, ptr<Program> p, int color, float size, vec3
     fontColor = color;
     position = pos;
     fontHeight = size;
+    statistics = false;
     if (fontMesh == NULL) {
-        fontMesh = new Mesh<Font::Vertex, unsigned int>(TRIANGLES, CPU);
+        fontMesh = new Mesh<Font::Vertex, unsigned int>(TRIANGLES, GPU_STREAM);
         fontMesh->addAttributeType(0, 4, A16F, false);
         fontMesh->addAttributeType(1, 4, A8UI, true);
     }
@@ -148,6 +152,11 @@ void ShowInfoTask::setInfo(const string &topic, const string &info)
     infos[topic] = info;
 }
 
+void ShowInfoTask::setShowStatistics(bool show)
+{
+    statistics = show;
+}
+
 void ShowInfoTask::drawLine(const vec4f &vp, float xs, float ys, int color, const string &s)
 {
     font->addLine(vp, xs, ys, s, fontHeight, color, fontMesh);
@@ -159,6 +168,12 @@ void ShowInfoTask::draw(ptr<Method> context)
         Logger::DEBUG_LOGGER->log("SCENEGRAPH", "ShowInfo");
     }
 
+    ptr<RingBuffer> stream = context->getOwner()->getOwner()->getStreamBuffer();
+    if (fontMeshStream != stream) {
+        fontMeshStream = stream;
+        fontMesh->setStreamBuffer(stream);
+    }
+
     ptr<FrameBuffer> fb = SceneManager::getCurrentFrameBuffer();
     fb->setBlend(true, ADD, SRC_ALPHA, ONE_MINUS_SRC_ALPHA, ADD, ZERO, ONE);
 
@@ -187,6 +202,10 @@ void ShowInfoTask::draw(ptr<Method> context)
         os << i->second << " FPS";
     }
 
+    if (statistics) {
+        infos["STATISTICS"] = Statistics::toString();
+    }
+
     fontMesh->clear();
     drawLine(vp, xs, ys, fontColor, os.str());
     ys += fontHeight;
@@ -216,6 +235,7 @@ void ShowInfoTask::swap(ptr<ShowInfoTask> t)
     std::swap(fontColor, t->fontColor);
     std::swap(fontHeight, t->fontHeight);
     std::swap(position, t->position);
+    std::swap(statistics, t->statistics);
     std::swap(fps, t->fps);
     std::swap(frames, t->frames);
     std::swap(start, t->start);
@@ -256,6 +276,10 @@ public:
         float size;
         initInfoTask(manager, name, desc, e, f, p, c, size, pos);
         init(f, p, c, size, pos);
+        e = e == NULL ? desc->descriptor : e;
+        if (e->Attribute("statistics") != NULL && strcmp(e->Attribute("statistics"), "true") == 0) {
+            setShowStatistics(true);
+        }
     }
 };
 
@@ -87,12 +87,25 @@ public:
      */
     static void setInfo(const std::string &topic, const std::string &info);
 
+    /**
+     * Sets if the rendering statistics of the last frame must be displayed,
+     * in addition to the framerate (see Statistics#toString).
+     */
+    void setShowStatistics(bool show);
+
 protected:
     /**
      * The mesh used to draw character quads, in order to display text.
      */
     static static_ptr< Mesh<Font::Vertex, unsigned int> > fontMesh;
 
+    /**
+     * The ring buffer last set as the stream buffer of #fontMesh. It is not
+     * set again if the mesh reverts to its own buffers because the ring
+     * buffer is full, so that this is logged only once.
+     */
+    static static_ptr<RingBuffer> fontMeshStream;
+
     /**
      * The current information messages, associated with their topic.
      */
@@ -128,6 +141,11 @@ protected:
      */
     vec3i position;
 
+    /**
+     * True to display the rendering statistics of the last frame.
+     */
+    bool statistics;
+
     /**
      * Creates an uninitialized ShowInfoTask.
      */
@@ -43,10 +43,13 @@
 
 #include "pmath.h"
 #include <time.h>
+#include <algorithm>
 #include <fstream>
 
 #include "ork/core/Timer.h"
+#include "ork/core/GPUProfiler.h"
 #include "ork/core/Logger.h"
+#include "ork/core/Profiler.h"
 #include "ork/resource/ResourceTemplate.h"
 #include "ork/taskgraph/TaskGraph.h"
 
@@ -76,6 +79,10 @@ using namespace std;
 // (more precise than using Sleep and pthread_cond_timedwait)
 //#define BUSY_WAITING
 
+// the period, in microseconds, at which the main thread polls the GL fences
+// awaited by suspended tasks, when it has nothing else to do
+#define FENCE_POLLING_PERIOD 100
+
 /**
  * Returns the current time.
  *
@@ -107,6 +114,29 @@ static void getAbsoluteTime(timespec &ts)
 #endif
 }
 
+/**
+ * Waits until the given condition is signaled, for at most
+ * FENCE_POLLING_PERIOD microseconds.
+ *
+ * @param cond the condition to wait for.
+ * @param mutex the mutex associated with cond, which must be locked.
+ * @param deadline an optional deadline before the end of the polling period.
+ */
+static void pollingWait(pthread_cond_t *cond, pthread_mutex_t *mutex, const timespec *deadline)
+{
+    timespec ts;
+    getAbsoluteTime(ts);
+    ts.tv_nsec += FENCE_POLLING_PERIOD * 1000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec += 1;
+        ts.tv_nsec -= 1000000000;
+    }
+    if (deadline != NULL && (deadline->tv_sec < ts.tv_sec || (deadline->tv_sec == ts.tv_sec && deadline->tv_nsec < ts.tv_nsec))) {
+        ts = *deadline;
+    }
+    pthread_cond_timedwait(cond, mutex, &ts);
+}
+
 namespace ork
 {
 
@@ -125,10 +155,16 @@ bool MultithreadScheduler::taskKeySort::operator()(const taskKey &x, const taskK
 
 bool MultithreadScheduler::taskSort::operator()(const ptr<Task> x, const ptr<Task> y) const
 {
-    int xDuration = int(x->getExpectedDuration());
-    int yDuration = int(y->getExpectedDuration());
+    return isBefore(x->rank, int(x->getExpectedDuration()), x->sequence, y->rank, int(y->getExpectedDuration()), y->sequence);
+}
+
+bool MultithreadScheduler::isBefore(float xRank, int xDuration, unsigned int xSequence, float yRank, int yDuration, unsigned int ySequence)
+{
+    if (xRank != yRank) {
+        return xRank > yRank;
+    }
     if (xDuration == yDuration) {
-        return x.get() < y.get();
+        return xSequence < ySequence;
     } else {
         return xDuration < yDuration;
     }
@@ -154,6 +190,7 @@ void MultithreadScheduler::init(int prefetchRate, int prefetchQueue, float frame
     pthread_cond_init((pthread_cond_t*) cpuTasksCond, NULL);
     this->prefetchRate = prefetchRate;
     this->prefetchQueueSize = prefetchQueue;
+    schedulingPolicy = SHORTEST_FIRST;
     framePeriod = frameRate == 0.0f ? 0.0f : 1e6f / frameRate;
     if (prefetchRate > 0 || frameRate > 0.0f) {
         assert(prefetchQueueSize > 0);
@@ -185,6 +222,19 @@ MultithreadScheduler::~MultithreadScheduler()
         pthread_join(*((pthread_t*) threads[i]), NULL);
         delete (pthread_t*) threads[i];
     }
+    // we then unregister from the events awaited by suspended tasks, so
+    // that they cannot notify this scheduler after it is deleted
+    vector< ptr<TaskEvent> > events;
+    pthread_mutex_lock((pthread_mutex_t*) mutex);
+    map< ptr<TaskEvent>, vector< ptr<Task> > >::iterator i = suspendedTasks.begin();
+    while (i != suspendedTasks.end()) {
+        events.push_back(i->first);
+        ++i;
+    }
+    pthread_mutex_unlock((pthread_mutex_t*) mutex);
+    for (unsigned int j = 0; j < events.size(); ++j) {
+        events[j]->removeListener(this);
+    }
     // we can then delete the mutex and the conditions
     pthread_mutex_destroy((pthread_mutex_t*) mutex);
     delete (pthread_mutex_t*) mutex;
@@ -214,12 +264,16 @@ bool MultithreadScheduler::supportsPrefetch(bool gpuTasks)
 
 void MultithreadScheduler::schedule(ptr<Task> task)
 {
+    Profiler::Zone zone("MultithreadScheduler::schedule");
     set<Task*> initialized;
     task->init(initialized);
     pthread_mutex_lock((pthread_mutex_t*) mutex);
     bool noCpuTasks = readyCpuTasks.empty();
     set< ptr<Task> > addedTasks;
     addFlattenedTask(task, addedTasks);
+    if (schedulingPolicy == CRITICAL_PATH) {
+        updateRanks();
+    }
     pthread_cond_broadcast((pthread_cond_t*) allTasksCond);
     if (noCpuTasks && !readyCpuTasks.empty()) {
         // if there was no ready CPU tasks before this method was called,
@@ -244,9 +298,13 @@ void MultithreadScheduler::reschedule(ptr<Task> task, Task::reason r, unsigned i
 
 void MultithreadScheduler::run(ptr<Task> task)
 {
+    Profiler::Zone zone("MultithreadScheduler::run");
     Timer timer;
     timer.start();
     schedule(task);
+    // the GL fences awaited by prefetching tasks are otherwise only polled
+    // when this thread waits for tasks
+    pollFenceEvents();
     double schedule = timer.end();
 
     if (Logger::DEBUG_LOGGER != NULL) {
@@ -272,7 +330,7 @@ void MultithreadScheduler::run(ptr<Task> task)
             frameStatistics.insert(make_pair(monitoredTasks[i], make_pair(0, 0.0f)));
         }
         if (bufferedStatistics == NULL) {
-            bufferedStatistics = new float[(2 * monitoredTasks.size() + 2) * 1000];
+            bufferedStatistics = new float[(3 * monitoredTasks.size() + 2) * 1000];
         }
     }
 
@@ -309,28 +367,57 @@ void MultithreadScheduler::run(ptr<Task> task)
                 double timeout = min(deadline, timer.start() + 500.0);
                 while (timer.start() < timeout) {
                 }
+                pollFenceEvents();
                 pthread_mutex_lock((pthread_mutex_t*) mutex);
             }
 #else
             while (allReadyTasks.empty() && timer.start() < deadline) {
                 // so we wait for a ready CPU or GPU task,
                 // and stop when the deadline is passed
-                pthread_cond_timedwait((pthread_cond_t*) allTasksCond, (pthread_mutex_t*) mutex, &deadlinespec);
+                if (fenceEvents.empty()) {
+                    pthread_cond_timedwait((pthread_cond_t*) allTasksCond, (pthread_mutex_t*) mutex, &deadlinespec);
+                } else {
+                    // GL fences do not notify their completion, they must
+                    // be polled, in this thread
+                    pthread_mutex_unlock((pthread_mutex_t*) mutex);
+                    bool signaled = pollFenceEvents();
+                    pthread_mutex_lock((pthread_mutex_t*) mutex);
+                    if (!signaled) {
+                        pollingWait((pthread_cond_t*) allTasksCond, (pthread_mutex_t*) mutex, &deadlinespec);
+                    }
+                }
             }
 #endif
         } else {
             // here either some tasks for the current frame are not completed
             // or they are all completed but we do not have a fixed framerate
-            while (!immediateTasks.empty() && (allReadyTasks.empty() || allReadyTasks.begin()->first.first > 0)) {
+            while (!immediateTasks.empty() && (allReadyTasks.empty() || allReadyTasks.begin()->first.first > 0) && !hasParallelTask(true)) {
                 // while some tasks for the current frame remain to be executed,
                 // and while the set of tasks ready to be executed is empty or
-                // contains only tasks for the next frames (deadline > 0), wait
-                pthread_cond_wait((pthread_cond_t*) allTasksCond, (pthread_mutex_t*) mutex);
+                // contains only tasks for the next frames (deadline > 0), and
+                // while there is no parallel task for the current frame to
+                // help with, wait
+                if (fenceEvents.empty()) {
+                    pthread_cond_wait((pthread_cond_t*) allTasksCond, (pthread_mutex_t*) mutex);
+                } else {
+                    // same as above for the GL fences
+                    pthread_mutex_unlock((pthread_mutex_t*) mutex);
+                    bool signaled = pollFenceEvents();
+                    pthread_mutex_lock((pthread_mutex_t*) mutex);
+                    if (!signaled) {
+                        pollingWait((pthread_cond_t*) allTasksCond, (pthread_mutex_t*) mutex, NULL);
+                    }
+                }
             }
         }
+        // if a parallel task for the current frame is being executed by other
+        // threads, we help them first
+        int range = -1;
+        ptr<ParallelForTask> p = joinParallelTask(true, range);
+        bool started = false;
         // if the deadline is passed or if all the tasks for the current frame
         // are completed, there may not be any task ready to be executed
-        if (!allReadyTasks.empty()) {
+        if (p == NULL && !allReadyTasks.empty()) {
             // but if there is at least one we pick one, if possible with the
             // same execution context as the last executed GPU task
             t = getTask(allReadyTasks, previousGpuTask == NULL ? NULL : previousGpuTask->getContext());
@@ -356,9 +443,16 @@ void MultithreadScheduler::run(ptr<Task> task)
                 // sets that may contain it (but we do not update the
                 // dependencies yet, this will be done after the task execution
                 // in #taskDone
-                immediateTasks.erase(t);
                 removeTask(allReadyTasks, t);
                 removeTask(readyCpuTasks, t);
+                // a parallel task remains in the immediate tasks until all
+                // its iterations are completed (see #taskDone)
+                p = startParallelTask(t, range);
+                if (p == NULL) {
+                    immediateTasks.erase(t);
+                } else {
+                    started = true;
+                }
             }
         }
         // we can now release the mutex since we will not read or modify the
@@ -367,6 +461,18 @@ void MultithreadScheduler::run(ptr<Task> task)
         // from the task sets.
         pthread_mutex_unlock((pthread_mutex_t*) mutex);
 
+        if (p != NULL) {
+            // executes iterations of the started or joined parallel task
+            executeParallelTask(p, range, started);
+            if (t != NULL) {
+                ++run;
+                if (t->getDeadline() > 0) {
+                    ++prefetched;
+                }
+            }
+            continue;
+        }
+
         if (t == NULL) {
             // stops the infinite execution loop
             break;
@@ -401,6 +507,8 @@ void MultithreadScheduler::run(ptr<Task> task)
                 // if we have a fixed framerate we measure the execution time
                 // of each task in order to get statistics about tasks, used to
                 // get estimated durations for future tasks
+                Profiler::Zone taskZone(t->getClass());
+                GPUProfiler::Zone gpuZone(t->isGpuTask() ? t->getClass() : NULL);
                 timer.start();
                 changes = t->run();
                 double duration = timer.end();
@@ -416,6 +524,8 @@ void MultithreadScheduler::run(ptr<Task> task)
                 }
             } else {
                 // otherwise we execute tasks without computing statistics
+                Profiler::Zone taskZone(t->getClass());
+                GPUProfiler::Zone gpuZone(t->isGpuTask() ? t->getClass() : NULL);
                 changes = t->run();
             }
 
@@ -425,8 +535,11 @@ void MultithreadScheduler::run(ptr<Task> task)
             }
         }
         // this updates the task dependencies, and signals other threads when
-        // new tasks become ready to be executed
-        taskDone(t, changes);
+        // new tasks become ready to be executed (unless t is waiting for an
+        // event, in which case it will be executed again later)
+        if (!suspendTask(t, changes)) {
+            taskDone(t, changes);
+        }
     }
 
     if (previousGpuTask != NULL) {
@@ -465,20 +578,50 @@ void MultithreadScheduler::run(ptr<Task> task)
 #endif
     }
 
+    // ends the frame for the GPU profiler, which reads back the GPU times of
+    // the previous frames whose results are now available
+    unsigned int gpuFrame = GPUProfiler::getFrame();
+    if (GPUProfiler::isEnabled()) {
+        GPUProfiler::endFrame();
+    }
+
     if (monitoredTasks.size() > 0) {
         double total = timer.start() - lastFrame;
         if (bufferedFrames == 1000) {
             clearBufferedFrames();
         }
-        int s = bufferedFrames * (2 * monitoredTasks.size() + 2);
+        int s = bufferedFrames * (3 * monitoredTasks.size() + 2);
         bufferedStatistics[s++] = static_cast<float>(schedule);
         bufferedStatistics[s++] = static_cast<float>(total);
         for (unsigned int i = 0; i < monitoredTasks.size(); ++i) {
             pair<int, float> nt = frameStatistics[monitoredTasks[i]];
             bufferedStatistics[s++] = (float) nt.first;
             bufferedStatistics[s++] = nt.second;
+            bufferedStatistics[s++] = 0.0f;
+        }
+        if (GPUProfiler::isEnabled()) {
+            gpuStatisticsFrames[gpuFrame] = bufferedFrames;
         }
         bufferedFrames += 1;
+
+        // the GPU times are only available a few frames later; we fill the
+        // buffered frames whose GPU times are now available
+        map<unsigned int, int>::iterator i = gpuStatisticsFrames.begin();
+        while (i != gpuStatisticsFrames.end()) {
+            map< string, pair<int, float> > gpuStatistics;
+            if (GPUProfiler::getStatistics(i->first, gpuStatistics)) {
+                int s = i->second * (3 * monitoredTasks.size() + 2) + 2;
+                for (unsigned int j = 0; j < monitoredTasks.size(); ++j) {
+                    bufferedStatistics[s + 3 * j + 2] = gpuStatistics[monitoredTasks[j]].second;
+                }
+                gpuStatisticsFrames.erase(i++);
+            } else if (GPUProfiler::getFrame() - i->first > 16) {
+                // the GPU times of this frame have been discarded
+                gpuStatisticsFrames.erase(i++);
+            } else {
+                ++i;
+            }
+        }
     }
 
     // measures the current time at the end of this method, to compute a
@@ -491,6 +634,21 @@ void MultithreadScheduler::monitorTask(const string &taskType)
     monitoredTasks.push_back(taskType);
 }
 
+MultithreadScheduler::policy MultithreadScheduler::getPolicy() const
+{
+    return schedulingPolicy;
+}
+
+void MultithreadScheduler::setPolicy(policy p)
+{
+    pthread_mutex_lock((pthread_mutex_t*) mutex);
+    if (schedulingPolicy != p) {
+        schedulingPolicy = p;
+        updateRanks();
+    }
+    pthread_mutex_unlock((pthread_mutex_t*) mutex);
+}
+
 void MultithreadScheduler::addFlattenedTask(ptr<Task> t, set< ptr<Task> > &addedTasks)
 {
     // NOTE: the mutex should be locked before calling this method!
@@ -503,6 +661,12 @@ void MultithreadScheduler::addFlattenedTask(ptr<Task> t, set< ptr<Task> > &added
     }
     ptr<TaskGraph> tg = t.cast<TaskGraph>();
     if (tg == NULL) {
+        ptr<SuspendableTask> st = t.cast<SuspendableTask>();
+        if (st != NULL && st->suspended) {
+            // a suspended task will be put back in the ready tasks when the
+            // event it is waiting for is signaled
+            return;
+        }
         if (t->getDeadline() == 0) {
             immediateTasks.insert(t);
         } else {
@@ -634,6 +798,65 @@ void MultithreadScheduler::setDeadline(ptr<Task> t, unsigned int deadline, set<
     }
 }
 
+void MultithreadScheduler::updateRanks()
+{
+    // NOTE: the mutex should be locked before calling this method!
+    map<Task*, float> ranks;
+    set< ptr<Task> >::iterator i = immediateTasks.begin();
+    while (i != immediateTasks.end()) {
+        computeRank(*i, ranks);
+        ++i;
+    }
+    i = prefetchQueue.begin();
+    while (i != prefetchQueue.end()) {
+        computeRank(*i, ranks);
+        ++i;
+    }
+    map<Task*, float>::iterator j = ranks.begin();
+    while (j != ranks.end()) {
+        ptr<Task> t = j->first;
+        float rank = schedulingPolicy == CRITICAL_PATH ? j->second : 0.0f;
+        if (t->rank != rank) {
+            // the task must be removed from the sorted sets before its rank
+            // is changed, and then reinserted, as in #setDeadline
+            bool b1 = removeTask(allReadyTasks, t);
+            bool b2 = removeTask(readyCpuTasks, t);
+            t->rank = rank;
+            if (b1) {
+                insertTask(allReadyTasks, t);
+            }
+            if (b2) {
+                insertTask(readyCpuTasks, t);
+            }
+        }
+        ++j;
+    }
+}
+
+float MultithreadScheduler::computeRank(ptr<Task> t, map<Task*, float> &ranks)
+{
+    map<Task*, float>::iterator i = ranks.find(t.get());
+    if (i != ranks.end()) {
+        return i->second;
+    }
+    float rank = 0.0f;
+    if (schedulingPolicy == CRITICAL_PATH) {
+        map< ptr<Task>, set< ptr<Task> > >::iterator j = inverseDependencies.find(t);
+        if (j != inverseDependencies.end()) {
+            set< ptr<Task> >::iterator k = j->second.begin();
+            while (k != j->second.end()) { // iterates over the successors of t
+                rank = max(rank, computeRank(*k, ranks));
+                ++k;
+            }
+        }
+        // tasks without statistics yet count for one micro second, so that
+        // the rank is at least the number of tasks on the longest path
+        rank += max(t->getExpectedDuration(), 1.0f);
+    }
+    ranks.insert(make_pair(t.get(), rank));
+    return rank;
+}
+
 void MultithreadScheduler::taskDone(ptr<Task> t, bool changes)
 {
     pthread_mutex_lock((pthread_mutex_t*) mutex);
@@ -674,6 +897,18 @@ void MultithreadScheduler::taskDone(ptr<Task> t, bool changes)
         inverseDependencies.erase(i);
     }
     prefetchQueue.erase(t);
+    if (immediateTasks.erase(t) > 0 || t.cast<ParallelForTask>() != NULL) {
+        // a completed parallel task for the current frame, which was kept in
+        // the immediate tasks until now, or a parallel task executed with
+        // #execute; the main thread may be waiting for it
+        pthread_cond_broadcast((pthread_cond_t*) allTasksCond);
+    }
+    for (unsigned int n = 0; n < parallelTasks.size(); ++n) {
+        if (parallelTasks[n].get() == t.get()) {
+            parallelTasks.erase(parallelTasks.begin() + n);
+            break;
+        }
+    }
     // finally we mark the task as completed
     t->setIsDone(true, completionDate);
     // and we increment the logical time counter
@@ -681,21 +916,219 @@ void MultithreadScheduler::taskDone(ptr<Task> t, bool changes)
     pthread_mutex_unlock((pthread_mutex_t*) mutex);
 }
 
+void MultithreadScheduler::execute(ptr<Task> task)
+{
+    ptr<ParallelForTask> p = task.cast<ParallelForTask>();
+    if (p == NULL || threads.empty()) {
+        Scheduler::execute(task);
+        return;
+    }
+    set<Task*> initialized;
+    task->init(initialized);
+    int range = -1;
+    pthread_mutex_lock((pthread_mutex_t*) mutex);
+    p = startParallelTask(task, range);
+    pthread_mutex_unlock((pthread_mutex_t*) mutex);
+    if (p != NULL) {
+        // returns when the iterations executed by other threads, if any, are
+        // completed
+        executeParallelTask(p, range, true);
+    }
+}
+
+ptr<ParallelForTask> MultithreadScheduler::startParallelTask(ptr<Task> t, int &range)
+{
+    // NOTE: the mutex should be locked before calling this method!
+    ptr<ParallelForTask> p = t.cast<ParallelForTask>();
+    if (p == NULL || p->isDone() || p->getCompletionDate() >= p->getPredecessorsCompletionDate()) {
+        return NULL;
+    }
+    if (Logger::DEBUG_LOGGER != NULL) {
+        ostringstream oss;
+        oss << (p->getDeadline() > 0 ? "PREFETCH " : "RUN ") << p->getClass() << " (parallel)";
+        Logger::DEBUG_LOGGER->log("SCHEDULER", oss.str());
+    }
+    // the execution context is set once, before other threads can join
+    p->begin();
+    p->start(int(threads.size()) + 1);
+    range = p->join();
+    if (!p->isFull()) {
+        // signals the other threads that they can join this task
+        parallelTasks.push_back(p);
+        pthread_cond_broadcast((pthread_cond_t*) cpuTasksCond);
+        pthread_cond_broadcast((pthread_cond_t*) allTasksCond);
+    }
+    return p;
+}
+
+ptr<ParallelForTask> MultithreadScheduler::joinParallelTask(bool immediate, int &range)
+{
+    // NOTE: the mutex should be locked before calling this method!
+    for (unsigned int i = 0; i < parallelTasks.size(); ++i) {
+        ptr<ParallelForTask> p = parallelTasks[i];
+        if (immediate && p->getDeadline() > 0) {
+            continue;
+        }
+        range = p->join();
+        if (p->isFull()) {
+            // no other thread can join this task
+            parallelTasks.erase(parallelTasks.begin() + i);
+        }
+        return p;
+    }
+    return NULL;
+}
+
+bool MultithreadScheduler::hasParallelTask(bool immediate)
+{
+    // NOTE: the mutex should be locked before calling this method!
+    for (unsigned int i = 0; i < parallelTasks.size(); ++i) {
+        if (!immediate || parallelTasks[i]->getDeadline() == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void MultithreadScheduler::executeParallelTask(ptr<ParallelForTask> t, int range, bool started)
+{
+    bool completed;
+    {
+        Profiler::Zone taskZone(t->getClass());
+        completed = t->execute(range);
+    }
+    // all the remaining iterations are completed or being executed by other
+    // threads, there is no point in joining this task anymore
+    pthread_mutex_lock((pthread_mutex_t*) mutex);
+    for (unsigned int i = 0; i < parallelTasks.size(); ++i) {
+        if (parallelTasks[i] == t) {
+            parallelTasks.erase(parallelTasks.begin() + i);
+            break;
+        }
+    }
+    if (!started) {
+        if (completed) {
+            // wakes up the thread that started the task
+            pthread_cond_broadcast((pthread_cond_t*) allTasksCond);
+        }
+        pthread_mutex_unlock((pthread_mutex_t*) mutex);
+        return;
+    }
+    // the thread that started the task waits for the iterations executed by
+    // other threads, if any, before restoring the execution context
+    while (t->remaining > 0) {
+        pthread_cond_wait((pthread_cond_t*) allTasksCond, (pthread_mutex_t*) mutex);
+    }
+    pthread_mutex_unlock((pthread_mutex_t*) mutex);
+    t->end();
+    if (framePeriod > 0.0) {
+        t->setActualDuration((float) t->timer.end());
+    }
+    taskDone(t, t->changes);
+}
+
+bool MultithreadScheduler::suspendTask(ptr<Task> t, bool &changes)
+{
+    ptr<SuspendableTask> s = t.cast<SuspendableTask>();
+    if (s == NULL) {
+        return false;
+    }
+    s->changes = s->changes || changes;
+    ptr<TaskEvent> e = s->awaitedEvent;
+    if (e == NULL) {
+        // the task is completed
+        changes = s->changes;
+        s->changes = false;
+        return false;
+    }
+    s->awaitedEvent = NULL;
+    pthread_mutex_lock((pthread_mutex_t*) mutex);
+    if (t->getDeadline() == 0) {
+        // a suspended task for the current frame must remain in the immediate
+        // tasks, otherwise #run could return before it is completed
+        immediateTasks.insert(t);
+    }
+    suspendedTasks[e].push_back(t);
+    s->suspended = true;
+    ptr<GLFenceEvent> f = e.cast<GLFenceEvent>();
+    if (f != NULL && find(fenceEvents.begin(), fenceEvents.end(), f) == fenceEvents.end()) {
+        fenceEvents.push_back(f);
+    }
+    pthread_mutex_unlock((pthread_mutex_t*) mutex);
+    if (!e->addListener(this)) {
+        // the event has already been signaled
+        eventSignaled(e);
+    }
+    return true;
+}
+
+void MultithreadScheduler::eventSignaled(ptr<TaskEvent> e)
+{
+    pthread_mutex_lock((pthread_mutex_t*) mutex);
+    map< ptr<TaskEvent>, vector< ptr<Task> > >::iterator i = suspendedTasks.find(e);
+    if (i != suspendedTasks.end()) {
+        for (unsigned int j = 0; j < i->second.size(); ++j) {
+            // the task is ready to be executed again
+            ptr<Task> t = i->second[j];
+            t.cast<SuspendableTask>()->suspended = false;
+            insertTask(allReadyTasks, t);
+            pthread_cond_broadcast((pthread_cond_t*) allTasksCond);
+#ifdef STRICT_PREFETCH
+            if (!t->isGpuTask() && t->getDeadline() > 0) {
+#else
+            if (!t->isGpuTask()) {
+#endif
+                insertTask(readyCpuTasks, t);
+                pthread_cond_broadcast((pthread_cond_t*) cpuTasksCond);
+            }
+        }
+        suspendedTasks.erase(i);
+    }
+    pthread_mutex_unlock((pthread_mutex_t*) mutex);
+}
+
+bool MultithreadScheduler::pollFenceEvents()
+{
+    pthread_mutex_lock((pthread_mutex_t*) mutex);
+    vector< ptr<GLFenceEvent> > events = fenceEvents;
+    pthread_mutex_unlock((pthread_mutex_t*) mutex);
+    bool signaled = false;
+    for (unsigned int i = 0; i < events.size(); ++i) {
+        // signals the event, and thus calls #eventSignaled, if completed
+        if (events[i]->poll()) {
+            pthread_mutex_lock((pthread_mutex_t*) mutex);
+            fenceEvents.erase(find(fenceEvents.begin(), fenceEvents.end(), events[i]));
+            pthread_mutex_unlock((pthread_mutex_t*) mutex);
+            signaled = true;
+        }
+    }
+    return signaled;
+}
+
 void MultithreadScheduler::schedulerThread()
 {
     Timer timer;
 
+    Profiler::setThreadName("MultithreadScheduler worker");
+
     // loop to execute tasks, until the scheduler must be deleted
     while (!stop) {
         ptr<Task> t;
+        ptr<ParallelForTask> p;
+        int range = -1;
         pthread_mutex_lock((pthread_mutex_t*) mutex);
         // wait until we have a CPU task ready to be executed (the additional
         // threads cannot execute GPU tasks, because OpenGL supports only one
-        // thread at a time), or the scheduler is being deleted
-        while (readyCpuTasks.empty() && !stop) {
+        // thread at a time), or a parallel task to join, or the scheduler is
+        // being deleted
+        while (readyCpuTasks.empty() && parallelTasks.empty() && !stop) {
             pthread_cond_wait((pthread_cond_t*) cpuTasksCond, (pthread_mutex_t*) mutex);
         }
         if (!stop) {
+            // joins a parallel task being executed by other threads, if any
+            p = joinParallelTask(false, range);
+        }
+        if (!stop && p == NULL && !readyCpuTasks.empty()) {
             SortedTaskSet::iterator i = readyCpuTasks.begin();
             assert(i != readyCpuTasks.end());
             assert(i->second.begin() != i->second.end());
@@ -706,15 +1139,19 @@ void MultithreadScheduler::schedulerThread()
 #endif
             // and removes it from the task sets,
             // so that other threads will not select it again
-            if (t->getDeadline() == 0) {
-                immediateTasks.erase(t);
-            }
             removeTask(allReadyTasks, t);
             removeTask(readyCpuTasks, t);
+            p = startParallelTask(t, range);
+            if (p == NULL && t->getDeadline() == 0) {
+                immediateTasks.erase(t);
+            }
         }
         pthread_mutex_unlock((pthread_mutex_t*) mutex);
 
-        if (!stop) {
+        if (p != NULL) {
+            // t is not NULL if p has been started by this thread
+            executeParallelTask(p, range, t != NULL);
+        } else if (!stop && t != NULL) {
             assert(!t->isGpuTask());
             bool changes = false;
             if (!t->isDone()) {
@@ -728,15 +1165,19 @@ void MultithreadScheduler::schedulerThread()
                 if (t->getCompletionDate() >= t->getPredecessorsCompletionDate()) {
                     // t is up to date, it is not necessary to run it
                 } else if (framePeriod > 0.0) {
+                    Profiler::Zone taskZone(t->getClass());
                     timer.start();
                     changes = t->run();
                     double duration = timer.end();
                     t->setActualDuration((float) duration);
                 } else {
+                    Profiler::Zone taskZone(t->getClass());
                     changes = t->run();
                 }
             }
-            taskDone(t, changes);
+            if (!suspendTask(t, changes)) {
+                taskDone(t, changes);
+            }
         }
     }
 }
@@ -753,7 +1194,7 @@ void MultithreadScheduler::clearBufferedFrames()
         statisticsFile = fopen("taskStatistics.dat", "w");
         fprintf(statisticsFile, "frame scheduling total");
         for (unsigned int i = 0; i < monitoredTasks.size(); ++i) {
-            fprintf(statisticsFile, " %s %s", monitoredTasks[i].c_str(), monitoredTasks[i].c_str());
+            fprintf(statisticsFile, " %s %s %s", monitoredTasks[i].c_str(), monitoredTasks[i].c_str(), monitoredTasks[i].c_str());
         }
         fprintf(statisticsFile, "\n");
     }
@@ -762,12 +1203,13 @@ void MultithreadScheduler::clearBufferedFrames()
         fprintf(statisticsFile, "%d %f %f", i, bufferedStatistics[s] * 1e-3, bufferedStatistics[s + 1] * 1e-3);
         s += 2;
         for (unsigned int j = 0; j < monitoredTasks.size(); ++j) {
-            fprintf(statisticsFile, " %d %f", (int) bufferedStatistics[s], bufferedStatistics[s + 1] * 1e-3);
-            s += 2;
+            fprintf(statisticsFile, " %d %f %f", (int) bufferedStatistics[s], bufferedStatistics[s + 1] * 1e-3, bufferedStatistics[s + 2] * 1e-3);
+            s += 3;
         }
         fprintf(statisticsFile, "\n");
     }
     bufferedFrames = 0;
+    gpuStatisticsFrames.clear();
 }
 
 ptr<Task> MultithreadScheduler::getTask(SortedTaskSet &s, void *previousContext)
@@ -840,7 +1282,7 @@ public:
         int prefetchQueue = 0;
         float frameRate = 0.0;
         int nthreads = 0;
-        checkParameters(desc, e, "name,prefetchRate,prefetchQueue,fps,nthreads,");
+        checkParameters(desc, e, "name,prefetchRate,prefetchQueue,fps,nthreads,policy,");
         if (e->Attribute("prefetchRate") != NULL) {
             getIntParameter(desc, e, "prefetchRate", &prefetchRate);
         }
@@ -854,6 +1296,9 @@ public:
             getIntParameter(desc, e, "nthreads", &nthreads);
         }
         init(prefetchRate, prefetchQueue, frameRate, nthreads);
+        if (e->Attribute("policy") != NULL && strcmp(e->Attribute("policy"), "criticalPath") == 0) {
+            setPolicy(CRITICAL_PATH);
+        }
     }
 };
 
@@ -27,7 +27,9 @@
 #include <vector>
 #include <set>
 #include <sstream>
+#include "ork/taskgraph/ParallelForTask.h"
 #include "ork/taskgraph/Scheduler.h"
+#include "ork/taskgraph/SuspendableTask.h"
 #include "ork/taskgraph/TaskGraph.h"
 
 namespace ork
@@ -42,13 +44,31 @@ namespace ork
  * have been executed. Hence if a prefetch rate is specified, or if a fixed frame
  * rate is specified, this scheduler supports prefetching of tasks of any kind.
  * Otherwise, if several threads are used, prefetching of cpu tasks is supported,
- * but not prefetching of gpu tasks.
+ * but not prefetching of gpu tasks. Ready tasks are executed by increasing
+ * deadline, grouped by execution context, and then in an order given by the
+ * scheduling #policy. The iterations of a ParallelForTask are shared between
+ * the thread that starts it and the other threads that become idle (only the
+ * main thread can join a ParallelForTask for the current frame if the
+ * additional threads only execute prefetching tasks). A SuspendableTask
+ * waiting for an event does not block any thread: it is put back in the set of
+ * ready tasks when the event is signaled. The GLFenceEvent awaited by suspended
+ * tasks are polled by the main thread, without blocking, when it waits for
+ * ready tasks, and at the start of each #run.
  *
  * @ingroup taskgraph
  */
-class ORK_API MultithreadScheduler : public Scheduler
+class ORK_API MultithreadScheduler : public Scheduler, public TaskEventListener
 {
 public:
+    /**
+     * The possible orders in which the ready tasks with the same deadline
+     * and execution context are executed.
+     */
+    enum policy {
+        SHORTEST_FIRST, ///< the tasks with the shortest expected duration are executed first.
+        CRITICAL_PATH ///< the tasks with the longest expected path to the end of their task graph are executed first.
+    };
+
     /**
      * Creates a new multithread scheduler.
      *
@@ -91,11 +111,44 @@ public:
 
     virtual void run(ptr<Task> task);
 
+    /**
+     * Executes the given task and returns when it is completed. If this task
+     * is a ParallelForTask, its iterations are shared between the current
+     * thread and the idle scheduler threads.
+     */
+    virtual void execute(ptr<Task> task);
+
     /**
      * Adds the given task type to the tasks whose execution times must be monitored (debug).
+     * The number of tasks of this type executed at each frame, and their CPU time, are
+     * written to a file. If the GPUProfiler is enabled, their GPU time is also written.
      */
     void monitorTask(const std::string &taskType);
 
+    /**
+     * Returns the order in which the ready tasks are executed.
+     */
+    policy getPolicy() const;
+
+    /**
+     * Sets the order in which the ready tasks are executed. The default
+     * policy is SHORTEST_FIRST. With the CRITICAL_PATH policy, the upward
+     * rank of each task (the sum of the expected durations on the longest
+     * path from this task to a task without successors) is computed each
+     * time new tasks are scheduled, and the tasks with the highest rank are
+     * executed first. This avoids that long chains of dependent tasks wait
+     * behind many short independent tasks.
+     *
+     * @param p the order in which the ready tasks must be executed.
+     */
+    void setPolicy(policy p);
+
+    /**
+     * Puts the tasks suspended until the given event back in the set of
+     * tasks ready to be executed.
+     */
+    virtual void eventSignaled(ptr<TaskEvent> e);
+
 protected:
     /**
      * Initializes this scheduler.
@@ -124,14 +177,33 @@ private:
     };
 
     /**
-     * A sort operator for tasks. This operator is based on the expected
-     * duration of tasks, so that shorter tasks are executed first.
+     * A sort operator for tasks, based on #isBefore.
      */
     struct taskSort : public std::less< ptr<Task> >
     {
         bool operator()(const ptr<Task> x, const ptr<Task> y) const;
     };
 
+    /**
+     * Returns true if a ready task must be executed before another ready task
+     * with the same deadline and execution context. The order is based on the
+     * rank of tasks (see #setPolicy), so that tasks on the critical path are
+     * executed first, then on the expected duration of tasks, so that shorter
+     * tasks are executed first, and finally on the creation order of tasks,
+     * so that it does not depend on memory addresses. This order is also used
+     * by SimulatedScheduler.
+     *
+     * @param xRank the rank of the first task.
+     * @param xDuration the expected duration of the first task, in micro
+     *      seconds, rounded to an integer.
+     * @param xSequence the creation order of the first task.
+     * @param yRank the rank of the second task.
+     * @param yDuration the expected duration of the second task, in micro
+     *      seconds, rounded to an integer.
+     * @param ySequence the creation order of the second task.
+     */
+    static bool isBefore(float xRank, int xDuration, unsigned int xSequence, float yRank, int yDuration, unsigned int ySequence);
+
     /**
      * A sorted task set, where tasks are sorted based on their deadline,
      * execution context and expected duration.
@@ -144,6 +216,11 @@ private:
      */
     void* mutex;
 
+    /**
+     * The order in which the ready tasks are executed.
+     */
+    policy schedulingPolicy;
+
     /**
      * A condition to signal to execution threads that new tasks are ready to be
      * executed.
@@ -229,6 +306,22 @@ private:
      */
     std::set< ptr<Task> > prefetchQueue;
 
+    /**
+     * The ParallelForTask being executed that other threads can still join.
+     */
+    std::vector< ptr<ParallelForTask> > parallelTasks;
+
+    /**
+     * The suspended tasks, for each event they are waiting for.
+     */
+    std::map< ptr<TaskEvent>, std::vector< ptr<Task> > > suspendedTasks;
+
+    /**
+     * The GL fence events awaited by suspended tasks. They must be polled
+     * because they do not notify their completion (see #pollFenceEvents).
+     */
+    std::vector< ptr<GLFenceEvent> > fenceEvents;
+
     /**
      * The task classes whose execution time must be monitored (debug).
      */
@@ -252,6 +345,12 @@ private:
      */
     int bufferedFrames;
 
+    /**
+     * The buffered frames whose GPU times are not yet available, indexed by
+     * their GPUProfiler frame number.
+     */
+    std::map<unsigned int, int> gpuStatisticsFrames;
+
     /**
      * File to store task execution time statistics per frame for monitored tasks.
      */
@@ -291,6 +390,24 @@ private:
      */
     void setDeadline(ptr<Task> t, unsigned int deadline, std::set< ptr<Task> > &visited);
 
+    /**
+     * Updates the rank of all the tasks that remain to be executed, depending
+     * on the scheduling policy. This method also updates the sorted sets that
+     * may contain these tasks, since the task order depends on their rank.
+     */
+    void updateRanks();
+
+    /**
+     * Computes the upward rank of a task, i.e. the sum of the expected
+     * durations of the tasks on the longest path from this task to a task
+     * without successors.
+     *
+     * @param t a task.
+     * @param[in,out] ranks the already computed ranks.
+     * @return the upward rank of t.
+     */
+    float computeRank(ptr<Task> t, std::map<Task*, float> &ranks);
+
     /**
      * Updates the data structures after the execution of a task. This method
      * removes the given task from #dependencies and #inverseDependencies. This
@@ -303,6 +420,75 @@ private:
      */
     void taskDone(ptr<Task> t, bool changes);
 
+    /**
+     * Starts the execution of the given task if it is a ParallelForTask that
+     * must be executed. This calls Task#begin, then the current thread joins
+     * this execution, and the task is added to #parallelTasks so that other
+     * threads can join it too.
+     *
+     * @param t a task that has just been removed from the ready task sets.
+     * @param[out] range the range of iterations reserved for the current
+     *      thread (see ParallelForTask#join).
+     * @return the started task, or NULL if t is not a ParallelForTask or if
+     *      it does not need to be executed.
+     */
+    ptr<ParallelForTask> startParallelTask(ptr<Task> t, int &range);
+
+    /**
+     * Joins the execution of a task from #parallelTasks.
+     *
+     * @param immediate true to join only tasks for the current frame.
+     * @param[out] range the range of iterations reserved for the current
+     *      thread (see ParallelForTask#join).
+     * @return the joined task, or NULL if there is no task to join.
+     */
+    ptr<ParallelForTask> joinParallelTask(bool immediate, int &range);
+
+    /**
+     * Returns true if #parallelTasks contains a task that can be joined.
+     *
+     * @param immediate true to consider only tasks for the current frame.
+     */
+    bool hasParallelTask(bool immediate);
+
+    /**
+     * Executes iterations of a started ParallelForTask, until no more
+     * iterations remain to be started. If the current thread started the
+     * task, it then waits until all the iterations are completed, and calls
+     * Task#end and #taskDone. <i>The mutex must not be locked when this
+     * method is called</i>.
+     *
+     * @param t a ParallelForTask joined by the current thread.
+     * @param range the range of iterations reserved for the current thread.
+     * @param started true if the current thread started the task (see
+     *      #startParallelTask), false if it joined it.
+     */
+    void executeParallelTask(ptr<ParallelForTask> t, int range, bool started);
+
+    /**
+     * Suspends the given task if it is a SuspendableTask whose last execution
+     * called SuspendableTask#await. Otherwise, if it is a SuspendableTask,
+     * this method sets changes to true if one of its previous executions
+     * returned true. <i>The mutex must not be locked when this method is
+     * called</i>.
+     *
+     * @param t a task that has just been executed.
+     * @param[in,out] changes the result of the last execution of t.
+     * @return true if the task has been suspended, in which case #taskDone
+     *      must not be called.
+     */
+    bool suspendTask(ptr<Task> t, bool &changes);
+
+    /**
+     * Polls the GL fence events awaited by suspended tasks, without waiting.
+     * The completed ones are signaled, which puts back their tasks in the set
+     * of ready tasks. <i>This method must be called in the OpenGL thread, and
+     * the mutex must not be locked when it is called</i>.
+     *
+     * @return true if at least one event has been signaled.
+     */
+    bool pollFenceEvents();
+
     /**
      * The method executed by the additional threads of this scheduler. This
      * method contains an infinite loop that executes tasks when they are ready
@@ -350,6 +536,8 @@ private:
      * @return true if the set contained t.
      */
     static bool removeTask(SortedTaskSet &s, ptr<Task> t);
+
+    friend class SimulatedScheduler;
 };
 
 }
@@ -0,0 +1,207 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#include "ork/taskgraph/ParallelForTask.h"
+
+#include <algorithm>
+
+#include "ork/core/Atomic.h"
+
+#include <pthread.h>
+
+using namespace std;
+
+namespace ork
+{
+
+struct ParallelForTask::Range
+{
+    int begin; ///< the first iteration of this range.
+
+    int end; ///< the iteration after the last iteration of this range.
+
+    pthread_mutex_t mutex; ///< mutex used to synchronize accesses to this range.
+};
+
+ParallelForTask::ParallelForTask(const char *type, int count, int grainSize, unsigned int deadline) :
+    Task(type, false, deadline), count(count), grainSize(grainSize), grain(1),
+    ranges(NULL), rangeCount(0), participants(0), remaining(0), changes(false)
+{
+}
+
+ParallelForTask::~ParallelForTask()
+{
+    for (int i = 0; i < rangeCount; ++i) {
+        pthread_mutex_destroy(&ranges[i].mutex);
+    }
+    delete[] ranges;
+}
+
+int ParallelForTask::getCount() const
+{
+    return count;
+}
+
+int ParallelForTask::getComplexity() const
+{
+    return max(count, 1);
+}
+
+bool ParallelForTask::run()
+{
+    start(1);
+    execute(join());
+    return changes;
+}
+
+void ParallelForTask::start(int maxParticipants)
+{
+    if (rangeCount != maxParticipants) {
+        for (int i = 0; i < rangeCount; ++i) {
+            pthread_mutex_destroy(&ranges[i].mutex);
+        }
+        delete[] ranges;
+        rangeCount = maxParticipants;
+        ranges = new Range[rangeCount];
+        for (int i = 0; i < rangeCount; ++i) {
+            pthread_mutex_init(&ranges[i].mutex, NULL);
+        }
+    }
+    // by default, each thread executes its range in about 16 chunks, which
+    // leaves enough small chunks at the end to balance the load
+    grain = grainSize > 0 ? grainSize : max(1, count / (16 * rangeCount));
+    for (int i = 0; i < rangeCount; ++i) {
+        ranges[i].begin = (int) ((long long) count * i / rangeCount);
+        ranges[i].end = (int) ((long long) count * (i + 1) / rangeCount);
+    }
+    participants = 0;
+    remaining = count;
+    changes = false;
+    timer.start();
+}
+
+int ParallelForTask::join()
+{
+    return participants < rangeCount ? participants++ : -1;
+}
+
+bool ParallelForTask::isFull() const
+{
+    return participants >= rangeCount;
+}
+
+bool ParallelForTask::execute(int range)
+{
+    if (count == 0) {
+        return true;
+    }
+    bool completed = false;
+    int begin;
+    int end;
+    while (takeChunk(range, begin, end) || stealChunk(range, begin, end)) {
+        if (run(begin, end)) {
+            changes = true;
+        }
+        long n = end - begin;
+        // the thread that completes the last iterations completes the task
+        if (atomic_exchange_and_add(&remaining, -n) == n) {
+            completed = true;
+        }
+    }
+    return completed;
+}
+
+bool ParallelForTask::takeChunk(int range, int &begin, int &end)
+{
+    Range &r = ranges[range];
+    pthread_mutex_lock(&r.mutex);
+    bool found = r.begin < r.end;
+    if (found) {
+        begin = r.begin;
+        end = min(r.end, begin + grain);
+        r.begin = end;
+    }
+    pthread_mutex_unlock(&r.mutex);
+    return found;
+}
+
+bool ParallelForTask::stealChunk(int range, int &begin, int &end)
+{
+    while (true) {
+        // finds the range with the largest number of remaining iterations
+        // (without locks, this is only a hint)
+        int victim = -1;
+        int victimSize = 0;
+        for (int i = 0; i < rangeCount; ++i) {
+            int size = ranges[i].end - ranges[i].begin;
+            if (i != range && size > victimSize) {
+                victim = i;
+                victimSize = size;
+            }
+        }
+        if (victim == -1) {
+            return false;
+        }
+        Range &v = ranges[victim];
+        pthread_mutex_lock(&v.mutex);
+        int size = v.end - v.begin;
+        if (size <= 0) {
+            // the victim range has been emptied in the meantime, try again
+            pthread_mutex_unlock(&v.mutex);
+            continue;
+        }
+        // steals the second half of the victim range, or the whole range if
+        // it is too small to be split
+        int stolenBegin = size > grain ? v.end - size / 2 : v.begin;
+        int stolenEnd = v.end;
+        v.end = stolenBegin;
+        pthread_mutex_unlock(&v.mutex);
+
+        Range &r = ranges[range];
+        pthread_mutex_lock(&r.mutex);
+        r.begin = stolenBegin;
+        r.end = stolenEnd;
+        pthread_mutex_unlock(&r.mutex);
+        return takeChunk(range, begin, end);
+    }
+}
+
+}
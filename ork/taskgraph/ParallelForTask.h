@@ -0,0 +1,228 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#ifndef _ORK_PARALLEL_FOR_TASK_H_
+#define _ORK_PARALLEL_FOR_TASK_H_
+
+#include "ork/core/Timer.h"
+#include "ork/taskgraph/Task.h"
+
+namespace ork
+{
+
+/**
+ * A CPU task made of many independent iterations of the same computation, which
+ * can be executed in parallel by several threads. The iterations are numbered
+ * from 0 to #getCount - 1, and are executed by calling #run(int, int) on
+ * contiguous ranges of iterations. When this task is executed by a
+ * MultithreadScheduler, the scheduler thread that starts it and all the other
+ * threads that become idle can join its execution. Each participating thread
+ * executes chunks of iterations from its own range, and steals half of the
+ * remaining iterations of the busiest other thread when its range is empty.
+ * This task is still a single task in its task graph: its successors are
+ * executed, and its listeners are notified, only when all its iterations are
+ * completed. The thread that starts it calls #begin before the first
+ * iteration, and #end after the last one. With other schedulers, or if no
+ * thread joins it, all iterations are simply executed in sequence by #run().
+ *
+ * @ingroup taskgraph
+ */
+class ORK_API ParallelForTask : public Task
+{
+public:
+    /**
+     * Creates a new parallel for task.
+     *
+     * @param type the type of the task.
+     * @param count the number of iterations of this task.
+     * @param grainSize the minimum number of iterations executed by a single
+     *      call to #run(int, int), or 0 to choose it automatically.
+     * @param deadline the frame number before which the task must be executed.
+     *      0 means that the task must be executed immediately.
+     */
+    ParallelForTask(const char *type, int count, int grainSize = 0, unsigned int deadline = 0);
+
+    /**
+     * Deletes this parallel for task.
+     */
+    virtual ~ParallelForTask();
+
+    /**
+     * Returns the number of iterations of this task.
+     */
+    int getCount() const;
+
+    /**
+     * Returns the number of iterations of this task.
+     */
+    virtual int getComplexity() const;
+
+    /**
+     * Executes all the iterations of this task in sequence, in the current
+     * thread.
+     *
+     * @return true if the result of one iteration has changed.
+     */
+    virtual bool run();
+
+protected:
+    /**
+     * Executes the given range of iterations. This method can be called
+     * concurrently from several threads, on disjoint ranges.
+     *
+     * @param begin the first iteration to execute.
+     * @param end the iteration after the last iteration to execute.
+     * @return true if the result of one of these iterations has changed.
+     */
+    virtual bool run(int begin, int end) = 0;
+
+private:
+    /**
+     * A range of iterations reserved for a participating thread.
+     */
+    struct Range;
+
+    /**
+     * The number of iterations of this task.
+     */
+    int count;
+
+    /**
+     * The minimum number of iterations executed by a call to #run(int, int),
+     * or 0 to choose it automatically.
+     */
+    int grainSize;
+
+    /**
+     * The number of iterations executed by a call to #run(int, int) during
+     * the current execution of this task.
+     */
+    int grain;
+
+    /**
+     * The ranges of iterations reserved for each participating thread.
+     */
+    Range *ranges;
+
+    /**
+     * The number of ranges in #ranges, i.e. the maximum number of threads
+     * that can participate to the current execution of this task.
+     */
+    int rangeCount;
+
+    /**
+     * The number of threads that have joined the current execution.
+     */
+    int participants;
+
+    /**
+     * The number of iterations that are not completed yet.
+     */
+    volatile long remaining;
+
+    /**
+     * True if the result of one iteration has changed.
+     */
+    volatile bool changes;
+
+    /**
+     * The timer used to measure the duration of the current execution.
+     */
+    Timer timer;
+
+    /**
+     * Prepares an execution of this task. The iterations are split into
+     * maxParticipants ranges of equal size.
+     *
+     * @param maxParticipants the maximum number of threads that can join
+     *      this execution.
+     */
+    void start(int maxParticipants);
+
+    /**
+     * Adds a thread to the current execution of this task.
+     *
+     * @return the index of the range reserved for this thread, or -1 if the
+     *      maximum number of participants is already reached.
+     */
+    int join();
+
+    /**
+     * Returns true if the maximum number of participants is reached.
+     */
+    bool isFull() const;
+
+    /**
+     * Executes iterations of this task until all iterations are completed or
+     * being executed by other threads.
+     *
+     * @param range the range reserved for the current thread (see #join).
+     * @return true if the current thread completed the last iteration.
+     */
+    bool execute(int range);
+
+    /**
+     * Removes a chunk of iterations from the given range.
+     *
+     * @param range a range index.
+     * @param[out] begin the first iteration of the chunk.
+     * @param[out] end the iteration after the last iteration of the chunk.
+     * @return false if the range is empty.
+     */
+    bool takeChunk(int range, int &begin, int &end);
+
+    /**
+     * Moves half of the iterations of the largest other range into the given
+     * range, and then removes a chunk of iterations from it.
+     *
+     * @param range a range index.
+     * @param[out] begin the first iteration of the chunk.
+     * @param[out] end the iteration after the last iteration of the chunk.
+     * @return false if all the ranges are empty.
+     */
+    bool stealChunk(int range, int &begin, int &end);
+
+    friend class MultithreadScheduler;
+};
+
+}
+
+#endif
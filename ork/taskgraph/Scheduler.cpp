@@ -41,6 +41,8 @@
 
 #include "ork/taskgraph/Scheduler.h"
 
+using namespace std;
+
 namespace ork
 {
 
@@ -52,6 +54,18 @@ Scheduler::~Scheduler()
 {
 }
 
+void Scheduler::execute(ptr<Task> task)
+{
+    set<Task*> initialized;
+    task->init(initialized);
+    if (!task->isDone()) {
+        task->begin();
+        task->run();
+        task->end();
+        task->setIsDone(true, task->getPredecessorsCompletionDate());
+    }
+}
+
 void Scheduler::swap(ptr<Scheduler> s)
 {
 }
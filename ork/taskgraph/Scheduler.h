@@ -109,6 +109,17 @@ public:
      */
     virtual void run(ptr<Task> task) = 0;
 
+    /**
+     * Executes the given task and returns when it is completed. Unlike #run,
+     * this method does not execute any other task, and can be called outside
+     * of the execution of a frame, for instance to execute a ParallelForTask
+     * whose result is needed immediately. The default implementation executes
+     * the task in the current thread.
+     *
+     * @param task a task, which must not be a task graph.
+     */
+    virtual void execute(ptr<Task> task);
+
 protected:
     /**
      * Swaps this scheduler with the given one.
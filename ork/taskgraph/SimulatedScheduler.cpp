@@ -0,0 +1,611 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#include "ork/taskgraph/SimulatedScheduler.h"
+
+#include "pmath.h"
+#include <cstring>
+
+#include "ork/core/Logger.h"
+#include "ork/resource/ResourceTemplate.h"
+
+using namespace std;
+
+namespace ork
+{
+
+bool SimulatedScheduler::ReadyTask::operator<(const ReadyTask &r) const
+{
+    // same order as in MultithreadScheduler
+    if (deadline != r.deadline) {
+        return deadline < r.deadline;
+    }
+    if (context != r.context) {
+        return context < r.context;
+    }
+    return MultithreadScheduler::isBefore(rank, duration, task->sequence, r.rank, r.duration, r.task->sequence);
+}
+
+SimulatedScheduler::SimulatedThread::SimulatedThread() :
+    task(NULL), start(0.0), end(0.0), busy(0.0), changes(false)
+{
+}
+
+SimulatedScheduler::SimulatedScheduler(int prefetchRate, float frameRate, int nThreads, float defaultDuration) :
+    Scheduler("SimulatedScheduler")
+{
+    init(prefetchRate, frameRate, nThreads, defaultDuration);
+}
+
+void SimulatedScheduler::init(int prefetchRate, float frameRate, int nThreads, float defaultDuration)
+{
+    this->prefetchRate = prefetchRate;
+    this->previousContext = NULL;
+    this->framePeriod = frameRate == 0.0f ? 0.0f : 1e6f / frameRate;
+    this->defaultDuration = defaultDuration;
+    schedulingPolicy = MultithreadScheduler::SHORTEST_FIRST;
+    now = 0.0;
+    lastCompletion = 0.0;
+    time = 2;
+    threads.resize(nThreads + 1);
+    frameDeadline = 0.0;
+    prefetched = 0;
+}
+
+SimulatedScheduler::~SimulatedScheduler()
+{
+}
+
+MultithreadScheduler::policy SimulatedScheduler::getPolicy() const
+{
+    return schedulingPolicy;
+}
+
+void SimulatedScheduler::setPolicy(MultithreadScheduler::policy p)
+{
+    schedulingPolicy = p;
+    updateReadyTasks();
+}
+
+void SimulatedScheduler::setTaskDuration(const string &taskType, float duration)
+{
+    durations[taskType] = duration;
+}
+
+bool SimulatedScheduler::supportsPrefetch(bool gpuTasks)
+{
+    return prefetchRate > 0 || framePeriod > 0.0f || (threads.size() > 1 && !gpuTasks);
+}
+
+void SimulatedScheduler::schedule(ptr<Task> task)
+{
+    set<Task*> initialized;
+    task->init(initialized);
+    set< ptr<Task> > addedTasks;
+    addFlattenedTask(task, addedTasks);
+    updateReadyTasks();
+}
+
+void SimulatedScheduler::reschedule(ptr<Task> task, Task::reason r, unsigned int deadline)
+{
+    task->setIsDone(false, 0, r);
+    if (r == Task::DATA_NEEDED) {
+        set< ptr<Task> > visited;
+        setDeadline(task, deadline, visited);
+        updateReadyTasks();
+    }
+}
+
+void SimulatedScheduler::run(ptr<Task> task)
+{
+    schedule(task);
+
+    double frameStart = now;
+    frameDeadline = framePeriod > 0.0f ? frameStart + framePeriod : 0.0;
+    int framePrefetched = 0;
+    while (true) {
+        startTasks(true, framePrefetched);
+        if (threads[0].task == NULL && immediateTasks.empty()) {
+            // the main thread has completed the tasks for this frame
+            break;
+        }
+        if (!completeTask(INFINITY)) {
+            // no task is being executed, nothing can change anymore
+            break;
+        }
+    }
+    if (frameDeadline > 0.0 && now < frameDeadline) {
+        // with a fixed framerate the main thread waits until the end of the
+        // frame, while the other threads continue to execute tasks
+        while (completeTask(frameDeadline)) {
+            startTasks(false, framePrefetched);
+        }
+        now = frameDeadline;
+    }
+    // as in MultithreadScheduler, the context of the last GPU task is ended
+    // at the end of each frame
+    previousContext = NULL;
+    frames.push_back(now - frameStart);
+}
+
+void SimulatedScheduler::finish()
+{
+    // the main thread executes only the tasks for the current frame, if any
+    int framePrefetched = prefetchRate;
+    frameDeadline = 0.0;
+    do {
+        startTasks(true, framePrefetched);
+    } while (completeTask(INFINITY));
+}
+
+double SimulatedScheduler::getTime() const
+{
+    return now;
+}
+
+double SimulatedScheduler::getMakespan() const
+{
+    return lastCompletion;
+}
+
+int SimulatedScheduler::getFrameCount() const
+{
+    return int(frames.size());
+}
+
+double SimulatedScheduler::getFrameDuration(int frame) const
+{
+    return frames[frame];
+}
+
+int SimulatedScheduler::getThreadCount() const
+{
+    return int(threads.size());
+}
+
+double SimulatedScheduler::getIdleTime(int thread) const
+{
+    const SimulatedThread &s = threads[thread];
+    double busy = s.busy;
+    if (s.task != NULL) {
+        busy += now - s.start;
+    }
+    return now - busy;
+}
+
+int SimulatedScheduler::getPrefetchedTasks() const
+{
+    return prefetched;
+}
+
+double SimulatedScheduler::getPrefetchThroughput() const
+{
+    return lastCompletion > 0.0 ? prefetched / (lastCompletion * 1e-6) : 0.0;
+}
+
+void SimulatedScheduler::logStatistics()
+{
+    if (Logger::INFO_LOGGER == NULL) {
+        return;
+    }
+    double frameSum = 0.0;
+    for (unsigned int i = 0; i < frames.size(); ++i) {
+        frameSum += frames[i];
+    }
+    ostringstream oss;
+    oss.setf(ios::fixed, ios::floatfield);
+    oss.precision(3);
+    oss << "makespan " << getMakespan() / 1000.0 << " ms; ";
+    oss << frames.size() << " frames, average " << (frames.empty() ? 0.0 : frameSum / frames.size() / 1000.0) << " ms; ";
+    oss << prefetched << " prefetched tasks, " << getPrefetchThroughput() << " per second; idle";
+    for (unsigned int i = 0; i < threads.size(); ++i) {
+        oss << " " << getIdleTime(i) / 1000.0;
+    }
+    oss << " ms";
+    Logger::INFO_LOGGER->log("SCHEDULER", oss.str());
+}
+
+void SimulatedScheduler::resetStatistics()
+{
+    for (unsigned int i = 0; i < threads.size(); ++i) {
+        SimulatedThread &s = threads[i];
+        if (s.task != NULL) {
+            s.start = max(s.start - now, 0.0);
+            s.end -= now;
+        }
+        s.busy = 0.0;
+    }
+    now = 0.0;
+    lastCompletion = 0.0;
+    frames.clear();
+    prefetched = 0;
+}
+
+float SimulatedScheduler::getDuration(ptr<Task> t)
+{
+    map<string, float>::iterator i = durations.find(t->getClass());
+    if (i != durations.end()) {
+        return i->second * t->getComplexity();
+    }
+    float duration = t->getExpectedDuration();
+    return duration > 0.0f ? duration : defaultDuration * t->getComplexity();
+}
+
+void SimulatedScheduler::addFlattenedTask(ptr<Task> t, set< ptr<Task> > &addedTasks)
+{
+    if (addedTasks.find(t) != addedTasks.end()) {
+        return;
+    }
+    addedTasks.insert(t);
+    if (t->isDone()) {
+        return;
+    }
+    ptr<TaskGraph> tg = t.cast<TaskGraph>();
+    if (tg == NULL) {
+        if (t->getDeadline() == 0) {
+            immediateTasks.insert(t);
+        } else {
+            prefetchQueue.insert(t);
+        }
+        if (taskDurations.find(t.get()) == taskDurations.end()) {
+            taskDurations.insert(make_pair(t.get(), getDuration(t)));
+        }
+    } else {
+        tg->flattenedFirstTasks.clear();
+        tg->flattenedLastTasks.clear();
+        TaskGraph::TaskIterator i = tg->getAllTasks();
+        while (i.hasNext()) {
+            addFlattenedTask(i.next(), addedTasks);
+        }
+        i = tg->getFirstTasks();
+        while (i.hasNext()) {
+            ptr<Task> u = i.next();
+            ptr<TaskGraph> ug = u.cast<TaskGraph>();
+            if (ug == NULL) {
+                tg->flattenedFirstTasks.insert(u);
+            } else {
+                tg->flattenedFirstTasks.insert(ug->flattenedFirstTasks.begin(), ug->flattenedFirstTasks.end());
+            }
+        }
+        i = tg->getLastTasks();
+        while (i.hasNext()) {
+            ptr<Task> u = i.next();
+            ptr<TaskGraph> ug = u.cast<TaskGraph>();
+            if (ug == NULL) {
+                tg->flattenedLastTasks.insert(u);
+            } else {
+                tg->flattenedLastTasks.insert(ug->flattenedLastTasks.begin(), ug->flattenedLastTasks.end());
+            }
+        }
+
+        i = tg->getAllTasks();
+        while (i.hasNext()) {
+            ptr<Task> dst = i.next();
+            if (dst->isDone()) {
+                continue;
+            }
+            TaskGraph::TaskIterator j = tg->getInverseDependencies(dst);
+            while (j.hasNext()) {
+                ptr<Task> src = j.next();
+                addFlattenedDependency(src, dst);
+            }
+        }
+    }
+}
+
+void SimulatedScheduler::addFlattenedDependency(ptr<Task> src, ptr<Task> dst)
+{
+    ptr<TaskGraph> srcTg = src.cast<TaskGraph>();
+    if (srcTg != NULL) {
+        set< ptr<Task> >::iterator i = srcTg->flattenedFirstTasks.begin();
+        while (i != srcTg->flattenedFirstTasks.end()) {
+            addFlattenedDependency(*i, dst);
+            ++i;
+        }
+    } else {
+        ptr<TaskGraph> dstTg = dst.cast<TaskGraph>();
+        if (dstTg != NULL) {
+            set< ptr<Task> >::iterator i = dstTg->flattenedLastTasks.begin();
+            while (i != dstTg->flattenedLastTasks.end()) {
+                addFlattenedDependency(src, *i);
+                ++i;
+            }
+        } else {
+            set< ptr<Task> > visited;
+            dependencies[src].insert(dst);
+            inverseDependencies[dst].insert(src);
+            setDeadline(dst, src->getDeadline(), visited);
+        }
+    }
+}
+
+void SimulatedScheduler::setDeadline(ptr<Task> t, unsigned int deadline, set< ptr<Task> > &visited)
+{
+    if (visited.find(t) != visited.end()) {
+        return;
+    }
+    visited.insert(t);
+
+    ptr<TaskGraph> tg = t.cast<TaskGraph>();
+    if (tg != NULL) {
+        TaskGraph::TaskIterator i = tg->getAllTasks();
+        while (i.hasNext()) {
+            setDeadline(i.next(), deadline, visited);
+        }
+    }
+
+    if (t->getDeadline() > deadline) {
+        t->setDeadline(deadline);
+        map< ptr<Task>, set< ptr<Task> > >::iterator i = dependencies.find(t);
+        if (i != dependencies.end()) {
+            set< ptr<Task> >::iterator j = i->second.begin();
+            while (j != i->second.end()) {
+                setDeadline(*j, deadline, visited);
+                j++;
+            }
+        }
+    }
+}
+
+void SimulatedScheduler::updateReadyTasks()
+{
+    set<Task*> running;
+    for (unsigned int i = 0; i < threads.size(); ++i) {
+        if (threads[i].task != NULL) {
+            running.insert(threads[i].task.get());
+        }
+    }
+    allReadyTasks.clear();
+    readyCpuTasks.clear();
+    ranks.clear();
+    for (int n = 0; n < 2; ++n) {
+        set< ptr<Task> > &tasks = n == 0 ? immediateTasks : prefetchQueue;
+        set< ptr<Task> >::iterator i = tasks.begin();
+        while (i != tasks.end()) {
+            ptr<Task> t = *i;
+            computeRank(t);
+            // a task is ready if it is not being executed and if all its
+            // predecessors are completed
+            if (running.find(t.get()) == running.end() && dependencies.find(t) == dependencies.end()) {
+                insertTask(t);
+            }
+            ++i;
+        }
+    }
+}
+
+float SimulatedScheduler::computeRank(ptr<Task> t)
+{
+    map<Task*, float>::iterator i = ranks.find(t.get());
+    if (i != ranks.end()) {
+        return i->second;
+    }
+    float rank = 0.0f;
+    map< ptr<Task>, set< ptr<Task> > >::iterator j = inverseDependencies.find(t);
+    if (j != inverseDependencies.end()) {
+        set< ptr<Task> >::iterator k = j->second.begin();
+        while (k != j->second.end()) { // iterates over the successors of t
+            rank = max(rank, computeRank(*k));
+            ++k;
+        }
+    }
+    // tasks with a null duration count for one micro second, as in
+    // MultithreadScheduler
+    rank += max(taskDurations[t.get()], 1.0f);
+    ranks.insert(make_pair(t.get(), rank));
+    return rank;
+}
+
+void SimulatedScheduler::insertTask(ptr<Task> t)
+{
+    ReadyTask r;
+    r.deadline = t->getDeadline();
+    r.context = t->getContext();
+    r.rank = schedulingPolicy == MultithreadScheduler::CRITICAL_PATH ? computeRank(t) : 0.0f;
+    r.duration = int(taskDurations[t.get()]);
+    r.task = t;
+    allReadyTasks.insert(r);
+    if (!t->isGpuTask() && t->getDeadline() > 0) {
+        readyCpuTasks.insert(r);
+    }
+}
+
+set<SimulatedScheduler::ReadyTask>::iterator SimulatedScheduler::getMainThreadTask()
+{
+    set<ReadyTask>::iterator i = allReadyTasks.begin();
+    // we look for a task with the minimum deadline and with the context of the
+    // last GPU task or, if there is none, with an empty context, to avoid a
+    // context switch; a key with an infinite rank is before all the tasks
+    // with the same deadline and context
+    ReadyTask key;
+    key.deadline = i->deadline;
+    key.context = previousContext;
+    key.rank = INFINITY;
+    key.duration = 0;
+    key.task = i->task;
+    set<ReadyTask>::iterator j = allReadyTasks.lower_bound(key);
+    if (j != allReadyTasks.end() && j->deadline == key.deadline && j->context == key.context) {
+        return j;
+    }
+    if (previousContext != NULL) {
+        key.context = NULL;
+        j = allReadyTasks.lower_bound(key);
+        if (j != allReadyTasks.end() && j->deadline == key.deadline && j->context == NULL) {
+            return j;
+        }
+    }
+    // in all other cases we just return the first task
+    return i;
+}
+
+void SimulatedScheduler::startTasks(bool mainThread, int &framePrefetched)
+{
+    for (unsigned int i = 0; i < threads.size(); ++i) {
+        SimulatedThread &s = threads[i];
+        if (s.task != NULL) {
+            continue;
+        }
+        set<ReadyTask>::iterator r;
+        if (i == 0) {
+            // the main thread executes the tasks for the current frame first,
+            // and then the minimum number of prefetching tasks per frame, or
+            // the prefetching tasks that can be completed before the end of
+            // the frame if there is a fixed framerate
+            if (!mainThread || allReadyTasks.empty()) {
+                continue;
+            }
+            r = getMainThreadTask();
+            if (r->deadline > 0) {
+                if (!immediateTasks.empty()) {
+                    continue;
+                }
+                if (framePrefetched >= prefetchRate && now + taskDurations[r->task.get()] > frameDeadline) {
+                    continue;
+                }
+                ++framePrefetched;
+            }
+        } else {
+            // the other threads only execute CPU prefetching tasks
+            if (readyCpuTasks.empty()) {
+                continue;
+            }
+            r = readyCpuTasks.begin();
+        }
+        ReadyTask t = *r;
+        allReadyTasks.erase(t);
+        readyCpuTasks.erase(t);
+        s.task = t.task;
+        s.start = now;
+        if (i == 0 && t.task->isGpuTask()) {
+            previousContext = t.task->getContext();
+        }
+        // as in MultithreadScheduler, an up to date task is not executed
+        s.changes = t.task->getCompletionDate() < t.task->getPredecessorsCompletionDate();
+        s.end = now + (s.changes ? taskDurations[t.task.get()] : 0.0f);
+    }
+}
+
+bool SimulatedScheduler::completeTask(double maxTime)
+{
+    int first = -1;
+    for (unsigned int i = 0; i < threads.size(); ++i) {
+        if (threads[i].task != NULL && (first == -1 || threads[i].end < threads[first].end)) {
+            first = i;
+        }
+    }
+    if (first == -1 || threads[first].end > maxTime) {
+        return false;
+    }
+    SimulatedThread &s = threads[first];
+    ptr<Task> t = s.task;
+    s.task = NULL;
+    s.busy += s.end - s.start;
+    now = max(now, s.end);
+    lastCompletion = now;
+
+    // same as MultithreadScheduler::taskDone
+    unsigned int completionDate = s.changes ? time : t->getCompletionDate();
+    map< ptr<Task>, set< ptr<Task> > >::iterator i = inverseDependencies.find(t);
+    if (i != inverseDependencies.end()) {
+        set< ptr<Task> >::iterator j = i->second.begin();
+        while (j != i->second.end()) { // iterates over the successors of t
+            ptr<Task> r = *j;
+            map< ptr<Task>, set< ptr<Task> > >::iterator k = dependencies.find(r);
+            assert(k != dependencies.end());
+            k->second.erase(t);
+            if (k->second.empty()) {
+                dependencies.erase(k);
+                insertTask(r);
+            }
+            j++;
+        }
+        inverseDependencies.erase(i);
+    }
+    if (prefetchQueue.erase(t) > 0) {
+        ++prefetched;
+    }
+    immediateTasks.erase(t);
+    taskDurations.erase(t.get());
+    t->setIsDone(true, completionDate);
+    ++time;
+    return true;
+}
+
+/// @cond RESOURCES
+
+class SimulatedSchedulerResource : public ResourceTemplate<0, SimulatedScheduler>
+{
+public:
+    SimulatedSchedulerResource(ptr<ResourceManager> manager, const string &name, ptr<ResourceDescriptor> desc, const TiXmlElement *e = NULL) :
+        ResourceTemplate<0, SimulatedScheduler>(manager, name, desc)
+    {
+        e = e == NULL ? desc->descriptor : e;
+        int prefetchRate = 0;
+        float frameRate = 0.0;
+        int nthreads = 0;
+        float defaultDuration = 1000.0f;
+        checkParameters(desc, e, "name,prefetchRate,fps,nthreads,policy,defaultDuration,");
+        if (e->Attribute("prefetchRate") != NULL) {
+            getIntParameter(desc, e, "prefetchRate", &prefetchRate);
+        }
+        if (e->Attribute("fps") != NULL) {
+            getFloatParameter(desc, e, "fps", &frameRate);
+        }
+        if (e->Attribute("nthreads") != NULL) {
+            getIntParameter(desc, e, "nthreads", &nthreads);
+        }
+        if (e->Attribute("defaultDuration") != NULL) {
+            getFloatParameter(desc, e, "defaultDuration", &defaultDuration);
+        }
+        init(prefetchRate, frameRate, nthreads, defaultDuration);
+        if (e->Attribute("policy") != NULL && strcmp(e->Attribute("policy"), "criticalPath") == 0) {
+            setPolicy(MultithreadScheduler::CRITICAL_PATH);
+        }
+    }
+};
+
+extern const char simulatedScheduler[] = "simulatedScheduler";
+
+static ResourceFactory::Type<simulatedScheduler, SimulatedSchedulerResource> SimulatedSchedulerType;
+
+/// @endcond
+
+}
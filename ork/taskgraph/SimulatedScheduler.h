@@ -0,0 +1,428 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#ifndef _ORK_SIMULATED_SCHEDULER_H_
+#define _ORK_SIMULATED_SCHEDULER_H_
+
+#include <string>
+#include <vector>
+
+#include "ork/taskgraph/MultithreadScheduler.h"
+
+namespace ork
+{
+
+/**
+ * A Scheduler that simulates the execution of tasks with a virtual clock,
+ * in order to compare scheduling policies or to detect performance
+ * regressions in a reproducible way. The tasks are not executed: each task
+ * is completed after a simulated duration, which comes from a duration model
+ * (see #setTaskDuration) or from the recorded execution times of the tasks of
+ * the same type (see Task#getExpectedDuration). The flattened task graph is
+ * executed by a fixed number of simulated threads, which follow the same
+ * rules as the threads of a MultithreadScheduler: the main thread (of index
+ * 0) executes the tasks for the current frame, and then the minimum number
+ * of prefetching tasks per frame, while the additional threads only execute
+ * CPU prefetching tasks. The ready tasks are executed by increasing deadline,
+ * and then in the order given by the scheduling policy. The result does not
+ * depend on the real execution times, nor on the number of real threads, and
+ * does not need a GPU.
+ *
+ * @ingroup taskgraph
+ */
+class ORK_API SimulatedScheduler : public Scheduler
+{
+public:
+    /**
+     * Creates a new simulated scheduler.
+     *
+     * @param prefetchRate the minimum number of prefetch tasks that the
+     *      simulated main thread executes at each frame, after all the tasks
+     *      for the current frame (see MultithreadScheduler).
+     * @param frameRate a fixed framerate that the simulated main thread
+     *      follows, or 0 to start each frame as soon as the previous one is
+     *      completed.
+     * @param nThreads the number of simulated threads, in addition to the
+     *      simulated main thread.
+     * @param defaultDuration the duration, in micro seconds, of the tasks
+     *      without duration model nor recorded execution time.
+     */
+    SimulatedScheduler(int prefetchRate = 0, float frameRate = 0.0f, int nThreads = 0, float defaultDuration = 1000.0f);
+
+    /**
+     * Deletes this scheduler.
+     */
+    virtual ~SimulatedScheduler();
+
+    /**
+     * Returns the order in which the ready tasks are executed.
+     */
+    MultithreadScheduler::policy getPolicy() const;
+
+    /**
+     * Sets the order in which the ready tasks are executed.
+     *
+     * @param p the order in which the ready tasks must be executed.
+     */
+    void setPolicy(MultithreadScheduler::policy p);
+
+    /**
+     * Sets the simulated duration of the tasks of the given type.
+     *
+     * @param taskType a task type (see Object#getClass).
+     * @param duration the duration, in micro seconds, of a task of this type
+     *      whose complexity is 1 (see Task#getComplexity).
+     */
+    void setTaskDuration(const std::string &taskType, float duration);
+
+    /**
+     * Returns true if the prefetch rate or the fixed frame rate is not null,
+     * or if there are several simulated threads and gpuTasks is false.
+     */
+    virtual bool supportsPrefetch(bool gpuTasks);
+
+    virtual void schedule(ptr<Task> task);
+
+    virtual void reschedule(ptr<Task> task, Task::reason r, unsigned int deadline);
+
+    /**
+     * Simulates one frame. The frame ends when the simulated main thread has
+     * completed all the tasks for the current frame (and the minimum number
+     * of prefetching tasks), or at the end of the frame period if there is
+     * a fixed framerate. The other simulated threads can still be executing
+     * prefetching tasks at this time.
+     *
+     * @param task the tasks to execute for this frame.
+     */
+    virtual void run(ptr<Task> task);
+
+    /**
+     * Simulates the execution of the scheduled tasks, without starting a new
+     * frame, until all the tasks that the simulated threads can execute are
+     * completed.
+     */
+    void finish();
+
+    /**
+     * Returns the current time of the virtual clock, in micro seconds, since
+     * the creation of this scheduler or the last call to #resetStatistics.
+     */
+    double getTime() const;
+
+    /**
+     * Returns the time of the virtual clock, in micro seconds, at which the
+     * last task was completed.
+     */
+    double getMakespan() const;
+
+    /**
+     * Returns the number of frames simulated with #run.
+     */
+    int getFrameCount() const;
+
+    /**
+     * Returns the duration of a simulated frame, in micro seconds.
+     *
+     * @param frame a frame index, between 0 and #getFrameCount (excluded).
+     */
+    double getFrameDuration(int frame) const;
+
+    /**
+     * Returns the number of simulated threads, including the main thread.
+     */
+    int getThreadCount() const;
+
+    /**
+     * Returns the time, in micro seconds, during which a simulated thread has
+     * not executed any task, until the current time of the virtual clock.
+     *
+     * @param thread a thread index, 0 being the main thread.
+     */
+    double getIdleTime(int thread) const;
+
+    /**
+     * Returns the number of completed prefetching tasks.
+     */
+    int getPrefetchedTasks() const;
+
+    /**
+     * Returns the number of completed prefetching tasks per second of
+     * virtual time, until the time of the last completed task.
+     */
+    double getPrefetchThroughput() const;
+
+    /**
+     * Logs the simulation results: makespan, idle time per thread, prefetch
+     * throughput, and average frame duration.
+     */
+    void logStatistics();
+
+    /**
+     * Resets the virtual clock and the simulation results to 0. The tasks
+     * being executed, if any, continue their execution.
+     */
+    void resetStatistics();
+
+protected:
+    /**
+     * Initializes this scheduler.
+     *
+     * See #SimulatedScheduler.
+     */
+    void init(int prefetchRate, float frameRate, int nThreads, float defaultDuration);
+
+    /**
+     * Returns the simulated duration of the given task, in micro seconds.
+     * The default implementation uses the duration model if there is one
+     * for the task type, and Task#getExpectedDuration otherwise.
+     *
+     * @param t a task.
+     */
+    virtual float getDuration(ptr<Task> t);
+
+private:
+    /**
+     * A ready task, with its sort keys. Ready tasks are sorted as in a
+     * MultithreadScheduler, i.e., by deadline, then by execution context, and
+     * then with MultithreadScheduler#isBefore.
+     */
+    struct ReadyTask
+    {
+        unsigned int deadline; ///< the task deadline.
+
+        void *context; ///< the task execution context.
+
+        float rank; ///< the task rank (see MultithreadScheduler#setPolicy).
+
+        int duration; ///< the simulated task duration, rounded to an integer.
+
+        ptr<Task> task; ///< the task.
+
+        bool operator<(const ReadyTask &r) const;
+    };
+
+    /**
+     * A simulated thread.
+     */
+    struct SimulatedThread
+    {
+        ptr<Task> task; ///< the task being executed, or NULL.
+
+        double start; ///< the time at which task was started.
+
+        double end; ///< the time at which task will be completed.
+
+        double busy; ///< the total duration of the completed tasks.
+
+        bool changes; ///< false if task was up to date, and thus not executed.
+
+        SimulatedThread();
+    };
+
+    /**
+     * Minimum number of prefetching tasks that the main thread executes per
+     * frame.
+     */
+    int prefetchRate;
+
+    /**
+     * The execution context of the last GPU task started by the simulated
+     * main thread during the current frame, or NULL.
+     */
+    void *previousContext;
+
+    /**
+     * Target frame duration in micro seconds, or 0 if no fixed framerate.
+     */
+    float framePeriod;
+
+    /**
+     * The duration of the tasks without duration model nor statistics.
+     */
+    float defaultDuration;
+
+    /**
+     * The order in which the ready tasks are executed.
+     */
+    MultithreadScheduler::policy schedulingPolicy;
+
+    /**
+     * The duration model. Maps task types to durations for complexity 1.
+     */
+    std::map<std::string, float> durations;
+
+    /**
+     * The current time of the virtual clock.
+     */
+    double now;
+
+    /**
+     * The time at which the last task was completed.
+     */
+    double lastCompletion;
+
+    /**
+     * Logical time used for task completion dates.
+     */
+    unsigned int time;
+
+    /**
+     * The simulated threads, the main thread being the first one.
+     */
+    std::vector<SimulatedThread> threads;
+
+    /**
+     * The time at which the current frame must end if there is a fixed
+     * framerate, or 0.
+     */
+    double frameDeadline;
+
+    /**
+     * The duration of each simulated frame.
+     */
+    std::vector<double> frames;
+
+    /**
+     * The number of completed prefetching tasks.
+     */
+    int prefetched;
+
+    /**
+     * The primitive tasks for the current frame that remain to be executed.
+     */
+    std::set< ptr<Task> > immediateTasks;
+
+    /**
+     * The prefetching tasks that remain to be executed.
+     */
+    std::set< ptr<Task> > prefetchQueue;
+
+    /**
+     * The primitive tasks that are ready to be executed.
+     */
+    std::set<ReadyTask> allReadyTasks;
+
+    /**
+     * The primitive CPU prefetching tasks that are ready to be executed.
+     */
+    std::set<ReadyTask> readyCpuTasks;
+
+    /**
+     * The predecessors of the tasks that remain to be executed.
+     */
+    std::map< ptr<Task>, std::set< ptr<Task> > > dependencies;
+
+    /**
+     * The successors of the tasks that remain to be executed.
+     */
+    std::map< ptr<Task>, std::set< ptr<Task> > > inverseDependencies;
+
+    /**
+     * The simulated duration of the tasks that remain to be executed.
+     */
+    std::map<Task*, float> taskDurations;
+
+    /**
+     * The upward rank of the tasks that remain to be executed (see
+     * MultithreadScheduler#setPolicy).
+     */
+    std::map<Task*, float> ranks;
+
+    /**
+     * Adds all the primitive tasks of the given task to the set of tasks to be
+     * executed (see MultithreadScheduler#addFlattenedTask).
+     */
+    void addFlattenedTask(ptr<Task> t, std::set< ptr<Task> > &addedTasks);
+
+    /**
+     * Adds all the primitive dependencies between the primitive first tasks of
+     * src and the primitive last tasks of dst.
+     */
+    void addFlattenedDependency(ptr<Task> src, ptr<Task> dst);
+
+    /**
+     * Sets the deadline of a task and of its predecessors, recursively.
+     */
+    void setDeadline(ptr<Task> t, unsigned int deadline, std::set< ptr<Task> > &visited);
+
+    /**
+     * Recomputes the task ranks and the ready task sets.
+     */
+    void updateReadyTasks();
+
+    /**
+     * Computes the upward rank of a task.
+     */
+    float computeRank(ptr<Task> t);
+
+    /**
+     * Inserts a task in the ready task sets.
+     */
+    void insertTask(ptr<Task> t);
+
+    /**
+     * Returns the ready task that the simulated main thread must execute,
+     * with the same rules as MultithreadScheduler#getTask.
+     */
+    std::set<ReadyTask>::iterator getMainThreadTask();
+
+    /**
+     * Starts the execution of ready tasks on the idle simulated threads.
+     *
+     * @param mainThread true if the main thread can start tasks.
+     * @param[in,out] framePrefetched the number of prefetching tasks started
+     *      by the main thread during the current frame.
+     */
+    void startTasks(bool mainThread, int &framePrefetched);
+
+    /**
+     * Completes the task that ends first, and advances the virtual clock to
+     * its completion time.
+     *
+     * @param maxTime the time that the virtual clock must not exceed.
+     * @return false if no task ends before maxTime.
+     */
+    bool completeTask(double maxTime);
+};
+
+}
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#ifndef _ORK_SUSPENDABLE_TASK_H_
+#define _ORK_SUSPENDABLE_TASK_H_
+
+#include "ork/taskgraph/TaskEvent.h"
+
+namespace ork
+{
+
+/**
+ * A task that can suspend its execution to wait for an event, without
+ * blocking the scheduler thread that executes it. The #run method of such a
+ * task can call #await and return. The task is then suspended: it is not
+ * completed, its successors are not executed, and the scheduler thread can
+ * execute other tasks. When the awaited event is signaled, the task is put
+ * back in the set of tasks ready to be executed, and its #run method is
+ * called again. This method must then resume the execution where it stopped,
+ * for instance by using a state variable. The task is completed when #run
+ * returns without calling #await. Its completion date, deadline and listeners
+ * are then handled as for any other task, and its result is considered as
+ * changed if one of its #run calls returned true.
+ *
+ * Only the MultithreadScheduler supports suspended tasks. A task for the
+ * current frame can be suspended, but the call to Scheduler#run then returns
+ * only when the awaited event is signaled and the task is completed.
+ *
+ * @ingroup taskgraph
+ */
+class ORK_API SuspendableTask : public Task
+{
+public:
+    /**
+     * Creates a new suspendable task.
+     *
+     * @param type the type of the task.
+     * @param gpuTask if the task must be executed on GPU.
+     * @param deadline the frame number before which the task must be executed.
+     *      0 means that the task must be executed immediately.
+     */
+    SuspendableTask(const char *type, bool gpuTask, unsigned int deadline);
+
+    /**
+     * Deletes this suspendable task.
+     */
+    virtual ~SuspendableTask();
+
+protected:
+    /**
+     * Suspends this task until the given event is signaled. This method must
+     * only be called from #run, which must return just after.
+     *
+     * @param e the event to wait for.
+     */
+    void await(ptr<TaskEvent> e);
+
+private:
+    /**
+     * The event passed to the last call to #await, or NULL. This event is
+     * reset to NULL when the task is suspended.
+     */
+    ptr<TaskEvent> awaitedEvent;
+
+    /**
+     * True if this task is suspended, waiting for an event.
+     */
+    bool suspended;
+
+    /**
+     * True if a previous call to #run, in the current execution of this
+     * task, has returned true.
+     */
+    bool changes;
+
+    friend class MultithreadScheduler;
+};
+
+}
+
+#endif
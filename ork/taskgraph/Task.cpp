@@ -45,6 +45,7 @@
 #include <algorithm>
 #include <sstream>
 
+#include "ork/core/Atomic.h"
 #include "ork/core/Logger.h"
 
 #include <pthread.h>
@@ -56,24 +57,217 @@ namespace ork
 
 void *Task::mutex = NULL;
 
+void *Task::threadStatistics = NULL;
+
+bool Task::collectHistograms = false;
+
+long Task::sequences = 0;
+
 map<type_info const*, Task::TaskStatistics*, Task::TypeInfoSort> Task::statistics;
 
+/**
+ * Minimum number of samples before the statistics of a task type are used
+ * to compute expected durations.
+ */
+static const int MIN_SAMPLES = 64;
+
+/**
+ * Number of samples accumulated in thread local statistics before trying to
+ * merge them into the global statistics.
+ */
+static const int MERGE_SAMPLES = 16;
+
+/**
+ * Number of bins of the execution time histograms. Bin i contains the
+ * durations between 2^(i/4) and 2^((i+1)/4) micro seconds.
+ */
+static const int HISTOGRAM_SIZE = 96;
+
+struct Task::ThreadStatistics
+{
+    /**
+     * The thread local statistics of a task type.
+     */
+    struct Local
+    {
+        TaskStatistics samples; ///< the samples not yet merged.
+
+        TaskStatistics *global; ///< the corresponding global statistics.
+    };
+
+    /**
+     * The thread local statistics for each task type.
+     */
+    map<type_info const*, Local*, TypeInfoSort> types;
+
+    /**
+     * Merges all the remaining samples into the global statistics.
+     */
+    ~ThreadStatistics()
+    {
+        pthread_mutex_lock((pthread_mutex_t*) mutex);
+        map<type_info const*, Local*, TypeInfoSort>::iterator i = types.begin();
+        while (i != types.end()) {
+            merge(i->second);
+            delete i->second;
+            i++;
+        }
+        pthread_mutex_unlock((pthread_mutex_t*) mutex);
+    }
+
+    /**
+     * Returns the thread local statistics of the current thread.
+     */
+    static ThreadStatistics *get()
+    {
+        pthread_key_t key = *((pthread_key_t*) threadStatistics);
+        ThreadStatistics *s = (ThreadStatistics*) pthread_getspecific(key);
+        if (s == NULL) {
+            s = new ThreadStatistics();
+            pthread_setspecific(key, s);
+        }
+        return s;
+    }
+
+    /**
+     * Deletes the thread local statistics of a thread that terminates.
+     */
+    static void release(void *s)
+    {
+        delete (ThreadStatistics*) s;
+    }
+
+    /**
+     * Returns the thread local statistics for the given task type. The global
+     * statistics for this type are created if necessary; this only takes the
+     * global lock the first time a type is seen by a thread.
+     */
+    Local *find(const type_info *id)
+    {
+        map<type_info const*, Local*, TypeInfoSort>::iterator i = types.find(id);
+        if (i != types.end()) {
+            return i->second;
+        }
+        Local *l = new Local();
+        pthread_mutex_lock((pthread_mutex_t*) mutex);
+        map<type_info const*, TaskStatistics*, TypeInfoSort>::iterator j = statistics.find(id);
+        if (j == statistics.end()) {
+            l->global = new TaskStatistics();
+            statistics.insert(make_pair(id, l->global));
+        } else {
+            l->global = j->second;
+        }
+        pthread_mutex_unlock((pthread_mutex_t*) mutex);
+        types.insert(make_pair(id, l));
+        return l;
+    }
+
+    /**
+     * Merges the samples of the given local statistics into the global ones.
+     * The global lock must be held by the caller.
+     */
+    static void merge(Local *l)
+    {
+        if (l->samples.n > 0) {
+            l->global->merge(l->samples);
+            l->global->updateExpected();
+            l->samples.reset();
+        }
+    }
+};
+
 bool Task::TypeInfoSort::operator()(const type_info *x, const type_info *y) const
 {
     return (*x).before(*y) != 0;
 }
 
 Task::TaskStatistics::TaskStatistics() :
-    durationSum(0.0f), durationSquareSum(0.0f), minDuration(INFINITY), maxDuration(0.0f), corrected(false), n(0)
+    n(0), mean(0.0), m2(0.0), minDuration(INFINITY), maxDuration(0.0f), histogram(NULL), expected(-1.0f)
 {
 }
 
+Task::TaskStatistics::~TaskStatistics()
+{
+    if (histogram != NULL) {
+        delete[] histogram;
+    }
+}
+
+void Task::TaskStatistics::add(float duration)
+{
+    // Welford's algorithm, numerically stable
+    n += 1;
+    double delta = duration - mean;
+    mean += delta / n;
+    m2 += delta * (duration - mean);
+    minDuration = min(duration, minDuration);
+    maxDuration = max(duration, maxDuration);
+    if (collectHistograms) {
+        if (histogram == NULL) {
+            histogram = new unsigned int[HISTOGRAM_SIZE];
+            fill(histogram, histogram + HISTOGRAM_SIZE, 0u);
+        }
+        int bin = duration > 1.0f ? int(4.0f * log(duration) / log(2.0f)) : 0;
+        histogram[min(bin, HISTOGRAM_SIZE - 1)] += 1;
+    }
+}
+
+void Task::TaskStatistics::merge(const TaskStatistics &s)
+{
+    // parallel variant of Welford's algorithm (Chan et al.)
+    int count = n + s.n;
+    double delta = s.mean - mean;
+    mean += delta * s.n / count;
+    m2 += s.m2 + delta * delta * n * s.n / count;
+    n = count;
+    minDuration = min(s.minDuration, minDuration);
+    maxDuration = max(s.maxDuration, maxDuration);
+    if (s.histogram != NULL) {
+        if (histogram == NULL) {
+            histogram = new unsigned int[HISTOGRAM_SIZE];
+            fill(histogram, histogram + HISTOGRAM_SIZE, 0u);
+        }
+        for (int i = 0; i < HISTOGRAM_SIZE; ++i) {
+            histogram[i] += s.histogram[i];
+        }
+    }
+}
+
+void Task::TaskStatistics::reset()
+{
+    n = 0;
+    mean = 0.0;
+    m2 = 0.0;
+    minDuration = INFINITY;
+    maxDuration = 0.0f;
+    if (histogram != NULL) {
+        fill(histogram, histogram + HISTOGRAM_SIZE, 0u);
+    }
+}
+
+void Task::TaskStatistics::updateExpected()
+{
+    // to get "valid" statistics, we wait until we have enough samples,
+    // and we ignore the min and max values
+    if (n >= MIN_SAMPLES) {
+        double count = n - 2;
+        double sum = mean * n - minDuration - maxDuration;
+        double squareSum = m2 + mean * mean * n - minDuration * minDuration - maxDuration * maxDuration;
+        double m = sum / count;
+        double variance = max(squareSum / count - m * m, 0.0);
+        expected = float(m + 2.0 * sqrt(variance));
+    }
+}
+
 Task::Task(const char *type, bool gpuTask, unsigned int deadline) :
-    Object(type), completionDate(0), gpuTask(gpuTask), deadline(deadline), predecessorsCompletionDate(1), done(false), expectedDuration(-1.0f)
+    Object(type), completionDate(0), gpuTask(gpuTask), deadline(deadline), predecessorsCompletionDate(1), done(false), expectedDuration(-1.0f), rank(0.0f)
 {
+    sequence = (unsigned int) atomic_exchange_and_add(&sequences, 1);
     if (mutex == NULL) {
         mutex = new pthread_mutex_t;
         pthread_mutex_init((pthread_mutex_t*) mutex, NULL);
+        threadStatistics = new pthread_key_t;
+        pthread_key_create((pthread_key_t*) threadStatistics, ThreadStatistics::release);
     }
 }
 
@@ -161,53 +355,28 @@ float Task::getExpectedDuration()
 {
     if (expectedDuration == -1.0f) {
         expectedDuration = 0.0f;
-        const type_info *id = getTypeInfo();
-        pthread_mutex_lock((pthread_mutex_t*) mutex);
-        map<type_info const*, TaskStatistics*, TypeInfoSort>::iterator i = statistics.find(id);
-        if (i != statistics.end()) {
-            TaskStatistics *stats = i->second;
-            // to get "valid" statistics, we wait until we have enough samples,
-            // and we ignore the min and max values
-            const int MIN_SAMPLES = 64;
-            if (stats->n >= MIN_SAMPLES) {
-                if (!stats->corrected) {
-                    float sum = stats->durationSum - stats->maxDuration - stats->minDuration;
-                    float squareSum = stats->durationSum - stats->maxDuration * stats->maxDuration - stats->minDuration * stats->minDuration;
-                    stats->durationSum = (sum * stats->n) / (stats->n - 2) ;
-                    stats->durationSquareSum = (squareSum * stats->n) / (stats->n - 2);
-                    stats->corrected = true;
-                }
-                float mean = stats->durationSum / stats->n;
-                float squareMean = stats->durationSquareSum / stats->n;
-                float variance = squareMean - mean * mean;
-                float standardDeviation = sqrt(variance);
-                expectedDuration = (mean + 2.0f * standardDeviation) * getComplexity();
-            }
+        TaskStatistics *stats = ThreadStatistics::get()->find(getTypeInfo())->global;
+        float expected = stats->expected;
+        if (expected >= 0.0f) {
+            expectedDuration = expected * getComplexity();
         }
-        pthread_mutex_unlock((pthread_mutex_t*) mutex);
     }
     return expectedDuration;
 }
 
 void Task::setActualDuration(float duration)
 {
-    TaskStatistics *stats;
-    const type_info *id = getTypeInfo();
-    pthread_mutex_lock((pthread_mutex_t*) mutex);
-    map<type_info const*, TaskStatistics*, TypeInfoSort>::iterator i = statistics.find(id);
-    if (i == statistics.end()) {
-        stats = new TaskStatistics();
-        statistics.insert(make_pair(id, stats));
-    } else {
-        stats = i->second;
-    }
-    duration = duration / getComplexity();
-    stats->durationSum += duration;
-    stats->durationSquareSum += duration * duration;
-    stats->minDuration = min(duration, stats->minDuration);
-    stats->maxDuration = max(duration, stats->maxDuration);
-    stats->n += 1;
-    pthread_mutex_unlock((pthread_mutex_t*) mutex);
+    ThreadStatistics::Local *stats = ThreadStatistics::get()->find(getTypeInfo());
+    stats->samples.add(duration / getComplexity());
+    // the samples are merged quickly until the global statistics become
+    // usable, and then by batches. If another thread holds the lock the
+    // merge is simply postponed, so that this method never waits.
+    if (stats->samples.n >= MERGE_SAMPLES || stats->global->expected < 0.0f) {
+        if (pthread_mutex_trylock((pthread_mutex_t*) mutex) == 0) {
+            ThreadStatistics::merge(stats);
+            pthread_mutex_unlock((pthread_mutex_t*) mutex);
+        }
+    }
 }
 
 const type_info *Task::getTypeInfo()
@@ -230,23 +399,80 @@ void Task::removeListener(TaskListener *l)
 
 void Task::logStatistics()
 {
+    if (mutex == NULL) {
+        return;
+    }
+    ThreadStatistics *local = ThreadStatistics::get();
     pthread_mutex_lock((pthread_mutex_t*) mutex);
+    map<type_info const*, ThreadStatistics::Local*, TypeInfoSort>::iterator j = local->types.begin();
+    while (j != local->types.end()) {
+        ThreadStatistics::merge(j->second);
+        j++;
+    }
     map<type_info const*, TaskStatistics*, TypeInfoSort>::iterator i = statistics.begin();
     while (i != statistics.end()) {
         TaskStatistics *stats = i->second;
-        float mean = stats->durationSum / stats->n;
-        float squareMean = stats->durationSquareSum / stats->n;
-        float variance = squareMean - mean * mean;
-        float standardDeviation = sqrt(variance);
+        if (stats->n == 0) {
+            i++;
+            continue;
+        }
+        float mean = float(stats->mean);
+        float standardDeviation = float(sqrt(stats->m2 / stats->n));
 
         ostringstream oss;
         oss.setf(ios::fixed,ios::floatfield);
         oss.precision(3);
         oss << i->first->name() << ": " << mean / 1000.0 << " +/- " << standardDeviation / 1000.0 << "; min/max " << stats->minDuration / 1000.0 << " " << stats->maxDuration / 1000.0;
+        if (stats->histogram != NULL) {
+            oss << "; p50/p95/p99 " << getPercentile(stats, 50.0f) / 1000.0 << " " << getPercentile(stats, 95.0f) / 1000.0 << " " << getPercentile(stats, 99.0f) / 1000.0;
+        }
         Logger::DEBUG_LOGGER->log("SCHEDULER", oss.str());
         i++;
     }
     pthread_mutex_unlock((pthread_mutex_t*) mutex);
 }
 
+void Task::setCollectHistograms(bool collect)
+{
+    collectHistograms = collect;
+}
+
+float Task::getDurationPercentile(const type_info *type, float p)
+{
+    float result = -1.0f;
+    if (mutex != NULL) {
+        pthread_mutex_lock((pthread_mutex_t*) mutex);
+        map<type_info const*, TaskStatistics*, TypeInfoSort>::iterator i = statistics.find(type);
+        if (i != statistics.end()) {
+            result = getPercentile(i->second, p);
+        }
+        pthread_mutex_unlock((pthread_mutex_t*) mutex);
+    }
+    return result;
+}
+
+float Task::getPercentile(const TaskStatistics *stats, float p)
+{
+    if (stats->histogram == NULL) {
+        return -1.0f;
+    }
+    unsigned int total = 0;
+    for (int i = 0; i < HISTOGRAM_SIZE; ++i) {
+        total += stats->histogram[i];
+    }
+    if (total == 0) {
+        return -1.0f;
+    }
+    // returns the geometric center of the bin containing the percentile
+    float rank = p / 100.0f * total;
+    unsigned int count = 0;
+    for (int i = 0; i < HISTOGRAM_SIZE; ++i) {
+        count += stats->histogram[i];
+        if (count >= rank && count > 0) {
+            return i == 0 ? 1.0f : pow(2.0f, (i + 0.5f) / 4.0f);
+        }
+    }
+    return stats->maxDuration;
+}
+
 }
@@ -230,7 +230,9 @@ public:
 
     /**
      * Returns the expected duration of this task in micro seconds. The result
-     * is based on the complexity of this task (see #getComplexity).
+     * is based on the complexity of this task (see #getComplexity). It is
+     * read from a snapshot of the execution time statistics of the tasks of
+     * this type, without any lock.
      */
     float getExpectedDuration();
 
@@ -238,7 +240,10 @@ public:
      * Sets the actual duration of this task. This actual duration is used to
      * improve the estimator for the duration of tasks of this type (see
      * #getTypeInfo). <i>For internal use only</i>. This method is called by
-     * schedulers, it must not called directly by users.
+     * schedulers, it must not called directly by users. The duration is first
+     * accumulated in statistics local to the calling thread, which are merged
+     * into the global statistics from time to time, when this can be done
+     * without waiting for another thread.
      *
      * @param duration the actual duration of this task in micro seconds.
      */
@@ -264,6 +269,27 @@ public:
      */
     static void logStatistics();
 
+    /**
+     * Enables or disables the collection of execution time histograms for
+     * each task type. Histograms are disabled by default. They are needed by
+     * #getDurationPercentile.
+     *
+     * @param collect true to collect execution time histograms.
+     */
+    static void setCollectHistograms(bool collect);
+
+    /**
+     * Returns an approximate percentile of the execution time of the tasks
+     * of the given type, in micro seconds. This percentile is computed from
+     * the execution time histogram of this type (see #setCollectHistograms).
+     *
+     * @param type a task type (see #getTypeInfo).
+     * @param p the percentile to compute, between 0 and 100.
+     * @return the requested percentile, or -1 if no histogram has been
+     *      collected for this type.
+     */
+    static float getDurationPercentile(const std::type_info *type, float p);
+
 protected:
     unsigned int completionDate; ///< time at which this task was completed.
 
@@ -289,21 +315,56 @@ private:
      */
     struct TaskStatistics
     {
-        float durationSum; ///< sum of the execution times.
+        int n; ///< number of executions.
 
-        float durationSquareSum; ///< sum of the squares of the execution times.
+        double mean; ///< running mean of the execution times.
+
+        double m2; ///< running sum of the squared differences to the mean.
 
         float minDuration; ///< minimum execution time.
 
         float maxDuration; ///< maximum execution time.
 
-        bool corrected; ///< true if min and max values have been removed from sum and squareSum
+        unsigned int *histogram; ///< execution time histogram, or NULL.
 
-        int n; ///< number of executions.
+        /**
+         * The expected duration of a task of complexity 1, computed from the
+         * above values when they are merged, or -1 if there are not enough
+         * samples yet. Read without lock by #getExpectedDuration.
+         */
+        volatile float expected;
 
         TaskStatistics();
+
+        ~TaskStatistics();
+
+        /**
+         * Adds an execution time to these statistics.
+         */
+        void add(float duration);
+
+        /**
+         * Adds the given statistics to these statistics.
+         */
+        void merge(const TaskStatistics &s);
+
+        /**
+         * Removes all the samples from these statistics.
+         */
+        void reset();
+
+        /**
+         * Updates #expected from the current samples.
+         */
+        void updateExpected();
     };
 
+    /**
+     * Execution time statistics of the current thread, not yet merged into
+     * #statistics.
+     */
+    struct ThreadStatistics;
+
     bool gpuTask; ///< true is this task is a GPU task.
 
     unsigned int deadline; ///< frame number before which this tasks must be completed.
@@ -314,8 +375,39 @@ private:
 
     float expectedDuration; ///< expected duration of this task.
 
+    /**
+     * The priority of this task, used by MultithreadScheduler to order the
+     * tasks that are ready to be executed. This is the length of the longest
+     * expected path from this task to the end of the task graph, or 0 if the
+     * scheduler does not use the MultithreadScheduler::CRITICAL_PATH policy.
+     */
+    float rank;
+
+    /**
+     * The creation order of this task, used by MultithreadScheduler and
+     * SimulatedScheduler to order the ready tasks with the same rank and
+     * expected duration independently of their memory address.
+     */
+    unsigned int sequence;
+
+    static long sequences; ///< number of tasks created so far, used for #sequence.
+
     static void* mutex; ///< mutex used to synchronize accesses to #statistics
 
+    static void* threadStatistics; ///< key of the ThreadStatistics of each thread.
+
+    static bool collectHistograms; ///< true to collect execution time histograms.
+
+    /**
+     * Returns an approximate percentile of the given statistics, or -1 if
+     * they do not have an histogram. The global lock must be held.
+     */
+    static float getPercentile(const TaskStatistics *stats, float p);
+
+    friend class MultithreadScheduler;
+
+    friend class SimulatedScheduler;
+
     /**
      * The execution time statistics for each task type. Maps TaskStatistics to
      *std::type_info objects.
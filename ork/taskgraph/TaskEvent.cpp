@@ -0,0 +1,204 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#include "ork/taskgraph/TaskEvent.h"
+
+#include <algorithm>
+
+#include <pthread.h>
+
+#include <GL/glew.h>
+
+using namespace std;
+
+namespace ork
+{
+
+TaskEvent::TaskEvent() : Object("TaskEvent")
+{
+    init();
+}
+
+TaskEvent::TaskEvent(const char *type) : Object(type)
+{
+    init();
+}
+
+void TaskEvent::init()
+{
+    mutex = new pthread_mutex_t;
+    pthread_mutex_init((pthread_mutex_t*) mutex, NULL);
+    notifiedCond = new pthread_cond_t;
+    pthread_cond_init((pthread_cond_t*) notifiedCond, NULL);
+    signaled = false;
+    notifications = 0;
+}
+
+TaskEvent::~TaskEvent()
+{
+    pthread_mutex_destroy((pthread_mutex_t*) mutex);
+    delete (pthread_mutex_t*) mutex;
+    pthread_cond_destroy((pthread_cond_t*) notifiedCond);
+    delete (pthread_cond_t*) notifiedCond;
+}
+
+bool TaskEvent::isSignaled()
+{
+    pthread_mutex_lock((pthread_mutex_t*) mutex);
+    bool result = signaled;
+    pthread_mutex_unlock((pthread_mutex_t*) mutex);
+    return result;
+}
+
+void TaskEvent::signal()
+{
+    vector<TaskEventListener*> l;
+    pthread_mutex_lock((pthread_mutex_t*) mutex);
+    signaled = true;
+    l.swap(listeners);
+    if (!l.empty()) {
+        ++notifications;
+    }
+    pthread_mutex_unlock((pthread_mutex_t*) mutex);
+    // the listeners are notified without holding the mutex, so that they
+    // can access this event
+    if (!l.empty()) {
+        // keeps this event alive until all its listeners are notified
+        ptr<TaskEvent> e = this;
+        for (unsigned int i = 0; i < l.size(); ++i) {
+            l[i]->eventSignaled(e);
+        }
+        pthread_mutex_lock((pthread_mutex_t*) mutex);
+        --notifications;
+        pthread_cond_broadcast((pthread_cond_t*) notifiedCond);
+        pthread_mutex_unlock((pthread_mutex_t*) mutex);
+    }
+}
+
+void TaskEvent::reset()
+{
+    pthread_mutex_lock((pthread_mutex_t*) mutex);
+    signaled = false;
+    pthread_mutex_unlock((pthread_mutex_t*) mutex);
+}
+
+bool TaskEvent::addListener(TaskEventListener *l)
+{
+    pthread_mutex_lock((pthread_mutex_t*) mutex);
+    bool result = !signaled;
+    if (result && find(listeners.begin(), listeners.end(), l) == listeners.end()) {
+        listeners.push_back(l);
+    }
+    pthread_mutex_unlock((pthread_mutex_t*) mutex);
+    return result;
+}
+
+void TaskEvent::removeListener(TaskEventListener *l)
+{
+    pthread_mutex_lock((pthread_mutex_t*) mutex);
+    vector<TaskEventListener*>::iterator i = find(listeners.begin(), listeners.end(), l);
+    if (i != listeners.end()) {
+        listeners.erase(i);
+    }
+    // l may be being notified by #signal, without the mutex
+    while (notifications > 0) {
+        pthread_cond_wait((pthread_cond_t*) notifiedCond, (pthread_mutex_t*) mutex);
+    }
+    pthread_mutex_unlock((pthread_mutex_t*) mutex);
+}
+
+TaskEventListener::~TaskEventListener()
+{
+}
+
+TaskCompletionEvent::TaskCompletionEvent(ptr<Task> task) :
+    TaskEvent("TaskCompletionEvent"), task(task)
+{
+    task->addListener(this);
+    if (task->isDone()) {
+        signal();
+    }
+}
+
+TaskCompletionEvent::~TaskCompletionEvent()
+{
+    task->removeListener(this);
+}
+
+void TaskCompletionEvent::taskStateChanged(ptr<Task> /*t*/, bool done, Task::reason /*r*/)
+{
+    if (done) {
+        signal();
+    }
+}
+
+void TaskCompletionEvent::completionDateChanged(ptr<Task> /*t*/, unsigned int /*date*/)
+{
+}
+
+GLFenceEvent::GLFenceEvent() : TaskEvent("GLFenceEvent")
+{
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // makes sure the fence reaches the GPU, since #poll does not flush
+    glFlush();
+}
+
+GLFenceEvent::~GLFenceEvent()
+{
+    glDeleteSync((GLsync) fence);
+}
+
+bool GLFenceEvent::poll()
+{
+    if (isSignaled()) {
+        return true;
+    }
+    GLenum status = glClientWaitSync((GLsync) fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        return false;
+    }
+    // GL_WAIT_FAILED also signals the event, otherwise the tasks waiting
+    // for it would be suspended forever
+    signal();
+    return true;
+}
+
+}
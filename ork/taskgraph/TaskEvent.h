@@ -0,0 +1,251 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#ifndef _ORK_TASK_EVENT_H_
+#define _ORK_TASK_EVENT_H_
+
+#include <vector>
+
+#include "ork/taskgraph/Task.h"
+
+namespace ork
+{
+
+class TaskEventListener;
+
+/**
+ * An event that a SuspendableTask can wait for, such as the end of a file
+ * read, of an asynchronous GPU readback, or of another task. An event is
+ * initially not signaled. It is signaled with #signal, by the code that
+ * produces the awaited result, from any thread. The listeners of the event,
+ * such as a MultithreadScheduler with suspended tasks waiting for it, are then
+ * notified.
+ *
+ * @ingroup taskgraph
+ */
+class ORK_API TaskEvent : public Object
+{
+public:
+    /**
+     * Creates a new, not signaled event.
+     */
+    TaskEvent();
+
+    /**
+     * Deletes this event.
+     */
+    virtual ~TaskEvent();
+
+    /**
+     * Returns true if this event has been signaled.
+     */
+    bool isSignaled();
+
+    /**
+     * Signals this event. The current listeners of this event are notified
+     * and removed. This method can be called from any thread.
+     */
+    void signal();
+
+    /**
+     * Sets this event in the not signaled state, so that it can be reused.
+     */
+    void reset();
+
+    /**
+     * Adds a listener to this event, if it is not already signaled. The
+     * listener is automatically removed after it has been notified.
+     *
+     * @param l a listener.
+     * @return false if this event is already signaled. In this case l is not
+     *      added to the listeners of this event.
+     */
+    bool addListener(TaskEventListener *l);
+
+    /**
+     * Removes a listener from this event. If this event is being signaled,
+     * this method waits until all its listeners are notified, so that the
+     * given listener can be safely deleted when this method returns. Hence
+     * it must not be called from TaskEventListener#eventSignaled.
+     *
+     * @param l a listener.
+     */
+    void removeListener(TaskEventListener *l);
+
+protected:
+    /**
+     * Creates a new, not signaled event.
+     *
+     * @param type the type of this event.
+     */
+    TaskEvent(const char *type);
+
+private:
+    /**
+     * A mutex used to synchronize accesses to this event.
+     */
+    void *mutex;
+
+    /**
+     * A condition signaled when the listeners of this event have been
+     * notified (see #removeListener).
+     */
+    void *notifiedCond;
+
+    /**
+     * True if this event has been signaled.
+     */
+    bool signaled;
+
+    /**
+     * The number of #signal calls that are notifying listeners.
+     */
+    int notifications;
+
+    /**
+     * The listeners waiting for this event to be signaled.
+     */
+    std::vector<TaskEventListener*> listeners;
+
+    /**
+     * Initializes this event.
+     */
+    void init();
+};
+
+/**
+ * A TaskEvent listener, notified when the event is signaled.
+ *
+ * @ingroup taskgraph
+ */
+class ORK_API TaskEventListener
+{
+public:
+    /**
+     * Deletes this listener.
+     */
+    virtual ~TaskEventListener();
+
+    /**
+     * Notifies this listener that the given event has been signaled. This
+     * method is called in the thread that signaled the event.
+     *
+     * @param e the signaled event.
+     */
+    virtual void eventSignaled(ptr<TaskEvent> e) = 0;
+};
+
+/**
+ * A TaskEvent that is signaled when a task is completed.
+ *
+ * @ingroup taskgraph
+ */
+class ORK_API TaskCompletionEvent : public TaskEvent, public TaskListener
+{
+public:
+    /**
+     * Creates a new task completion event. If the task is already completed,
+     * the event is signaled immediately.
+     *
+     * @param task the task whose completion must signal this event.
+     */
+    TaskCompletionEvent(ptr<Task> task);
+
+    /**
+     * Deletes this event.
+     */
+    virtual ~TaskCompletionEvent();
+
+    virtual void taskStateChanged(ptr<Task> t, bool done, Task::reason r);
+
+    virtual void completionDateChanged(ptr<Task> t, unsigned int date);
+
+private:
+    /**
+     * The task whose completion must signal this event.
+     */
+    ptr<Task> task;
+};
+
+/**
+ * A TaskEvent that is signaled when the GPU has completed the OpenGL commands
+ * issued before its creation, such as the commands filling a buffer that must
+ * be read back. OpenGL does not notify the completion of these commands, and
+ * they can only be tested in the OpenGL thread. Hence this event is signaled by
+ * #poll, which is periodically called by the MultithreadScheduler while some
+ * suspended tasks are waiting for it.
+ *
+ * @ingroup taskgraph
+ */
+class ORK_API GLFenceEvent : public TaskEvent
+{
+public:
+    /**
+     * Creates a new event, signaled when the OpenGL commands issued so far
+     * are completed. <i>This constructor must be called in the OpenGL
+     * thread</i>.
+     */
+    GLFenceEvent();
+
+    /**
+     * Deletes this event.
+     */
+    virtual ~GLFenceEvent();
+
+    /**
+     * Tests if the OpenGL commands issued before this event are completed,
+     * without waiting for them, and signals this event if this is the case.
+     * <i>This method must be called in the OpenGL thread</i>.
+     *
+     * @return true if this event is signaled.
+     */
+    bool poll();
+
+private:
+    /**
+     * The OpenGL fence inserted after the awaited commands, as a GLsync.
+     */
+    void *fence;
+};
+
+}
+
+#endif
@@ -139,8 +139,7 @@ TaskGraph::TaskIterator TaskGraph::getDependencies(ptr<Task> t)
     map< ptr<Task>, set< ptr<Task> > >::iterator i;
     i = dependencies.find(t);
     if (i != dependencies.end()) {
-        set< ptr<Task> > s = i->second;
-        return TaskIterator(s);
+        return TaskIterator(i->second);
     }
     return TaskIterator();
 }
@@ -231,6 +231,8 @@ private:
     std::map< ptr<Task>, std::set< ptr<Task> > > inverseDependencies;
 
     friend class MultithreadScheduler;
+
+    friend class SimulatedScheduler;
 };
 
 }
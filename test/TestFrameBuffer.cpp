@@ -41,6 +41,7 @@
 
 #include "test/Test.h"
 
+#include "ork/core/Statistics.h"
 #include "ork/render/FrameBuffer.h"
 
 using namespace std;
@@ -1030,3 +1031,75 @@ TEST(gpuMeshModificationIndices)
         pixels2[0] == 0 && pixels2[1] == 0 && pixels2[2] == 0 && pixels2[3] == 0 &&
         pixels2[l] == 1 && pixels2[l + 1] == 2 && pixels2[l + 2] == 3 && pixels2[l + 3] == 4);
 }
+
+class SwappableMeshBuffers : public MeshBuffers
+{
+public:
+    virtual void swap(ptr<MeshBuffers> buffers)
+    {
+        MeshBuffers::swap(buffers);
+    }
+};
+
+TEST(meshBuffersLayoutModification)
+{
+    ptr<FrameBuffer> fb = new FrameBuffer();
+    fb->setTextureBuffer(COLOR0, new Texture2D(8, 8, RGBA8I, RGBA_INTEGER, INT,
+        Texture::Parameters().mag(NEAREST),  Buffer::Parameters(), CPUBuffer(NULL)), 0);
+    fb->setViewport(vec4<GLint>(0, 0, 8, 8));
+    ptr<Program> p = new Program(new Module(330, FRAGMENT_SHADER));
+    vec4f vertices[6] = {
+        vec4f(-1, -1, 0, 1), vec4f(1, -1, 0, 1), vec4f(-1, 1, 0, 1),
+        vec4f(-1, 1, 0, 1), vec4f(1, -1, 0, 1), vec4f(1, 1, 0, 1)
+    };
+    ptr<GPUBuffer> b = new GPUBuffer();
+    b->setData(sizeof(vertices), vertices, STATIC_DRAW);
+    ptr<SwappableMeshBuffers> m = new SwappableMeshBuffers();
+    m->addAttributeBuffer(new AttributeBuffer(0, 4, A32F, false, b));
+    fb->clear(true, true, true);
+    fb->draw(p, *m, TRIANGLES, 0, 3);
+    int pixels1[4 * 8 * 8];
+    int pixels2[4 * 8 * 8];
+    int l = 4 * (8 * 8 - 1);
+    fb->readPixels(0, 0, 8, 8, RGBA_INTEGER, INT, Buffer::Parameters(), CPUBuffer(pixels1));
+    // same buffer, but with a different offset: the vertex array must be updated
+    ptr<MeshBuffers> n = new MeshBuffers();
+    n->addAttributeBuffer(new AttributeBuffer(0, 4, A32F, false, b, 0, 3 * sizeof(vec4f)));
+    m->swap(n);
+    fb->clear(true, true, true);
+    fb->draw(p, *m, TRIANGLES, 0, 3);
+    fb->readPixels(0, 0, 8, 8, RGBA_INTEGER, INT, Buffer::Parameters(), CPUBuffer(pixels2));
+    ASSERT(pixels1[0] == 1 && pixels1[1] == 2 && pixels1[2] == 3 && pixels1[3] == 4 &&
+        pixels1[l] == 0 && pixels1[l + 1] == 0 && pixels1[l + 2] == 0 && pixels1[l + 3] == 0 &&
+        pixels2[0] == 0 && pixels2[1] == 0 && pixels2[2] == 0 && pixels2[3] == 0 &&
+        pixels2[l] == 1 && pixels2[l + 1] == 2 && pixels2[l + 2] == 3 && pixels2[l + 3] == 4);
+}
+
+TEST(redundantStateCalls)
+{
+    ptr<FrameBuffer> fb = new FrameBuffer();
+    fb->setTextureBuffer(COLOR0, new Texture2D(8, 8, RGBA8I, RGBA_INTEGER, INT,
+        Texture::Parameters().mag(NEAREST),  Buffer::Parameters(), CPUBuffer(NULL)), 0);
+    fb->setViewport(vec4<GLint>(0, 0, 8, 8));
+    ptr<Program> p = new Program(new Module(330, FRAGMENT_SHADER));
+    ptr< Mesh<vec4f, unsigned int> > quad = new Mesh<vec4f, unsigned int>(TRIANGLE_STRIP, GPU_STATIC);
+    quad->addAttributeType(0, 4, A32F, false);
+    quad->addVertex(vec4f(-1, -1, 0, 1));
+    quad->addVertex(vec4f(1, -1, 0, 1));
+    quad->addVertex(vec4f(-1, 1, 0, 1));
+    quad->addVertex(vec4f(1, 1, 0, 1));
+    fb->draw(p, *quad);
+    Statistics::endFrame();
+    // unchanged parameters must not be set again
+    fb->draw(p, *quad);
+    Statistics::endFrame();
+    unsigned int unchanged = Statistics::get(Statistics::STATE_CALLS);
+    // parameters set to their current value must not be set again, and
+    // only the changed parameters of a group must be set
+    fb->setViewport(vec4<GLint>(0, 0, 8, 8));
+    fb->setDepthRange(0.0f, 0.5f);
+    fb->draw(p, *quad);
+    Statistics::endFrame();
+    unsigned int changed = Statistics::get(Statistics::STATE_CALLS);
+    ASSERT(unchanged == 0 && changed == 1);
+}
@@ -0,0 +1,134 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#include "test/Test.h"
+
+#include <sstream>
+#include <vector>
+
+#include "ork/core/Logger.h"
+
+using namespace std;
+using namespace ork;
+
+// a logger that records the topics of the messages that it writes
+class RecordingLogger : public Logger
+{
+public:
+    vector<string> topics;
+
+    RecordingLogger() : Logger("TEST")
+    {
+    }
+
+protected:
+    virtual void write(const string &topic, const string &msg)
+    {
+        topics.push_back(topic);
+    }
+};
+
+string getTopic(const char *prefix, int i)
+{
+    ostringstream oss;
+    oss << prefix << i;
+    return oss.str();
+}
+
+TEST(loggerTopicFiltering)
+{
+    ptr<RecordingLogger> all = new RecordingLogger();
+    ptr<RecordingLogger> filtered = new RecordingLogger();
+    // more topics than the maximum number of selected topics are logged
+    // before a topic is selected, which must not change its id
+    for (int i = 0; i < 40; ++i) {
+        all->log(getTopic("UNSELECTED", i), "message");
+    }
+    filtered->addTopic("FILTERED");
+    for (int i = 0; i < 40; ++i) {
+        filtered->log(getTopic("UNSELECTED", i), "message");
+    }
+    filtered->log("FILTERED", "message");
+    ASSERT(all->topics.size() == 40 && all->hasTopic("FILTERED"));
+    ASSERT(filtered->topics.size() == 1 && filtered->topics[0] == "FILTERED");
+    ASSERT(filtered->hasTopic("FILTERED") && !filtered->hasTopic("UNSELECTED39"));
+}
+
+TEST(loggerTooManyTopics)
+{
+    ptr<Logger> errorLogger = Logger::ERROR_LOGGER;
+    ptr<RecordingLogger> errors = new RecordingLogger();
+    Logger::ERROR_LOGGER = errors;
+    ptr<RecordingLogger> logger = new RecordingLogger();
+    for (int i = 0; i < 40; ++i) {
+        logger->addTopic(getTopic("SELECTED", i));
+    }
+    Logger::ERROR_LOGGER = errorLogger;
+    // the topics that cannot be selected are rejected, and must not share
+    // the id of another topic
+    int selected = 0;
+    for (int i = 0; i < 40; ++i) {
+        if (logger->hasTopic(getTopic("SELECTED", i))) {
+            ++selected;
+        }
+        logger->log(getTopic("SELECTED", i), "message");
+    }
+    ASSERT(selected > 0 && selected < 40);
+    ASSERT(int(errors->topics.size()) == 40 - selected);
+    ASSERT(int(logger->topics.size()) == selected);
+    ASSERT(!logger->hasTopic("UNSELECTED"));
+}
+
+TEST(loggerAsynchronous)
+{
+    ptr<RecordingLogger> logger = new RecordingLogger();
+    Logger::setAsynchronous(true);
+    for (int i = 0; i < 10; ++i) {
+        logger->log(getTopic("ASYNCHRONOUS", i), "message");
+    }
+    logger->flush();
+    Logger::setAsynchronous(false);
+    bool ok = logger->topics.size() == 10;
+    for (unsigned int i = 0; ok && i < logger->topics.size(); ++i) {
+        ok = logger->topics[i] == getTopic("ASYNCHRONOUS", i);
+    }
+    ASSERT(ok);
+}
@@ -0,0 +1,252 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#include "test/Test.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "GL/glew.h"
+
+#include "ork/core/GPUProfiler.h"
+#include "ork/core/Profiler.h"
+
+using namespace std;
+using namespace ork;
+
+struct TraceZone
+{
+    char name[64];
+
+    double start;
+
+    double end;
+};
+
+// reads the zones of a Chrome trace written by Profiler::writeChromeTrace
+vector<TraceZone> readChromeTrace(const char *file)
+{
+    vector<TraceZone> zones;
+    FILE *f = fopen(file, "r");
+    if (f == NULL) {
+        return zones;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        TraceZone z;
+        double duration;
+        int tid;
+        if (sscanf(line, "{\"name\":\"%63[^\"]\",\"ph\":\"X\",\"ts\":%lf,\"dur\":%lf,\"pid\":0,\"tid\":%d", z.name, &z.start, &duration, &tid) == 4) {
+            z.end = z.start + duration;
+            zones.push_back(z);
+        }
+    }
+    fclose(f);
+    return zones;
+}
+
+// returns true if the first zone is inside the second one, up to the
+// rounding of the exported times
+bool isInside(const TraceZone &z, const TraceZone &parent)
+{
+    return z.start >= parent.start - 0.002 && z.end <= parent.end + 0.002;
+}
+
+TEST(profilerZoneNesting)
+{
+    Profiler::clear();
+    Profiler::setEnabled(true);
+    {
+        Profiler::Zone outer("outer");
+        {
+            Profiler::Zone inner1("inner1");
+        }
+        {
+            Profiler::Zone inner2("inner2");
+            Profiler::Zone innermost("innermost");
+        }
+    }
+    Profiler::setEnabled(false);
+    {
+        Profiler::Zone disabled("disabled");
+    }
+    bool written = Profiler::writeChromeTrace("profiler.json");
+    vector<TraceZone> zones = readChromeTrace("profiler.json");
+    remove("profiler.json");
+    // the zones are recorded in the order they end
+    ASSERT(written && zones.size() == 4);
+    ASSERT(strcmp(zones[0].name, "inner1") == 0 && strcmp(zones[1].name, "innermost") == 0);
+    ASSERT(strcmp(zones[2].name, "inner2") == 0 && strcmp(zones[3].name, "outer") == 0);
+    ASSERT(isInside(zones[0], zones[3]) && isInside(zones[2], zones[3]) && isInside(zones[1], zones[2]));
+    ASSERT(zones[0].end <= zones[2].start + 0.002);
+}
+
+// the OpenGL query functions replaced by the functions below
+static PFNGLGENQUERIESPROC realGenQueries = NULL;
+static PFNGLGETQUERYOBJECTUIVPROC realGetQueryObjectuiv = NULL;
+static PFNGLGETQUERYOBJECTUI64VPROC realGetQueryObjectui64v = NULL;
+
+// true to simulate a GPU that has not yet executed the issued queries
+static bool queriesPending = false;
+
+// the number of query results read while they were not available
+static int blockingReads = 0;
+
+// the number of queries created with glGenQueries
+static int createdQueries = 0;
+
+static void GLAPIENTRY countedGenQueries(GLsizei n, GLuint *ids)
+{
+    createdQueries += n;
+    realGenQueries(n, ids);
+}
+
+static void GLAPIENTRY pendingGetQueryObjectuiv(GLuint id, GLenum pname, GLuint *params)
+{
+    realGetQueryObjectuiv(id, pname, params);
+    if (pname == GL_QUERY_RESULT_AVAILABLE && queriesPending) {
+        *params = 0;
+    }
+}
+
+static void GLAPIENTRY pendingGetQueryObjectui64v(GLuint id, GLenum pname, GLuint64 *params)
+{
+    if (pname == GL_QUERY_RESULT && queriesPending) {
+        ++blockingReads;
+    }
+    realGetQueryObjectui64v(id, pname, params);
+}
+
+// replaces the query functions used by GPUProfiler with the above ones, or
+// restores them
+void hookGPUProfilerQueries(bool hook)
+{
+    if (hook) {
+        realGenQueries = glGenQueries;
+        realGetQueryObjectuiv = glGetQueryObjectuiv;
+        realGetQueryObjectui64v = glGetQueryObjectui64v;
+        glGenQueries = countedGenQueries;
+        glGetQueryObjectuiv = pendingGetQueryObjectuiv;
+        glGetQueryObjectui64v = pendingGetQueryObjectui64v;
+    } else {
+        glGenQueries = realGenQueries;
+        glGetQueryObjectuiv = realGetQueryObjectuiv;
+        glGetQueryObjectui64v = realGetQueryObjectui64v;
+    }
+    queriesPending = false;
+    blockingReads = 0;
+    createdQueries = 0;
+}
+
+TEST(gpuProfilerDeferredResults)
+{
+    hookGPUProfilerQueries(true);
+    GPUProfiler::setEnabled(true);
+    int owners[2];
+    unsigned int frame = GPUProfiler::getFrame();
+    queriesPending = true;
+    {
+        GPUProfiler::Zone outer("outer");
+        GPUProfiler::setOwner(&owners[0]);
+        {
+            GPUProfiler::Zone inner("inner");
+            GPUProfiler::setOwner(&owners[1]);
+        }
+    }
+    // the results are not available while the queries are pending, and
+    // endFrame must not wait for them
+    vector<GPUProfiler::Sample> samples;
+    GPUProfiler::endFrame();
+    bool pending = !GPUProfiler::getSamples(frame, samples);
+    GPUProfiler::endFrame();
+    pending = pending && !GPUProfiler::getSamples(frame, samples);
+    // they are read back by the first endFrame after the queries complete
+    queriesPending = false;
+    glFinish();
+    GPUProfiler::endFrame();
+    bool available = GPUProfiler::getSamples(frame, samples);
+    int reads = blockingReads;
+    GPUProfiler::setEnabled(false);
+    hookGPUProfilerQueries(false);
+    ASSERT(pending && available && reads == 0 && samples.size() == 2);
+    ASSERT(strcmp(samples[0].name, "outer") == 0 && samples[0].owner == &owners[0]);
+    ASSERT(strcmp(samples[1].name, "inner") == 0 && samples[1].owner == &owners[1]);
+    ASSERT(samples[1].start >= samples[0].start && samples[1].duration <= samples[0].duration);
+}
+
+TEST(gpuProfilerDiscardedFrames)
+{
+    hookGPUProfilerQueries(true);
+    GPUProfiler::setEnabled(true);
+    unsigned int frame = GPUProfiler::getFrame();
+    queriesPending = true;
+    for (int i = 0; i < 50; ++i) {
+        GPUProfiler::Zone zone("discarded");
+    }
+    int created = createdQueries;
+    // a frame still pending after GPU_PROFILER_FRAMES (4) frames is
+    // discarded, and its results never become available
+    for (int i = 0; i < 4; ++i) {
+        GPUProfiler::endFrame();
+    }
+    queriesPending = false;
+    glFinish();
+    GPUProfiler::endFrame();
+    vector<GPUProfiler::Sample> samples;
+    bool discarded = !GPUProfiler::getSamples(frame, samples);
+    // the queries of the discarded frame are returned to the pool, and
+    // reused by the next frames
+    createdQueries = 0;
+    unsigned int next = GPUProfiler::getFrame();
+    for (int i = 0; i < 50; ++i) {
+        GPUProfiler::Zone zone("reused");
+    }
+    glFinish();
+    GPUProfiler::endFrame();
+    bool available = GPUProfiler::getSamples(next, samples);
+    int reused = createdQueries;
+    int reads = blockingReads;
+    GPUProfiler::setEnabled(false);
+    hookGPUProfilerQueries(false);
+    ASSERT(discarded && created > 0 && reads == 0);
+    ASSERT(available && samples.size() == 50 && reused == 0);
+}
@@ -70,6 +70,29 @@ TEST(testProgramBinary)
     ASSERT(pixels1[0] == 1.0f && pixels2[0] == 2.0f);
 }
 
+TEST(testProgramAsynchronousLink)
+{
+    ptr<FrameBuffer> fb = getFrameBuffer(RenderBuffer::R32F, 1, 1);
+    Module::setAsynchronousCompilation(true);
+    ptr<Program> p = new Program(new Module(330, NULL, "\
+        uniform float u;\n\
+        layout(location=0) out vec4 color;\n\
+        void main() { color = vec4(u, 0.0, 0.0, 0.0); }\n"));
+    Module::setAsynchronousCompilation(false);
+    bool pending = p->isPending();
+    unsigned int version = p->getUniformsVersion();
+    // polls the link status, without waiting, until the link is finished
+    while (!p->isReady()) {
+    }
+    // the uniforms must be initialized when the program is no longer pending
+    bool ready = !p->isPending() && p->getUniformsVersion() != version && p->getUniforms().size() == 1;
+    p->getUniform1f("u")->set(3.0f);
+    GLfloat pixels[4];
+    fb->drawQuad(p);
+    fb->readPixels(0, 0, 1, 1, RGBA, FLOAT, Buffer::Parameters(), CPUBuffer(&pixels));
+    ASSERT(pending && ready && pixels[0] == 3.0f);
+}
+
 TEST(testProgramPipeline)
 {
     ptr<FrameBuffer> fb = getFrameBuffer(RenderBuffer::RG32F, 1, 1);
@@ -0,0 +1,662 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#include "test/Test.h"
+
+#include <algorithm>
+#include <set>
+#include <sstream>
+
+#include <pthread.h>
+
+#include "ork/resource/ResourceManager.h"
+#include "ork/resource/XMLResourceLoader.h"
+#include "ork/scenegraph/BatchRenderer.h"
+#include "ork/scenegraph/DrawMeshTask.h"
+#include "ork/scenegraph/LodMesh.h"
+#include "ork/scenegraph/LoopTask.h"
+#include "ork/scenegraph/RecordTask.h"
+#include "ork/scenegraph/RenderQueue.h"
+#include "ork/scenegraph/OcclusionCuller.h"
+#include "ork/scenegraph/SceneManager.h"
+#include "ork/scenegraph/SequenceTask.h"
+#include "ork/taskgraph/MultithreadScheduler.h"
+
+using namespace std;
+using namespace ork;
+
+// a scene graph with a camera at the origin looking down the negative z
+// axis, and n nodes with the "object" flag in front of the camera
+ptr<SceneManager> createSceneManager(int n)
+{
+    ptr<SceneManager> manager = new SceneManager();
+    manager->setResourceManager(new ResourceManager(new XMLResourceLoader()));
+    ptr<SceneNode> root = new SceneNode();
+    ptr<SceneNode> camera = new SceneNode();
+    camera->addFlag("camera");
+    root->addChild(camera);
+    for (int i = 0; i < n; ++i) {
+        ptr<SceneNode> node = new SceneNode();
+        node->addFlag("object");
+        node->setLocalBounds(box3d(-1.0, 1.0, -1.0, 1.0, -1.0, 1.0));
+        node->setLocalToParent(mat4d::translate(vec3d(0.0, 0.0, -10.0)));
+        root->addChild(node);
+    }
+    manager->setRoot(root);
+    manager->setCameraNode("camera");
+    manager->setCameraToScreen(mat4d::perspectiveProjection(60.0, 1.0, 0.1, 1000.0));
+    return manager;
+}
+
+// returns true if the visible nodes with the "object" flag are the children
+// of the root node, starting from the second one, in this order
+bool checkVisibleNodes(ptr<SceneManager> manager)
+{
+    manager->update(0.0, 0.0);
+    ptr<SceneNode> root = manager->getRoot();
+    vector< ptr<SceneNode> > nodes;
+    manager->getVisibleNodes(SceneNode::getFlagId("object"), nodes);
+    if (nodes.size() != root->getChildrenCount() - 1) {
+        return false;
+    }
+    for (unsigned int i = 0; i < nodes.size(); ++i) {
+        if (nodes[i] != root->getChild(i + 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST(sceneManagerVisibleNodes)
+{
+    ptr<SceneManager> manager = createSceneManager(40);
+    ASSERT(checkVisibleNodes(manager));
+}
+
+TEST(sceneManagerVisibleNodesOrder)
+{
+    ptr<SceneManager> manager = createSceneManager(40);
+    ptr<SceneNode> root = manager->getRoot();
+    ASSERT(checkVisibleNodes(manager));
+    // the nodes added after some removals reuse the identifiers of the
+    // removed nodes, but must still be returned in scene graph order
+    root->removeChild(3);
+    root->removeChild(10);
+    for (int i = 0; i < 2; ++i) {
+        ptr<SceneNode> node = new SceneNode();
+        node->addFlag("object");
+        node->setLocalBounds(box3d(-1.0, 1.0, -1.0, 1.0, -1.0, 1.0));
+        node->setLocalToParent(mat4d::translate(vec3d(0.0, 0.0, -10.0)));
+        root->addChild(node);
+    }
+    ASSERT(checkVisibleNodes(manager));
+    // a flag added to a node must not move it at the end of the flag nodes
+    root->getChild(5)->removeFlag("object");
+    root->getChild(5)->addFlag("object");
+    ASSERT(checkVisibleNodes(manager));
+}
+
+TEST(sceneManagerNodeIdsCompaction)
+{
+    ptr<SceneManager> manager = createSceneManager(100);
+    ptr<SceneNode> root = manager->getRoot();
+    ASSERT(checkVisibleNodes(manager));
+    // removing most nodes reclaims their identifiers, which must not change
+    // the order of the remaining nodes, nor of the nodes added after them
+    for (int i = 0; i < 80; ++i) {
+        root->removeChild(1 + (i * 7) % (root->getChildrenCount() - 1));
+    }
+    for (int i = 0; i < 10; ++i) {
+        ptr<SceneNode> node = new SceneNode();
+        node->addFlag("object");
+        node->setLocalBounds(box3d(-1.0, 1.0, -1.0, 1.0, -1.0, 1.0));
+        node->setLocalToParent(mat4d::translate(vec3d(0.0, 0.0, -10.0)));
+        root->addChild(node);
+    }
+    root->getChild(3)->removeFlag("object");
+    root->getChild(3)->addFlag("object");
+    SceneManager::NodeIterator i = manager->getNodes("object");
+    bool ordered = i.size() == 30;
+    for (unsigned int j = 1; i.hasNext(); ++j) {
+        ordered = ordered && i.next() == root->getChild(j);
+    }
+    ASSERT(ordered && checkVisibleNodes(manager));
+}
+
+TEST(sceneManagerInvisibleNodes)
+{
+    ptr<SceneManager> manager = createSceneManager(10);
+    ptr<SceneNode> root = manager->getRoot();
+    root->getChild(4)->setLocalToParent(mat4d::translate(vec3d(0.0, 0.0, 10.0)));
+    manager->update(0.0, 0.0);
+    vector< ptr<SceneNode> > nodes;
+    manager->getVisibleNodes(SceneNode::getFlagId("object"), nodes);
+    ASSERT(nodes.size() == 9 && find(nodes.begin(), nodes.end(), root->getChild(4)) == nodes.end());
+}
+
+static const int THREAD_FLAG_COUNT = 1000;
+
+// the identifiers of the "threadFlag<i>" flags, requested by a thread
+struct ThreadFlags
+{
+    int thread;
+
+    vector<unsigned int> ids;
+};
+
+// requests the identifiers of the "threadFlag<i>" flags, in increasing or
+// decreasing order depending on the thread index
+void *getThreadFlagIds(void *arg)
+{
+    ThreadFlags *f = (ThreadFlags*) arg;
+    f->ids.resize(THREAD_FLAG_COUNT);
+    for (int i = 0; i < THREAD_FLAG_COUNT; ++i) {
+        int j = f->thread % 2 == 0 ? i : THREAD_FLAG_COUNT - 1 - i;
+        ostringstream flag;
+        flag << "threadFlag" << j;
+        f->ids[j] = SceneNode::getFlagId(flag.str());
+    }
+    return NULL;
+}
+
+TEST(sceneNodeFlagIdsMultithread)
+{
+    ThreadFlags flags[4];
+    pthread_t threads[4];
+    for (int t = 0; t < 4; ++t) {
+        flags[t].thread = t;
+        pthread_create(&threads[t], NULL, getThreadFlagIds, &flags[t]);
+    }
+    for (int t = 0; t < 4; ++t) {
+        pthread_join(threads[t], NULL);
+    }
+    // all the threads must get the same identifier for each flag, and
+    // distinct flags must get distinct identifiers
+    bool same = true;
+    set<unsigned int> ids;
+    for (int i = 0; i < THREAD_FLAG_COUNT; ++i) {
+        ostringstream flag;
+        flag << "threadFlag" << i;
+        for (int t = 1; t < 4; ++t) {
+            same = same && flags[t].ids[i] == flags[0].ids[i];
+        }
+        same = same && SceneNode::getFlagName(flags[0].ids[i]) == flag.str();
+        ids.insert(flags[0].ids[i]);
+    }
+    ASSERT(same && ids.size() == THREAD_FLAG_COUNT);
+}
+
+ptr<SceneNode> addNode(ptr<SceneNode> parent, const char *flag, const box3d &bounds, const vec3d &position)
+{
+    ptr<SceneNode> node = new SceneNode();
+    node->addFlag(flag);
+    node->setLocalBounds(bounds);
+    node->setLocalToParent(mat4d::translate(position));
+    parent->addChild(node);
+    return node;
+}
+
+// a wall occluder 10 units in front of the camera, whose right edge is at
+// x=192.55 in the 256x128 depth buffer, a node hidden behind it, a node in
+// front of it, and a small node whose right edge is at x=192.9, and is
+// thus partially visible on the right of the wall
+bool testOcclusionCulling(ptr<Scheduler> scheduler)
+{
+    ptr<SceneManager> manager = createSceneManager(0);
+    ptr<SceneNode> root = manager->getRoot();
+    manager->setCameraToScreen(mat4d::perspectiveProjection(90.0, 1.0, 0.1, 1000.0));
+    manager->setScheduler(scheduler);
+    manager->setOcclusionCuller(new OcclusionCuller("occluder", 256, 128));
+    addNode(root, "occluder", box3d(-5.03795, 5.03795, -5.0, 5.0, -0.01, 0.01), vec3d(0.0, 0.0, -10.0));
+    ptr<SceneNode> hidden = addNode(root, "object", box3d(-1.0, 1.0, -1.0, 1.0, -0.5, 0.5), vec3d(0.0, 0.0, -30.0));
+    ptr<SceneNode> front = addNode(root, "object", box3d(-1.0, 1.0, -1.0, 1.0, -0.5, 0.5), vec3d(0.0, 0.0, -5.0));
+    ptr<SceneNode> border = addNode(root, "object", box3d(-0.15, 0.15, -0.15, 0.15, -0.05, 0.05), vec3d(15.036, 0.0, -30.0));
+    manager->update(0.0, 0.0);
+    ptr<OcclusionCuller> culler = manager->getOcclusionCuller();
+    return !hidden->isVisible && front->isVisible && border->isVisible &&
+        culler->getOccluderCount() == 1 && culler->getOccludedCount() == 1;
+}
+
+TEST(occlusionCulling)
+{
+    ASSERT(testOcclusionCulling(NULL));
+}
+
+TEST(occlusionCullingMultithread)
+{
+    ASSERT(testOcclusionCulling(new MultithreadScheduler(0, 0, 0.0f, 3)));
+}
+
+ptr<MeshBuffers> createLodLevel(int triangles)
+{
+    ptr<MeshBuffers> mesh = new MeshBuffers();
+    mesh->mode = TRIANGLES;
+    mesh->nvertices = 3 * triangles;
+    mesh->bounds = box3f(-1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f);
+    return mesh;
+}
+
+TEST(sceneManagerLodScreenSize)
+{
+    ptr<SceneManager> manager = createSceneManager(0);
+    ptr<SceneNode> root = manager->getRoot();
+    manager->setCameraToScreen(mat4d::perspectiveProjection(90.0, 1.0, 0.1, 1000.0));
+    ptr<LodMesh> lod = new LodMesh(0.1f);
+    lod->addLevel(createLodLevel(1000), 0.5f);
+    lod->addLevel(createLodLevel(100), 0.1f);
+    lod->addLevel(createLodLevel(10), 0.0f);
+    // a node with a large child, whose screen size must not depend on
+    // the bounds of this child
+    ptr<SceneNode> node = new SceneNode();
+    node->addLod("geometry", lod);
+    node->setLocalToParent(mat4d::translate(vec3d(0.0, 0.0, -40.0)));
+    root->addChild(node);
+    addNode(node, "object", box3d(-1.0, 1.0, -1.0, 1.0, -1.0, 1.0), vec3d(30.0, 0.0, 0.0));
+    // a node scaled by a factor 10
+    ptr<SceneNode> scaled = new SceneNode();
+    scaled->addLod("geometry", lod);
+    scaled->setLocalToParent(mat4d::translate(vec3d(0.0, 0.0, -20.0)) * mat4d(10.0, 0.0, 0.0, 0.0, 0.0, 10.0, 0.0, 0.0, 0.0, 0.0, 10.0, 0.0, 0.0, 0.0, 0.0, 1.0));
+    root->addChild(scaled);
+    manager->update(0.0, 0.0);
+    ASSERT(node->getLodLevel("geometry") == 2 && scaled->getLodLevel("geometry") == 0);
+}
+
+static bool programDeleted = false;
+
+class DeletedProgram : public Program
+{
+public:
+    DeletedProgram(ptr<Module> module) : Program(module)
+    {
+    }
+
+    virtual ~DeletedProgram()
+    {
+        programDeleted = true;
+    }
+};
+
+ptr<Module> createUniformModule()
+{
+    return new Module(330, NULL, "\
+        uniform float u;\n\
+        layout(location=0) out vec4 color;\n\
+        void main() { color = vec4(u, 0.0, 0.0, 0.0); }\n");
+}
+
+TEST(sceneNodeUniformBindings)
+{
+    ptr<SceneNode> node = new SceneNode();
+    node->addValue(new Value1f("u", 1.0f));
+    ptr<Program> p = new DeletedProgram(createUniformModule());
+    node->setUniforms(p);
+    bool set1 = p->getUniform1f("u")->get() == 1.0f;
+    // the cached bindings of the node must not keep the program alive
+    p = NULL;
+    bool deleted = programDeleted;
+    // a new program, possibly at the same address, must be bound again
+    p = new Program(createUniformModule());
+    node->setUniforms(p);
+    bool set2 = p->getUniform1f("u")->get() == 1.0f;
+    ASSERT(set1 && deleted && set2);
+}
+
+// a GPU task that sets u to (index, u.y + 1) when executed directly, or
+// records u = (index, 0) if it is recordable
+class NodeIndexTask : public Task, public Recordable
+{
+public:
+    NodeIndexTask(ptr<Uniform2f> u, float index, bool recordable) :
+        Task("NodeIndexTask", true, 0), u(u), index(index), recordable(recordable)
+    {
+    }
+
+    virtual bool run()
+    {
+        u->set(vec2f(index, u->get().y + 1.0f));
+        return true;
+    }
+
+    virtual bool record(CommandList &commands)
+    {
+        if (!recordable) {
+            return false;
+        }
+        commands.set(u, vec2f(index, 0.0f));
+        return true;
+    }
+
+private:
+    ptr<Uniform2f> u;
+
+    float index;
+
+    bool recordable;
+};
+
+class NodeIndexTaskFactory : public TaskFactory
+{
+public:
+    NodeIndexTaskFactory(ptr<Uniform2f> u, bool recordable) :
+        TaskFactory("NodeIndexTaskFactory"), u(u), index(0), recordable(recordable)
+    {
+    }
+
+    virtual ptr<Task> getTask(ptr<Object> context)
+    {
+        return new NodeIndexTask(u, float(index++), recordable);
+    }
+
+private:
+    ptr<Uniform2f> u;
+
+    int index;
+
+    bool recordable;
+};
+
+ptr<Uniform2f> createNodeIndexUniform()
+{
+    ptr<Program> p = new Program(new Module(330, NULL, "\
+        uniform vec2 u;\n\
+        layout(location=0) out vec4 color;\n\
+        void main() { color = vec4(u, 0.0, 0.0); }\n"));
+    return p->getUniform2f("u");
+}
+
+// returns the RecordTask and the ReplayTask of a recording LoopTask
+void getRecordTasks(ptr<Task> t, vector< ptr<RecordTask> > &records, ptr<ReplayTask> &replay)
+{
+    TaskGraph::TaskIterator i = t.cast<TaskGraph>()->getAllTasks();
+    while (i.hasNext()) {
+        ptr<Task> u = i.next();
+        if (u.cast<RecordTask>() != NULL) {
+            records.push_back(u.cast<RecordTask>());
+        } else if (u.cast<ReplayTask>() != NULL) {
+            replay = u.cast<ReplayTask>();
+        }
+    }
+}
+
+TEST(loopTaskRecord)
+{
+    ptr<SceneManager> manager = createSceneManager(40);
+    ptr<Uniform2f> u = createNodeIndexUniform();
+    ptr<LoopTask> loop = new LoopTask("n", "object", false, false, new NodeIndexTaskFactory(u, true), false, false, false, true);
+    ptr<Method> m = new Method(loop);
+    manager->getCameraNode()->addMethod("draw", m);
+    // two expansions in the same frame must not share their command lists,
+    // even if their RecordTask are all executed before their ReplayTask
+    vector< ptr<RecordTask> > recordsA;
+    vector< ptr<RecordTask> > recordsB;
+    ptr<ReplayTask> replayA;
+    ptr<ReplayTask> replayB;
+    getRecordTasks(loop->getTask(m), recordsA, replayA);
+    getRecordTasks(loop->getTask(m), recordsB, replayB);
+    for (unsigned int i = 0; i < recordsA.size(); ++i) {
+        recordsA[i]->run();
+    }
+    for (unsigned int i = 0; i < recordsB.size(); ++i) {
+        recordsB[i]->run();
+    }
+    replayA->run();
+    vec2f a = u->get();
+    replayB->run();
+    vec2f b = u->get();
+    ASSERT(recordsA.size() == 3 && recordsB.size() == 3 && a == vec2f(39.0f, 0.0f) && b == vec2f(79.0f, 0.0f));
+}
+
+TEST(loopTaskRecordFallback)
+{
+    ptr<SceneManager> manager = createSceneManager(40);
+    ptr<Uniform2f> u = createNodeIndexUniform();
+    ptr<LoopTask> loop = new LoopTask("n", "object", false, false, new NodeIndexTaskFactory(u, false), false, false, false, true);
+    ptr<Method> m = new Method(loop);
+    manager->getCameraNode()->addMethod("draw", m);
+    // tasks that cannot be recorded must all be executed by the ReplayTask
+    vector< ptr<RecordTask> > records;
+    ptr<ReplayTask> replay;
+    getRecordTasks(loop->getTask(m), records, replay);
+    for (unsigned int i = 0; i < records.size(); ++i) {
+        records[i]->run();
+    }
+    replay->run();
+    ASSERT(u->get() == vec2f(39.0f, 40.0f));
+}
+
+// a quad covering the given horizontal range, with the given value at each
+// vertex, stored in GPU buffers
+ptr<MeshBuffers> createValueQuad(float x0, float x1, float value)
+{
+    float vertices[20] = {
+        x0, -1.0f, 0.0f, 1.0f, value,
+        x1, -1.0f, 0.0f, 1.0f, value,
+        x0, 1.0f, 0.0f, 1.0f, value,
+        x1, 1.0f, 0.0f, 1.0f, value
+    };
+    unsigned short indices[6] = { 0, 1, 2, 2, 1, 3 };
+    ptr<GPUBuffer> vb = new GPUBuffer();
+    vb->setData(sizeof(vertices), vertices, STATIC_DRAW);
+    ptr<GPUBuffer> ib = new GPUBuffer();
+    ib->setData(sizeof(indices), indices, STATIC_DRAW);
+    ptr<MeshBuffers> m = new MeshBuffers();
+    m->mode = TRIANGLES;
+    m->nvertices = 4;
+    m->nindices = 6;
+    m->addAttributeBuffer(new AttributeBuffer(0, 4, A32F, false, vb, 5 * sizeof(float), 0));
+    m->addAttributeBuffer(new AttributeBuffer(1, 1, A32F, false, vb, 5 * sizeof(float), 4 * sizeof(float)));
+    m->setIndicesBuffer(new AttributeBuffer(0, 1, A16UI, false, ib));
+    return m;
+}
+
+TEST4(batchRendererMeshModification)
+{
+    ptr<FrameBuffer> fb = new FrameBuffer();
+    fb->setTextureBuffer(COLOR0, new Texture2D(2, 1, R32F, RED, FLOAT,
+        Texture::Parameters().mag(NEAREST),  Buffer::Parameters(), CPUBuffer(NULL)), 0);
+    fb->setViewport(vec4<GLint>(0, 0, 2, 1));
+    SceneManager::setCurrentFrameBuffer(fb);
+    ptr<Program> p = new Program(new Module(330, "\
+        #ifdef _VERTEX_\n\
+        layout(location=0) in vec4 pos;\n\
+        layout(location=1) in float value;\n\
+        flat out float v;\n\
+        void main() { gl_Position = pos; v = value; }\n\
+        #endif\n\
+        #ifdef _FRAGMENT_\n\
+        flat in float v;\n\
+        layout(location=0) out vec4 color;\n\
+        void main() { color = vec4(v); }\n\
+        #endif\n"));
+    ptr<MeshBuffers> a = createValueQuad(-1.0f, 0.0f, 1.0f);
+    ptr<MeshBuffers> b = createValueQuad(0.0f, 1.0f, 2.0f);
+    vector< ptr<MeshBuffers> > meshes;
+    meshes.push_back(a);
+    meshes.push_back(b);
+    vector< ptr<SceneNode> > nodes(2, new SceneNode());
+    ptr<BatchRenderer> r = new BatchRenderer();
+    bool added = r->addMesh(a) && r->addMesh(b) && r->getBatchCount() == 1;
+    float pixels1[2];
+    float pixels2[2];
+    fb->clear(true, false, false);
+    r->draw(p, meshes, nodes);
+    fb->readPixels(0, 0, 2, 1, RED, FLOAT, Buffer::Parameters(), CPUBuffer(pixels1));
+    // the batch must be updated when the data of one of its meshes changes
+    float value = 3.0f;
+    for (int i = 0; i < 4; ++i) {
+        b->getAttributeBuffer(0)->getBuffer().cast<GPUBuffer>()->setSubData((5 * i + 4) * sizeof(float), sizeof(float), &value);
+    }
+    fb->clear(true, false, false);
+    r->draw(p, meshes, nodes);
+    fb->readPixels(0, 0, 2, 1, RED, FLOAT, Buffer::Parameters(), CPUBuffer(pixels2));
+    SceneManager::setCurrentFrameBuffer(NULL);
+    ASSERT(added && pixels1[0] == 1.0f && pixels1[1] == 2.0f && pixels2[0] == 1.0f && pixels2[1] == 3.0f && r->getMeshCount() == 2);
+}
+
+// a task that appends its index to a list when it is executed
+class OrderTask : public Task
+{
+public:
+    OrderTask(vector<int> *order, int index) :
+        Task("OrderTask", true, 0), order(order), index(index)
+    {
+    }
+
+    virtual bool run()
+    {
+        order->push_back(index);
+        return true;
+    }
+
+private:
+    vector<int> *order;
+
+    int index;
+};
+
+TEST(renderQueueSort)
+{
+    ptr<Program> programs[2];
+    ptr<Texture> textures[2];
+    ptr<MeshBuffers> meshes[2];
+    for (int i = 0; i < 2; ++i) {
+        programs[i] = new Program(new Module(330, NULL, "\
+            uniform sampler2D tex;\n\
+            layout(location=0) out vec4 color;\n\
+            void main() { color = texture(tex, vec2(0.0)); }\n"));
+        textures[i] = new Texture2D(1, 1, RGBA8, RGBA, UNSIGNED_BYTE,
+            Texture::Parameters(), Buffer::Parameters(), CPUBuffer(NULL));
+        meshes[i] = new MeshBuffers();
+    }
+    // the draws are recorded in an interleaved program, texture and mesh
+    // order, and must be submitted sorted by program, then by texture set,
+    // then by mesh, the draws with equal keys keeping their recording order
+    ptr<RenderQueue> q = new RenderQueue();
+    vector<int> order;
+    for (int i = 0; i < 8; ++i) {
+        ptr<SceneNode> n = new SceneNode();
+        n->addValue(new ValueSampler(SAMPLER_2D, "tex", textures[((i + 1) / 2) % 2]));
+        q->begin(n);
+        q->setProgram(programs[i % 2], n);
+        q->setMesh(meshes[i % 2]);
+        q->end(new OrderTask(&order, i));
+    }
+    ptr<Task> t = q->submit();
+    ptr<Scheduler> scheduler = new MultithreadScheduler();
+    scheduler->run(t);
+    int expected[8] = { 0, 4, 2, 6, 3, 7, 1, 5 };
+    ASSERT(order == vector<int>(expected, expected + 8));
+    // the number of state changes must drop after sorting
+    ASSERT(q->getStateChanges(RenderQueue::FRAMEBUFFER, false) == 1 && q->getStateChanges(RenderQueue::FRAMEBUFFER, true) == 1);
+    ASSERT(q->getStateChanges(RenderQueue::PROGRAM, false) == 8 && q->getStateChanges(RenderQueue::PROGRAM, true) == 2);
+    ASSERT(q->getStateChanges(RenderQueue::TEXTURES, false) == 5 && q->getStateChanges(RenderQueue::TEXTURES, true) == 4);
+    ASSERT(q->getStateChanges(RenderQueue::MESH, false) == 8 && q->getStateChanges(RenderQueue::MESH, true) == 2);
+    ASSERT(q->getDraws(false) == 8 && q->getDraws(true) == 8 && q->getSize() == 0);
+}
+
+// a DrawMeshTask drawing the "quad" mesh of the scene node "$n"
+class DrawQuadTask : public DrawMeshTask
+{
+public:
+    DrawQuadTask() : DrawMeshTask(QualifiedName("$n.quad"))
+    {
+    }
+};
+
+TEST(renderQueueInstancing)
+{
+    ptr<SceneManager> manager = createSceneManager(3);
+    ptr<FrameBuffer> fb = new FrameBuffer();
+    fb->setTextureBuffer(COLOR0, new Texture2D(3, 1, R32F, RED, FLOAT,
+        Texture::Parameters().mag(NEAREST),  Buffer::Parameters(), CPUBuffer(NULL)), 0);
+    fb->setViewport(vec4<GLint>(0, 0, 3, 1));
+    SceneManager::setCurrentFrameBuffer(fb);
+    programDeleted = false;
+    ptr<Program> p = new DeletedProgram(new Module(330, "\
+        #ifdef _VERTEX_\n\
+        layout(location=0) in vec4 pos;\n\
+        layout(location=2) in float x;\n\
+        layout(location=3) in float v;\n\
+        flat out float c;\n\
+        void main() { gl_Position = vec4(pos.x + x, pos.yzw); c = v; }\n\
+        #endif\n\
+        #ifdef _FRAGMENT_\n\
+        flat in float c;\n\
+        layout(location=0) out vec4 color;\n\
+        void main() { color = vec4(c); }\n\
+        #endif\n"));
+    SceneManager::setCurrentProgram(p);
+    // each node draws a quad in its own pixel, with its own value
+    ptr<MeshBuffers> quad = createValueQuad(-1.0f, -1.0f / 3.0f, 0.0f);
+    ptr<SceneNode> root = manager->getRoot();
+    for (unsigned int i = 1; i < root->getChildrenCount(); ++i) {
+        ptr<SceneNode> n = root->getChild(i);
+        n->addMesh("quad", quad);
+        n->addValue(new Value1f("x", (i - 1) * 2.0f / 3.0f));
+        n->addValue(new Value1f("v", float(i)));
+    }
+    ptr<Uniform2f> u = createNodeIndexUniform();
+    vector< ptr<TaskFactory> > subtasks;
+    subtasks.push_back(new NodeIndexTaskFactory(u, false));
+    subtasks.push_back(new DrawQuadTask());
+    ptr<LoopTask> loop = new LoopTask("n", "object", false, false, new SequenceTask(subtasks), true, true, false, false);
+    ptr<Method> m = new Method(loop);
+    manager->getCameraNode()->addMethod("draw", m);
+    // the per instance data must be read at its offset in the ring buffer
+    manager->getStreamBuffer()->allocate(16, 4);
+    float pixels[3];
+    fb->clear(true, false, false);
+    ptr<Task> t = loop->getTask(m);
+    ptr<Scheduler> scheduler = new MultithreadScheduler();
+    scheduler->run(t);
+    fb->readPixels(0, 0, 3, 1, RED, FLOAT, Buffer::Parameters(), CPUBuffer(pixels));
+    SceneManager::setCurrentFrameBuffer(NULL);
+    SceneManager::setCurrentProgram(NULL);
+    // the three draws must be merged, but the other subtasks of the merged
+    // tasks must still be executed
+    ASSERT(manager->getRenderQueue()->getDraws(true) == 1 && u->get().y == 3.0f &&
+        pixels[0] == 1.0f && pixels[1] == 2.0f && pixels[2] == 3.0f);
+    // the instancing data cached by the DrawMeshTask must not keep the
+    // program alive
+    t = NULL;
+    p = NULL;
+    ASSERT(programDeleted);
+}
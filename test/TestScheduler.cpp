@@ -0,0 +1,596 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#include "test/Test.h"
+
+#include <pthread.h>
+#include <typeinfo>
+
+#include "pmath.h"
+
+#include "ork/core/Logger.h"
+#include "ork/core/Timer.h"
+#include "ork/taskgraph/MultithreadScheduler.h"
+#include "ork/taskgraph/ParallelForTask.h"
+#include "ork/taskgraph/SimulatedScheduler.h"
+#include "ork/taskgraph/SuspendableTask.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace ork;
+
+// duration of one unit of work of the synthetic tasks, in micro seconds
+#define WORK_UNIT 2000
+
+// number of worker threads used to execute the synthetic task graphs
+#define WORKERS 3
+
+void sleepMicroseconds(int us)
+{
+#ifdef _WIN32
+    Sleep(us / 1000);
+#else
+    usleep(us);
+#endif
+}
+
+class WorkTask : public Task
+{
+public:
+    int units;
+
+    WorkTask(int units) : Task("WorkTask", false, 1), units(units)
+    {
+    }
+
+    virtual int getComplexity() const
+    {
+        return units;
+    }
+
+    virtual bool run()
+    {
+        sleepMicroseconds(units * WORK_UNIT);
+        return true;
+    }
+};
+
+// gives WorkTask statistics such that its expected duration is proportional
+// to its number of units
+void initWorkTaskStatistics()
+{
+    static bool initialized = false;
+    if (!initialized) {
+        for (int i = 0; i < 64; ++i) {
+            ptr<Task> t = new WorkTask(1);
+            t->setActualDuration(WORK_UNIT);
+        }
+        initialized = true;
+    }
+}
+
+// a chain of long tasks, and many short independent tasks
+ptr<TaskGraph> createChainGraph(vector< ptr<Task> > &tasks)
+{
+    ptr<TaskGraph> graph = new TaskGraph();
+    ptr<Task> previous = NULL;
+    for (int i = 0; i < 10; ++i) {
+        ptr<Task> t = new WorkTask(2);
+        graph->addTask(t);
+        if (previous != NULL) {
+            graph->addDependency(t, previous);
+        }
+        previous = t;
+        tasks.push_back(t);
+    }
+    for (int i = 0; i < 60; ++i) {
+        ptr<Task> t = new WorkTask(1);
+        graph->addTask(t);
+        tasks.push_back(t);
+    }
+    return graph;
+}
+
+// a random layered graph, where each task depends on some tasks of the
+// previous layer
+ptr<TaskGraph> createLayeredGraph(unsigned int seed, vector< ptr<Task> > &tasks)
+{
+    ptr<TaskGraph> graph = new TaskGraph();
+    vector< ptr<Task> > previousLayer;
+    for (int i = 0; i < 8; ++i) {
+        vector< ptr<Task> > layer;
+        seed = seed * 1103515245 + 12345;
+        int width = 2 + (seed >> 16) % 9;
+        for (int j = 0; j < width; ++j) {
+            seed = seed * 1103515245 + 12345;
+            ptr<Task> t = new WorkTask(1 + (seed >> 16) % 4);
+            graph->addTask(t);
+            for (unsigned int k = 0; k < previousLayer.size(); ++k) {
+                seed = seed * 1103515245 + 12345;
+                if ((seed >> 16) % 3 == 0) {
+                    graph->addDependency(t, previousLayer[k]);
+                }
+            }
+            layer.push_back(t);
+            tasks.push_back(t);
+        }
+        previousLayer = layer;
+    }
+    return graph;
+}
+
+// executes the given graph and returns its makespan in micro seconds
+double getMakespan(ptr<TaskGraph> graph, const vector< ptr<Task> > &tasks, MultithreadScheduler::policy p)
+{
+    ptr<MultithreadScheduler> scheduler = new MultithreadScheduler(0, 0, 0.0f, WORKERS);
+    scheduler->setPolicy(p);
+    Timer timer;
+    timer.start();
+    scheduler->schedule(graph);
+    for (unsigned int i = 0; i < tasks.size(); ++i) {
+        while (!tasks[i]->isDone()) {
+            sleepMicroseconds(100);
+        }
+    }
+    return timer.end();
+}
+
+// simulates the execution of the given graph and returns its makespan in
+// virtual micro seconds
+double getSimulatedMakespan(ptr<TaskGraph> graph, MultithreadScheduler::policy p, double *idle = NULL)
+{
+    ptr<SimulatedScheduler> scheduler = new SimulatedScheduler(0, 0.0f, WORKERS);
+    scheduler->setPolicy(p);
+    scheduler->setTaskDuration("WorkTask", WORK_UNIT);
+    scheduler->schedule(graph);
+    scheduler->finish();
+    if (idle != NULL) {
+        *idle = 0.0;
+        for (int i = 1; i < scheduler->getThreadCount(); ++i) {
+            *idle += scheduler->getIdleTime(i);
+        }
+    }
+    return graph->isDone() ? scheduler->getMakespan() : -1.0;
+}
+
+void logMakespans(const char *name, double shortestFirst, double criticalPath)
+{
+    if (Logger::INFO_LOGGER != NULL) {
+        ostringstream oss;
+        oss << name << " makespan: shortest first " << int(shortestFirst / 1000.0);
+        oss << " ms, critical path " << int(criticalPath / 1000.0) << " ms";
+        Logger::INFO_LOGGER->log("SCHEDULER", oss.str());
+    }
+}
+
+// the wall-clock makespans depend on the load of the machine, and are only
+// logged; the assertions use the simulated makespans, which do not
+TEST(testCriticalPathScheduling)
+{
+    initWorkTaskStatistics();
+    vector< ptr<Task> > tasks;
+    double shortestFirst = getMakespan(createChainGraph(tasks), tasks, MultithreadScheduler::SHORTEST_FIRST);
+    tasks.clear();
+    double criticalPath = getMakespan(createChainGraph(tasks), tasks, MultithreadScheduler::CRITICAL_PATH);
+    logMakespans("chain", shortestFirst, criticalPath);
+    tasks.clear();
+    shortestFirst = getSimulatedMakespan(createChainGraph(tasks), MultithreadScheduler::SHORTEST_FIRST);
+    tasks.clear();
+    criticalPath = getSimulatedMakespan(createChainGraph(tasks), MultithreadScheduler::CRITICAL_PATH);
+    ASSERT(criticalPath > 0.0 && criticalPath < 0.9 * shortestFirst);
+}
+
+TEST(testCriticalPathSchedulingRandom)
+{
+    initWorkTaskStatistics();
+    double shortestFirst = 0.0;
+    double criticalPath = 0.0;
+    double simulatedShortestFirst = 0.0;
+    double simulatedCriticalPath = 0.0;
+    for (unsigned int seed = 1; seed <= 4; ++seed) {
+        vector< ptr<Task> > tasks;
+        shortestFirst += getMakespan(createLayeredGraph(seed, tasks), tasks, MultithreadScheduler::SHORTEST_FIRST);
+        tasks.clear();
+        criticalPath += getMakespan(createLayeredGraph(seed, tasks), tasks, MultithreadScheduler::CRITICAL_PATH);
+        simulatedShortestFirst += getSimulatedMakespan(createLayeredGraph(seed, tasks), MultithreadScheduler::SHORTEST_FIRST);
+        simulatedCriticalPath += getSimulatedMakespan(createLayeredGraph(seed, tasks), MultithreadScheduler::CRITICAL_PATH);
+    }
+    logMakespans("layered", shortestFirst, criticalPath);
+    logMakespans("simulated layered", simulatedShortestFirst, simulatedCriticalPath);
+    ASSERT(simulatedCriticalPath > 0.0 && simulatedCriticalPath <= simulatedShortestFirst);
+}
+
+class CountTask : public ParallelForTask
+{
+public:
+    vector<int> counts;
+
+    int begins;
+
+    int ends;
+
+    bool completedBeforeEnd;
+
+    CountTask(int count, unsigned int deadline) : ParallelForTask("CountTask", count, 0, deadline),
+        counts(count, 0), begins(0), ends(0), completedBeforeEnd(false)
+    {
+    }
+
+    virtual void begin()
+    {
+        begins += 1;
+    }
+
+    virtual void end()
+    {
+        ends += 1;
+        completedBeforeEnd = true;
+        for (unsigned int i = 0; i < counts.size(); ++i) {
+            completedBeforeEnd = completedBeforeEnd && counts[i] == 1;
+        }
+    }
+
+protected:
+    virtual bool run(int begin, int end)
+    {
+        for (int i = begin; i < end; ++i) {
+            counts[i] += 1;
+        }
+        sleepMicroseconds((end - begin) * 10);
+        return true;
+    }
+};
+
+class CheckTask : public Task
+{
+public:
+    ptr<CountTask> task;
+
+    bool ok;
+
+    CheckTask(ptr<CountTask> task, unsigned int deadline) : Task("CheckTask", false, deadline), task(task), ok(false)
+    {
+    }
+
+    virtual bool run()
+    {
+        ok = task->begins == 1 && task->ends == 1 && task->completedBeforeEnd;
+        for (unsigned int i = 0; i < task->counts.size(); ++i) {
+            ok = ok && task->counts[i] == 1;
+        }
+        return true;
+    }
+};
+
+// a parallel task between two other tasks; returns true if each iteration
+// has been executed exactly once, between the begin and end methods of the
+// task, which are called once, before the successor task
+bool testParallelForTask(unsigned int deadline)
+{
+    ptr<MultithreadScheduler> scheduler = new MultithreadScheduler(0, 0, 0.0f, WORKERS);
+    ptr<TaskGraph> graph = new TaskGraph();
+    ptr<Task> first = new WorkTask(1);
+    ptr<CountTask> task = new CountTask(2000, deadline);
+    ptr<CheckTask> last = new CheckTask(task, deadline);
+    graph->addTask(first);
+    graph->addTask(task);
+    graph->addTask(last);
+    graph->addDependency(task, first);
+    graph->addDependency(last, task);
+    Timer timer;
+    timer.start();
+    if (deadline == 0) {
+        scheduler->run(graph);
+    } else {
+        scheduler->schedule(graph);
+        while (!last->isDone()) {
+            sleepMicroseconds(100);
+        }
+    }
+    double duration = timer.end();
+    if (Logger::INFO_LOGGER != NULL) {
+        ostringstream oss;
+        oss << "parallel for: " << int(duration / 1000.0) << " ms, ";
+        oss << int(task->getCount() * 10 / 1000) << " ms if executed in sequence";
+        Logger::INFO_LOGGER->log("SCHEDULER", oss.str());
+    }
+    return task->isDone() && last->isDone() && last->ok;
+}
+
+TEST(testParallelForTaskImmediate)
+{
+    ASSERT(testParallelForTask(0));
+}
+
+TEST(testParallelForTaskPrefetch)
+{
+    ASSERT(testParallelForTask(1));
+}
+
+class SignalTask : public Task
+{
+public:
+    ptr<TaskEvent> event;
+
+    SignalTask(ptr<TaskEvent> event, unsigned int deadline) : Task("SignalTask", false, deadline), event(event)
+    {
+    }
+
+    virtual bool run()
+    {
+        sleepMicroseconds(WORK_UNIT);
+        event->signal();
+        return true;
+    }
+};
+
+class WaitingTask : public SuspendableTask
+{
+public:
+    ptr<TaskEvent> event;
+
+    int step;
+
+    bool ok;
+
+    WaitingTask(ptr<TaskEvent> event, unsigned int deadline) : SuspendableTask("WaitingTask", false, deadline), event(event), step(0), ok(false)
+    {
+    }
+
+    virtual bool run()
+    {
+        if (step++ == 0) {
+            await(event);
+            return false;
+        }
+        ok = event->isSignaled();
+        return true;
+    }
+};
+
+// a task waiting for an event signaled by another task, which can only be
+// executed if the waiting task does not block its thread
+bool testSuspendableTask(ptr<TaskEvent> event, ptr<Task> signalTask, unsigned int deadline)
+{
+    ptr<MultithreadScheduler> scheduler = new MultithreadScheduler(0, 0, 0.0f, deadline == 0 ? 0 : 1);
+    ptr<TaskGraph> graph = new TaskGraph();
+    ptr<WaitingTask> waiting = new WaitingTask(event, deadline);
+    ptr<CheckTask> last = new CheckTask(new CountTask(0, deadline), deadline);
+    graph->addTask(waiting);
+    graph->addTask(signalTask);
+    graph->addTask(last);
+    graph->addDependency(last, waiting);
+    if (deadline == 0) {
+        scheduler->run(graph);
+    } else {
+        scheduler->schedule(graph);
+        while (!last->isDone()) {
+            sleepMicroseconds(100);
+        }
+    }
+    return waiting->isDone() && waiting->step == 2 && waiting->ok && last->isDone();
+}
+
+TEST(testSuspendableTaskImmediate)
+{
+    ptr<TaskEvent> event = new TaskEvent();
+    ASSERT(testSuspendableTask(event, new SignalTask(event, 0), 0));
+}
+
+TEST(testSuspendableTaskPrefetch)
+{
+    ptr<TaskEvent> event = new TaskEvent();
+    ASSERT(testSuspendableTask(event, new SignalTask(event, 1), 1));
+}
+
+TEST(testSuspendableTaskCompletion)
+{
+    ptr<Task> t = new WorkTask(1);
+    ASSERT(testSuspendableTask(new TaskCompletionEvent(t), t, 1));
+}
+
+// an event awaited by a suspended task, signaled after the scheduler of this
+// task has been deleted, must not notify this scheduler
+TEST(testSuspendableTaskSchedulerDeletion)
+{
+    ptr<TaskEvent> event = new TaskEvent();
+    ptr<WaitingTask> waiting = new WaitingTask(event, 1);
+    ptr<MultithreadScheduler> scheduler = new MultithreadScheduler(0, 0, 0.0f, 1);
+    scheduler->schedule(waiting);
+    while (waiting->step == 0) {
+        sleepMicroseconds(100);
+    }
+    // leaves time for the task to be suspended after its first execution
+    sleepMicroseconds(10 * WORK_UNIT);
+    scheduler = NULL;
+    event->signal();
+    ASSERT(waiting->step == 1 && !waiting->isDone());
+}
+
+// a task waiting for a GL fence, which is never signaled unless the scheduler
+// polls it (this would block the run method forever)
+TEST(testSuspendableTaskGLFence)
+{
+    ptr<MultithreadScheduler> scheduler = new MultithreadScheduler();
+    ptr<GLFenceEvent> fence = new GLFenceEvent();
+    ptr<WaitingTask> waiting = new WaitingTask(fence, 0);
+    scheduler->run(waiting);
+    ASSERT(waiting->isDone() && waiting->step == 2 && waiting->ok);
+}
+
+TEST(testSimulatedScheduler)
+{
+    vector< ptr<Task> > tasks;
+    double shortestFirst = getSimulatedMakespan(createChainGraph(tasks), MultithreadScheduler::SHORTEST_FIRST);
+    double idle;
+    double criticalPath = getSimulatedMakespan(createChainGraph(tasks), MultithreadScheduler::CRITICAL_PATH, &idle);
+    logMakespans("simulated chain", shortestFirst, criticalPath);
+    // 60 short tasks and then the chain of 10 long tasks, versus the chain in
+    // parallel with the short tasks
+    ASSERT(shortestFirst == 40 * WORK_UNIT);
+    ASSERT(criticalPath == 27 * WORK_UNIT);
+    ASSERT(idle == 3 * 27 * WORK_UNIT - 80 * WORK_UNIT);
+}
+
+TEST(testSimulatedSchedulerDeterminism)
+{
+    for (unsigned int seed = 1; seed <= 4; ++seed) {
+        vector< ptr<Task> > tasks;
+        double idle1, idle2;
+        double makespan1 = getSimulatedMakespan(createLayeredGraph(seed, tasks), MultithreadScheduler::CRITICAL_PATH, &idle1);
+        double makespan2 = getSimulatedMakespan(createLayeredGraph(seed, tasks), MultithreadScheduler::CRITICAL_PATH, &idle2);
+        ASSERT(makespan1 > 0.0 && makespan1 == makespan2 && idle1 == idle2);
+    }
+}
+
+TEST(testSimulatedSchedulerFrames)
+{
+    // one immediate task per frame, and prefetching tasks executed by the
+    // worker threads and by the main thread at the end of each frame
+    ptr<SimulatedScheduler> scheduler = new SimulatedScheduler(0, 50.0f, 1);
+    scheduler->setTaskDuration("WorkTask", WORK_UNIT);
+    ptr<TaskGraph> prefetch = new TaskGraph();
+    for (int i = 0; i < 30; ++i) {
+        prefetch->addTask(new WorkTask(1));
+    }
+    scheduler->schedule(prefetch);
+    for (int i = 0; i < 2; ++i) {
+        ptr<Task> t = new WorkTask(2);
+        t->setDeadline(0);
+        scheduler->run(t);
+        ASSERT(t->isDone());
+    }
+    // 2 frames of 10 units: the main thread executes the immediate task (2
+    // units) and then prefetching tasks until the end of the frame, while the
+    // worker thread executes prefetching tasks; the 30 prefetching tasks are
+    // completed 3 units before the end of the second frame
+    ASSERT(scheduler->getFrameCount() == 2);
+    ASSERT(scheduler->getFrameDuration(0) == 10 * WORK_UNIT);
+    ASSERT(scheduler->getFrameDuration(1) == 10 * WORK_UNIT);
+    ASSERT(prefetch->isDone() && scheduler->getPrefetchedTasks() == 30);
+    ASSERT(scheduler->getIdleTime(0) == 3 * WORK_UNIT);
+    ASSERT(scheduler->getIdleTime(1) == 3 * WORK_UNIT);
+}
+
+class StatisticsTask : public Task
+{
+public:
+    StatisticsTask() : Task("StatisticsTask", false, 0)
+    {
+    }
+
+    virtual bool run()
+    {
+        return true;
+    }
+};
+
+class HistogramTask : public Task
+{
+public:
+    HistogramTask() : Task("HistogramTask", false, 0)
+    {
+    }
+
+    virtual bool run()
+    {
+        return true;
+    }
+};
+
+void *histogramThread(void *arg)
+{
+    pair<int, float> *samples = (pair<int, float>*) arg;
+    for (int i = 0; i < samples->first; ++i) {
+        ptr<Task> t = new HistogramTask();
+        t->setActualDuration(samples->second);
+    }
+    return NULL;
+}
+
+// adds the given number of HistogramTask samples of the given duration from
+// a new thread, whose remaining samples are merged when it terminates
+void addHistogramSamples(int count, float duration)
+{
+    pair<int, float> samples = make_pair(count, duration);
+    pthread_t thread;
+    pthread_create(&thread, NULL, histogramThread, &samples);
+    pthread_join(thread, NULL);
+}
+
+TEST(testTaskStatistics)
+{
+    // the min and max durations are ignored, and the expected duration is
+    // the mean plus two standard deviations of the other ones
+    for (int i = 0; i < 62; ++i) {
+        ptr<Task> t = new StatisticsTask();
+        t->setActualDuration(i % 2 == 0 ? 90.0f : 110.0f);
+    }
+    ptr<Task> t = new StatisticsTask();
+    t->setActualDuration(1.0f);
+    t = new StatisticsTask();
+    t->setActualDuration(10000.0f);
+    t = new StatisticsTask();
+    ASSERT(fabs(t->getExpectedDuration() - 120.0f) < 0.01f);
+}
+
+TEST(testTaskDurationPercentiles)
+{
+    Task::setCollectHistograms(true);
+    ASSERT(Task::getDurationPercentile(&typeid(HistogramTask), 50.0f) == -1.0f);
+    addHistogramSamples(90, 100.0f);
+    addHistogramSamples(10, 10000.0f);
+    Task::setCollectHistograms(false);
+    // the percentiles are the centers of the bins [2^(i/4),2^((i+1)/4)]
+    // containing the sample durations
+    float p50 = Task::getDurationPercentile(&typeid(HistogramTask), 50.0f);
+    float p90 = Task::getDurationPercentile(&typeid(HistogramTask), 90.0f);
+    float p99 = Task::getDurationPercentile(&typeid(HistogramTask), 99.0f);
+    ASSERT(p50 > pow(2.0f, 26.0f / 4.0f) && p50 < pow(2.0f, 27.0f / 4.0f));
+    ASSERT(p90 == p50);
+    ASSERT(p99 > pow(2.0f, 53.0f / 4.0f) && p99 < pow(2.0f, 54.0f / 4.0f));
+    ASSERT(Task::getDurationPercentile(&typeid(StatisticsTask), 50.0f) == -1.0f);
+}
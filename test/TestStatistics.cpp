@@ -0,0 +1,87 @@
+/*
+ * Ork: a small object-oriented OpenGL Rendering Kernel.
+ * Website : http://ork.gforge.inria.fr/
+ * Copyright (c) 2008-2015 INRIA - LJK (CNRS - Grenoble University)
+ * All rights reserved.
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors 
+ * may be used to endorse or promote products derived from this software without 
+ * specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF 
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Ork is distributed under the BSD3 Licence. 
+ * For any assistance, feedback and remarks, you can check out the 
+ * mailing list on the project page : 
+ * http://ork.gforge.inria.fr/
+ */
+/*
+ * Main authors: Eric Bruneton, Antoine Begault, Guillaume Piolat.
+ */
+
+#include "test/Test.h"
+
+#include <pthread.h>
+
+#include "ork/core/Statistics.h"
+
+using namespace std;
+using namespace ork;
+
+void *countEvents(void *arg)
+{
+    Statistics::add(*((int*) arg), 3);
+    return NULL;
+}
+
+TEST(statisticsCounters)
+{
+    int counter = Statistics::registerCounter("testEvents");
+    ASSERT(counter > Statistics::STATE_CALLS && Statistics::getName(counter) == "testEvents");
+    Statistics::endFrame();
+    Statistics::add(counter, 2);
+    // the events of all the threads are summed
+    pthread_t thread;
+    pthread_create(&thread, NULL, countEvents, &counter);
+    pthread_join(thread, NULL);
+    // invalid counter ids are ignored
+    Statistics::add(-1);
+    Statistics::add(Statistics::MAX_COUNTERS);
+    Statistics::endFrame();
+    ASSERT(Statistics::get(counter) == 5);
+    ASSERT(Statistics::toString().find("testEvents 5") != string::npos);
+    Statistics::endFrame();
+    ASSERT(Statistics::get(counter) == 0 && Statistics::get(-1) == 0);
+}
+
+TEST(statisticsTooManyCounters)
+{
+    int counter = 0;
+    while (counter != -1) {
+        counter = Statistics::registerCounter("unusedEvents");
+    }
+    ASSERT(Statistics::getCounterCount() == Statistics::MAX_COUNTERS);
+    Statistics::add(counter);
+    Statistics::endFrame();
+    ASSERT(Statistics::getName(counter) == "" && Statistics::get(counter) == 0);
+}
@@ -41,6 +41,11 @@
 
 #include "test/Test.h"
 
+#include <sstream>
+
+#include <GL/glew.h>
+
+#include "ork/core/Statistics.h"
 #include "ork/render/FrameBuffer.h"
 
 using namespace std;
@@ -300,3 +305,97 @@ TEST(automaticSamplerBinding)
     }
     ASSERT(ok);
 }
+
+TEST(textureUnitBindingCalls)
+{
+    GLint n;
+    glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &n);
+    n = std::min(n, MAX_TEXTURE_UNITS);
+    vector< ptr<Texture2D> > textures;
+    vector< ptr<Program> > programs;
+    for (int i = 0; i <= n; ++i) {
+        GLint value = i;
+        textures.push_back(new Texture2D(1, 1, R32I, RED_INTEGER, INT,
+            Texture::Parameters().mag(NEAREST),  Buffer::Parameters(), CPUBuffer(&value)));
+        ptr<Program> p = new Program(new Module(330, NULL, "\
+            uniform isampler2D tex;\n\
+            layout(location=0) out ivec4 color;\n\
+            void main() { color = texture(tex, vec2(0.5)); }\n"));
+        p->getUniformSampler("tex")->set(textures[i]);
+        programs.push_back(p);
+    }
+    ptr<FrameBuffer> fb = getFrameBuffer(RenderBuffer::R32I, 1, 1);
+    // a first pass binds the first n textures to the n texture units, the
+    // first one being the least recently bound; the second pass draws again
+    // with the first texture, then with a new texture, which must evict the
+    // least recently bound one, i.e. the second texture, and then with the
+    // first, second and fourth textures (the third one is evicted by the
+    // second one)
+    // the binding calls of each draw of the second pass are counted as the
+    // events of one frame (see Statistics#endFrame)
+    int order[5] = { 0, n, 0, 1, 3 };
+    unsigned int calls[5];
+    unsigned int avoided[5];
+    bool ok = true;
+    for (int i = 0; i < n + 5; ++i) {
+        int p = i < n ? i : order[i - n];
+        GLint pixel;
+        fb->clear(true, true, true);
+        fb->drawQuad(programs[p]);
+        fb->readPixels(0, 0, 1, 1, RED_INTEGER, INT, Buffer::Parameters(), CPUBuffer(&pixel));
+        ok = ok && (pixel == p);
+        Statistics::endFrame();
+        if (i >= n) {
+            calls[i - n] = Statistics::get(Statistics::TEXTURE_CALLS);
+            avoided[i - n] = Statistics::get(Statistics::AVOIDED_TEXTURE_CALLS);
+        }
+    }
+    ASSERT(ok &&
+        calls[0] == 0 && avoided[0] > 0 && // first texture still bound
+        calls[1] > 0 && // new texture
+        calls[2] == 0 && avoided[2] > 0 && // first texture still bound
+        calls[3] > 0 && // second texture evicted
+        calls[4] == 0 && avoided[4] > 0); // fourth texture still bound
+}
+
+TEST4(bindlessTextures)
+{
+    // with bindless textures the sampler array is in an uniform block, which
+    // stores the texture handles, otherwise its textures are all bound to
+    // texture units; in both cases the draws select their texture with an
+    // index, without any texture binding
+    ptr<Program> p = new Program(new Module(400, NULL, "\
+        #ifdef GL_ARB_bindless_texture\n\
+        #extension GL_ARB_bindless_texture : require\n\
+        uniform Textures { isampler2D textures[4]; };\n\
+        #else\n\
+        uniform isampler2D textures[4];\n\
+        #endif\n\
+        uniform int index;\n\
+        layout(location=0) out ivec4 color;\n\
+        void main() { color = texture(textures[index], vec2(0.5)); }\n"));
+    p->setBindless(true);
+    for (int i = 0; i < 4; ++i) {
+        GLint value = 10 + i;
+        ostringstream name;
+        name << "textures[" << i << "]";
+        p->getUniformSampler(name.str())->set(new Texture2D(1, 1, R32I, RED_INTEGER, INT,
+            Texture::Parameters().mag(NEAREST),  Buffer::Parameters(), CPUBuffer(&value)));
+    }
+    ptr<FrameBuffer> fb = getFrameBuffer(RenderBuffer::R32I, 1, 1);
+    bool ok = true;
+    unsigned int calls = 0;
+    for (int i = 0; i < 4; ++i) {
+        GLint pixel;
+        p->getUniform1i("index")->set(i);
+        fb->clear(true, true, true);
+        fb->drawQuad(p);
+        fb->readPixels(0, 0, 1, 1, RED_INTEGER, INT, Buffer::Parameters(), CPUBuffer(&pixel));
+        ok = ok && (pixel == 10 + i);
+        Statistics::endFrame();
+        if (i > 0) {
+            calls += Statistics::get(Statistics::TEXTURE_CALLS);
+        }
+    }
+    ASSERT(ok && calls == 0 && p->isBindless() == Texture::isBindlessSupported());
+}
@@ -41,7 +41,9 @@
 
 #include "test/Test.h"
 
+#include "ork/core/Statistics.h"
 #include "ork/render/FrameBuffer.h"
+#include "ork/render/RingBuffer.h"
 
 using namespace std;
 using namespace ork;
@@ -459,3 +461,37 @@ TEST(automaticUniformBlockBufferBinding)
     }
     ASSERT(ok);
 }
+
+TEST(streamedUniformBlock)
+{
+    ptr<FrameBuffer> fb = getFrameBuffer(RenderBuffer::R32F, 1, 1);
+    ptr<Program> p1 = new Program(new Module(330, NULL, "\
+        uniform s { float u; };\n\
+        layout(location=0) out vec4 color;\n\
+        void main() { color = vec4(u, 0.0, 0.0, 0.0); }\n"));
+    ptr<Program> p2 = new Program(new Module(330, NULL, "\
+        uniform s { float u; };\n\
+        layout(location=0) out vec4 color;\n\
+        void main() { color = vec4(2.0 * u, 0.0, 0.0, 0.0); }\n"));
+    // the two programs share the buffer, and thus the stream, of block s
+    ptr<RingBuffer> stream = new RingBuffer(4096);
+    p1->getUniformBlock("s")->setStreamBuffer(stream);
+    GLfloat pixels[4][4];
+    Statistics::endFrame();
+    p1->getUniform1f("u")->set(1.0f);
+    fb->drawQuad(p1);
+    fb->readPixels(0, 0, 1, 1, RGBA, FLOAT, Buffer::Parameters(), CPUBuffer(&pixels[0]));
+    p1->getUniform1f("u")->set(3.0f);
+    fb->drawQuad(p1);
+    fb->readPixels(0, 0, 1, 1, RGBA, FLOAT, Buffer::Parameters(), CPUBuffer(&pixels[1]));
+    // program switches must not copy the unmodified values again
+    fb->drawQuad(p2);
+    fb->readPixels(0, 0, 1, 1, RGBA, FLOAT, Buffer::Parameters(), CPUBuffer(&pixels[2]));
+    fb->drawQuad(p1);
+    fb->readPixels(0, 0, 1, 1, RGBA, FLOAT, Buffer::Parameters(), CPUBuffer(&pixels[3]));
+    Statistics::endFrame();
+    unsigned int uploads = Statistics::get(Statistics::UNIFORM_UPLOADS);
+    stream->nextFrame();
+    p1->getUniformBlock("s")->setStreamBuffer(NULL);
+    ASSERT(pixels[0][0] == 1.0f && pixels[1][0] == 3.0f && pixels[2][0] == 6.0f && pixels[3][0] == 3.0f && uploads == 2);
+}